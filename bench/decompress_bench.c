@@ -0,0 +1,175 @@
+/*********************************************************************
+  Benchmark for decompressing large multi-block buffers.
+
+  Compresses a set of chunks that, together, are much larger than the
+  caches, and then decompresses them round robin into a single
+  destination.  This way the compressed blocks always come cold from
+  memory, as when decompressing a large dataset, which is where the
+  start of every block waiting on cache misses shows up.
+
+  Usage: decompress_bench [total_mb [blocksize_kb [nthreads]]]
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#if defined(_WIN32)
+  /* For QueryPerformanceCounter(), etc. */
+  #include <windows.h>
+#else
+  #include <time.h>
+#endif
+
+#include "../blosc/blosc.h"
+
+#define KB  1024
+#define MB  (1024*KB)
+
+/* The uncompressed size of every chunk */
+#define CHUNKSIZE  (4*MB)
+#define NITER 3
+
+
+/* System-specific high-precision timing functions. */
+#if defined(_WIN32)
+
+#define blosc_timestamp_t LARGE_INTEGER
+
+static void blosc_set_timestamp(blosc_timestamp_t* timestamp) {
+  QueryPerformanceCounter(timestamp);
+}
+
+static double blosc_elapsed_secs(blosc_timestamp_t start_time, blosc_timestamp_t end_time) {
+  LARGE_INTEGER CounterFreq;
+  QueryPerformanceFrequency(&CounterFreq);
+
+  return (double)(end_time.QuadPart - start_time.QuadPart) / (double)CounterFreq.QuadPart;
+}
+
+#else
+
+#define blosc_timestamp_t struct timespec
+
+static void blosc_set_timestamp(blosc_timestamp_t* timestamp) {
+  clock_gettime(CLOCK_MONOTONIC, timestamp);
+}
+
+static double blosc_elapsed_secs(blosc_timestamp_t start_time, blosc_timestamp_t end_time) {
+  return (double)(end_time.tv_sec - start_time.tv_sec)
+         + 1e-9 * (double)(end_time.tv_nsec - start_time.tv_nsec);
+}
+
+#endif
+
+
+/* Return the bandwidth (in MB/s of uncompressed data) of the best of
+   NITER round robin decompressions of all the chunks */
+static double bandwidth(void** chunks, int nchunks, uint8_t* dest,
+                        int nthreads) {
+  blosc_timestamp_t start, end;
+  double secs, best = 1e30;
+  int i, j;
+
+  for (i = 0; i < NITER; i++) {
+    blosc_set_timestamp(&start);
+    for (j = 0; j < nchunks; j++) {
+      if (blosc_decompress_ctx(chunks[j], dest, CHUNKSIZE, nthreads) != CHUNKSIZE) {
+        printf("Decompression error in chunk %d\n", j);
+        return -1;
+      }
+    }
+    blosc_set_timestamp(&end);
+    secs = blosc_elapsed_secs(start, end);
+    if (secs < best) {
+      best = secs;
+    }
+  }
+  return ((double)nchunks * CHUNKSIZE) / (best * MB);
+}
+
+
+int main(int argc, char* argv[]) {
+  static const char* compressors[] = {"blosclz", "lz4", "zstd"};
+  size_t total = 1024 * MB;
+  size_t blocksize = 32 * KB;
+  int maxthreads = 4;
+  int nchunks, i, j, c, nthreads, cbytes;
+  size_t ctotal;
+  void** chunks;
+  int32_t* src;
+  uint8_t* dest;
+  uint32_t seed = 1;
+
+  if (argc > 1) {
+    total = (size_t)atoi(argv[1]) * MB;
+  }
+  if (argc > 2) {
+    blocksize = (size_t)atoi(argv[2]) * KB;
+  }
+  if (argc > 3) {
+    maxthreads = atoi(argv[3]);
+  }
+  nchunks = (int)(total / CHUNKSIZE);
+  if (nchunks <= 0 || maxthreads <= 0) {
+    printf("Usage: %s [total_mb [blocksize_kb [nthreads]]]\n", argv[0]);
+    return 1;
+  }
+
+  src = malloc(CHUNKSIZE);
+  dest = malloc(CHUNKSIZE);
+  chunks = calloc((size_t)nchunks, sizeof(void*));
+  if (src == NULL || dest == NULL || chunks == NULL) {
+    printf("Cannot allocate the buffers\n");
+    return 1;
+  }
+
+  blosc_init();
+  printf("Decompressing %d chunks of %d MB (%zu KB blocks) round robin\n",
+         nchunks, CHUNKSIZE / MB, blocksize / KB);
+  printf("%10s %10s %8s %12s\n", "codec", "ratio", "threads", "MB/s");
+
+  for (c = 0; c < (int)(sizeof(compressors) / sizeof(compressors[0])); c++) {
+    if (blosc_compname_to_compcode(compressors[c]) < 0) {
+      /* Not available in this build */
+      continue;
+    }
+    ctotal = 0;
+    for (j = 0; j < nchunks; j++) {
+      /* A ramp with noisy low bits, so that every chunk is different and
+         only moderately compressible */
+      for (i = 0; i < CHUNKSIZE / (int)sizeof(int32_t); i++) {
+        seed = seed * 1103515245 + 12345;
+        src[i] = (int32_t)((j * CHUNKSIZE + i) * 4 + ((seed >> 16) & 0x3ff));
+      }
+      chunks[j] = malloc(CHUNKSIZE + BLOSC_MAX_OVERHEAD);
+      if (chunks[j] == NULL) {
+        printf("Cannot allocate the chunks\n");
+        return 1;
+      }
+      cbytes = blosc_compress_ctx(5, BLOSC_SHUFFLE, sizeof(int32_t), CHUNKSIZE,
+                                  src, chunks[j], CHUNKSIZE + BLOSC_MAX_OVERHEAD,
+                                  compressors[c], blocksize, 1);
+      if (cbytes <= 0) {
+        printf("Compression error with %s\n", compressors[c]);
+        return 1;
+      }
+      ctotal += (size_t)cbytes;
+    }
+    for (nthreads = 1; nthreads <= maxthreads; nthreads *= 2) {
+      printf("%10s %10.2f %8d %12.1f\n", compressors[c],
+             (double)nchunks * CHUNKSIZE / (double)ctotal, nthreads,
+             bandwidth(chunks, nchunks, dest, nthreads));
+    }
+    for (j = 0; j < nchunks; j++) {
+      free(chunks[j]);
+    }
+  }
+
+  blosc_destroy();
+  free(src);
+  free(dest);
+  free(chunks);
+  return 0;
+}
@@ -0,0 +1,259 @@
+/*********************************************************************
+  Benchmark for backing large buffers with huge pages.
+
+  Bitshuffles a large buffer block by block, which walks every block
+  with strides of blocksize/8 bytes and so misses the TLB a lot with
+  4 KB pages, and then decompresses a bitshuffled buffer of the same
+  size.  Both are run with the buffers (and the internal scratch of
+  Blosc) in regular pages and in huge pages, as given by
+  blosc_set_hugepages().  The internal bitshuffle routines are only
+  exported by the testing library, so this is built along with the
+  tests.
+
+  Usage: hugepage_bench [size_mb [blocksize_kb [typesize [niter]]]]
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#if defined(_WIN32)
+  /* For QueryPerformanceCounter(), etc. */
+  #include <windows.h>
+#else
+  #include <time.h>
+#endif
+#if defined(__linux__)
+  #include <sys/mman.h>
+#endif
+
+#include "../blosc/blosc.h"
+#include "../blosc/shuffle.h"
+
+#define KB  1024
+#define MB  (1024*KB)
+
+
+/* System-specific high-precision timing functions. */
+#if defined(_WIN32)
+
+#define blosc_timestamp_t LARGE_INTEGER
+
+static void blosc_set_timestamp(blosc_timestamp_t* timestamp) {
+  QueryPerformanceCounter(timestamp);
+}
+
+static double blosc_elapsed_secs(blosc_timestamp_t start_time, blosc_timestamp_t end_time) {
+  LARGE_INTEGER CounterFreq;
+  QueryPerformanceFrequency(&CounterFreq);
+
+  return (double)(end_time.QuadPart - start_time.QuadPart) / (double)CounterFreq.QuadPart;
+}
+
+#else
+
+#define blosc_timestamp_t struct timespec
+
+static void blosc_set_timestamp(blosc_timestamp_t* timestamp) {
+  clock_gettime(CLOCK_MONOTONIC, timestamp);
+}
+
+static double blosc_elapsed_secs(blosc_timestamp_t start_time, blosc_timestamp_t end_time) {
+  return (double)(end_time.tv_sec - start_time.tv_sec)
+         + 1e-9 * (double)(end_time.tv_nsec - start_time.tv_nsec);
+}
+
+#endif
+
+
+/* Allocate a buffer for the benchmark in the pages of `hugepages`.  The
+   regular pages are forced where the system would use huge pages for
+   every large buffer anyway. */
+static uint8_t* bench_malloc(size_t size, int hugepages) {
+  uint8_t* buf = blosc_malloc(size);
+
+#if defined(__linux__) && defined(MADV_NOHUGEPAGE)
+  if (buf != NULL && !hugepages) {
+    /* madvise() wants the start of a page */
+    uintptr_t start = ((uintptr_t)buf + 4095) & ~(uintptr_t)4095;
+    if (start < (uintptr_t)buf + size) {
+      madvise((void*)start, (uintptr_t)buf + size - start, MADV_NOHUGEPAGE);
+    }
+  }
+#else
+  (void)hugepages;
+#endif
+  return buf;
+}
+
+/* The kB of anonymous memory in huge pages of this process, or -1 if
+   not known */
+static long anon_hugepages_kb(void) {
+  long kb = -1;
+#if defined(__linux__)
+  char line[256];
+  FILE* f = fopen("/proc/self/smaps_rollup", "r");
+
+  if (f == NULL) {
+    return -1;
+  }
+  while (fgets(line, sizeof(line), f) != NULL) {
+    if (sscanf(line, "AnonHugePages: %ld kB", &kb) == 1) {
+      break;
+    }
+  }
+  fclose(f);
+#endif
+  return kb;
+}
+
+/* Return the throughput (in MB/s) of the best of `niter` block-wise
+   bitshuffles (or bitunshuffles) of the whole buffer */
+static double bitshuffle_throughput(int unshuffle, size_t typesize,
+                                    size_t blocksize, size_t size,
+                                    const uint8_t* src, uint8_t* dest,
+                                    uint8_t* tmp, int niter) {
+  blosc_timestamp_t start, end;
+  double secs, best = 1e30;
+  size_t offset;
+  int i;
+
+  for (i = 0; i < niter; i++) {
+    blosc_set_timestamp(&start);
+    for (offset = 0; offset + blocksize <= size; offset += blocksize) {
+      if (unshuffle) {
+        blosc_internal_bitunshuffle(typesize, blocksize, src + offset,
+                                    dest + offset, tmp);
+      }
+      else {
+        blosc_internal_bitshuffle(typesize, blocksize, src + offset,
+                                  dest + offset, tmp);
+      }
+    }
+    blosc_set_timestamp(&end);
+    secs = blosc_elapsed_secs(start, end);
+    if (secs < best) {
+      best = secs;
+    }
+  }
+  return (double)(size / blocksize * blocksize) / (best * MB);
+}
+
+/* Return the throughput (in MB/s) of the best of `niter` decompressions
+   of a bitshuffled buffer */
+static double decompress_throughput(size_t typesize, size_t blocksize,
+                                    size_t size, const uint8_t* src,
+                                    uint8_t* comp, uint8_t* dest, int niter) {
+  blosc_timestamp_t start, end;
+  double secs, best = 1e30;
+  int i, csize;
+
+  csize = blosc_compress_ctx(1, BLOSC_BITSHUFFLE, typesize, size, src, comp,
+                             size + BLOSC_MAX_OVERHEAD, "blosclz", blocksize, 1);
+  if (csize <= 0) {
+    printf("Compression error: %d\n", csize);
+    return -1;
+  }
+  for (i = 0; i < niter; i++) {
+    blosc_set_timestamp(&start);
+    if (blosc_decompress(comp, dest, size) != (int)size) {
+      printf("Decompression error\n");
+      return -1;
+    }
+    blosc_set_timestamp(&end);
+    secs = blosc_elapsed_secs(start, end);
+    if (secs < best) {
+      best = secs;
+    }
+  }
+  if (memcmp(src, dest, size) != 0) {
+    printf("Roundtrip failed!\n");
+    return -1;
+  }
+  return (double)size / (best * MB);
+}
+
+
+int main(int argc, char* argv[]) {
+  static const char* modes[] = {"regular pages", "huge pages"};
+  size_t size = 256 * MB;
+  size_t blocksize = 4 * MB;
+  size_t typesize = 4;
+  int niter = 3;
+  int hugepages;
+  size_t i;
+  uint8_t *src, *dest, *comp, *tmp;
+  uint32_t seed = 1;
+
+  if (argc > 1) {
+    size = (size_t)atoi(argv[1]) * MB;
+  }
+  if (argc > 2) {
+    blocksize = (size_t)atoi(argv[2]) * KB;
+  }
+  if (argc > 3) {
+    typesize = (size_t)atoi(argv[3]);
+  }
+  if (argc > 4) {
+    niter = atoi(argv[4]);
+  }
+  if (size == 0 || size > (size_t)BLOSC_MAX_BUFFERSIZE || blocksize == 0 ||
+      blocksize > size || blocksize % (8 * typesize) != 0 ||
+      typesize == 0 || typesize > BLOSC_MAX_TYPESIZE || niter <= 0) {
+    printf("Usage: %s [size_mb [blocksize_kb [typesize [niter]]]]\n", argv[0]);
+    printf("The blocksize must be a multiple of 8 * typesize\n");
+    return 1;
+  }
+
+  printf("Buffer size: %zu MB, blocksize: %zu KB, typesize: %zu\n",
+         size / MB, blocksize / KB, typesize);
+  printf("%14s %16s %18s %16s %14s\n", "", "bitshuffle MB/s",
+         "bitunshuffle MB/s", "decompress MB/s", "huge pages MB");
+
+  for (hugepages = 0; hugepages <= 1; hugepages++) {
+    double shuf, unshuf, decomp;
+    long hugekb;
+
+    /* Start from scratch, so that the internal buffers are allocated
+       with the new setting */
+    blosc_set_hugepages(hugepages);
+    blosc_init();
+    blosc_set_nthreads(1);
+
+    src = bench_malloc(size, hugepages);
+    dest = bench_malloc(size, hugepages);
+    comp = bench_malloc(size + BLOSC_MAX_OVERHEAD, hugepages);
+    tmp = bench_malloc(blocksize, hugepages);
+    if (src == NULL || dest == NULL || comp == NULL || tmp == NULL) {
+      printf("Cannot allocate %zu MB buffers\n", size / MB);
+      return 1;
+    }
+    /* A noisy ramp, and touch all the pages of the buffers */
+    for (i = 0; i < size / sizeof(int32_t); i++) {
+      seed = seed * 1103515245 + 12345;
+      ((int32_t*)src)[i] = (int32_t)(i * 4 + ((seed >> 16) & 0x3ff));
+    }
+    memset(dest, 0, size);
+    memset(comp, 0, size + BLOSC_MAX_OVERHEAD);
+
+    shuf = bitshuffle_throughput(0, typesize, blocksize, size, src, dest,
+                                 tmp, niter);
+    unshuf = bitshuffle_throughput(1, typesize, blocksize, size, dest, comp,
+                                   tmp, niter);
+    decomp = decompress_throughput(typesize, blocksize, size, src, comp, dest,
+                                   niter);
+    hugekb = anon_hugepages_kb();
+    printf("%14s %16.1f %18.1f %16.1f %14ld\n", modes[hugepages], shuf, unshuf,
+           decomp, (hugekb < 0) ? -1 : hugekb / KB);
+
+    blosc_free(src);
+    blosc_free(dest);
+    blosc_free(comp);
+    blosc_free(tmp);
+    blosc_destroy();
+  }
+
+  blosc_set_hugepages(0);
+  return 0;
+}
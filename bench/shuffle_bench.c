@@ -0,0 +1,154 @@
+/*********************************************************************
+  Benchmark for the shuffle/unshuffle routines.
+
+  Measures the throughput of the accelerated shuffle and unshuffle
+  (whatever implementation is selected for the host processor) against
+  the generic ones, for a range of type sizes.  The internal routines
+  are only exported by the testing library, so this is built along
+  with the tests.
+
+  Usage: shuffle_bench [blocksize_kb [niter]]
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#if defined(_WIN32)
+  /* For QueryPerformanceCounter(), etc. */
+  #include <windows.h>
+#else
+  #include <time.h>
+#endif
+
+#include "../blosc/shuffle.h"
+#include "../blosc/shuffle-generic.h"
+
+#define KB  1024
+#define MB  (1024*KB)
+
+
+/* System-specific high-precision timing functions. */
+#if defined(_WIN32)
+
+#define blosc_timestamp_t LARGE_INTEGER
+
+static void blosc_set_timestamp(blosc_timestamp_t* timestamp) {
+  QueryPerformanceCounter(timestamp);
+}
+
+static double blosc_elapsed_secs(blosc_timestamp_t start_time, blosc_timestamp_t end_time) {
+  LARGE_INTEGER CounterFreq;
+  QueryPerformanceFrequency(&CounterFreq);
+
+  return (double)(end_time.QuadPart - start_time.QuadPart) / (double)CounterFreq.QuadPart;
+}
+
+#else
+
+#define blosc_timestamp_t struct timespec
+
+static void blosc_set_timestamp(blosc_timestamp_t* timestamp) {
+  clock_gettime(CLOCK_MONOTONIC, timestamp);
+}
+
+static double blosc_elapsed_secs(blosc_timestamp_t start_time, blosc_timestamp_t end_time) {
+  return (double)(end_time.tv_sec - start_time.tv_sec)
+         + 1e-9 * (double)(end_time.tv_nsec - start_time.tv_nsec);
+}
+
+#endif
+
+
+typedef void (*shuffle_func)(const size_t, const size_t, const uint8_t*, const uint8_t*);
+
+/* Return the throughput (in MB/s) of the best of `niter` runs over a block */
+static double throughput(shuffle_func func, size_t typesize, size_t blocksize,
+                         const uint8_t* src, uint8_t* dest, int niter) {
+  blosc_timestamp_t start, end;
+  double secs, best = 1e30;
+  int i, j;
+  /* Repeat enough times for the clock resolution not to matter */
+  int nrep = (int)(64 * MB / blocksize) + 1;
+
+  for (i = 0; i < niter; i++) {
+    blosc_set_timestamp(&start);
+    for (j = 0; j < nrep; j++) {
+      func(typesize, blocksize, src, dest);
+    }
+    blosc_set_timestamp(&end);
+    secs = blosc_elapsed_secs(start, end);
+    if (secs < best) {
+      best = secs;
+    }
+  }
+  return ((double)blocksize * nrep) / (best * MB);
+}
+
+static void shuffle_generic(const size_t typesize, const size_t blocksize,
+                            const uint8_t* src, const uint8_t* dest) {
+  blosc_internal_shuffle_generic(typesize, blocksize, src, (uint8_t*)dest);
+}
+
+static void unshuffle_generic(const size_t typesize, const size_t blocksize,
+                              const uint8_t* src, const uint8_t* dest) {
+  blosc_internal_unshuffle_generic(typesize, blocksize, src, (uint8_t*)dest);
+}
+
+
+int main(int argc, char* argv[]) {
+  static const size_t typesizes[] = {2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13,
+                                     14, 15, 16, 20, 24, 32, 48};
+  size_t blocksize = 256 * KB;
+  int niter = 5;
+  uint8_t *src, *dest, *dest2;
+  size_t i;
+
+  if (argc > 1) {
+    blocksize = (size_t)atoi(argv[1]) * KB;
+  }
+  if (argc > 2) {
+    niter = atoi(argv[2]);
+  }
+  if (blocksize == 0 || niter <= 0) {
+    printf("Usage: %s [blocksize_kb [niter]]\n", argv[0]);
+    return 1;
+  }
+
+  src = malloc(blocksize);
+  dest = malloc(blocksize);
+  dest2 = malloc(blocksize);
+  if (src == NULL || dest == NULL || dest2 == NULL) {
+    printf("Cannot allocate %zu bytes\n", blocksize);
+    return 1;
+  }
+  for (i = 0; i < blocksize; i++) {
+    src[i] = (uint8_t)(i * 7 + (i >> 9));
+  }
+
+  printf("Blocksize: %zu KB, CPU features: 0x%x\n", blocksize / KB,
+         blosc_internal_cpu_features());
+  printf("%8s %14s %14s %16s %16s\n", "typesize", "shuffle MB/s",
+         "generic MB/s", "unshuffle MB/s", "generic MB/s");
+  for (i = 0; i < sizeof(typesizes) / sizeof(typesizes[0]); i++) {
+    const size_t typesize = typesizes[i];
+    double shuf, shuf_gen, unshuf, unshuf_gen;
+
+    shuf = throughput(blosc_internal_shuffle, typesize, blocksize, src, dest, niter);
+    shuf_gen = throughput(shuffle_generic, typesize, blocksize, src, dest, niter);
+    unshuf = throughput(blosc_internal_unshuffle, typesize, blocksize, dest, dest2, niter);
+    unshuf_gen = throughput(unshuffle_generic, typesize, blocksize, dest, dest2, niter);
+    if (memcmp(src, dest2, blocksize) != 0) {
+      printf("Roundtrip failed for typesize %zu!\n", typesize);
+      return 1;
+    }
+    printf("%8zu %14.1f %14.1f %16.1f %16.1f\n", typesize,
+           shuf, shuf_gen, unshuf, unshuf_gen);
+  }
+
+  free(src);
+  free(dest);
+  free(dest2);
+  return 0;
+}
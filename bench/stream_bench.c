@@ -0,0 +1,186 @@
+/*********************************************************************
+  Benchmark for the non-temporal (streaming) stores.
+
+  Measures the bandwidth of copying a large buffer block by block with
+  regular and with non-temporal stores, and then the bandwidth of
+  decompressing a buffer of the same size, both for a memcpyed chunk
+  and for a shuffled one.  Blosc only switches to non-temporal stores
+  when the destination is larger than the last level cache, so pass a
+  size above it for the decompression figures to use them.  The
+  internal copy routines are only exported by the testing library, so
+  this is built along with the tests.
+
+  Usage: stream_bench [size_mb [niter]]
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#if defined(_WIN32)
+  /* For QueryPerformanceCounter(), etc. */
+  #include <windows.h>
+#else
+  #include <time.h>
+#endif
+
+#include "../blosc/blosc.h"
+#include "../blosc/fastcopy.h"
+#include "../blosc/shuffle.h"
+
+#define KB  1024
+#define MB  (1024*KB)
+
+/* The size of the blocks copied, as for a memcpyed chunk */
+#define COPY_BLOCKSIZE  (256*KB)
+
+
+/* System-specific high-precision timing functions. */
+#if defined(_WIN32)
+
+#define blosc_timestamp_t LARGE_INTEGER
+
+static void blosc_set_timestamp(blosc_timestamp_t* timestamp) {
+  QueryPerformanceCounter(timestamp);
+}
+
+static double blosc_elapsed_secs(blosc_timestamp_t start_time, blosc_timestamp_t end_time) {
+  LARGE_INTEGER CounterFreq;
+  QueryPerformanceFrequency(&CounterFreq);
+
+  return (double)(end_time.QuadPart - start_time.QuadPart) / (double)CounterFreq.QuadPart;
+}
+
+#else
+
+#define blosc_timestamp_t struct timespec
+
+static void blosc_set_timestamp(blosc_timestamp_t* timestamp) {
+  clock_gettime(CLOCK_MONOTONIC, timestamp);
+}
+
+static double blosc_elapsed_secs(blosc_timestamp_t start_time, blosc_timestamp_t end_time) {
+  return (double)(end_time.tv_sec - start_time.tv_sec)
+         + 1e-9 * (double)(end_time.tv_nsec - start_time.tv_nsec);
+}
+
+#endif
+
+
+typedef unsigned char* (*copy_func)(unsigned char*, const unsigned char*, unsigned);
+
+/* Return the bandwidth (in MB/s) of the best of `niter` block-wise copies */
+static double copy_bandwidth(copy_func func, size_t size, const uint8_t* src,
+                             uint8_t* dest, int niter) {
+  blosc_timestamp_t start, end;
+  double secs, best = 1e30;
+  size_t offset, len;
+  int i;
+
+  for (i = 0; i < niter; i++) {
+    blosc_set_timestamp(&start);
+    for (offset = 0; offset < size; offset += COPY_BLOCKSIZE) {
+      len = (size - offset < COPY_BLOCKSIZE) ? size - offset : COPY_BLOCKSIZE;
+      func(dest + offset, src + offset, (unsigned)len);
+    }
+    blosc_set_timestamp(&end);
+    secs = blosc_elapsed_secs(start, end);
+    if (secs < best) {
+      best = secs;
+    }
+  }
+  return (double)size / (best * MB);
+}
+
+/* Return the bandwidth (in MB/s) of the best of `niter` decompressions */
+static double decompress_bandwidth(int clevel, size_t size, const uint8_t* src,
+                                   uint8_t* comp, uint8_t* dest, int niter) {
+  blosc_timestamp_t start, end;
+  double secs, best = 1e30;
+  int i, csize;
+
+  csize = blosc_compress(clevel, BLOSC_SHUFFLE, sizeof(int32_t), size, src,
+                         comp, size + BLOSC_MAX_OVERHEAD);
+  if (csize <= 0) {
+    printf("Compression error: %d\n", csize);
+    return -1;
+  }
+  for (i = 0; i < niter; i++) {
+    blosc_set_timestamp(&start);
+    if (blosc_decompress(comp, dest, size) != (int)size) {
+      printf("Decompression error\n");
+      return -1;
+    }
+    blosc_set_timestamp(&end);
+    secs = blosc_elapsed_secs(start, end);
+    if (secs < best) {
+      best = secs;
+    }
+  }
+  if (memcmp(src, dest, size) != 0) {
+    printf("Roundtrip failed for clevel %d!\n", clevel);
+    return -1;
+  }
+  return (double)size / (best * MB);
+}
+
+
+int main(int argc, char* argv[]) {
+  size_t size = 512 * MB;
+  int niter = 3;
+  size_t llc_size, i;
+  uint8_t *src, *dest, *comp;
+  int32_t *isrc;
+
+  if (argc > 1) {
+    size = (size_t)atoi(argv[1]) * MB;
+  }
+  if (argc > 2) {
+    niter = atoi(argv[2]);
+  }
+  if (size == 0 || size > (size_t)BLOSC_MAX_BUFFERSIZE || niter <= 0) {
+    printf("Usage: %s [size_mb [niter]]\n", argv[0]);
+    return 1;
+  }
+
+  src = malloc(size);
+  dest = malloc(size);
+  comp = malloc(size + BLOSC_MAX_OVERHEAD);
+  if (src == NULL || dest == NULL || comp == NULL) {
+    printf("Cannot allocate %zu MB buffers\n", size / MB);
+    return 1;
+  }
+  /* Some compressible data, and touch all the pages of the buffers */
+  isrc = (int32_t*)src;
+  for (i = 0; i < size / sizeof(int32_t); i++) {
+    isrc[i] = (int32_t)i;
+  }
+  memset(dest, 0, size);
+
+  blosc_init();
+  blosc_set_nthreads(1);
+
+  llc_size = blosc_internal_llc_size();
+  printf("Buffer size: %zu MB, last level cache: %zu KB (%s)\n", size / MB,
+         llc_size / KB, (llc_size > 0 && size > llc_size) ?
+         "streaming stores used" : "streaming stores not used");
+
+  printf("Copy in %d KB blocks:\n", COPY_BLOCKSIZE / KB);
+  printf("  regular stores:\t%8.1f MB/s\n",
+         copy_bandwidth(fastcopy, size, src, dest, niter));
+  printf("  streaming stores:\t%8.1f MB/s\n",
+         copy_bandwidth(fastcopy_stream, size, src, dest, niter));
+
+  printf("Decompression:\n");
+  printf("  memcpyed (clevel 0):\t%8.1f MB/s\n",
+         decompress_bandwidth(0, size, src, comp, dest, niter));
+  printf("  shuffled (clevel 1):\t%8.1f MB/s\n",
+         decompress_bandwidth(1, size, src, comp, dest, niter));
+
+  blosc_destroy();
+  free(src);
+  free(dest);
+  free(comp);
+  return 0;
+}
@@ -0,0 +1,211 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+/* For CPU_SET() and friends */
+#define _GNU_SOURCE
+#endif
+
+#include "affinity.h"
+#include "blosc.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__linux__)
+#include <sched.h>
+#include <dirent.h>
+#endif
+
+
+#if defined(__linux__)
+
+/* Where a CPU sits in the topology of the host */
+struct cpu_place {
+  int cpu;
+  int node;       /* NUMA node, or package if the node is not known */
+  int core;       /* physical core in the package */
+  int sibling;    /* hardware thread in the core */
+  int rank;       /* position of the CPU in its node for scatter */
+};
+
+/* Read a non-negative integer from a sysfs file, or return -1 */
+static int read_sysfs_int(int cpu, const char* name) {
+  char path[128];
+  FILE* f;
+  int value = -1;
+
+  snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/%s", cpu, name);
+  f = fopen(path, "r");
+  if (f == NULL) {
+    return -1;
+  }
+  if (fscanf(f, "%d", &value) != 1) {
+    value = -1;
+  }
+  fclose(f);
+  return value;
+}
+
+/* The NUMA node of a CPU, from its nodeN entry in sysfs, or -1 */
+static int cpu_node(int cpu) {
+  char path[64];
+  DIR* dir;
+  struct dirent* entry;
+  int node = -1;
+
+  snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+  dir = opendir(path);
+  if (dir == NULL) {
+    return -1;
+  }
+  while ((entry = readdir(dir)) != NULL) {
+    if (sscanf(entry->d_name, "node%d", &node) == 1) {
+      break;
+    }
+    node = -1;
+  }
+  closedir(dir);
+  return node;
+}
+
+static int compare_compact(const void* a, const void* b) {
+  const struct cpu_place* pa = (const struct cpu_place*)a;
+  const struct cpu_place* pb = (const struct cpu_place*)b;
+
+  if (pa->node != pb->node) return pa->node - pb->node;
+  if (pa->core != pb->core) return pa->core - pb->core;
+  return pa->cpu - pb->cpu;
+}
+
+static int compare_scatter(const void* a, const void* b) {
+  const struct cpu_place* pa = (const struct cpu_place*)a;
+  const struct cpu_place* pb = (const struct cpu_place*)b;
+
+  if (pa->rank != pb->rank) return pa->rank - pb->rank;
+  return pa->node - pb->node;
+}
+
+/* Order the CPUs this process can run on following `policy` */
+static int policy_cpus(int policy, int* cpus, int maxcpus) {
+  cpu_set_t allowed;
+  struct cpu_place* places;
+  int ncpus = 0;
+  int cpu, i, j;
+
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    return -1;
+  }
+  places = malloc(CPU_SETSIZE * sizeof(struct cpu_place));
+  if (places == NULL) {
+    return -1;
+  }
+  for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (!CPU_ISSET(cpu, &allowed)) {
+      continue;
+    }
+    places[ncpus].cpu = cpu;
+    places[ncpus].node = cpu_node(cpu);
+    if (places[ncpus].node < 0) {
+      places[ncpus].node = read_sysfs_int(cpu, "topology/physical_package_id");
+    }
+    places[ncpus].core = read_sysfs_int(cpu, "topology/core_id");
+    if (places[ncpus].core < 0) {
+      /* Unknown topology: take every CPU as a core of its own */
+      places[ncpus].core = cpu;
+    }
+    ncpus++;
+  }
+
+  /* The compact order keeps the siblings of a core together */
+  qsort(places, (size_t)ncpus, sizeof(struct cpu_place), compare_compact);
+  if (policy == BLOSC_AFFINITY_SCATTER) {
+    /* Rank the CPUs of every node by sibling first, so that all the
+       physical cores come before their second hardware threads, and then
+       take the nodes round robin */
+    for (i = 0; i < ncpus; i++) {
+      places[i].sibling = 0;
+      for (j = i - 1; j >= 0 && places[j].node == places[i].node &&
+                      places[j].core == places[i].core; j--) {
+        places[i].sibling++;
+      }
+    }
+    for (i = 0; i < ncpus; i++) {
+      places[i].rank = 0;
+      for (j = 0; j < ncpus; j++) {
+        if (places[j].node == places[i].node &&
+            (places[j].sibling < places[i].sibling ||
+             (places[j].sibling == places[i].sibling && j < i))) {
+          places[i].rank++;
+        }
+      }
+    }
+    qsort(places, (size_t)ncpus, sizeof(struct cpu_place), compare_scatter);
+  }
+
+  if (ncpus > maxcpus) {
+    ncpus = maxcpus;
+  }
+  for (i = 0; i < ncpus; i++) {
+    cpus[i] = places[i].cpu;
+  }
+  free(places);
+  return ncpus;
+}
+
+int blosc_internal_affinity_cpus(int policy, const int* cores, int ncores,
+                                 int* cpus, int maxcpus) {
+  int i;
+
+  if (cores != NULL) {
+    if (ncores <= 0) {
+      return -1;
+    }
+    if (ncores > maxcpus) {
+      /* The threads past `maxcpus` would never get to them */
+      ncores = maxcpus;
+    }
+    for (i = 0; i < ncores; i++) {
+      if (cores[i] < 0 || cores[i] >= CPU_SETSIZE) {
+        return -1;
+      }
+      cpus[i] = cores[i];
+    }
+    return ncores;
+  }
+  switch (policy) {
+    case BLOSC_AFFINITY_NONE:
+      return 0;
+    case BLOSC_AFFINITY_COMPACT:
+    case BLOSC_AFFINITY_SCATTER:
+      return policy_cpus(policy, cpus, maxcpus);
+    default:
+      return -1;
+  }
+}
+
+int blosc_internal_pin_thread(int cpu) {
+  cpu_set_t set;
+
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  /* 0 is the calling thread */
+  return sched_setaffinity(0, sizeof(set), &set) == 0 ? 0 : -1;
+}
+
+#else  /* defined(__linux__) */
+
+int blosc_internal_affinity_cpus(int policy, const int* cores, int ncores,
+                                 int* cpus, int maxcpus) {
+  (void)cores; (void)ncores; (void)cpus; (void)maxcpus;
+  return (cores == NULL && policy == BLOSC_AFFINITY_NONE) ? 0 : -1;
+}
+
+int blosc_internal_pin_thread(int cpu) {
+  (void)cpu;
+  return -1;
+}
+
+#endif  /* defined(__linux__) */
@@ -0,0 +1,42 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* Placement of the threads of the pool on the CPUs of the host. */
+
+#ifndef BLOSC_AFFINITY_H
+#define BLOSC_AFFINITY_H
+
+#include "blosc-common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+  Fill `cpus` with up to `maxcpus` CPU numbers in the order that the
+  threads of a pool should be pinned to them, as given by `policy` (one
+  of the BLOSC_AFFINITY_* values).  If `cores` is not NULL, its `ncores`
+  CPUs are used in that order instead, regardless of the policy.
+
+  Return the number of CPUs in `cpus`, 0 for BLOSC_AFFINITY_NONE, or a
+  negative value if the policy or the CPUs are not valid, or pinning
+  threads is not supported on this platform.
+*/
+BLOSC_NO_EXPORT int blosc_internal_affinity_cpus(int policy, const int* cores,
+                                                 int ncores, int* cpus,
+                                                 int maxcpus);
+
+/**
+  Pin the calling thread to `cpu`.  Return 0 on success or a negative
+  value otherwise.
+*/
+BLOSC_NO_EXPORT int blosc_internal_pin_thread(int cpu);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BLOSC_AFFINITY_H */
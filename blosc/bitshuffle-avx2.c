@@ -109,8 +109,8 @@ int64_t blosc_internal_bshuf_trans_bit_elem_avx2(void* in, void* out, const size
 
 /* For data organized into a row for each bit (8 * elem_size rows), transpose
  * the bytes. */
-static int64_t bshuf_trans_byte_bitrow_avx2(void* in, void* out, const size_t size,
-                                            const size_t elem_size) {
+int64_t blosc_internal_bshuf_trans_byte_bitrow_avx2(void* in, void* out, const size_t size,
+                                                    const size_t elem_size) {
 
     char* in_b = (char*) in;
     char* out_b = (char*) out;
@@ -204,8 +204,8 @@ static int64_t bshuf_trans_byte_bitrow_avx2(void* in, void* out, const size_t si
 
 
 /* Shuffle bits within the bytes of eight element blocks. */
-static int64_t bshuf_shuffle_bit_eightelem_avx2(void* in, void* out, const size_t size,
-                                                const size_t elem_size) {
+int64_t blosc_internal_bshuf_shuffle_bit_eightelem_avx2(void* in, void* out, const size_t size,
+                                                        const size_t elem_size) {
 
     CHECK_MULT_EIGHT(size);
 
@@ -248,9 +248,9 @@ int64_t blosc_internal_bshuf_untrans_bit_elem_avx2(void* in, void* out, const si
 
     CHECK_MULT_EIGHT(size);
 
-    count = bshuf_trans_byte_bitrow_avx2(in, tmp_buf, size, elem_size);
+    count = blosc_internal_bshuf_trans_byte_bitrow_avx2(in, tmp_buf, size, elem_size);
     CHECK_ERR(count);
-    count =  bshuf_shuffle_bit_eightelem_avx2(tmp_buf, out, size, elem_size);
+    count =  blosc_internal_bshuf_shuffle_bit_eightelem_avx2(tmp_buf, out, size, elem_size);
 
     return count;
 }
@@ -31,6 +31,20 @@ BLOSC_NO_EXPORT int64_t
 blosc_internal_bshuf_untrans_bit_elem_avx2(void* in, void* out, const size_t size,
                                            const size_t elem_size, void* tmp_buf);
 
+/**
+  AVX2-accelerated transpose of the bytes of a bit-row matrix.
+*/
+BLOSC_NO_EXPORT int64_t
+blosc_internal_bshuf_trans_byte_bitrow_avx2(void* in, void* out, const size_t size,
+                                            const size_t elem_size);
+
+/**
+  AVX2-accelerated shuffle of the bits within eight element blocks.
+*/
+BLOSC_NO_EXPORT int64_t
+blosc_internal_bshuf_shuffle_bit_eightelem_avx2(void* in, void* out, const size_t size,
+                                                const size_t elem_size);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,132 @@
+/*
+ * Bitshuffle - Filter for improving compression of typed binary data.
+ *
+ * AVX512BW variants of the routines in bitshuffle-avx2.c.
+ *
+ * See LICENSES/BITSHUFFLE.txt file for details about copyright and
+ * rights to use.
+ *
+ */
+
+#include "bitshuffle-generic.h"
+#include "bitshuffle-avx2.h"
+#include "bitshuffle-avx512.h"
+#include "shuffle-avx512.h"
+
+
+/* Define dummy functions if AVX512BW is not available for the compilation target and compiler. */
+#if !defined(__AVX512BW__)
+#include <stdlib.h>
+
+int64_t blosc_internal_bshuf_trans_bit_elem_avx512(void* in, void* out, const size_t size,
+                                                   const size_t elem_size, void* tmp_buf) {
+    abort();
+}
+
+int64_t blosc_internal_bshuf_untrans_bit_elem_avx512(void* in, void* out, const size_t size,
+                                                     const size_t elem_size, void* tmp_buf) {
+    abort();
+}
+
+#else /* defined(__AVX512BW__) */
+
+#include <immintrin.h>
+
+
+/* ---- Code that requires AVX512BW. Intel Skylake-SP (2017) and later. ---- */
+
+
+/* Transpose bits within bytes. */
+static int64_t bshuf_trans_bit_byte_avx512(void* in, void* out, const size_t size,
+                                           const size_t elem_size) {
+
+    char* in_b = (char*) in;
+    char* out_b = (char*) out;
+
+    size_t nbyte = elem_size * size;
+
+    int64_t count;
+
+    __m512i zmm;
+    uint64_t bt;
+    size_t ii, kk;
+
+    for (ii = 0; ii + 63 < nbyte; ii += 64) {
+        zmm = _mm512_loadu_si512((__m512i *) &in_b[ii]);
+        for (kk = 0; kk < 8; kk++) {
+            bt = _mm512_movepi8_mask(zmm);
+            zmm = _mm512_slli_epi16(zmm, 1);
+            * (uint64_t *) &out_b[((7 - kk) * nbyte + ii) / 8] = bt;
+        }
+    }
+    count = blosc_internal_bshuf_trans_bit_byte_remainder(in, out, size, elem_size,
+            nbyte - nbyte % 64);
+    return count;
+}
+
+/* Transpose bits within elements. */
+int64_t blosc_internal_bshuf_trans_bit_elem_avx512(void* in, void* out, const size_t size,
+                                                   const size_t elem_size, void* tmp_buf) {
+    int64_t count;
+
+    CHECK_MULT_EIGHT(size);
+
+    /* Transposing the bytes within elements is exactly a byte shuffle */
+    blosc_internal_shuffle_avx512(elem_size, size * elem_size, (const uint8_t*)in, (uint8_t*)out);
+    count = bshuf_trans_bit_byte_avx512(out, tmp_buf, size, elem_size);
+    CHECK_ERR(count);
+    count = blosc_internal_bshuf_trans_bitrow_eight(tmp_buf, out, size, elem_size);
+
+    return count;
+}
+
+/* Shuffle bits within the bytes of eight element blocks. */
+static int64_t bshuf_shuffle_bit_eightelem_avx512(void* in, void* out, const size_t size,
+                                                  const size_t elem_size) {
+
+    CHECK_MULT_EIGHT(size);
+
+    char* in_b = (char*) in;
+    char* out_b = (char*) out;
+
+    size_t nbyte = elem_size * size;
+    size_t ii, jj, kk, ind;
+
+    __m512i zmm;
+    uint64_t bt;
+
+    if (elem_size % 8) {
+        return blosc_internal_bshuf_shuffle_bit_eightelem_avx2(in, out, size, elem_size);
+    } else {
+        for (jj = 0; jj + 63 < 8 * elem_size; jj += 64) {
+            for (ii = 0; ii + 8 * elem_size - 1 < nbyte;
+                    ii += 8 * elem_size) {
+                zmm = _mm512_loadu_si512((__m512i *) &in_b[ii + jj]);
+                for (kk = 0; kk < 8; kk++) {
+                    bt = _mm512_movepi8_mask(zmm);
+                    zmm = _mm512_slli_epi16(zmm, 1);
+                    ind = (ii + jj / 8 + (7 - kk) * elem_size);
+                    * (uint64_t *) &out_b[ind] = bt;
+                }
+            }
+        }
+    }
+    return size * elem_size;
+}
+
+/* Untranspose bits within elements. */
+int64_t blosc_internal_bshuf_untrans_bit_elem_avx512(void* in, void* out, const size_t size,
+                                                     const size_t elem_size, void* tmp_buf) {
+
+    int64_t count;
+
+    CHECK_MULT_EIGHT(size);
+
+    count = blosc_internal_bshuf_trans_byte_bitrow_avx2(in, tmp_buf, size, elem_size);
+    CHECK_ERR(count);
+    count = bshuf_shuffle_bit_eightelem_avx512(tmp_buf, out, size, elem_size);
+
+    return count;
+}
+
+#endif /* !defined(__AVX512BW__) */
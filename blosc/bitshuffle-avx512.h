@@ -0,0 +1,36 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* AVX512BW-accelerated bitshuffle/bitunshuffle routines. */
+
+#ifndef BITSHUFFLE_AVX512_H
+#define BITSHUFFLE_AVX512_H
+
+#include "blosc-common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+  AVX512BW-accelerated bitshuffle routine.
+*/
+BLOSC_NO_EXPORT int64_t
+blosc_internal_bshuf_trans_bit_elem_avx512(void* in, void* out, const size_t size,
+                                           const size_t elem_size, void* tmp_buf);
+
+/**
+  AVX512BW-accelerated bitunshuffle routine.
+*/
+BLOSC_NO_EXPORT int64_t
+blosc_internal_bshuf_untrans_bit_elem_avx512(void* in, void* out, const size_t size,
+                                             const size_t elem_size, void* tmp_buf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BITSHUFFLE_AVX512_H */
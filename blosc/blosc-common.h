@@ -9,6 +9,13 @@
 #ifndef SHUFFLE_COMMON_H
 #define SHUFFLE_COMMON_H
 
+/* Whether `version` is a Blosc format version that can be read (the
+   symbols come from blosc.h) */
+#define BLOSC_KNOWN_VERSION(version)                                  \
+  (((version) >= 1 && (version) <= BLOSC_VERSION_FORMAT) ||           \
+   (version) == BLOSC_VERSION_FORMAT_EXTENDED ||                      \
+   (version) == BLOSC_VERSION_FORMAT_BLOCKFILTERS)
+
 #include "blosc-export.h"
 #include <string.h>
 
@@ -74,4 +81,15 @@
   #include <immintrin.h>
 #endif
 
+/*
+ * Prefetch the cache line at `addr` for reading.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+  #define BLOSC_PREFETCH(addr) __builtin_prefetch((addr), 0, 3)
+#elif defined(__SSE2__)
+  #define BLOSC_PREFETCH(addr) _mm_prefetch((const char*)(addr), _MM_HINT_T0)
+#else
+  #define BLOSC_PREFETCH(addr) ((void)(addr))
+#endif
+
 #endif  /* SHUFFLE_COMMON_H */
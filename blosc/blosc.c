@@ -22,6 +22,8 @@
 #endif /*  USING_CMAKE */
 #include "blosc.h"
 #include "shuffle.h"
+#include "crc32c.h"
+#include "affinity.h"
 #include "blosclz.h"
 #if defined(HAVE_LZ4)
   #include "lz4.h"
@@ -34,6 +36,8 @@
   #include "zlib.h"
 #endif /*  HAVE_ZLIB */
 #if defined(HAVE_ZSTD)
+  /* For ZSTD_customMem */
+  #define ZSTD_STATIC_LINKING_ONLY
   #include "zstd.h"
 #endif /*  HAVE_ZSTD */
 
@@ -56,6 +60,16 @@
   #include <inttypes.h>
 #endif  /* _WIN32 */
 
+#if defined(__linux__)
+  /* For madvise() */
+  #include <sys/mman.h>
+#endif
+
+#if defined(HAVE_SYS_SDT_H)
+  /* Static probes for tracers (see trace_event()) */
+  #include <sys/sdt.h>
+#endif
+
 /* Include the win32/pthread.h library for all the Windows builds. See #224. */
 #if defined(_WIN32)
   #include "win32/pthread.h"
@@ -64,11 +78,25 @@
   #include <pthread.h>
 #endif
 
+#if defined(BLOSC_ENABLE_STATS)
+  /* For the timestamp counter */
+  #if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    #include <intrin.h>
+  #elif defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+  #elif !defined(_WIN32)
+    #include <time.h>
+  #endif
+#endif  /* BLOSC_ENABLE_STATS */
+
 
 /* Some useful units */
 #define KB 1024
 #define MB (1024 * (KB))
 
+/* The size of the (transparent) huge pages used for large buffers */
+#define HUGEPAGE_SIZE (2 * MB)
+
 /* Minimum buffer size to be compressed */
 #define MIN_BUFFERSIZE 128       /* Cannot be smaller than 66 */
 
@@ -78,6 +106,50 @@
 /* The size of L1 cache.  32 KB is quite common nowadays. */
 #define L1 (32 * (KB))
 
+/* The size of a cache line, and how much of the next compressed block
+   to prefetch while decompressing the current one */
+#define CACHE_LINE_SIZE 64
+#define PREFETCH_SIZE (8 * CACHE_LINE_SIZE)
+
+/* The compressibility probe samples two windows of this size (at the start
+   and at the middle of a split), and looks for repeats in them with a hash
+   table of 1 << PROBE_HASH_LOG entries */
+#define PROBE_WINDOW 1024
+#define PROBE_HASH_LOG 10
+
+/* The number of blocks probed before compressing a whole buffer */
+#define PROBE_NBLOCKS 4
+
+/* The minimum size of the segments that keep the compressed blocks when
+   compressing into a sink */
+#define STAGE_SEGMENT_SIZE (1 * MB)
+
+/* With BLOSC_AUTOSHUFFLE, blocks use a fast codec if its result is at most
+   1/FAST_CODEC_SLACK larger than the one of a slower codec */
+#define FAST_CODEC_SLACK 32
+
+/* The alignment of the scratch buffers, as for the SIMD filters */
+#define SCRATCH_ALIGN 32
+
+/* Per-phase timings and counters (see blosc_get_stats()).  TIMED()
+   runs `stmt` adding the ticks it takes to `field`; without
+   BLOSC_ENABLE_STATS it only runs `stmt`. */
+#if defined(BLOSC_ENABLE_STATS)
+#define TIMED(stats, field, stmt) do {          \
+    uint64_t start_ = stats_clock();            \
+    stmt;                                       \
+    (stats)->field += stats_clock() - start_;   \
+  } while (0)
+#define COUNT(stats, field) ((stats)->field++)
+#define RESET_STATS(stats) memset((stats), 0, sizeof(struct phase_stats))
+#define PUBLISH_STATS(stats) publish_stats(stats)
+#else
+#define TIMED(stats, field, stmt) do { stmt; } while (0)
+#define COUNT(stats, field) ((void)0)
+#define RESET_STATS(stats) ((void)0)
+#define PUBLISH_STATS(stats) ((void)0)
+#endif  /* BLOSC_ENABLE_STATS */
+
 /* Have problems using posix barriers when symbol value is 200112L */
 /* This requires more investigation, but will work for the moment */
 #if defined(_POSIX_BARRIERS) && ( (_POSIX_BARRIERS - 20012L) >= 0 && _POSIX_BARRIERS != 200112L)
@@ -86,6 +158,60 @@
 /* Synchronization variables */
 
 
+/* Ticks spent in every phase and events counted by a thread or a
+   context, until they are added to the totals of the process */
+struct phase_stats {
+  uint64_t filter;                /* (un)shuffling and (un)bitshuffling */
+  uint64_t codec;                 /* running the codecs */
+  uint64_t copy;                  /* copying data stored as is */
+  uint64_t wait;                  /* threads waiting for the others */
+  uint64_t arrivals;              /* sum of the times threads got to wait */
+  uint64_t incompressible_splits;
+  uint64_t memcpy_fallbacks;
+  uint64_t recompressions;
+};
+
+/* Partial result of a reduction (one per thread) */
+struct reduce_partial {
+  int64_t nitems;                 /* Number of items visited so far */
+  union {
+    int64_t i;                    /* For signed integer types */
+    uint64_t u;                   /* For unsigned integer types */
+    double f;                     /* For floating point types */
+  } acc;                          /* Accumulator for sum, min, max and nonzero */
+  int64_t* hist;                  /* Bin counts (histogram only) */
+};
+
+/* A reduction computed over the decompressed blocks of a buffer */
+struct reduce_state {
+  int op;                         /* BLOSC_REDUCE_* code */
+  int dtype;                      /* BLOSC_INT8 ... BLOSC_FLOAT64 code */
+  int32_t itemsize;               /* Size in bytes of `dtype` */
+  double lo;                      /* Lower edge of the histogram range */
+  double hi;                      /* Upper edge of the histogram range */
+  int32_t nbins;                  /* Number of histogram bins */
+  struct reduce_partial partials[BLOSC_MAX_THREADS];
+};
+
+/* A piece of memory keeping compressed blocks of one thread; the
+   data follows the struct */
+struct stage_segment {
+  struct stage_segment* prev;     /* Previous segment of the thread */
+  int64_t size;                   /* Bytes of data in the segment */
+  int64_t used;                   /* Bytes of data filled so far */
+};
+
+/* Compression into a sink: the compressed blocks are kept in the
+   segments of every thread until the whole buffer is compressed, and
+   then passed to `func` after the header */
+struct sink_state {
+  blosc_stream_sink func;
+  void* user_data;
+  struct stage_segment* stages[BLOSC_MAX_THREADS];  /* Last segments */
+  uint8_t** blocks;               /* Compressed data of every block */
+  int32_t* sizes;                 /* Compressed size of every block */
+};
+
 struct blosc_context {
   int32_t compress;               /* 1 if we are doing compression 0 if decompress */
 
@@ -93,20 +219,45 @@ struct blosc_context {
   uint8_t* dest;                  /* The current pos in the destination buffer */
   uint8_t* header_flags;          /* Flags for header */
   int compversion;                /* Compressor version byte, only used during decompression */
-  int32_t sourcesize;             /* Number of bytes in source buffer (or uncompressed bytes in compressed file) */
-  int32_t compressedsize;         /* Number of bytes of compressed data (only used when decompressing) */
+  int64_t sourcesize;             /* Number of bytes in source buffer (or uncompressed bytes in compressed file) */
+  int64_t compressedsize;         /* Number of bytes of compressed data (only used when decompressing) */
   int32_t nblocks;                /* Number of total blocks in buffer */
   int32_t leftover;               /* Extra bytes at end of buffer */
   int32_t blocksize;              /* Length of the block in bytes */
   int32_t typesize;               /* Type size */
-  int32_t num_output_bytes;       /* Counter for the number of output bytes */
-  int32_t destsize;               /* Maximum size for destination buffer */
+  int64_t num_output_bytes;       /* Counter for the number of output bytes */
+  int64_t destsize;               /* Maximum size for destination buffer */
+  int32_t header_len;             /* Length of the header (16, or 32 for the extended format) */
+  int32_t bstart_size;            /* Size of the entries in bstarts (4, or 8 for the extended format) */
   uint8_t* bstarts;               /* Start of the buffer past header info */
+  int32_t checksum;               /* Whether to add block checksums (compression only) */
+  uint8_t* checksums;             /* Start of the block checksums, or NULL */
   int32_t compcode;               /* Compressor code to use */
+  int32_t streaming;              /* Whether to write dest with non-temporal stores */
   int clevel;                     /* Compression level (1-9) */
   /* Function to use for decompression.  Only used when decompression */
   int (*decompress_func)(const void* input, int compressed_length, void* output,
                          int maxout);
+  /* Reduction to compute instead of writing `dest`.  Only used when
+     decompressing with blosc_reduce_ctx() or blosc_histogram_ctx() */
+  struct reduce_state* reduce;
+  /* Caller-provided scratch memory for the serial path, or NULL to
+     allocate it on every call (see blosc_compress_ctx_ws()) */
+  uint8_t* workspace;
+  /* Scratch memory kept across calls (only for the global context) */
+  uint8_t* scratch;
+  int32_t scratch_size;
+  /* Where the compressed blocks go instead of `dest`, which only holds
+     the header, or NULL (see blosc_compress_ctx_sink()) */
+  struct sink_state* sink;
+  /* Fragments of the source (when compressing) or of the destination
+     (when decompressing) instead of `src` or `dest`, or NULL */
+  const blosc_iovec* iov;
+  int32_t iovcnt;
+  int64_t* iov_starts;            /* Offset of every fragment */
+  /* Timings and counters of the serial path and of the finished
+     threads (see blosc_get_stats()) */
+  struct phase_stats stats;
 
   /* Threading */
   int32_t numthreads;
@@ -136,7 +287,11 @@ struct thread_context {
   uint8_t* tmp;
   uint8_t* tmp2;
   uint8_t* tmp3;
-  int32_t tmpblocksize; /* Used to keep track of how big the temporary buffers are */
+  uint8_t* codec_tmp;   /* Scratch memory of the codec (see codec_room()) */
+  uint8_t* gather;      /* Blocks spanning fragments (see blosc_compress_ctx_iov()) */
+  size_t tmp_size;      /* Used to keep track of how big the temporary buffers are */
+  int cpu;              /* CPU to pin the thread to, or -1 */
+  struct phase_stats stats;
 };
 
 /* Global context for non-contextual API */
@@ -148,6 +303,81 @@ static int32_t g_force_blocksize = 0;
 static int32_t g_initlib = 0;
 static int32_t g_atfork_registered = 0;
 static int32_t g_splitmode = BLOSC_FORWARD_COMPAT_SPLIT;
+static int32_t g_checksum = 0;
+/* The allocator set with blosc_set_allocator(), if `free_func` is not NULL */
+static blosc_allocator g_allocator = {NULL, NULL, NULL, NULL};
+/* Whether to back large buffers by huge pages */
+static int32_t g_hugepages = 0;
+/* The CPUs to pin the threads of the pools to (see blosc_set_affinity()) */
+static int g_affinity_cpus[BLOSC_MAX_THREADS];
+static int32_t g_affinity_ncpus = 0;
+/* The callback set with blosc_set_trace_callback(), or NULL */
+static blosc_trace_callback g_trace_callback = NULL;
+static void* g_trace_user_data = NULL;
+
+#if defined(BLOSC_ENABLE_STATS)
+/* The totals of the process, added to atomically by every context, so
+   that the contextual functions do not need blosc_init() */
+static blosc_stats g_stats;
+
+#if defined(_MSC_VER)
+#define STATS_ADD(total, value) \
+  InterlockedExchangeAdd64((volatile LONG64*)&(total), (LONG64)(value))
+#define STATS_LOAD(total) \
+  ((uint64_t)InterlockedCompareExchange64((volatile LONG64*)&(total), 0, 0))
+#define STATS_CLEAR(total) \
+  InterlockedExchange64((volatile LONG64*)&(total), 0)
+#else
+#define STATS_ADD(total, value) \
+  __atomic_fetch_add(&(total), (value), __ATOMIC_RELAXED)
+#define STATS_LOAD(total) __atomic_load_n(&(total), __ATOMIC_RELAXED)
+#define STATS_CLEAR(total) __atomic_store_n(&(total), 0, __ATOMIC_RELAXED)
+#endif
+
+/* The timestamp counter: CPU cycles on x86, nanoseconds elsewhere */
+static uint64_t stats_clock(void)
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  return __rdtsc();
+#elif defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#elif defined(_WIN32)
+  LARGE_INTEGER count, freq;
+
+  QueryPerformanceCounter(&count);
+  QueryPerformanceFrequency(&freq);
+  return (uint64_t)(count.QuadPart * (1000000000.0 / freq.QuadPart));
+#else
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+/* Add the stats of a thread to the ones of its context and reset them */
+static void merge_stats(struct phase_stats* total, struct phase_stats* stats)
+{
+  total->filter += stats->filter;
+  total->codec += stats->codec;
+  total->copy += stats->copy;
+  total->incompressible_splits += stats->incompressible_splits;
+  memset(stats, 0, sizeof(struct phase_stats));
+}
+
+/* Add the stats of a context to the totals of the process and reset them */
+static void publish_stats(struct phase_stats* stats)
+{
+  STATS_ADD(g_stats.filter_cycles, stats->filter);
+  STATS_ADD(g_stats.codec_cycles, stats->codec);
+  STATS_ADD(g_stats.copy_cycles, stats->copy);
+  STATS_ADD(g_stats.wait_cycles, stats->wait);
+  STATS_ADD(g_stats.incompressible_splits, stats->incompressible_splits);
+  STATS_ADD(g_stats.memcpy_fallbacks, stats->memcpy_fallbacks);
+  STATS_ADD(g_stats.recompressions, stats->recompressions);
+  memset(stats, 0, sizeof(struct phase_stats));
+}
+#endif  /* BLOSC_ENABLE_STATS */
 
 
 
@@ -202,24 +432,53 @@ int blosc_release_threadpool(struct blosc_context* context);
 #endif
 
 
-/* A function for aligned malloc that is portable */
-static uint8_t *my_malloc(size_t size)
+/* Aligned malloc with the user allocator, or a portable one */
+static void *aligned_malloc(size_t size, size_t alignment)
 {
   void *block = NULL;
   int res = 0;
 
-/* Do an alignment to 32 bytes because AVX2 is supported */
+  if (g_allocator.free_func != NULL) {
+    return g_allocator.aligned_malloc_func(size, alignment,
+                                           g_allocator.user_data);
+  }
+
 #if defined(_WIN32)
   /* A (void *) cast needed for avoiding a warning with MINGW :-/ */
-  block = (void *)_aligned_malloc(size, 32);
+  block = (void *)_aligned_malloc(size, alignment);
 #elif _POSIX_C_SOURCE >= 200112L || _XOPEN_SOURCE >= 600
   /* Platform does have an implementation of posix_memalign */
-  res = posix_memalign(&block, 32, size);
+  res = posix_memalign(&block, alignment, size);
 #else
   block = malloc(size);
 #endif  /* _WIN32 */
 
-  if (block == NULL || res != 0) {
+  return (res == 0) ? block : NULL;
+}
+
+/* A function for aligned malloc that is portable.  Large buffers are
+   backed by huge pages when asked to (see blosc_set_hugepages()). */
+static uint8_t *my_malloc(size_t size)
+{
+  void *block = NULL;
+
+  if (g_hugepages && size >= HUGEPAGE_SIZE) {
+    /* Whole huge pages, so that the tail does not need small ones */
+    size_t hsize = (size + HUGEPAGE_SIZE - 1) / HUGEPAGE_SIZE * HUGEPAGE_SIZE;
+    block = aligned_malloc(hsize, HUGEPAGE_SIZE);
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    if (block != NULL) {
+      /* Just a hint; the kernel may not have transparent huge pages */
+      madvise(block, hsize, MADV_HUGEPAGE);
+    }
+#endif
+  }
+  if (block == NULL) {
+    /* Do an alignment to 32 bytes because AVX2 is supported */
+    block = aligned_malloc(size, 32);
+  }
+
+  if (block == NULL) {
     printf("Error allocating memory!");
     return NULL;
   }
@@ -228,9 +487,27 @@ static uint8_t *my_malloc(size_t size)
 }
 
 
-/* Release memory booked by my_malloc */
+/* Allocate memory with no alignment requirements (used for the state of
+   the codecs) */
+static void *my_malloc_unaligned(size_t size)
+{
+  if (g_allocator.free_func != NULL) {
+    return g_allocator.malloc_func(size, g_allocator.user_data);
+  }
+  /* my_free() has to release both kinds of memory */
+  return my_malloc(size);
+}
+
+
+/* Release memory booked by my_malloc or my_malloc_unaligned */
 static void my_free(void *block)
 {
+  if (g_allocator.free_func != NULL) {
+    if (block != NULL) {
+      g_allocator.free_func(block, g_allocator.user_data);
+    }
+    return;
+  }
 #if defined(_WIN32)
     _aligned_free(block);
 #else
@@ -288,6 +565,171 @@ static void _sw32(uint8_t* dest, int32_t a)
   }
 }
 
+/* Copy 8 bytes from `*pa` to int64_t, changing endianness if necessary. */
+static int64_t sw64_(const uint8_t *pa)
+{
+  int64_t idest;
+  uint8_t *dest = (uint8_t *)&idest;
+  int i = 1;                    /* for big/little endian detection */
+  char *p = (char *)&i;
+  int j;
+
+  if (p[0] != 1) {
+    /* big endian */
+    for (j = 0; j < 8; j++) {
+      dest[j] = pa[7 - j];
+    }
+  }
+  else {
+    /* little endian */
+    for (j = 0; j < 8; j++) {
+      dest[j] = pa[j];
+    }
+  }
+  return idest;
+}
+
+
+/* Copy 8 bytes from `*pa` to `*dest`, changing endianness if necessary. */
+static void _sw64(uint8_t* dest, int64_t a)
+{
+  uint8_t *pa = (uint8_t *)&a;
+  int i = 1;                    /* for big/little endian detection */
+  char *p = (char *)&i;
+  int j;
+
+  if (p[0] != 1) {
+    /* big endian */
+    for (j = 0; j < 8; j++) {
+      dest[j] = pa[7 - j];
+    }
+  }
+  else {
+    /* little endian */
+    for (j = 0; j < 8; j++) {
+      dest[j] = pa[j];
+    }
+  }
+}
+
+/* The header of a compressed buffer, in any of the supported formats */
+struct blosc_header {
+  uint8_t version;                /* BLOSC_VERSION_FORMAT(_EXTENDED/_BLOCKFILTERS) */
+  uint8_t versionlz;              /* Version of the internal compressor format */
+  uint8_t flags;                  /* Flags for header */
+  int32_t typesize;               /* Type size */
+  int32_t blocksize;              /* Length of the blocks in bytes */
+  int64_t nbytes;                 /* Number of uncompressed bytes */
+  int64_t cbytes;                 /* Number of compressed bytes (header included) */
+  int32_t header_len;             /* Length of the header */
+  int32_t bstart_size;            /* Size of the entries in bstarts */
+};
+
+/* Read the header of the compressed buffer `src`.  Returns 0 on success
+   and -1 if the format version is not supported. */
+static int read_header(const uint8_t* src, struct blosc_header* header)
+{
+  header->version = src[0];                  /* blosc format version */
+  header->versionlz = src[1];
+  header->flags = src[2];                    /* flags */
+  header->typesize = (int32_t)src[3];        /* typesize */
+
+  if (header->version == BLOSC_VERSION_FORMAT ||
+      header->version == BLOSC_VERSION_FORMAT_BLOCKFILTERS) {
+    header->nbytes = sw32_(src + 4);         /* buffer size */
+    header->blocksize = sw32_(src + 8);      /* block size */
+    header->cbytes = sw32_(src + 12);        /* compressed buffer size */
+    header->header_len = BLOSC_MIN_HEADER_LENGTH;
+    header->bstart_size = (int32_t)sizeof(int32_t);
+    return 0;
+  }
+  if (header->version == BLOSC_VERSION_FORMAT_EXTENDED) {
+    header->blocksize = sw32_(src + 4);      /* block size */
+    header->nbytes = sw64_(src + 16);        /* buffer size */
+    header->cbytes = sw64_(src + 24);        /* compressed buffer size */
+    header->header_len = BLOSC_EXTENDED_HEADER_LENGTH;
+    header->bstart_size = (int32_t)sizeof(int64_t);
+    return 0;
+  }
+  /* Version from future */
+  return -1;
+}
+
+/* Get the start of the block `j` in the compressed buffer */
+static int64_t get_bstart(const struct blosc_context* context, int32_t j)
+{
+  if (context->bstart_size == (int32_t)sizeof(int64_t)) {
+    return sw64_(context->bstarts + (int64_t)j * 8);
+  }
+  return sw32_(context->bstarts + (int64_t)j * 4);
+}
+
+/* Prefetch the start of the compressed block `j`, so that its decoding
+   does not begin with a series of cache misses.  The hardware prefetchers
+   take over once the codec is streaming through it. */
+static void prefetch_block(const struct blosc_context* context, int32_t j)
+{
+  int64_t bstart, len, i;
+
+  if (j >= context->nblocks) {
+    return;
+  }
+  bstart = get_bstart(context, j);
+  if (bstart <= 0 || bstart >= context->compressedsize) {
+    return;
+  }
+  len = context->compressedsize - bstart;
+  if (len > PREFETCH_SIZE) {
+    len = PREFETCH_SIZE;
+  }
+  for (i = 0; i < len; i += CACHE_LINE_SIZE) {
+    BLOSC_PREFETCH(context->src + bstart + i);
+  }
+}
+
+/* Set the start of the block `j` in the compressed buffer */
+static void set_bstart(struct blosc_context* context, int32_t j, int64_t bstart)
+{
+  if (context->bstart_size == (int32_t)sizeof(int64_t)) {
+    _sw64(context->bstarts + (int64_t)j * 8, bstart);
+  }
+  else {
+    _sw32(context->bstarts + (int64_t)j * 4, (int32_t)bstart);
+  }
+}
+
+/* Offset of the block checksums in a compressed buffer.  They follow
+   the bstarts, or the data for memcpyed buffers. */
+static int64_t checksums_offset(const struct blosc_context* context)
+{
+  if (*(context->header_flags) & BLOSC_MEMCPYED) {
+    return context->header_len + context->sourcesize;
+  }
+  return context->header_len + (int64_t)context->bstart_size * context->nblocks;
+}
+
+/* Store the checksum of the uncompressed block `j` */
+static void store_checksum(const struct blosc_context* context, int32_t j,
+                           const uint8_t* block, int32_t bsize)
+{
+  _sw32(context->checksums + (int64_t)j * sizeof(int32_t),
+        (int32_t)blosc_internal_crc32c(block, (size_t)bsize));
+}
+
+/* Check the uncompressed block `j` against its checksum, if any */
+static int check_block(const struct blosc_context* context, int32_t j,
+                       const uint8_t* block, int32_t bsize)
+{
+  if (context->checksums == NULL) {
+    return 0;
+  }
+  if (blosc_internal_crc32c(block, (size_t)bsize) !=
+      (uint32_t)sw32_(context->checksums + (int64_t)j * sizeof(int32_t))) {
+    return -3;    /* corrupted block */
+  }
+  return 0;
+}
+
 /*
  * Conversion routines between compressor and compression libraries
  */
@@ -469,26 +911,68 @@ static int snappy_wrap_decompress(const void* input, int compressed_length,
 #if defined(HAVE_ZLIB)
 /* zlib is not very respectful with sharing name space with others.
  Fortunately, its names do not collide with those already in blosc. */
+
+/* The state of zlib goes through the allocator of Blosc */
+static voidpf zlib_alloc(voidpf opaque, uInt items, uInt size)
+{
+  (void)opaque;
+  return my_malloc_unaligned((size_t)items * size);
+}
+
+static void zlib_free(voidpf opaque, voidpf address)
+{
+  (void)opaque;
+  my_free(address);
+}
+
+/* Same as compress2(), but with our allocator */
 static int zlib_wrap_compress(const char* input, size_t input_length,
                               char* output, size_t maxout, int clevel)
 {
+  z_stream stream;
   int status;
-  uLongf cl = maxout;
-  status = compress2(
-             (Bytef*)output, &cl, (Bytef*)input, (uLong)input_length, clevel);
-  if (status != Z_OK){
+  uLong cl;
+
+  stream.zalloc = zlib_alloc;
+  stream.zfree = zlib_free;
+  stream.opaque = Z_NULL;
+  if (deflateInit(&stream, clevel) != Z_OK) {
+    return 0;
+  }
+  stream.next_in = (Bytef*)input;
+  stream.avail_in = (uInt)input_length;
+  stream.next_out = (Bytef*)output;
+  stream.avail_out = (uInt)maxout;
+  status = deflate(&stream, Z_FINISH);
+  cl = stream.total_out;
+  deflateEnd(&stream);
+  if (status != Z_STREAM_END){
     return 0;
   }
   return (int)cl;
 }
 
+/* Same as uncompress(), but with our allocator */
 static int zlib_wrap_decompress(const void* input, int compressed_length,
                                 void* output, int maxout) {
+  z_stream stream;
   int status;
-  uLongf ul = maxout;
-  status = uncompress(
-             (Bytef*)output, &ul, (Bytef*)input, (uLong)compressed_length);
-  if (status != Z_OK){
+  uLong ul;
+
+  stream.zalloc = zlib_alloc;
+  stream.zfree = zlib_free;
+  stream.opaque = Z_NULL;
+  stream.next_in = (Bytef*)input;
+  stream.avail_in = (uInt)compressed_length;
+  if (inflateInit(&stream) != Z_OK) {
+    return 0;
+  }
+  stream.next_out = (Bytef*)output;
+  stream.avail_out = (uInt)maxout;
+  status = inflate(&stream, Z_FINISH);
+  ul = stream.total_out;
+  inflateEnd(&stream);
+  if (status != Z_STREAM_END){
     return 0;
   }
   return (int)ul;
@@ -496,14 +980,35 @@ static int zlib_wrap_decompress(const void* input, int compressed_length,
 #endif /*  HAVE_ZLIB */
 
 #if defined(HAVE_ZSTD)
+/* The state of zstd goes through the allocator of Blosc */
+static void* zstd_alloc(void* opaque, size_t size)
+{
+  (void)opaque;
+  return my_malloc_unaligned(size);
+}
+
+static void zstd_free(void* opaque, void* address)
+{
+  (void)opaque;
+  my_free(address);
+}
+
+static const ZSTD_customMem zstd_mem = {zstd_alloc, zstd_free, NULL};
+
 static int zstd_wrap_compress(const char* input, size_t input_length,
                               char* output, size_t maxout, int clevel) {
+  ZSTD_CCtx* cctx;
   size_t code;
   clevel = (clevel < 9) ? clevel * 2 - 1 : ZSTD_maxCLevel();
   /* Make the level 8 close enough to maxCLevel */
   if (clevel == 8) clevel = ZSTD_maxCLevel() - 2;
-  code = ZSTD_compress(
+  cctx = ZSTD_createCCtx_advanced(zstd_mem);
+  if (cctx == NULL) {
+    return -1;
+  }
+  code = ZSTD_compressCCtx(cctx,
       (void*)output, maxout, (void*)input, input_length, clevel);
+  ZSTD_freeCCtx(cctx);
   if (ZSTD_isError(code)) {
     return 0;
   }
@@ -512,9 +1017,15 @@ static int zstd_wrap_compress(const char* input, size_t input_length,
 
 static int zstd_wrap_decompress(const void* input, int compressed_length,
                                 void* output, int maxout) {
+  ZSTD_DCtx* dctx;
   size_t code;
-  code = ZSTD_decompress(
+  dctx = ZSTD_createDCtx_advanced(zstd_mem);
+  if (dctx == NULL) {
+    return 0;
+  }
+  code = ZSTD_decompressDCtx(dctx,
       (void*)output, maxout, (void*)input, compressed_length);
+  ZSTD_freeDCtx(dctx);
   if (ZSTD_isError(code)) {
     return 0;
   }
@@ -522,6 +1033,36 @@ static int zstd_wrap_decompress(const void* input, int compressed_length,
 }
 #endif /*  HAVE_ZSTD */
 
+/* The decompressor for the blocks in the `compformat` format that record
+   their own flags (see BLOSC_AUTOSHUFFLE), or NULL if not supported.
+   These always use the current format version of the codec. */
+static int (*block_decompress_func(int32_t compformat))(const void*, int, void*, int) {
+  if (compformat == BLOSC_BLOSCLZ_FORMAT) {
+    return &blosclz_decompress;
+  }
+#if defined(HAVE_LZ4)
+  if (compformat == BLOSC_LZ4_FORMAT) {
+    return &lz4_wrap_decompress;
+  }
+#endif /*  HAVE_LZ4 */
+#if defined(HAVE_SNAPPY)
+  if (compformat == BLOSC_SNAPPY_FORMAT) {
+    return &snappy_wrap_decompress;
+  }
+#endif /*  HAVE_SNAPPY */
+#if defined(HAVE_ZLIB)
+  if (compformat == BLOSC_ZLIB_FORMAT) {
+    return &zlib_wrap_decompress;
+  }
+#endif /*  HAVE_ZLIB */
+#if defined(HAVE_ZSTD)
+  if (compformat == BLOSC_ZSTD_FORMAT) {
+    return &zstd_wrap_decompress;
+  }
+#endif /*  HAVE_ZSTD */
+  return NULL;
+}
+
 static int initialize_decompress_func(struct blosc_context* context) {
   int8_t header_flags = *(context->header_flags);
   int32_t compformat = (header_flags & 0xe0) >> 5;
@@ -574,10 +1115,8 @@ static int initialize_decompress_func(struct blosc_context* context) {
 }
 
 /* Compute acceleration for blosclz */
-static int get_accel(const struct blosc_context* context) {
-  int32_t clevel = context->clevel;
-
-  if (context->compcode == BLOSC_LZ4) {
+static int get_accel(int compcode, int clevel) {
+  if (compcode == BLOSC_LZ4) {
     /* This acceleration setting based on discussions held in:
      * https://groups.google.com/forum/#!topic/lz4c/zosy90P8MQw
      */
@@ -586,112 +1125,325 @@ static int get_accel(const struct blosc_context* context) {
   return 1;
 }
 
+/* Conditions for splitting a block before compressing with a codec. */
+static int split_block(int compcode, int typesize, int blocksize) {
+  int splitblock = -1;
 
-/* Shuffle & compress a single block */
-static int blosc_c(const struct blosc_context* context, int32_t blocksize,
-                   int32_t leftoverblock, int32_t ntbytes, int32_t maxbytes,
-                   const uint8_t *src, uint8_t *dest, uint8_t *tmp,
-                   uint8_t *tmp2)
-{
-  int8_t header_flags = *(context->header_flags);
-  int dont_split = (header_flags & 0x10) >> 4;
-  int32_t j, neblock, nsplits;
-  int32_t cbytes;                   /* number of compressed bytes in split */
-  int32_t ctbytes = 0;              /* number of compressed bytes in block */
-  int32_t maxout;
-  int32_t typesize = context->typesize;
-  const uint8_t *_tmp = src;
-  const char *compname;
-  int accel;
-  int bscount;
-  int doshuffle = (header_flags & BLOSC_DOSHUFFLE) && (typesize > 1);
-  int dobitshuffle = ((header_flags & BLOSC_DOBITSHUFFLE) &&
-                      (blocksize >= typesize));
-
-  if (doshuffle) {
-    /* Byte shuffling only makes sense if typesize > 1 */
-    blosc_internal_shuffle(typesize, blocksize, src, tmp);
-    _tmp = tmp;
+  switch (g_splitmode) {
+    case BLOSC_ALWAYS_SPLIT:
+      splitblock = 1;
+      break;
+    case BLOSC_NEVER_SPLIT:
+      splitblock = 0;
+      break;
+    case BLOSC_AUTO_SPLIT:
+      /* Normally all the compressors designed for speed benefit from a
+         split.  However, in conducted benchmarks LZ4 seems that it runs
+         faster if we don't split, which is quite surprising. */
+      splitblock= (((compcode == BLOSC_BLOSCLZ) ||
+                    (compcode == BLOSC_SNAPPY)) &&
+                   (typesize <= MAX_SPLITS) &&
+                   (blocksize / typesize) >= MIN_BUFFERSIZE);
+      break;
+    case BLOSC_FORWARD_COMPAT_SPLIT:
+      /* The zstd support was introduced at the same time than the split flag, so
+       * there should be not a problem with not splitting bloscks with it */
+      splitblock = ((compcode != BLOSC_ZSTD) &&
+                    (typesize <= MAX_SPLITS) &&
+                    (blocksize / typesize) >= MIN_BUFFERSIZE);
+      break;
+    default:
+      fprintf(stderr, "Split mode %d not supported", g_splitmode);
   }
-  /* We don't allow more than 1 filter at the same time (yet) */
-  else if (dobitshuffle) {
-    bscount = blosc_internal_bitshuffle(typesize, blocksize, src, tmp, tmp2);
-    if (bscount < 0)
-      return bscount;
-    _tmp = tmp;
+  return splitblock;
+}
+
+/* The format of the compressor `compcode`, as stored in the flags */
+static int compcode_to_compformat(int compcode)
+{
+  switch (compcode) {
+    case BLOSC_LZ4:
+      return BLOSC_LZ4_FORMAT;
+    case BLOSC_LZ4HC:
+      return BLOSC_LZ4HC_FORMAT;
+    case BLOSC_SNAPPY:
+      return BLOSC_SNAPPY_FORMAT;
+    case BLOSC_ZLIB:
+      return BLOSC_ZLIB_FORMAT;
+    case BLOSC_ZSTD:
+      return BLOSC_ZSTD_FORMAT;
+    default:
+      return BLOSC_BLOSCLZ_FORMAT;
   }
+}
 
-  /* Calculate acceleration for different compressors */
-  accel = get_accel(context);
 
-  /* The number of splits for this block */
-  if (!dont_split && !leftoverblock) {
-    nsplits = typesize;
+/* Whether a destination of `nbytes` should be written with non-temporal
+   stores, i.e. whether it would not fit in the last level cache anyway */
+static int use_streaming_stores(int64_t nbytes) {
+  size_t llc_size = blosc_internal_llc_size();
+
+  return (llc_size > 0) && (nbytes > (int64_t)llc_size);
+}
+
+/* Copy a block (or its compressed bytes) to the destination buffer */
+static void copy_block(const struct blosc_context* context, uint8_t* dest,
+                       const uint8_t* src, int32_t nbytes) {
+  if (context->streaming) {
+    fastcopy_stream(dest, src, (unsigned)nbytes);
   }
   else {
-    nsplits = 1;
+    fastcopy(dest, src, (unsigned)nbytes);
   }
-  neblock = blocksize / nsplits;
-  for (j = 0; j < nsplits; j++) {
-    dest += sizeof(int32_t);
-    ntbytes += (int32_t)sizeof(int32_t);
-    ctbytes += (int32_t)sizeof(int32_t);
-    maxout = neblock;
-    #if defined(HAVE_SNAPPY)
-    if (context->compcode == BLOSC_SNAPPY) {
-      /* TODO perhaps refactor this to keep the value stashed somewhere */
-      maxout = snappy_max_compressed_length(neblock);
+}
+
+/* Guess whether the data sampled in the two `windows` of PROBE_WINDOW
+   bytes is incompressible (e.g. it is encrypted or already compressed):
+   its byte histogram has to be nearly flat, and it cannot contain
+   repeated 4-byte sequences.  This is independent of the codec, and errs
+   on the side of compressing. */
+static int probe_windows(const uint8_t* const windows[2]) {
+  uint32_t hist[256];
+  uint32_t htab[1U << PROBE_HASH_LOG];
+  const uint64_t n = 2 * PROBE_WINDOW;
+  uint64_t sumsq = 0;
+  uint32_t seq, ref, hval, offset;
+  int32_t i, w, nmatches = 0;
+
+  memset(hist, 0, sizeof(hist));
+  for (w = 0; w < 2; w++) {
+    for (i = 0; i < PROBE_WINDOW; i++) {
+      hist[windows[w][i]]++;
     }
-    #endif /*  HAVE_SNAPPY */
-    if (ntbytes+maxout > maxbytes) {
-      maxout = maxbytes - ntbytes;   /* avoid buffer overrun */
-      if (maxout <= 0) {
-        return 0;                  /* non-compressible block */
-      }
-    }
-    if (context->compcode == BLOSC_BLOSCLZ) {
-      cbytes = blosclz_compress(context->clevel, _tmp+j*neblock, neblock,
-                                dest, maxout, !dont_split);
+  }
+  for (i = 0; i < 256; i++) {
+    sumsq += (uint64_t)hist[i] * hist[i];
+  }
+  /* For uniformly random bytes the expected sum of squares is
+     n + n * (n - 1) / 256.  Allowing 10% more than that still means more
+     than ~7.85 bits per byte, which not even an entropy coder can squeeze. */
+  if (sumsq * 10 > 11 * (n + n * (n - 1) / 256)) {
+    return 0;
+  }
+
+  memset(htab, 0, sizeof(htab));
+  for (w = 0; w < 2; w++) {
+    for (i = 0; i <= PROBE_WINDOW - (int32_t)sizeof(uint32_t); i++) {
+      memcpy(&seq, windows[w] + i, sizeof(seq));
+      hval = (seq * 2654435761U) >> (32 - PROBE_HASH_LOG);
+      /* offsets in the sample are biased, '0' means an empty slot */
+      offset = htab[hval];
+      if (offset > 0) {
+        offset--;
+        memcpy(&ref, windows[offset / PROBE_WINDOW] + offset % PROBE_WINDOW,
+               sizeof(ref));
+        if (ref == seq) {
+          nmatches++;
+        }
+      }
+      htab[hval] = (uint32_t)(w * PROBE_WINDOW + i) + 1;
     }
-    #if defined(HAVE_LZ4)
-    else if (context->compcode == BLOSC_LZ4) {
-      cbytes = lz4_wrap_compress((char *)_tmp+j*neblock, (size_t)neblock,
-                                 (char *)dest, (size_t)maxout, accel);
+  }
+  return nmatches <= (int32_t)(n / 64);
+}
+
+/* Guess whether the `size` bytes at `src` are incompressible from the
+   windows at its start and its middle */
+static int probe_incompressible(const uint8_t* src, int32_t size) {
+  const uint8_t* windows[2];
+
+  if (size < 2 * PROBE_WINDOW) {
+    return 0;                   /* too small for the sample to tell */
+  }
+  windows[0] = src;
+  windows[1] = src + size / 2;
+  return probe_windows(windows);
+}
+
+/* Gather into `sample` the windows that probe_incompressible() would
+   look at in the block `src` of `blocksize` bytes once filtered as in
+   `flags`, straight from `src`.  `blocksize` must be at least
+   2 * PROBE_WINDOW bytes. */
+static void filter_windows(const struct blosc_context* context, uint8_t flags,
+                           int32_t blocksize, const uint8_t* src,
+                           uint8_t* sample)
+{
+  int32_t typesize = context->typesize;
+  int32_t nelems = blocksize / typesize;
+  int32_t nfiltered = nelems * typesize;  /* the leftovers stay as is */
+  int32_t rowsize = nelems / 8;
+  int32_t i, p, w, e, elem, row;
+  uint8_t byte;
+  int doshuffle = (flags & BLOSC_DOSHUFFLE) && (typesize > 1);
+  /* See blosc_internal_bitshuffle() for when the bits are shuffled */
+  int dobitshuffle = ((flags & BLOSC_DOBITSHUFFLE) &&
+                      (blocksize >= typesize) && (nelems % 8 == 0));
+
+  for (w = 0; w < 2; w++) {
+    for (i = 0; i < PROBE_WINDOW; i++) {
+      p = ((w == 0) ? 0 : blocksize / 2) + i;
+      if (doshuffle && p < nfiltered) {
+        /* Byte p / nelems of the element p % nelems */
+        byte = src[(p % nelems) * typesize + p / nelems];
+      }
+      else if (dobitshuffle && p < nfiltered) {
+        /* The bits of the row (i.e. bit `row % 8` of byte `row / 8`) of
+           8 consecutive elements */
+        row = p / rowsize;
+        elem = (p % rowsize) * 8;
+        byte = 0;
+        for (e = 0; e < 8; e++) {
+          byte |= (uint8_t)(((src[(elem + e) * typesize + row / 8] >>
+                              (row % 8)) & 1) << e);
+        }
+      }
+      else {
+        byte = src[p];
+      }
+      sample[w * PROBE_WINDOW + i] = byte;
     }
-    else if (context->compcode == BLOSC_LZ4HC) {
-      cbytes = lz4hc_wrap_compress((char *)_tmp+j*neblock, (size_t)neblock,
-                                   (char *)dest, (size_t)maxout,
-                                   context->clevel);
+  }
+}
+
+/* Apply the filter in `flags` to the block `src`.  `*filtered` is set to
+   the result, which is `src` itself when there is no filter to apply. */
+static int filter_block(const struct blosc_context* context, uint8_t flags,
+                        int32_t blocksize, const uint8_t* src, uint8_t* tmp,
+                        uint8_t* tmp2, const uint8_t** filtered,
+                        struct phase_stats* stats)
+{
+  int32_t typesize = context->typesize;
+  int bscount;
+  int doshuffle = (flags & BLOSC_DOSHUFFLE) && (typesize > 1);
+  int dobitshuffle = ((flags & BLOSC_DOBITSHUFFLE) &&
+                      (blocksize >= typesize));
+
+  *filtered = src;
+  if (doshuffle) {
+    /* Byte shuffling only makes sense if typesize > 1 */
+    TIMED(stats, filter, blosc_internal_shuffle(typesize, blocksize, src, tmp));
+    *filtered = tmp;
+  }
+  /* We don't allow more than 1 filter at the same time (yet) */
+  else if (dobitshuffle) {
+    TIMED(stats, filter,
+          bscount = blosc_internal_bitshuffle(typesize, blocksize, src, tmp,
+                                              tmp2));
+    if (bscount < 0)
+      return bscount;
+    *filtered = tmp;
+  }
+  return 0;
+}
+
+/* Compress the split `src` of `neblock` bytes with `compcode` into at
+   most `maxout` bytes of `dest`, using `codec_tmp` as scratch memory */
+static int compress_split(const struct blosc_context* context, int compcode,
+                          const uint8_t* src, int32_t neblock, uint8_t* dest,
+                          int32_t maxout, int dont_split, int accel,
+                          uint8_t* codec_tmp)
+{
+  const char *compname;
+
+  if (compcode == BLOSC_BLOSCLZ) {
+    return blosclz_compress(context->clevel, src, neblock,
+                            dest, maxout, !dont_split, codec_tmp);
+  }
+  #if defined(HAVE_LZ4)
+  else if (compcode == BLOSC_LZ4) {
+    return lz4_wrap_compress((char *)src, (size_t)neblock,
+                             (char *)dest, (size_t)maxout, accel);
+  }
+  else if (compcode == BLOSC_LZ4HC) {
+    return lz4hc_wrap_compress((char *)src, (size_t)neblock,
+                               (char *)dest, (size_t)maxout,
+                               context->clevel);
+  }
+  #endif /* HAVE_LZ4 */
+  #if defined(HAVE_SNAPPY)
+  else if (compcode == BLOSC_SNAPPY) {
+    return snappy_wrap_compress((char *)src, (size_t)neblock,
+                                (char *)dest, (size_t)maxout);
+  }
+  #endif /* HAVE_SNAPPY */
+  #if defined(HAVE_ZLIB)
+  else if (compcode == BLOSC_ZLIB) {
+    return zlib_wrap_compress((char *)src, (size_t)neblock,
+                              (char *)dest, (size_t)maxout,
+                              context->clevel);
+  }
+  #endif /* HAVE_ZLIB */
+  #if defined(HAVE_ZSTD)
+  else if (compcode == BLOSC_ZSTD) {
+    return zstd_wrap_compress((char*)src, (size_t)neblock,
+                              (char*)dest, (size_t)maxout, context->clevel);
+  }
+  #endif /* HAVE_ZSTD */
+
+  else {
+    blosc_compcode_to_compname(compcode, &compname);
+    if (compname == NULL) {
+        compname = "(null)";
     }
-    #endif /* HAVE_LZ4 */
+    fprintf(stderr, "Blosc has not been compiled with '%s' ", compname);
+    fprintf(stderr, "compression support.  Please use one having it.");
+    return -5;    /* signals no compression support */
+  }
+}
+
+/* Compress the (already filtered) block `_tmp` with `compcode`, in the
+   splits that `flags` says */
+static int compress_splits(const struct blosc_context* context, int compcode,
+                           uint8_t flags, int32_t blocksize,
+                           int32_t leftoverblock, int64_t ntbytes,
+                           int64_t maxbytes, const uint8_t* _tmp,
+                           uint8_t* dest, uint8_t* codec_tmp,
+                           struct phase_stats* stats)
+{
+  int dont_split = (flags & 0x10) >> 4;
+  int32_t j, neblock, nsplits;
+  int32_t cbytes;                   /* number of compressed bytes in split */
+  int32_t ctbytes = 0;              /* number of compressed bytes in block */
+  int32_t maxout;
+  int32_t typesize = context->typesize;
+  int accel;
+
+  /* Calculate acceleration for different compressors */
+  accel = get_accel(compcode, context->clevel);
+
+  /* The number of splits for this block */
+  if (!dont_split && !leftoverblock) {
+    nsplits = typesize;
+  }
+  else {
+    nsplits = 1;
+  }
+  neblock = blocksize / nsplits;
+  for (j = 0; j < nsplits; j++) {
+    dest += sizeof(int32_t);
+    ntbytes += (int64_t)sizeof(int32_t);
+    ctbytes += (int32_t)sizeof(int32_t);
+    maxout = neblock;
     #if defined(HAVE_SNAPPY)
-    else if (context->compcode == BLOSC_SNAPPY) {
-      cbytes = snappy_wrap_compress((char *)_tmp+j*neblock, (size_t)neblock,
-                                    (char *)dest, (size_t)maxout);
+    if (compcode == BLOSC_SNAPPY) {
+      /* TODO perhaps refactor this to keep the value stashed somewhere */
+      maxout = snappy_max_compressed_length(neblock);
     }
-    #endif /* HAVE_SNAPPY */
-    #if defined(HAVE_ZLIB)
-    else if (context->compcode == BLOSC_ZLIB) {
-      cbytes = zlib_wrap_compress((char *)_tmp+j*neblock, (size_t)neblock,
-                                  (char *)dest, (size_t)maxout,
-                                  context->clevel);
+    #endif /*  HAVE_SNAPPY */
+    if (ntbytes+maxout > maxbytes) {
+      maxout = (int32_t)(maxbytes - ntbytes);   /* avoid buffer overrun */
+      if (maxout <= 0) {
+        return 0;                  /* non-compressible block */
+      }
     }
-    #endif /* HAVE_ZLIB */
-    #if defined(HAVE_ZSTD)
-    else if (context->compcode == BLOSC_ZSTD) {
-      cbytes = zstd_wrap_compress((char*)_tmp + j * neblock, (size_t)neblock,
-                                  (char*)dest, (size_t)maxout, context->clevel);
+    if (probe_incompressible(_tmp + j * neblock, neblock)) {
+      cbytes = 0;       /* do not even try, just copy the split below */
     }
-    #endif /* HAVE_ZSTD */
-
     else {
-      blosc_compcode_to_compname(context->compcode, &compname);
-      if (compname == NULL) {
-          compname = "(null)";
-      }
-      fprintf(stderr, "Blosc has not been compiled with '%s' ", compname);
-      fprintf(stderr, "compression support.  Please use one having it.");
-      return -5;    /* signals no compression support */
+      TIMED(stats, codec,
+            cbytes = compress_split(context, compcode, _tmp + j * neblock,
+                                    neblock, dest, maxout, dont_split, accel,
+                                    codec_tmp));
     }
 
     if (cbytes > maxout) {
@@ -709,7 +1461,8 @@ static int blosc_c(const struct blosc_context* context, int32_t blocksize,
       if ((ntbytes+neblock) > maxbytes) {
         return 0;    /* Non-compressible data */
       }
-      fastcopy(dest, _tmp + j * neblock, neblock);
+      COUNT(stats, incompressible_splits);
+      TIMED(stats, copy, fastcopy(dest, _tmp + j * neblock, neblock));
       cbytes = neblock;
     }
     _sw32(dest - 4, cbytes);
@@ -721,25 +1474,169 @@ static int blosc_c(const struct blosc_context* context, int32_t blocksize,
   return ctbytes;
 }
 
-/* Decompress & unshuffle a single block */
+/* The flags of a block compressed with `compcode` when every block
+   records its own (see BLOSC_AUTOSHUFFLE), laid out as in the header */
+static uint8_t block_flags(const struct blosc_context* context, int compcode)
+{
+  int dont_split = !split_block(compcode, context->typesize,
+                                context->blocksize);
+
+  return (uint8_t)((compcode_to_compformat(compcode) << 5) | (dont_split << 4));
+}
+
+/* Shuffle & compress a single block trying every filter, and keep the
+   smallest result after a byte with the flags of the block.  The trials
+   that may not be the best go to `tmp2`, which is only used as scratch
+   while filtering. */
+static int compress_block_auto(const struct blosc_context* context,
+                               int32_t blocksize, int32_t leftoverblock,
+                               int64_t ntbytes, int64_t maxbytes,
+                               const uint8_t *src, uint8_t *dest,
+                               uint8_t *tmp, uint8_t *tmp2,
+                               uint8_t *codec_tmp, struct phase_stats* stats)
+{
+  static const uint8_t filters[] = {0, BLOSC_DOSHUFFLE, BLOSC_DOBITSHUFFLE};
+  int compcode = context->compcode;
+  int32_t typesize = context->typesize;
+  int32_t cbytes, best = 0;
+  int64_t limit;
+  uint8_t flags, best_flags = 0;
+  const uint8_t *_tmp;
+  int i, rc;
+
+  if (ntbytes + 1 > maxbytes) {
+    return 0;                      /* no room for the flags */
+  }
+  for (i = 0; i < (int)(sizeof(filters) / sizeof(filters[0])); i++) {
+    if ((filters[i] == BLOSC_DOSHUFFLE && typesize == 1) ||
+        (filters[i] == BLOSC_DOBITSHUFFLE && blocksize < typesize)) {
+      continue;                    /* same as no filter */
+    }
+    flags = block_flags(context, compcode) | filters[i];
+    rc = filter_block(context, flags, blocksize, src, tmp, tmp2, &_tmp, stats);
+    if (rc < 0) {
+      return rc;
+    }
+    /* Once there is a result, the trials only have to beat it */
+    limit = (best > 0) ? ntbytes + best : maxbytes;
+    cbytes = compress_splits(context, compcode, flags, blocksize,
+                             leftoverblock, ntbytes + 1, limit, _tmp,
+                             (best > 0) ? tmp2 : dest + 1, codec_tmp, stats);
+    if (cbytes < 0) {
+      return cbytes;
+    }
+    if (cbytes > 0) {
+      if (best > 0) {
+        TIMED(stats, copy, fastcopy(dest + 1, tmp2, cbytes));
+      }
+      best = cbytes;
+      best_flags = flags;
+    }
+  }
+  if (best == 0) {
+    return 0;                      /* non-compressible block */
+  }
+
+  /* Blocks that a fast codec compresses about as well are faster to
+     decompress with it */
+  if (compcode == BLOSC_ZLIB || compcode == BLOSC_ZSTD ||
+      compcode == BLOSC_LZ4HC) {
+#if defined(HAVE_LZ4)
+    compcode = BLOSC_LZ4;
+#else
+    compcode = BLOSC_BLOSCLZ;
+#endif
+    flags = block_flags(context, compcode) | (best_flags & BLOSC_BLOCKFILTERS);
+    rc = filter_block(context, flags, blocksize, src, tmp, tmp2, &_tmp, stats);
+    if (rc < 0) {
+      return rc;
+    }
+    limit = ntbytes + 1 + best + best / FAST_CODEC_SLACK;
+    cbytes = compress_splits(context, compcode, flags, blocksize,
+                             leftoverblock, ntbytes + 1,
+                             (limit < maxbytes) ? limit : maxbytes, _tmp, tmp2,
+                             codec_tmp, stats);
+    if (cbytes < 0) {
+      return cbytes;
+    }
+    if (cbytes > 0) {
+      TIMED(stats, copy, fastcopy(dest + 1, tmp2, cbytes));
+      best = cbytes;
+      best_flags = flags;
+    }
+  }
+
+  dest[0] = best_flags;
+  return best + 1;
+}
+
+/* Shuffle & compress a single block.  `codec_tmp` is the scratch memory
+   of the codec (see codec_room()). */
+static int blosc_c(const struct blosc_context* context, int32_t blocksize,
+                   int32_t leftoverblock, int64_t ntbytes, int64_t maxbytes,
+                   const uint8_t *src, uint8_t *dest, uint8_t *tmp,
+                   uint8_t *tmp2, uint8_t *codec_tmp,
+                   struct phase_stats* stats)
+{
+  uint8_t header_flags = *(context->header_flags);
+  const uint8_t *_tmp;
+  int rc;
+
+  if ((header_flags & BLOSC_BLOCKFILTERS) == BLOSC_BLOCKFILTERS) {
+    return compress_block_auto(context, blocksize, leftoverblock, ntbytes,
+                               maxbytes, src, dest, tmp, tmp2, codec_tmp,
+                               stats);
+  }
+  rc = filter_block(context, header_flags, blocksize, src, tmp, tmp2, &_tmp,
+                    stats);
+  if (rc < 0) {
+    return rc;
+  }
+  return compress_splits(context, context->compcode, header_flags, blocksize,
+                         leftoverblock, ntbytes, maxbytes, _tmp, dest,
+                         codec_tmp, stats);
+}
+
+/* Decompress & unshuffle the block `nblock` */
 static int blosc_d(struct blosc_context* context, int32_t blocksize,
-                   int32_t leftoverblock, const uint8_t* base_src,
-                   int32_t src_offset, uint8_t* dest, uint8_t* tmp,
-                   uint8_t* tmp2) {
-  int8_t header_flags = *(context->header_flags);
-  int dont_split = (header_flags & 0x10) >> 4;
+                   int32_t leftoverblock, int32_t nblock,
+                   const uint8_t* base_src, int64_t src_offset,
+                   uint8_t* dest, uint8_t* tmp, uint8_t* tmp2,
+                   struct phase_stats* stats) {
+  uint8_t header_flags = *(context->header_flags);
+  int dont_split;
   int32_t j, neblock, nsplits;
   int32_t nbytes;                /* number of decompressed bytes in split */
-  const int32_t compressedsize = context->compressedsize;
+  const int64_t compressedsize = context->compressedsize;
   int32_t cbytes;                /* number of compressed bytes in split */
   int32_t ntbytes = 0;           /* number of uncompressed bytes in block */
   uint8_t *_tmp = dest;
   int32_t typesize = context->typesize;
   int bscount;
-  int doshuffle = (header_flags & BLOSC_DOSHUFFLE) && (typesize > 1);
-  int dobitshuffle = ((header_flags & BLOSC_DOBITSHUFFLE) &&
-                      (blocksize >= typesize));
+  int rc;
+  int doshuffle, dobitshuffle;
   const uint8_t* src;
+  int (*decompress_func)(const void*, int, void*, int) = context->decompress_func;
+
+  if ((header_flags & BLOSC_BLOCKFILTERS) == BLOSC_BLOCKFILTERS) {
+    /* The block starts with its own flags */
+    if (src_offset < 0 || src_offset >= compressedsize) {
+      return -1;
+    }
+    header_flags = base_src[src_offset];
+    src_offset += 1;
+    if ((header_flags & BLOSC_BLOCKFILTERS) == BLOSC_BLOCKFILTERS) {
+      return -1;
+    }
+    decompress_func = block_decompress_func((header_flags & 0xe0) >> 5);
+    if (decompress_func == NULL) {
+      return -5;    /* signals no decompression support */
+    }
+  }
+  dont_split = (header_flags & 0x10) >> 4;
+  doshuffle = (header_flags & BLOSC_DOSHUFFLE) && (typesize > 1);
+  dobitshuffle = ((header_flags & BLOSC_DOBITSHUFFLE) &&
+                  (blocksize >= typesize));
 
   if (doshuffle || dobitshuffle) {
     _tmp = tmp;
@@ -759,7 +1656,7 @@ static int blosc_d(struct blosc_context* context, int32_t blocksize,
   neblock = blocksize / nsplits;
   for (j = 0; j < nsplits; j++) {
     /* Validate src_offset */
-    if (src_offset < 0 || src_offset > compressedsize - sizeof(int32_t)) {
+    if (src_offset < 0 || src_offset > compressedsize - (int64_t)sizeof(int32_t)) {
       return -1;
     }
     cbytes = sw32_(base_src + src_offset); /* amount of compressed bytes */
@@ -771,11 +1668,11 @@ static int blosc_d(struct blosc_context* context, int32_t blocksize,
     src = base_src + src_offset;
     /* Uncompress */
     if (cbytes == neblock) {
-      fastcopy(_tmp, src, neblock);
+      TIMED(stats, copy, fastcopy(_tmp, src, neblock));
       nbytes = neblock;
     }
     else {
-      nbytes = context->decompress_func(src, cbytes, _tmp, neblock);
+      TIMED(stats, codec, nbytes = decompress_func(src, cbytes, _tmp, neblock));
       /* Check that decompressed bytes number is correct */
       if (nbytes != neblock) {
         return -2;
@@ -786,73 +1683,690 @@ static int blosc_d(struct blosc_context* context, int32_t blocksize,
     ntbytes += nbytes;
   } /* Closes j < nsplits */
 
-  if (doshuffle) {
-    blosc_internal_unshuffle(typesize, blocksize, tmp, dest);
+  if (doshuffle && context->streaming) {
+    /* Unshuffle into the (cache resident) tmp2 and stream it out */
+    TIMED(stats, filter,
+          blosc_internal_unshuffle(typesize, blocksize, tmp, tmp2));
+    rc = check_block(context, nblock, tmp2, blocksize);
+    if (rc < 0) {
+      return rc;
+    }
+    TIMED(stats, copy, fastcopy_stream(dest, tmp2, blocksize));
+    return ntbytes;
+  }
+  else if (doshuffle) {
+    TIMED(stats, filter,
+          blosc_internal_unshuffle(typesize, blocksize, tmp, dest));
   }
   else if (dobitshuffle) {
-    bscount = blosc_internal_bitunshuffle(typesize, blocksize, tmp, dest, tmp2);
+    TIMED(stats, filter,
+          bscount = blosc_internal_bitunshuffle(typesize, blocksize, tmp, dest,
+                                                tmp2));
     if (bscount < 0)
       return bscount;
   }
 
+  /* Verify the block while it is still hot in cache */
+  rc = check_block(context, nblock, dest, blocksize);
+  if (rc < 0) {
+    return rc;
+  }
+
   /* Return the number of uncompressed bytes */
   return ntbytes;
 }
 
+/* Size in bytes of the items for the reduction data types */
+static int32_t dtype_itemsize(int dtype)
+{
+  switch (dtype) {
+    case BLOSC_INT8:
+    case BLOSC_UINT8:
+      return 1;
+    case BLOSC_INT16:
+    case BLOSC_UINT16:
+      return 2;
+    case BLOSC_INT32:
+    case BLOSC_UINT32:
+    case BLOSC_FLOAT32:
+      return 4;
+    case BLOSC_INT64:
+    case BLOSC_UINT64:
+    case BLOSC_FLOAT64:
+      return 8;
+    default:
+      return -1;
+  }
+}
+
+/* Reduce the `n` items of type T in `data` into the partial `p`.  FIELD is
+   the member of the accumulator union to use.  The `acc != acc` checks are
+   only true for NaN, so that min/max skip NaN values (and get optimized
+   away for integer types). */
+#define REDUCE_ITEMS(T, FIELD, state, p, data, n) do {                      \
+  const T* v_ = (const T*)(data);                                           \
+  int64_t k_;                                                               \
+  switch ((state)->op) {                                                    \
+    case BLOSC_REDUCE_SUM:                                                  \
+      for (k_ = 0; k_ < (n); k_++) {                                        \
+        (p)->acc.FIELD += v_[k_];                                           \
+      }                                                                     \
+      break;                                                                \
+    case BLOSC_REDUCE_MIN:                                                  \
+      if ((p)->nitems == 0) (p)->acc.FIELD = v_[0];                         \
+      for (k_ = 0; k_ < (n); k_++) {                                        \
+        if (v_[k_] < (p)->acc.FIELD || (p)->acc.FIELD != (p)->acc.FIELD) {  \
+          (p)->acc.FIELD = v_[k_];                                          \
+        }                                                                   \
+      }                                                                     \
+      break;                                                                \
+    case BLOSC_REDUCE_MAX:                                                  \
+      if ((p)->nitems == 0) (p)->acc.FIELD = v_[0];                         \
+      for (k_ = 0; k_ < (n); k_++) {                                        \
+        if (v_[k_] > (p)->acc.FIELD || (p)->acc.FIELD != (p)->acc.FIELD) {  \
+          (p)->acc.FIELD = v_[k_];                                          \
+        }                                                                   \
+      }                                                                     \
+      break;                                                                \
+    case BLOSC_REDUCE_NONZERO:                                              \
+      for (k_ = 0; k_ < (n); k_++) {                                        \
+        (p)->acc.i += (v_[k_] != 0);                                        \
+      }                                                                     \
+      break;                                                                \
+    case BLOSC_REDUCE_HISTOGRAM: {                                          \
+      double scale_ = (state)->nbins / ((state)->hi - (state)->lo);         \
+      for (k_ = 0; k_ < (n); k_++) {                                        \
+        double x_ = (double)v_[k_];                                         \
+        if (x_ >= (state)->lo && x_ < (state)->hi) {                        \
+          int32_t bin_ = (int32_t)((x_ - (state)->lo) * scale_);            \
+          if (bin_ >= (state)->nbins) bin_ = (state)->nbins - 1;            \
+          (p)->hist[bin_]++;                                                \
+        }                                                                   \
+      }                                                                     \
+      break;                                                                \
+    }                                                                       \
+    default:                                                                \
+      break;                                                                \
+  }                                                                         \
+} while (0)
+
+/* Reduce a decompressed block while it is still hot in cache */
+static void reduce_block(struct reduce_state* state, struct reduce_partial* p,
+                         const uint8_t* data, int32_t nbytes)
+{
+  int64_t n = nbytes / state->itemsize;
+
+  if (n <= 0) {
+    return;
+  }
+
+  switch (state->dtype) {
+    case BLOSC_INT8:
+      REDUCE_ITEMS(int8_t, i, state, p, data, n);
+      break;
+    case BLOSC_UINT8:
+      REDUCE_ITEMS(uint8_t, u, state, p, data, n);
+      break;
+    case BLOSC_INT16:
+      REDUCE_ITEMS(int16_t, i, state, p, data, n);
+      break;
+    case BLOSC_UINT16:
+      REDUCE_ITEMS(uint16_t, u, state, p, data, n);
+      break;
+    case BLOSC_INT32:
+      REDUCE_ITEMS(int32_t, i, state, p, data, n);
+      break;
+    case BLOSC_UINT32:
+      REDUCE_ITEMS(uint32_t, u, state, p, data, n);
+      break;
+    case BLOSC_INT64:
+      REDUCE_ITEMS(int64_t, i, state, p, data, n);
+      break;
+    case BLOSC_UINT64:
+      REDUCE_ITEMS(uint64_t, u, state, p, data, n);
+      break;
+    case BLOSC_FLOAT32:
+      REDUCE_ITEMS(float, f, state, p, data, n);
+      break;
+    case BLOSC_FLOAT64:
+      REDUCE_ITEMS(double, f, state, p, data, n);
+      break;
+    default:
+      break;
+  }
+  p->nitems += n;
+}
+
+/* Reduce a block stored as a plain copy, without copying it out first
+   (unless it is misaligned for the item type) */
+static void reduce_memcpyed_block(struct reduce_state* state,
+                                  struct reduce_partial* p,
+                                  const uint8_t* data, int32_t nbytes,
+                                  uint8_t* tmp)
+{
+  if (((uintptr_t)data % state->itemsize) != 0) {
+    fastcopy(tmp, data, nbytes);
+    data = tmp;
+  }
+  reduce_block(state, p, data, nbytes);
+}
+
+/* The room for `size` bytes in the scratch memory, rounded up so that
+   the scratch buffers after it stay as aligned as the memory from
+   my_malloc() */
+static int32_t scratch_room(int32_t size)
+{
+  return (size + SCRATCH_ALIGN - 1) & ~(SCRATCH_ALIGN - 1);
+}
+
+/* The room for a compressed block in the scratch memory: the block, the
+   sizes of its splits and its flags */
+static int32_t ext_blocksize(int32_t typesize, int32_t blocksize)
+{
+  return scratch_room(blocksize + typesize * (int32_t)sizeof(int32_t) + 1);
+}
+
+/* The scratch memory that the codec of `context` needs for compressing
+   a block, which goes after the one from workspace_size().  Only the
+   high compression mode of BloscLZ needs some. */
+static int32_t codec_room(const struct blosc_context* context)
+{
+  int blosclz = (context->compcode == BLOSC_BLOSCLZ);
+
+#if !defined(HAVE_LZ4)
+  /* compress_block_auto() retries the slow codecs with BloscLZ */
+  blosclz = blosclz || context->compcode == BLOSC_LZ4HC ||
+            context->compcode == BLOSC_ZLIB || context->compcode == BLOSC_ZSTD;
+#endif
+  if (!context->compress || !blosclz ||
+      context->clevel < BLOSCLZ_HC_LEVEL) {
+    return 0;
+  }
+  return scratch_room(BLOSCLZ_WORKSPACE_SIZE);
+}
+
+/* The scratch memory needed to (de)compress blocks of `blocksize` bytes
+   in the serial path: a filtered block, a compressed block with the sizes
+   of its splits, and a decompressed block for getitem and reductions */
+static int32_t workspace_size(int32_t typesize, int32_t blocksize)
+{
+  /* BLOSC_MAX_BLOCKSIZE guarantees that this does not overflow */
+  return scratch_room(blocksize) + ext_blocksize(typesize, blocksize) +
+         blocksize;
+}
+
+/* Use `workspace` as the scratch memory for `context`, if it is large
+   enough */
+static int use_workspace(struct blosc_context* context, void* workspace,
+                         size_t wssize)
+{
+  int32_t needed = workspace_size(context->typesize, context->blocksize) +
+                   codec_room(context);
+
+  if (wssize < (size_t)needed) {
+    fprintf(stderr, "The workspace must be at least %d bytes long\n", needed);
+    return -1;
+  }
+  context->workspace = (uint8_t*)workspace;
+  return 0;
+}
+
+/* Get `size` bytes of scratch memory for the serial path.  The global
+   context lives across calls, so it keeps its scratch memory for the
+   next ones and only allocates it again when they need more. */
+static uint8_t* get_scratch(struct blosc_context* context, int32_t size)
+{
+  if (context->workspace != NULL) {
+    return context->workspace;
+  }
+  if (context != g_global_context) {
+    return my_malloc(size);
+  }
+  if (context->scratch_size < size) {
+    my_free(context->scratch);
+    context->scratch = my_malloc(size);
+    context->scratch_size = (context->scratch != NULL) ? size : 0;
+  }
+  return context->scratch;
+}
+
+/* Release the scratch memory from get_scratch() */
+static void put_scratch(struct blosc_context* context, uint8_t* scratch)
+{
+  if (scratch != context->workspace && context != g_global_context) {
+    my_free(scratch);
+  }
+}
+
+/* Get room for `size` bytes at the end of the stage of thread `tid` */
+static uint8_t* stage_room(struct sink_state* sink, int32_t tid, int32_t size)
+{
+  struct stage_segment* segment = sink->stages[tid];
+  int64_t segsize;
+
+  if (segment == NULL || segment->size - segment->used < size) {
+    /* Start a new segment instead of growing this one, which would
+       move the blocks already in it */
+    segsize = (size > STAGE_SEGMENT_SIZE) ? size : STAGE_SEGMENT_SIZE;
+    segment = (struct stage_segment*)my_malloc(sizeof(struct stage_segment) +
+                                               (size_t)segsize);
+    if (segment == NULL) {
+      return NULL;
+    }
+    segment->prev = sink->stages[tid];
+    segment->size = segsize;
+    segment->used = 0;
+    sink->stages[tid] = segment;
+  }
+  return (uint8_t*)(segment + 1) + segment->used;
+}
+
+/* Compress the block `nblock` into the stage of thread `tid`.  Returns
+   the compressed size, 0 if the block is larger than `ebsize` or a
+   negative value on error. */
+static int sink_block(struct blosc_context* context, int32_t tid,
+                      int32_t nblock, int32_t bsize, int32_t leftoverblock,
+                      int32_t ebsize, const uint8_t* src, uint8_t* tmp,
+                      uint8_t* tmp2, uint8_t* codec_tmp,
+                      struct phase_stats* stats)
+{
+  struct sink_state* sink = context->sink;
+  uint8_t* room = stage_room(sink, tid, ebsize);
+  int cbytes;
+
+  if (room == NULL) {
+    return -1;
+  }
+  cbytes = blosc_c(context, bsize, leftoverblock, 0, ebsize, src, room,
+                   tmp, tmp2, codec_tmp, stats);
+  if (cbytes > 0) {
+    sink->blocks[nblock] = room;
+    sink->sizes[nblock] = cbytes;
+    sink->stages[tid]->used += cbytes;
+  }
+  return cbytes;
+}
+
+/* Release the stages of all the threads */
+static void free_stages(struct sink_state* sink)
+{
+  struct stage_segment* segment;
+  int32_t t;
+
+  for (t = 0; t < BLOSC_MAX_THREADS; t++) {
+    while (sink->stages[t] != NULL) {
+      segment = sink->stages[t];
+      sink->stages[t] = segment->prev;
+      my_free(segment);
+    }
+  }
+}
+
+/* Pass the compressed buffer to the sink: the header from `dest`, and
+   then the copied source or the staged blocks, in order.  Blocks that
+   follow each other in memory are passed together. */
+static int flush_sink(struct blosc_context* context)
+{
+  struct sink_state* sink = context->sink;
+  int64_t csize = (context->checksums != NULL) ?
+                  (int64_t)context->nblocks * sizeof(int32_t) : 0;
+  int64_t size, bstart;
+  int32_t j, k;
+  int rc;
+
+  if (*(context->header_flags) & BLOSC_MEMCPYED) {
+    rc = sink->func(context->dest, (size_t)context->header_len,
+                    sink->user_data);
+    if (rc >= 0 && context->sourcesize > 0) {
+      rc = sink->func(context->src, (size_t)context->sourcesize,
+                      sink->user_data);
+    }
+    if (rc >= 0 && csize > 0) {
+      rc = sink->func(context->checksums, (size_t)csize, sink->user_data);
+    }
+    return (rc < 0) ? rc : 0;
+  }
+
+  /* The threads store the blocks in the order they finish them, but
+     they are passed to the sink in their own order */
+  bstart = checksums_offset(context) + csize;
+  for (j = 0; j < context->nblocks; j++) {
+    set_bstart(context, j, bstart);
+    bstart += sink->sizes[j];
+  }
+
+  rc = sink->func(context->dest, (size_t)(checksums_offset(context) + csize),
+                  sink->user_data);
+  for (j = 0; j < context->nblocks && rc >= 0; j = k) {
+    size = sink->sizes[j];
+    for (k = j + 1; k < context->nblocks &&
+                    sink->blocks[k] == sink->blocks[j] + size; k++) {
+      size += sink->sizes[k];
+    }
+    rc = sink->func(sink->blocks[j], (size_t)size, sink->user_data);
+  }
+  return (rc < 0) ? rc : 0;
+}
+
+/* The fragment holding the byte at `offset` of a scatter-gather list */
+static int32_t find_fragment(const struct blosc_context* context,
+                             int64_t offset)
+{
+  int32_t lo = 0, hi = context->iovcnt - 1, mid;
+
+  /* The last fragment starting at or before `offset`, which skips the
+     empty ones */
+  while (lo < hi) {
+    mid = lo + (hi - lo + 1) / 2;
+    if (context->iov_starts[mid] <= offset) {
+      lo = mid;
+    }
+    else {
+      hi = mid - 1;
+    }
+  }
+  return lo;
+}
+
+/* Copy `bsize` bytes at `boffset` of the fragments to `dest` */
+static void gather_block(const struct blosc_context* context, uint8_t* dest,
+                         int64_t boffset, int32_t bsize)
+{
+  int32_t i = find_fragment(context, boffset);
+  int64_t offset = boffset - context->iov_starts[i];
+  int64_t n;
+
+  for (; bsize > 0; i++, offset = 0) {
+    n = (int64_t)context->iov[i].iov_len - offset;
+    if (n > bsize) {
+      n = bsize;
+    }
+    memcpy(dest, (const uint8_t*)context->iov[i].iov_base + offset, (size_t)n);
+    dest += n;
+    bsize -= (int32_t)n;
+  }
+}
+
+/* Copy the `bsize` bytes of `block` to `boffset` of the fragments */
+static void scatter_block(const struct blosc_context* context,
+                          const uint8_t* block, int64_t boffset,
+                          int32_t bsize)
+{
+  int32_t i = find_fragment(context, boffset);
+  int64_t offset = boffset - context->iov_starts[i];
+  int64_t n;
+
+  for (; bsize > 0; i++, offset = 0) {
+    n = (int64_t)context->iov[i].iov_len - offset;
+    if (n > bsize) {
+      n = bsize;
+    }
+    memcpy((uint8_t*)context->iov[i].iov_base + offset, block, (size_t)n);
+    block += n;
+    bsize -= (int32_t)n;
+  }
+}
+
+/* The block at `boffset` of `bsize` bytes in the fragments, or NULL if
+   it spans several of them */
+static uint8_t* fragment_block(const struct blosc_context* context,
+                               int64_t boffset, int32_t bsize)
+{
+  int32_t i = find_fragment(context, boffset);
+  int64_t offset = boffset - context->iov_starts[i];
+
+  if (offset + bsize > (int64_t)context->iov[i].iov_len) {
+    return NULL;
+  }
+  return (uint8_t*)context->iov[i].iov_base + offset;
+}
+
+/* The source block at `boffset`, gathered into `gather` only if it spans
+   several fragments */
+static const uint8_t* source_block(const struct blosc_context* context,
+                                   int64_t boffset, int32_t bsize,
+                                   uint8_t* gather)
+{
+  const uint8_t* block;
+
+  if (context->iov == NULL) {
+    return context->src + boffset;
+  }
+  block = fragment_block(context, boffset, bsize);
+  if (block == NULL) {
+    gather_block(context, gather, boffset, bsize);
+    block = gather;
+  }
+  return block;
+}
+
+/* Where to write the destination block at `boffset`.  If it is `gather`,
+   because the block spans several fragments, it has to be scattered
+   afterwards. */
+static uint8_t* dest_block(const struct blosc_context* context,
+                           int64_t boffset, int32_t bsize, uint8_t* gather)
+{
+  uint8_t* block;
+
+  if (context->iov == NULL) {
+    return context->dest + boffset;
+  }
+  block = fragment_block(context, boffset, bsize);
+  return (block != NULL) ? block : gather;
+}
+
+/* Fire the static probe of an event and pass it to the trace callback,
+   if any.  The probes are in the `blosc` provider, named after the
+   BLOSC_TRACE_* codes (chunk__start, block__end...), and take the
+   fields of blosc_trace_event that matter for them. */
+static void trace_event(int type, int compress, int tid, int32_t nblock,
+                        int codec, int64_t nbytes, int64_t result)
+{
+  blosc_trace_event event;
+  blosc_trace_callback callback = g_trace_callback;
+
+#if defined(HAVE_SYS_SDT_H)
+  switch (type) {
+    case BLOSC_TRACE_CHUNK_START:
+      DTRACE_PROBE2(blosc, chunk__start, compress, nbytes);
+      break;
+    case BLOSC_TRACE_CHUNK_END:
+      DTRACE_PROBE3(blosc, chunk__end, compress, nbytes, result);
+      break;
+    case BLOSC_TRACE_BLOCK_START:
+      DTRACE_PROBE4(blosc, block__start, compress, tid, nblock, nbytes);
+      break;
+    case BLOSC_TRACE_BLOCK_END:
+      DTRACE_PROBE6(blosc, block__end, compress, tid, nblock, codec, nbytes,
+                    result);
+      break;
+    case BLOSC_TRACE_THREAD_WAKEUP:
+      DTRACE_PROBE2(blosc, thread__wakeup, compress, tid);
+      break;
+    default:
+      break;
+  }
+#endif  /* HAVE_SYS_SDT_H */
+
+  if (callback == NULL) {
+    return;
+  }
+  event.type = type;
+  event.compress = compress;
+  event.tid = tid;
+  event.nblock = nblock;
+  event.codec = codec;
+  event.nbytes = nbytes;
+  event.result = result;
+  callback(&event, g_trace_user_data);
+}
+
+/* The codec of a block for the trace events: -1 if stored as is, or
+   the one in the flags of `block` (NULL if unknown) with block filters */
+static int block_codec(const struct blosc_context* context,
+                       const uint8_t* block)
+{
+  uint8_t flags = *(context->header_flags);
+
+  if (flags & BLOSC_MEMCPYED) {
+    return -1;
+  }
+  if ((flags & BLOSC_BLOCKFILTERS) == BLOSC_BLOCKFILTERS) {
+    if (block == NULL) {
+      return -1;
+    }
+    flags = block[0];
+  }
+  return (flags & 0xe0) >> 5;
+}
+
+/* The codec of the block `j` to decompress, read before the block is
+   (its data is overwritten when decompressing in place) */
+static int dblock_codec(const struct blosc_context* context, int32_t j)
+{
+  int64_t bstart;
+
+  if (*(context->header_flags) & BLOSC_MEMCPYED) {
+    return -1;
+  }
+  bstart = get_bstart(context, j);
+  if (bstart < 0 || bstart >= context->compressedsize) {
+    return -1;
+  }
+  return block_codec(context, context->src + bstart);
+}
+
 /* Serial version for compression/decompression */
-static int serial_blosc(struct blosc_context* context)
+static int64_t serial_blosc(struct blosc_context* context)
 {
   int32_t j, bsize, leftoverblock;
   int32_t cbytes;
-
-  int32_t ebsize = context->blocksize + context->typesize * (int32_t)sizeof(int32_t);
-  int32_t ntbytes = context->num_output_bytes;
-
-  uint8_t *tmp = my_malloc(context->blocksize + ebsize);
-  uint8_t *tmp2 = tmp + context->blocksize;
+  int64_t boffset;              /* offset of the block in the uncompressed buffer */
+  const uint8_t *bsrc;
+  uint8_t *bdest;
+  int codec;                    /* codec of the block, for the trace events */
+
+  int32_t ebsize = ext_blocksize(context->typesize, context->blocksize);
+  struct phase_stats* stats = &context->stats;
+  int64_t ntbytes = context->num_output_bytes;
+
+  /* Reductions need an additional buffer to decompress the block into,
+     and scatter-gather lists one for the blocks spanning fragments */
+  int32_t rbsize = (context->reduce != NULL || context->iov != NULL) ?
+                   context->blocksize : 0;
+  int32_t bsroom = scratch_room(context->blocksize);
+  int32_t croom = codec_room(context);
+  uint8_t *tmp = get_scratch(context, bsroom + ebsize + croom + rbsize);
+  uint8_t *tmp2 = tmp + bsroom;
+  uint8_t *codec_tmp = tmp + bsroom + ebsize;
+  uint8_t *tmp3 = codec_tmp + croom;
+
+  if (tmp == NULL) {
+    return -1;
+  }
 
   for (j = 0; j < context->nblocks; j++) {
     if (context->compress && !(*(context->header_flags) & BLOSC_MEMCPYED)) {
-      _sw32(context->bstarts + j * 4, ntbytes);
+      set_bstart(context, j, ntbytes);
     }
+    boffset = (int64_t)j * context->blocksize;
     bsize = context->blocksize;
     leftoverblock = 0;
     if ((j == context->nblocks - 1) && (context->leftover > 0)) {
       bsize = context->leftover;
       leftoverblock = 1;
     }
+    codec = context->compress ? -1 : dblock_codec(context, j);
+    trace_event(BLOSC_TRACE_BLOCK_START, context->compress, -1, j, codec,
+                bsize, 0);
     if (context->compress) {
+      bsrc = source_block(context, boffset, bsize, tmp3);
+      if (context->checksums != NULL) {
+        store_checksum(context, j, bsrc, bsize);
+      }
       if (*(context->header_flags) & BLOSC_MEMCPYED) {
-        /* We want to memcpy only */
-        fastcopy(context->dest + BLOSC_MAX_OVERHEAD + j * context->blocksize,
-                 context->src + j * context->blocksize, bsize);
+        /* We want to memcpy only (a sink takes `src` as is) */
+        if (context->sink == NULL) {
+          TIMED(stats, copy,
+                copy_block(context,
+                           context->dest + context->header_len + boffset,
+                           bsrc, bsize));
+        }
         cbytes = bsize;
       }
       else {
-        /* Regular compression */
-        cbytes = blosc_c(context, bsize, leftoverblock, ntbytes,
-                         context->destsize, context->src+j*context->blocksize,
-                         context->dest+ntbytes, tmp, tmp2);
+        if (context->sink != NULL) {
+          /* Compress into the stage, bounded as in the threads */
+          cbytes = sink_block(context, 0, j, bsize, leftoverblock, ebsize,
+                              bsrc, tmp, tmp2, codec_tmp, stats);
+          if (cbytes > 0 && ntbytes + cbytes > context->destsize) {
+            cbytes = 0;
+          }
+        }
+        else {
+          /* Regular compression */
+          cbytes = blosc_c(context, bsize, leftoverblock, ntbytes,
+                           context->destsize, bsrc,
+                           context->dest+ntbytes, tmp, tmp2, codec_tmp,
+                           stats);
+        }
         if (cbytes == 0) {
+          trace_event(BLOSC_TRACE_BLOCK_END, 1, -1, j, -1, bsize, 0);
           ntbytes = 0;              /* incompressible data */
           break;
         }
       }
     }
+    else if (context->reduce != NULL) {
+      if (*(context->header_flags) & BLOSC_MEMCPYED) {
+        cbytes = check_block(context, j,
+                             context->src + context->header_len + boffset, bsize);
+        if (cbytes == 0) {
+          reduce_memcpyed_block(context->reduce, &context->reduce->partials[0],
+                                context->src + context->header_len + boffset,
+                                bsize, tmp3);
+          cbytes = bsize;
+        }
+      }
+      else {
+        prefetch_block(context, j + 1);
+        cbytes = blosc_d(context, bsize, leftoverblock, j, context->src,
+                         get_bstart(context, j), tmp3, tmp, tmp2, stats);
+        if (cbytes > 0) {
+          reduce_block(context->reduce, &context->reduce->partials[0],
+                       tmp3, cbytes);
+        }
+      }
+    }
     else {
+      bdest = dest_block(context, boffset, bsize, tmp3);
       if (*(context->header_flags) & BLOSC_MEMCPYED) {
         /* We want to memcpy only */
-        fastcopy(context->dest + j * context->blocksize,
-                 context->src + BLOSC_MAX_OVERHEAD + j * context->blocksize, bsize);
-        cbytes = bsize;
+        TIMED(stats, copy,
+              copy_block(context, bdest,
+                         context->src + context->header_len + boffset, bsize));
+        cbytes = check_block(context, j, bdest, bsize);
+        if (cbytes == 0) {
+          cbytes = bsize;
+        }
       }
       else {
         /* Regular decompression */
-        cbytes = blosc_d(context, bsize, leftoverblock, context->src,
-                         sw32_(context->bstarts + j * 4),
-                         context->dest + j * context->blocksize, tmp, tmp2);
+        prefetch_block(context, j + 1);
+        cbytes = blosc_d(context, bsize, leftoverblock, j, context->src,
+                         get_bstart(context, j), bdest, tmp, tmp2, stats);
+      }
+      if (bdest == tmp3 && cbytes > 0) {
+        scatter_block(context, bdest, boffset, bsize);
       }
     }
+    if (context->compress && cbytes > 0) {
+      codec = block_codec(context, (context->sink != NULL) ?
+                                   context->sink->blocks[j] :
+                                   context->dest + ntbytes);
+    }
+    trace_event(BLOSC_TRACE_BLOCK_END, context->compress, -1, j, codec, bsize,
+                cbytes);
     if (cbytes < 0) {
       ntbytes = cbytes;         /* error in blosc_c or blosc_d */
       break;
@@ -861,14 +2375,14 @@ static int serial_blosc(struct blosc_context* context)
   }
 
   /* Free temporaries */
-  my_free(tmp);
+  put_scratch(context, tmp);
 
   return ntbytes;
 }
 
 
 /* Threaded version for compression/decompression */
-static int parallel_blosc(struct blosc_context* context)
+static int64_t parallel_blosc(struct blosc_context* context)
 {
   int rc;
   (void)rc;  // just to avoid 'unused-variable' warning
@@ -888,6 +2402,13 @@ static int parallel_blosc(struct blosc_context* context)
   /* Synchronization point for all threads (wait for finalization) */
   WAIT_FINISH(-1, context);
 
+#if defined(BLOSC_ENABLE_STATS)
+  /* Every thread waited from its arrival until now */
+  context->stats.wait += (uint64_t)context->numthreads * stats_clock() -
+                         context->stats.arrivals;
+  context->stats.arrivals = 0;
+#endif  /* BLOSC_ENABLE_STATS */
+
   if (context->thread_giveup_code > 0) {
     /* Return the total bytes (de-)compressed in threads */
     return context->num_output_bytes;
@@ -901,9 +2422,12 @@ static int parallel_blosc(struct blosc_context* context)
 
 /* Do the compression or decompression of the buffer depending on the
    global params. */
-static int do_job(struct blosc_context* context)
+static int64_t do_job(struct blosc_context* context)
 {
-  int32_t ntbytes;
+  int64_t ntbytes;
+
+  trace_event(BLOSC_TRACE_CHUNK_START, context->compress, -1, -1, -1,
+              context->sourcesize, 0);
 
   /* Run the serial version when nthreads is 1 or when the buffers are
      not much larger than blocksize */
@@ -913,6 +2437,9 @@ static int do_job(struct blosc_context* context)
   else {
     ntbytes = parallel_blosc(context);
   }
+  PUBLISH_STATS(&context->stats);
+  trace_event(BLOSC_TRACE_CHUNK_END, context->compress, -1, -1, -1,
+              context->sourcesize, ntbytes);
 
   return ntbytes;
 }
@@ -925,52 +2452,20 @@ static int do_job(struct blosc_context* context)
              ((codec) == BLOSC_ZSTD) ? 1 : 0 )
 
 
-/* Conditions for splitting a block before compressing with a codec. */
-static int split_block(int compcode, int typesize, int blocksize) {
-  int splitblock = -1;
-
-  switch (g_splitmode) {
-    case BLOSC_ALWAYS_SPLIT:
-      splitblock = 1;
-      break;
-    case BLOSC_NEVER_SPLIT:
-      splitblock = 0;
-      break;
-    case BLOSC_AUTO_SPLIT:
-      /* Normally all the compressors designed for speed benefit from a
-         split.  However, in conducted benchmarks LZ4 seems that it runs
-         faster if we don't split, which is quite surprising. */
-      splitblock= (((compcode == BLOSC_BLOSCLZ) ||
-                    (compcode == BLOSC_SNAPPY)) &&
-                   (typesize <= MAX_SPLITS) &&
-                   (blocksize / typesize) >= MIN_BUFFERSIZE);
-      break;
-    case BLOSC_FORWARD_COMPAT_SPLIT:
-      /* The zstd support was introduced at the same time than the split flag, so
-       * there should be not a problem with not splitting bloscks with it */
-      splitblock = ((compcode != BLOSC_ZSTD) &&
-                    (typesize <= MAX_SPLITS) &&
-                    (blocksize / typesize) >= MIN_BUFFERSIZE);
-      break;
-    default:
-      fprintf(stderr, "Split mode %d not supported", g_splitmode);
-  }
-  return splitblock;
-}
-
 
 static int32_t compute_blocksize(struct blosc_context* context, int32_t clevel,
-                                 int32_t typesize, int32_t nbytes,
+                                 int32_t typesize, int64_t nbytes,
                                  int32_t forced_blocksize)
 {
   int32_t blocksize;
 
   /* Protection against very small buffers */
-  if (nbytes < (int32_t)typesize) {
+  if (nbytes < (int64_t)typesize) {
     return 1;
   }
 
-  blocksize = nbytes;           /* Start by a whole buffer as blocksize */
+  /* Start by a whole buffer as blocksize (only kept for buffers < L1) */
+  blocksize = (nbytes > BLOSC_MAX_BLOCKSIZE) ? BLOSC_MAX_BLOCKSIZE : (int32_t)nbytes;
 
   if (forced_blocksize) {
     blocksize = forced_blocksize;
@@ -1047,8 +2542,8 @@ static int32_t compute_blocksize(struct blosc_context* context, int32_t clevel,
   }
 
   /* Check that blocksize is not too large */
-  if (blocksize > (int32_t)nbytes) {
-    blocksize = nbytes;
+  if (blocksize > nbytes) {
+    blocksize = (int32_t)nbytes;
   }
 
   /* blocksize *must absolutely* be a multiple of the typesize */
@@ -1070,26 +2565,29 @@ static int initialize_context_compression(struct blosc_context* context,
                           int32_t compressor,
                           int32_t blocksize,
                           int32_t numthreads,
+                          int extended,
                           int warnlvl)
 {
+  /* The extended format has a larger header but no 2 GB limit */
+  size_t max_overhead = extended ? BLOSC_MAX_OVERHEAD_EXTENDED : BLOSC_MAX_OVERHEAD;
+  size_t max_buffersize = extended ? (size_t)BLOSC_MAX_BUFFERSIZE_EXTENDED :
+                                     (size_t)BLOSC_MAX_BUFFERSIZE;
+
   /* Check buffer size limits and clamp destsize */
-  if (sourcesize > BLOSC_MAX_BUFFERSIZE) {
+  if (sourcesize > max_buffersize) {
     if (warnlvl > 0) {
-      fprintf(stderr, "Input buffer size cannot exceed %d bytes\n",
-              BLOSC_MAX_BUFFERSIZE);
+      fprintf(stderr, "Input buffer size cannot exceed %.0f bytes\n",
+              (double)max_buffersize);
     }
     return 0;
   }
-  if (destsize < BLOSC_MAX_OVERHEAD) {
+  if (destsize < max_overhead) {
     if (warnlvl > 0) {
       fprintf(stderr, "Output buffer size should be larger than %d bytes\n",
-              BLOSC_MAX_OVERHEAD);
+              (int)max_overhead);
     }
     return 0;
   }
-  if (destsize - BLOSC_MAX_OVERHEAD > sourcesize) {
-    destsize = sourcesize + BLOSC_MAX_OVERHEAD;
-  }
 
   /* Compression level */
   if (clevel < 0 || clevel > 9) {
@@ -1100,9 +2598,9 @@ static int initialize_context_compression(struct blosc_context* context,
   }
 
   /* Shuffle */
-  if (doshuffle != 0 && doshuffle != 1 && doshuffle != 2) {
+  if (doshuffle < BLOSC_NOSHUFFLE || doshuffle > BLOSC_AUTOSHUFFLE) {
     if (warnlvl > 0) {
-      fprintf(stderr, "`shuffle` parameter must be either 0, 1 or 2!\n");
+      fprintf(stderr, "`shuffle` parameter must be either 0, 1, 2 or 3!\n");
     }
     return -10;
   }
@@ -1121,26 +2619,53 @@ static int initialize_context_compression(struct blosc_context* context,
 
   /* Set parameters */
   context->compress = 1;
+  context->reduce = NULL;
+  context->workspace = NULL;
+  context->sink = NULL;
+  context->iov = NULL;
   context->src = (const uint8_t*)src;
   context->dest = (uint8_t *)(dest);
   context->num_output_bytes = 0;
-  // previous checks ensure the following size_t to int32_t casts don't overflow
-  context->destsize = (int32_t)destsize;
-  context->sourcesize = (int32_t)sourcesize;
+  // previous checks ensure the following size_t to int64_t casts don't overflow
+  context->sourcesize = (int64_t)sourcesize;
   context->typesize = (int32_t)typesize;
+  context->header_len = (int32_t)max_overhead;
+  context->bstart_size = extended ? (int32_t)sizeof(int64_t) : (int32_t)sizeof(int32_t);
   context->compcode = compressor;
   context->numthreads = numthreads;
   context->end_threads = 0;
   context->clevel = clevel;
+  context->streaming = use_streaming_stores(context->sourcesize);
+  RESET_STATS(&context->stats);
 
   /* Get the blocksize */
   context->blocksize = compute_blocksize(context, clevel, context->typesize, context->sourcesize, blocksize);
 
   /* Compute number of blocks in buffer */
-  context->nblocks = context->sourcesize / context->blocksize;
-  context->leftover = context->sourcesize % context->blocksize;
+  if (context->sourcesize / context->blocksize >= INT32_MAX) {
+    if (warnlvl > 0) {
+      fprintf(stderr, "Too many blocks; please use a larger blocksize\n");
+    }
+    return -10;
+  }
+  context->nblocks = (int32_t)(context->sourcesize / context->blocksize);
+  context->leftover = (int32_t)(context->sourcesize % context->blocksize);
   context->nblocks = (context->leftover > 0) ? (context->nblocks + 1) : context->nblocks;
 
+  /* Clamp destsize, leaving room for the block checksums */
+  context->checksum = g_checksum;
+  if (context->checksum) {
+    max_overhead += (size_t)context->nblocks * sizeof(int32_t);
+  }
+  if (destsize > sourcesize + max_overhead) {
+    destsize = sourcesize + max_overhead;
+  }
+  if (!extended && destsize > INT_MAX) {
+    /* Sizes in the classic header are 32-bit */
+    destsize = INT_MAX;
+  }
+  context->destsize = (int64_t)destsize;
+
   return 1;
 }
 
@@ -1151,7 +2676,12 @@ static int write_compression_header(struct blosc_context* context, int clevel, i
   int dont_split;
 
   /* Write version header for this block */
-  context->dest[0] = BLOSC_VERSION_FORMAT;           /* blosc format version */
+  if (context->header_len == BLOSC_EXTENDED_HEADER_LENGTH) {
+    context->dest[0] = BLOSC_VERSION_FORMAT_EXTENDED;  /* blosc format version */
+  }
+  else {
+    context->dest[0] = BLOSC_VERSION_FORMAT;           /* blosc format version */
+  }
 
   /* Write compressor format */
   compformat = -1;
@@ -1211,21 +2741,38 @@ static int write_compression_header(struct blosc_context* context, int clevel, i
   context->header_flags = context->dest+2;  /* flags */
   context->dest[2] = 0;  /* zeroes flags */
   context->dest[3] = (uint8_t)context->typesize;  /* type size */
-  _sw32(context->dest + 4, context->sourcesize);  /* size of the buffer */
-  _sw32(context->dest + 8, context->blocksize);  /* block size */
-  context->bstarts = context->dest + 16;  /* starts for every block */
-  context->num_output_bytes = 16 + sizeof(int32_t)*context->nblocks;  /* space for header and pointers */
+  if (context->header_len == BLOSC_EXTENDED_HEADER_LENGTH) {
+    _sw32(context->dest + 4, context->blocksize);  /* block size */
+    memset(context->dest + 8, 0, 8);  /* reserved */
+    _sw64(context->dest + 16, context->sourcesize);  /* size of the buffer */
+  }
+  else {
+    _sw32(context->dest + 4, (int32_t)context->sourcesize);  /* size of the buffer */
+    _sw32(context->dest + 8, context->blocksize);  /* block size */
+  }
+  context->bstarts = context->dest + context->header_len;  /* starts for every block */
+  /* space for header and pointers */
+  context->num_output_bytes = context->header_len +
+                              (int64_t)context->bstart_size * context->nblocks;
 
   if (context->clevel == 0) {
     /* Compression level 0 means buffer to be memcpy'ed */
     *(context->header_flags) |= BLOSC_MEMCPYED;
-    context->num_output_bytes = 16;      /* space just for header */
+    context->num_output_bytes = context->header_len;  /* space just for header */
   }
 
   if (context->sourcesize < MIN_BUFFERSIZE) {
     /* Buffer is too small.  Try memcpy'ing. */
     *(context->header_flags) |= BLOSC_MEMCPYED;
-    context->num_output_bytes = 16;      /* space just for header */
+    context->num_output_bytes = context->header_len;  /* space just for header */
+  }
+
+  if (context->checksum && context->nblocks > 0) {
+    /* Block checksums follow the bstarts (or the data if memcpyed) */
+    *(context->header_flags) |= BLOSC_CHECKSUMMED;  /* bit 3 set to one in flags */
+    if (!(*(context->header_flags) & BLOSC_MEMCPYED)) {
+      context->num_output_bytes += (int64_t)context->nblocks * sizeof(int32_t);
+    }
   }
 
   if (doshuffle == BLOSC_SHUFFLE) {
@@ -1238,6 +2785,15 @@ static int write_compression_header(struct blosc_context* context, int clevel, i
     *(context->header_flags) |= BLOSC_DOBITSHUFFLE;  /* bit 2 set to one in flags */
   }
 
+  if (doshuffle == BLOSC_AUTOSHUFFLE) {
+    /* Every block records its filter and codec (bits 0 and 2 set) */
+    *(context->header_flags) |= BLOSC_BLOCKFILTERS;
+    if (context->header_len == BLOSC_MIN_HEADER_LENGTH) {
+      /* Keep older versions from misreading the blocks */
+      context->dest[0] = BLOSC_VERSION_FORMAT_BLOCKFILTERS;
+    }
+  }
+
   dont_split = !split_block(context->compcode, context->typesize,
                             context->blocksize);
   *(context->header_flags) |= dont_split << 4;  /* dont_split is in bit 4 */
@@ -1247,37 +2803,204 @@ static int write_compression_header(struct blosc_context* context, int clevel, i
 }
 
 
-int blosc_compress_context(struct blosc_context* context)
+/* Whether the source buffer looks incompressible as a whole, judging from
+   a few blocks spread over it as the codec would see them: after the
+   filter, or after every filter that may be picked with block filters.
+   Only the sampled windows are filtered. */
+static int probe_incompressible_buffer(struct blosc_context* context)
+{
+  static const uint8_t filters[] = {0, BLOSC_DOSHUFFLE, BLOSC_DOBITSHUFFLE};
+  uint8_t header_flags = *(context->header_flags);
+  int blockfilters =
+    (header_flags & BLOSC_BLOCKFILTERS) == BLOSC_BLOCKFILTERS;
+  int32_t nprobes = (context->nblocks < PROBE_NBLOCKS) ?
+                    context->nblocks : PROBE_NBLOCKS;
+  int32_t nfilters = blockfilters ?
+                     (int32_t)(sizeof(filters) / sizeof(filters[0])) : 1;
+  uint8_t sample[2 * PROBE_WINDOW];
+  const uint8_t* const windows[2] = {sample, sample + PROBE_WINDOW};
+  int64_t boffset, bsize;
+  int32_t i, f;
+
+  if (nprobes == 0 || context->iov != NULL) {
+    /* Fragmented sources are only probed split by split */
+    return 0;
+  }
+  for (i = 0; i < nprobes; i++) {
+    boffset = (int64_t)(i * (context->nblocks / nprobes)) * context->blocksize;
+    bsize = context->sourcesize - boffset;
+    if (bsize > context->blocksize) {
+      bsize = context->blocksize;
+    }
+    if (bsize < 2 * PROBE_WINDOW) {
+      return 0;                 /* too small for the sample to tell */
+    }
+    for (f = 0; f < nfilters; f++) {
+      filter_windows(context, blockfilters ? filters[f] : header_flags,
+                     (int32_t)bsize, context->src + boffset, sample);
+      if (!probe_windows(windows)) {
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+/* Check that a memcpyed buffer fits in `dest` with its checksums, if
+   any.  Returns 0 if the data itself does not fit, and a negative value
+   if the checksums do not. */
+static int fit_memcpyed_checksums(struct blosc_context* context)
+{
+  int64_t csize = (int64_t)context->nblocks * sizeof(int32_t);
+
+  if (context->sourcesize + context->header_len > context->destsize) {
+    return 0;   /* data cannot be copied without overrun destination */
+  }
+  if ((*(context->header_flags) & BLOSC_CHECKSUMMED) &&
+      (context->sourcesize + context->header_len + csize > context->destsize)) {
+    fprintf(stderr, "No room for the checksums of the data stored as is "
+            "(see BLOSC_MAX_OVERHEAD_CHECKSUMS)\n");
+    return -1;
+  }
+  return 1;
+}
+
+/* Point the context to the checksums area in `dest`, if any */
+static void setup_checksums(struct blosc_context* context)
+{
+  context->checksums = NULL;
+  if ((*(context->header_flags) & BLOSC_CHECKSUMMED) &&
+      (*(context->header_flags) & BLOSC_MEMCPYED) && context->sink != NULL) {
+    /* The copied data is not in `dest`, which only holds the header */
+    context->checksums = context->dest + context->header_len;
+  }
+  else if (*(context->header_flags) & BLOSC_CHECKSUMMED) {
+    context->checksums = context->dest + checksums_offset(context);
+  }
+}
+
+int64_t blosc_compress_context(struct blosc_context* context)
 {
-  int32_t ntbytes = 0;
+  int64_t ntbytes = 0;
+  int rc;
 
-  if ((*(context->header_flags) & BLOSC_MEMCPYED) &&
-      (context->sourcesize + BLOSC_MAX_OVERHEAD > context->destsize)) {
-    return 0;   /* data cannot be copied without overrun destination */
+  if (!(*(context->header_flags) & BLOSC_MEMCPYED) &&
+      (context->sourcesize + context->header_len <= context->destsize) &&
+      probe_incompressible_buffer(context)) {
+    /* Store `src` as is right away, instead of after a failed attempt */
+    *(context->header_flags) |= BLOSC_MEMCPYED;
+    context->num_output_bytes = context->header_len;
+    COUNT(&context->stats, memcpy_fallbacks);
+  }
+
+  if (*(context->header_flags) & BLOSC_MEMCPYED) {
+    rc = fit_memcpyed_checksums(context);
+    if (rc <= 0) {
+      return rc;  /* data or checksums cannot be copied without overrun */
+    }
   }
 
   /* Do the actual compression */
+  setup_checksums(context);
   ntbytes = do_job(context);
   if (ntbytes < 0) {
     return -1;
   }
-  if ((ntbytes == 0) && (context->sourcesize + BLOSC_MAX_OVERHEAD <= context->destsize)) {
+  if ((ntbytes == 0) && (context->sourcesize + context->header_len <= context->destsize)) {
     /* Last chance for fitting `src` buffer in `dest`.  Update flags and force a copy. */
     *(context->header_flags) |= BLOSC_MEMCPYED;
-    context->num_output_bytes = BLOSC_MAX_OVERHEAD;  /* reset the output bytes in previous step */
+    context->num_output_bytes = context->header_len;  /* reset the output bytes in previous step */
+    COUNT(&context->stats, memcpy_fallbacks);
+    COUNT(&context->stats, recompressions);
+    if (fit_memcpyed_checksums(context) < 0) {
+      return -1;
+    }
+    setup_checksums(context);
     ntbytes = do_job(context);
     if (ntbytes < 0) {
       return -1;
     }
   }
+  if ((*(context->header_flags) & BLOSC_MEMCPYED) && context->checksums != NULL) {
+    /* The checksums go after the copied data */
+    ntbytes += (int64_t)context->nblocks * sizeof(int32_t);
+  }
 
   /* Set the number of compressed bytes in header */
-  _sw32(context->dest + 12, ntbytes);
+  if (context->header_len == BLOSC_EXTENDED_HEADER_LENGTH) {
+    _sw64(context->dest + 24, ntbytes);
+  }
+  else {
+    _sw32(context->dest + 12, (int32_t)ntbytes);
+  }
 
   assert(ntbytes <= context->destsize);
   return ntbytes;
 }
 
+int blosc_compress_ctx_sink(int clevel, int doshuffle, size_t typesize,
+                            size_t nbytes, const void* src,
+                            const char* compressor, size_t blocksize,
+                            int numinternalthreads, blosc_stream_sink sink,
+                            void* user_data)
+{
+  int error, result;
+  struct blosc_context context;
+  struct sink_state state;
+  size_t headsize;
+
+  if (sink == NULL) {
+    fprintf(stderr, "A sink is needed for compressing into it\n");
+    return -1;
+  }
+
+  /* Only the bound of the compressed size matters, not a real `dest` */
+  context.threads_started = 0;
+  error = initialize_context_compression(&context, clevel, doshuffle, typesize,
+                                         nbytes, src, NULL, (size_t)-1,
+                                         blosc_compname_to_compcode(compressor),
+                                         (int32_t)blocksize, numinternalthreads,
+                                         0, 0);
+  if (error <= 0) { return error; }
+
+  /* `dest` holds the header, the block starts and the checksums */
+  headsize = (size_t)context.header_len +
+             (size_t)context.nblocks * (context.bstart_size + sizeof(int32_t));
+  memset(&state, 0, sizeof(state));
+  state.func = sink;
+  state.user_data = user_data;
+  context.dest = my_malloc(headsize);
+  /* (at least one entry, for empty buffers) */
+  state.blocks = (uint8_t**)my_malloc((size_t)(context.nblocks + 1) *
+                                      sizeof(uint8_t*));
+  state.sizes = (int32_t*)my_malloc((size_t)(context.nblocks + 1) *
+                                    sizeof(int32_t));
+  context.sink = &state;
+  if (context.dest == NULL || state.blocks == NULL || state.sizes == NULL) {
+    result = -1;
+  }
+  else {
+    result = write_compression_header(&context, clevel, doshuffle);
+    if (result > 0) {
+      result = (int)blosc_compress_context(&context);
+    }
+    if (result > 0 && flush_sink(&context) < 0) {
+      result = -1;
+    }
+  }
+
+  if (numinternalthreads > 1)
+  {
+    blosc_release_threadpool(&context);
+  }
+  free_stages(&state);
+  my_free(state.sizes);
+  my_free(state.blocks);
+  my_free(context.dest);
+
+  return result;
+}
+
 /* The public routine for compression with context. */
 int blosc_compress_ctx(int clevel, int doshuffle, size_t typesize,
                        size_t nbytes, const void* src, void* dest,
@@ -1291,7 +3014,37 @@ int blosc_compress_ctx(int clevel, int doshuffle, size_t typesize,
   error = initialize_context_compression(&context, clevel, doshuffle, typesize,
 					 nbytes, src, dest, destsize,
 					 blosc_compname_to_compcode(compressor),
-					 blocksize, numinternalthreads, 0);
+					 blocksize, numinternalthreads, 0, 0);
+  if (error <= 0) { return error; }
+
+  error = write_compression_header(&context, clevel, doshuffle);
+  if (error <= 0) { return error; }
+
+  result = (int)blosc_compress_context(&context);
+
+  if (numinternalthreads > 1)
+  {
+    blosc_release_threadpool(&context);
+  }
+
+  return result;
+}
+
+/* The public routine for compression into the extended (64-bit) format. */
+int64_t blosc_compress_ctx64(int clevel, int doshuffle, size_t typesize,
+                             size_t nbytes, const void* src, void* dest,
+                             size_t destsize, const char* compressor,
+                             size_t blocksize, int numinternalthreads)
+{
+  int error;
+  int64_t result;
+  struct blosc_context context;
+
+  context.threads_started = 0;
+  error = initialize_context_compression(&context, clevel, doshuffle, typesize,
+					 nbytes, src, dest, destsize,
+					 blosc_compname_to_compcode(compressor),
+					 blocksize, numinternalthreads, 1, 0);
   if (error <= 0) { return error; }
 
   error = write_compression_header(&context, clevel, doshuffle);
@@ -1307,6 +3060,124 @@ int blosc_compress_ctx(int clevel, int doshuffle, size_t typesize,
   return result;
 }
 
+int blosc_compress_workspace_size(int clevel, int doshuffle, size_t typesize,
+                                  size_t nbytes, const char* compressor,
+                                  size_t blocksize)
+{
+  int error;
+  struct blosc_context context;
+
+  /* Only the parameters that the blocksize depends on are needed */
+  context.threads_started = 0;
+  error = initialize_context_compression(&context, clevel, doshuffle, typesize,
+                                         nbytes, NULL, NULL,
+                                         nbytes + BLOSC_MAX_OVERHEAD,
+                                         blosc_compname_to_compcode(compressor),
+                                         (int32_t)blocksize, 1, 0, 0);
+  if (error <= 0) { return (error < 0) ? error : -1; }
+
+  return workspace_size(context.typesize, context.blocksize) +
+         codec_room(&context);
+}
+
+int blosc_compress_ctx_ws(int clevel, int doshuffle, size_t typesize,
+                          size_t nbytes, const void* src, void* dest,
+                          size_t destsize, const char* compressor,
+                          size_t blocksize, void* workspace, size_t wssize)
+{
+  int error;
+  struct blosc_context context;
+
+  context.threads_started = 0;
+  error = initialize_context_compression(&context, clevel, doshuffle, typesize,
+					 nbytes, src, dest, destsize,
+					 blosc_compname_to_compcode(compressor),
+					 (int32_t)blocksize, 1, 0, 0);
+  if (error <= 0) { return error; }
+
+  if (workspace != NULL && use_workspace(&context, workspace, wssize) < 0) {
+    return -1;
+  }
+
+  error = write_compression_header(&context, clevel, doshuffle);
+  if (error <= 0) { return error; }
+
+  return (int)blosc_compress_context(&context);
+}
+
+/* Compute the offset of every fragment of a scatter-gather list.
+   Returns the total size of the fragments or a negative value on
+   error. */
+static int64_t iov_offsets(const blosc_iovec* iov, int iovcnt,
+                           int64_t** starts)
+{
+  int64_t total = 0;
+  int i;
+
+  *starts = NULL;
+  if (iovcnt < 0 || (iovcnt > 0 && iov == NULL)) {
+    fprintf(stderr, "Invalid scatter-gather list\n");
+    return -1;
+  }
+  /* (at least one entry, for empty lists) */
+  *starts = (int64_t*)my_malloc((size_t)(iovcnt + 1) * sizeof(int64_t));
+  if (*starts == NULL) {
+    return -1;
+  }
+  for (i = 0; i < iovcnt; i++) {
+    if (iov[i].iov_len > 0 && iov[i].iov_base == NULL) {
+      fprintf(stderr, "Fragment %d of the scatter-gather list is NULL\n", i);
+      my_free(*starts);
+      *starts = NULL;
+      return -1;
+    }
+    (*starts)[i] = total;
+    total += (int64_t)iov[i].iov_len;
+  }
+  return total;
+}
+
+int blosc_compress_ctx_iov(int clevel, int doshuffle, size_t typesize,
+                           const blosc_iovec* iov, int iovcnt, void* dest,
+                           size_t destsize, const char* compressor,
+                           size_t blocksize, int numinternalthreads)
+{
+  int error, result;
+  struct blosc_context context;
+  int64_t* starts;
+  int64_t nbytes;
+
+  nbytes = iov_offsets(iov, iovcnt, &starts);
+  if (nbytes < 0) { return -1; }
+
+  context.threads_started = 0;
+  error = initialize_context_compression(&context, clevel, doshuffle, typesize,
+                                         (size_t)nbytes, NULL, dest, destsize,
+                                         blosc_compname_to_compcode(compressor),
+                                         (int32_t)blocksize, numinternalthreads,
+                                         0, 0);
+  if (error <= 0) {
+    my_free(starts);
+    return error;
+  }
+  context.iov = iov;
+  context.iovcnt = iovcnt;
+  context.iov_starts = starts;
+
+  result = write_compression_header(&context, clevel, doshuffle);
+  if (result > 0) {
+    result = (int)blosc_compress_context(&context);
+  }
+
+  if (numinternalthreads > 1)
+  {
+    blosc_release_threadpool(&context);
+  }
+  my_free(starts);
+
+  return result;
+}
+
 /* The public routine for compression.  See blosc.h for docstrings. */
 int blosc_compress(int clevel, int doshuffle, size_t typesize, size_t nbytes,
                    const void *src, void *dest, size_t destsize)
@@ -1338,6 +3209,9 @@ int blosc_compress(int clevel, int doshuffle, size_t typesize, size_t nbytes,
     if (strcmp(envvar, "BITSHUFFLE") == 0) {
       doshuffle = BLOSC_BITSHUFFLE;
     }
+    if (strcmp(envvar, "AUTOSHUFFLE") == 0) {
+      doshuffle = BLOSC_AUTOSHUFFLE;
+    }
   }
 
   envvar = getenv("BLOSC_TYPESIZE");
@@ -1394,6 +3268,15 @@ int blosc_compress(int clevel, int doshuffle, size_t typesize, size_t nbytes,
     }
   }
 
+  envvar = getenv("BLOSC_CHECKSUM");
+  if (envvar != NULL) {
+    long value;
+    value = strtol(envvar, NULL, 10);
+    if ((value != EINVAL) && (value >= 0)) {
+      blosc_set_checksum((int)value);
+    }
+  }
+
   /* Check for a BLOSC_NOLOCK environment variable.  It is important
      that this should be the last env var so that it can take the
      previous ones into account */
@@ -1418,13 +3301,13 @@ int blosc_compress(int clevel, int doshuffle, size_t typesize, size_t nbytes,
     result = initialize_context_compression(g_global_context, clevel, doshuffle,
                                            typesize, nbytes, src, dest, destsize,
                                            g_compressor, g_force_blocksize,
-                                           g_threads, warnlvl);
+                                           g_threads, 0, warnlvl);
     if (result <= 0) { break; }
 
     result = write_compression_header(g_global_context, clevel, doshuffle);
     if (result <= 0) { break; }
 
-    result = blosc_compress_context(g_global_context);
+    result = (int)blosc_compress_context(g_global_context);
   } while (0);
 
   pthread_mutex_unlock(global_comp_mutex);
@@ -1432,106 +3315,394 @@ int blosc_compress(int clevel, int doshuffle, size_t typesize, size_t nbytes,
   return result;
 }
 
-static int blosc_run_decompression_with_context(struct blosc_context* context,
-                                                const void* src,
-                                                void* dest,
-                                                size_t destsize,
-                                                int numinternalthreads)
+/* Read and validate the header of a compressed buffer and set up the
+   context for decompression.  Returns 1 on success, 0 if the buffer is
+   empty and a negative value on errors. */
+/* Validate that the compressed size can hold the data or the bstarts,
+   plus the block checksums, and point the context to the latter */
+static int validate_block_layout(struct blosc_context* context)
 {
-  uint8_t version;
+  int64_t csize = 0;
+
+  if (*(context->header_flags) & BLOSC_CHECKSUMMED) {
+    csize = (int64_t)context->nblocks * sizeof(int32_t);
+  }
+  if (*(context->header_flags) & BLOSC_MEMCPYED) {
+    /* Validate that compressed size is equal to decompressed size + header
+       size (+ checksums). */
+    if (context->sourcesize + context->header_len + csize !=
+        context->compressedsize) {
+      return -1;
+    }
+  }
+  else {
+    /* Validate that compressed size is large enough to hold the bstarts
+       (and checksums) array */
+    if (context->nblocks > (context->compressedsize - context->header_len) /
+                           (context->bstart_size + (csize > 0 ? 4 : 0))) {
+      return -1;
+    }
+  }
+  if (csize > 0) {
+    context->checksums = (uint8_t*)context->src + checksums_offset(context);
+  }
+  return 0;
+}
+
+static int initialize_context_decompression(struct blosc_context* context,
+                                            const void* src,
+                                            void* dest,
+                                            size_t destsize,
+                                            int numinternalthreads)
+{
+  struct blosc_header header;
   int32_t ntbytes;
 
   context->compress = 0;
+  context->reduce = NULL;
+  context->workspace = NULL;
+  context->sink = NULL;
+  context->iov = NULL;
   context->src = (const uint8_t*)src;
   context->dest = (uint8_t*)dest;
-  context->destsize = destsize;
+  context->destsize = (int64_t)destsize;
   context->num_output_bytes = 0;
   context->numthreads = numinternalthreads;
   context->end_threads = 0;
 
   /* Read the header block */
-  version = context->src[0];                        /* blosc format version */
-  context->compversion = context->src[1];
-
+  if (read_header(context->src, &header) < 0) {
+    /* Version from future */
+    return -1;
+  }
+  context->compversion = header.versionlz;
   context->header_flags = (uint8_t*)(context->src + 2);           /* flags */
-  context->typesize = (int32_t)context->src[3];      /* typesize */
-  context->sourcesize = sw32_(context->src + 4);     /* buffer size */
-  context->blocksize = sw32_(context->src + 8);      /* block size */
-  context->compressedsize = sw32_(context->src + 12); /* compressed buffer size */
-  context->bstarts = (uint8_t*)(context->src + 16);
+  context->typesize = header.typesize;
+  context->sourcesize = header.nbytes;
+  context->blocksize = header.blocksize;
+  context->compressedsize = header.cbytes;
+  context->header_len = header.header_len;
+  context->bstart_size = header.bstart_size;
+  context->bstarts = (uint8_t*)(context->src + header.header_len);
+  context->checksums = NULL;
+  context->streaming = use_streaming_stores(context->sourcesize);
+  RESET_STATS(&context->stats);
 
   if (context->sourcesize == 0) {
     /* Source buffer was empty, so we are done */
     return 0;
   }
 
-  if (context->blocksize <= 0 || context->blocksize > destsize ||
+  if (context->blocksize <= 0 || context->blocksize > context->destsize ||
       context->blocksize > BLOSC_MAX_BLOCKSIZE || context->typesize <= 0 ||
-      context->typesize > BLOSC_MAX_TYPESIZE) {
+      context->typesize > BLOSC_MAX_TYPESIZE || context->sourcesize < 0) {
     return -1;
   }
 
-  if (version != BLOSC_VERSION_FORMAT) {
-    /* Version from future */
-    return -1;
-  }
-  if (*context->header_flags & 0x08) {
-    /* compressor flags from the future */
+  /* Check that we have enough space to decompress */
+  if (context->sourcesize > context->destsize) {
     return -1;
   }
 
   /* Compute some params */
   /* Total blocks */
-  context->nblocks = context->sourcesize / context->blocksize;
-  context->leftover = context->sourcesize % context->blocksize;
+  if (context->sourcesize / context->blocksize >= INT32_MAX) {
+    return -1;
+  }
+  context->nblocks = (int32_t)(context->sourcesize / context->blocksize);
+  context->leftover = (int32_t)(context->sourcesize % context->blocksize);
   context->nblocks = (context->leftover>0)? context->nblocks+1: context->nblocks;
 
-  /* Check that we have enough space to decompress */
-  if (context->sourcesize > (int32_t)destsize) {
+  ntbytes = validate_block_layout(context);
+  if (ntbytes < 0) {
+    return ntbytes;
+  }
+  if (!(*(context->header_flags) & BLOSC_MEMCPYED)) {
+    ntbytes = initialize_decompress_func(context);
+    if (ntbytes != 0) return ntbytes;
+  }
+
+  return 1;
+}
+
+static int64_t blosc_run_decompression_with_context(struct blosc_context* context,
+                                                    const void* src,
+                                                    void* dest,
+                                                    size_t destsize,
+                                                    int numinternalthreads,
+                                                    void* workspace,
+                                                    size_t wssize)
+{
+  int64_t ntbytes;
+
+  ntbytes = initialize_context_decompression(context, src, dest, destsize,
+                                             numinternalthreads);
+  if (ntbytes <= 0) {
+    return ntbytes;
+  }
+  if (workspace != NULL && use_workspace(context, workspace, wssize) < 0) {
+    return -1;
+  }
+
+  /* Do the actual decompression */
+  ntbytes = do_job(context);
+  if (ntbytes < 0) {
+    return -1;
+  }
+
+  assert(ntbytes <= (int64_t)destsize);
+  return ntbytes;
+}
+
+int blosc_decompress_ctx(const void* src, void* dest, size_t destsize,
+                         int numinternalthreads) {
+  int result;
+  struct blosc_context context;
+
+  /* The return value limits decompression to 2 GB */
+  if (destsize > BLOSC_MAX_BUFFERSIZE) {
+    destsize = BLOSC_MAX_BUFFERSIZE;
+  }
+
+  context.threads_started = 0;
+  result = (int)blosc_run_decompression_with_context(&context, src, dest,
+                                                     destsize, numinternalthreads,
+                                                     NULL, 0);
+
+  if (numinternalthreads > 1)
+  {
+    blosc_release_threadpool(&context);
+  }
+
+  return result;
+}
+
+int64_t blosc_decompress_ctx64(const void* src, void* dest, size_t destsize,
+                               int numinternalthreads) {
+  int64_t result;
+  struct blosc_context context;
+
+  context.threads_started = 0;
+  result = blosc_run_decompression_with_context(&context, src, dest, destsize,
+                                                numinternalthreads, NULL, 0);
+
+  if (numinternalthreads > 1)
+  {
+    blosc_release_threadpool(&context);
+  }
+
+  return result;
+}
+
+int blosc_decompress_workspace_size(const void* src)
+{
+  struct blosc_header header;
+
+  if (read_header((const uint8_t*)src, &header) < 0) {
+    return -1;
+  }
+  if (header.blocksize <= 0 || header.blocksize > BLOSC_MAX_BLOCKSIZE ||
+      header.typesize <= 0 || header.typesize > BLOSC_MAX_TYPESIZE) {
     return -1;
   }
+  return workspace_size(header.typesize, header.blocksize);
+}
+
+int blosc_decompress_ctx_iov(const void* src, const blosc_iovec* iov,
+                             int iovcnt, int numinternalthreads) {
+  int result;
+  struct blosc_context context;
+  int64_t* starts;
+  int64_t destsize;
+
+  destsize = iov_offsets(iov, iovcnt, &starts);
+  if (destsize < 0) { return -1; }
+  /* The return value limits decompression to 2 GB */
+  if (destsize > BLOSC_MAX_BUFFERSIZE) {
+    destsize = BLOSC_MAX_BUFFERSIZE;
+  }
+
+  context.threads_started = 0;
+  result = initialize_context_decompression(&context, src, NULL,
+                                            (size_t)destsize,
+                                            numinternalthreads);
+  if (result > 0) {
+    context.iov = iov;
+    context.iovcnt = iovcnt;
+    context.iov_starts = starts;
+    result = (int)do_job(&context);
+    if (result < 0) {
+      result = -1;
+    }
+  }
+
+  if (numinternalthreads > 1)
+  {
+    blosc_release_threadpool(&context);
+  }
+  my_free(starts);
+
+  return result;
+}
+
+/* The least offset in the destination at which the compressed buffer
+   can start so that decompressing its blocks in order never overwrites
+   compressed data still to be read, or -1 if the bstarts are not valid.
+   The header, bstarts and checksums are not counted: they are kept
+   aside during the decompression. */
+static int64_t inplace_offset(const struct blosc_context* context)
+{
+  int64_t offset = 0;
+  int64_t first = context->compressedsize;
+  int64_t bstart, bend;
+  int32_t j;
 
   if (*(context->header_flags) & BLOSC_MEMCPYED) {
-    /* Validate that compressed size is equal to decompressed size + header
-       size. */
-    if (context->sourcesize + BLOSC_MAX_OVERHEAD != context->compressedsize) {
+    /* The blocks only move towards the start of the buffer */
+    return 0;
+  }
+  /* Walk backwards so that `first` is the lowest start of the blocks
+     decompressed from `j` on (threads store them in any order) */
+  for (j = context->nblocks - 1; j >= 0; j--) {
+    bstart = get_bstart(context, j);
+    if (bstart < context->header_len || bstart >= context->compressedsize) {
       return -1;
     }
-  } else {
-    ntbytes = initialize_decompress_func(context);
-    if (ntbytes != 0) return ntbytes;
+    if (bstart < first) {
+      first = bstart;
+    }
+    bend = (int64_t)j * context->blocksize + context->blocksize;
+    if (j == context->nblocks - 1 && context->leftover > 0) {
+      bend = context->sourcesize;
+    }
+    if (bend - first > offset) {
+      offset = bend - first;
+    }
+  }
+  return offset;
+}
+
+int blosc_decompress_inplace_margin(const void* src, size_t* margin)
+{
+  struct blosc_context context;
+  struct blosc_header header;
+  int64_t offset = 0;
+  int rc;
 
-    /* Validate that compressed size is large enough to hold the bstarts array */
-    if (context->nblocks > (context->compressedsize - 16) / 4) {
+  *margin = 0;
+  if (read_header((const uint8_t*)src, &header) < 0 || header.nbytes < 0 ||
+      header.cbytes < header.header_len) {
+    return -1;
+  }
+  context.threads_started = 0;
+  rc = initialize_context_decompression(&context, src, NULL,
+                                        (size_t)header.nbytes, 1);
+  if (rc < 0) {
+    return rc;
+  }
+  if (rc > 0) {
+    offset = inplace_offset(&context);
+    if (offset < 0) {
       return -1;
     }
   }
+  /* The buffer has to hold the compressed data and the decompressed one */
+  if (offset + header.cbytes > header.nbytes) {
+    *margin = (size_t)(offset + header.cbytes - header.nbytes);
+  }
+  return 0;
+}
+
+int blosc_decompress_inplace(void* buffer, size_t bufsize, size_t cbytes)
+{
+  struct blosc_context context;
+  uint8_t* chunk;
+  uint8_t* meta;
+  size_t nbytes;
+  int64_t nbstarts, ncsums, boffset, ntbytes;
+  int32_t j, bsize;
+  int result;
+
+  if (cbytes > bufsize) {
+    return -1;
+  }
+  chunk = (uint8_t*)buffer + (bufsize - cbytes);
+  if (blosc_cbuffer_validate(chunk, cbytes, &nbytes) < 0 ||
+      nbytes > BLOSC_MAX_BUFFERSIZE) {
+    return -1;
+  }
+  context.threads_started = 0;
+  result = initialize_context_decompression(&context, chunk, buffer, bufsize, 1);
+  if (result <= 0) {
+    return result;
+  }
+  ntbytes = inplace_offset(&context);
+  if (ntbytes < 0 || (int64_t)(bufsize - cbytes) < ntbytes) {
+    return -1;
+  }
 
-  /* Do the actual decompression */
-  ntbytes = do_job(context);
-  if (ntbytes < 0) {
+  /* The first blocks overwrite the header, bstarts and checksums, which
+     are needed until the last one, so keep a copy of them */
+  nbstarts = (*(context.header_flags) & BLOSC_MEMCPYED) ?
+             0 : (int64_t)context.bstart_size * context.nblocks;
+  ncsums = (context.checksums != NULL) ?
+           (int64_t)context.nblocks * (int64_t)sizeof(int32_t) : 0;
+  meta = my_malloc((size_t)(context.header_len + nbstarts + ncsums));
+  if (meta == NULL) {
     return -1;
   }
+  memcpy(meta, chunk, (size_t)(context.header_len + nbstarts));
+  if (ncsums > 0) {
+    memcpy(meta + context.header_len + nbstarts, context.checksums,
+           (size_t)ncsums);
+    context.checksums = meta + context.header_len + nbstarts;
+  }
+  context.header_flags = meta + 2;
+  context.bstarts = meta + context.header_len;
+
+  trace_event(BLOSC_TRACE_CHUNK_START, 0, -1, -1, -1, context.sourcesize, 0);
+  if (*(context.header_flags) & BLOSC_MEMCPYED) {
+    result = (int)context.sourcesize;
+    for (j = 0; j < context.nblocks; j++) {
+      boffset = (int64_t)j * context.blocksize;
+      bsize = context.blocksize;
+      if (j == context.nblocks - 1 && context.leftover > 0) {
+        bsize = context.leftover;
+      }
+      /* The source of the block may overlap its destination */
+      memmove(context.dest + boffset, chunk + context.header_len + boffset,
+              (size_t)bsize);
+      if (check_block(&context, j, context.dest + boffset, bsize) < 0) {
+        result = -1;
+        break;
+      }
+    }
+  }
+  else {
+    ntbytes = serial_blosc(&context);
+    result = (ntbytes < 0) ? -1 : (int)ntbytes;
+    PUBLISH_STATS(&context.stats);
+  }
+  trace_event(BLOSC_TRACE_CHUNK_END, 0, -1, -1, -1, context.sourcesize, result);
 
-  assert(ntbytes <= (int32_t)destsize);
-  return ntbytes;
+  my_free(meta);
+  return result;
 }
 
-int blosc_decompress_ctx(const void* src, void* dest, size_t destsize,
-                         int numinternalthreads) {
-  int result;
+int blosc_decompress_ctx_ws(const void* src, void* dest, size_t destsize,
+                            void* workspace, size_t wssize) {
   struct blosc_context context;
 
-  context.threads_started = 0;
-  result = blosc_run_decompression_with_context(&context, src, dest, destsize,
-                                                numinternalthreads);
-
-  if (numinternalthreads > 1)
-  {
-    blosc_release_threadpool(&context);
+  /* The return value limits decompression to 2 GB */
+  if (destsize > BLOSC_MAX_BUFFERSIZE) {
+    destsize = BLOSC_MAX_BUFFERSIZE;
   }
 
-  return result;
+  /* A single thread, so that there is no thread pool to set up */
+  context.threads_started = 0;
+  return (int)blosc_run_decompression_with_context(&context, src, dest,
+                                                   destsize, 1,
+                                                   workspace, wssize);
 }
 
 int blosc_decompress(const void* src, void* dest, size_t destsize) {
@@ -1561,28 +3732,215 @@ int blosc_decompress(const void* src, void* dest, size_t destsize) {
     return result;
   }
 
+  /* The return value limits decompression to 2 GB */
+  if (destsize > BLOSC_MAX_BUFFERSIZE) {
+    destsize = BLOSC_MAX_BUFFERSIZE;
+  }
+
   pthread_mutex_lock(global_comp_mutex);
 
-  result = blosc_run_decompression_with_context(g_global_context, src, dest,
-                                                destsize, g_threads);
+  result = (int)blosc_run_decompression_with_context(g_global_context, src, dest,
+                                                     destsize, g_threads,
+                                                     NULL, 0);
 
   pthread_mutex_unlock(global_comp_mutex);
 
   return result;
 }
 
-int blosc_getitem(const void* src, int start, int nitems, void* dest) {
+/* Run the reduction in `state` over all the blocks in `src`.  Returns the
+   number of items visited or a negative value on errors. */
+static int blosc_run_reduction(const void* src, struct reduce_state* state,
+                               int numinternalthreads)
+{
+  struct blosc_context context;
+  int64_t ntbytes;
+  int result;
+
+  if (numinternalthreads < 1 || numinternalthreads > BLOSC_MAX_THREADS) {
+    fprintf(stderr, "Error.  nthreads must be a positive integer <= %d",
+            BLOSC_MAX_THREADS);
+    return -1;
+  }
+
+  /* There is no destination buffer, so do not limit on its size */
+  context.threads_started = 0;
+  result = initialize_context_decompression(&context, src, NULL,
+                                            BLOSC_MAX_BUFFERSIZE,
+                                            numinternalthreads);
+  if (result <= 0) {
+    goto out;
+  }
+  if ((context.sourcesize % state->itemsize) != 0 ||
+      (context.blocksize % state->itemsize) != 0) {
+    /* Items would straddle blocks */
+    result = -1;
+    goto out;
+  }
+
+  context.reduce = state;
+  context.streaming = 0;    /* blocks are reduced, not written out */
+  ntbytes = do_job(&context);
+  result = (ntbytes < 0) ? -1 : (int)(ntbytes / state->itemsize);
+
+  out:
+  if (numinternalthreads > 1) {
+    blosc_release_threadpool(&context);
+  }
+  return result;
+}
+
+int blosc_reduce_ctx(const void* src, int dtype, int op, void* result,
+                     int numinternalthreads)
+{
+  struct reduce_state state;
+  int is_float = (dtype == BLOSC_FLOAT32 || dtype == BLOSC_FLOAT64);
+  int is_unsigned = (dtype == BLOSC_UINT8 || dtype == BLOSC_UINT16 ||
+                     dtype == BLOSC_UINT32 || dtype == BLOSC_UINT64);
+  int64_t nitems = 0;
+  int nthreads, i, rc;
+
+  if (op != BLOSC_REDUCE_SUM && op != BLOSC_REDUCE_MIN &&
+      op != BLOSC_REDUCE_MAX && op != BLOSC_REDUCE_NONZERO) {
+    fprintf(stderr, "Error.  Unknown reduction operation: %d\n", op);
+    return -1;
+  }
+  state.itemsize = dtype_itemsize(dtype);
+  if (state.itemsize < 0) {
+    fprintf(stderr, "Error.  Unknown data type: %d\n", dtype);
+    return -1;
+  }
+  state.op = op;
+  state.dtype = dtype;
+  nthreads = (numinternalthreads > 0 &&
+              numinternalthreads <= BLOSC_MAX_THREADS) ? numinternalthreads : 1;
+  memset(state.partials, 0, nthreads * sizeof(struct reduce_partial));
+
+  rc = blosc_run_reduction(src, &state, numinternalthreads);
+  if (rc < 0) {
+    return rc;
+  }
+
+  /* Merge the partial results of every thread */
+  for (i = 0; i < nthreads; i++) {
+    struct reduce_partial* p = &state.partials[i];
+    struct reduce_partial* r = &state.partials[0];
+    if (i == 0 || p->nitems == 0) {
+      nitems += p->nitems;
+      continue;
+    }
+    switch (op) {
+      case BLOSC_REDUCE_SUM:
+        if (is_float) r->acc.f += p->acc.f;
+        else r->acc.u += p->acc.u;    /* wraps the same for signed ints */
+        break;
+      case BLOSC_REDUCE_NONZERO:
+        r->acc.i += p->acc.i;
+        break;
+      case BLOSC_REDUCE_MIN:
+        if (nitems == 0 ||
+            (is_float && (p->acc.f < r->acc.f || r->acc.f != r->acc.f)) ||
+            (is_unsigned && p->acc.u < r->acc.u) ||
+            (!is_float && !is_unsigned && p->acc.i < r->acc.i)) {
+          r->acc = p->acc;
+        }
+        break;
+      case BLOSC_REDUCE_MAX:
+        if (nitems == 0 ||
+            (is_float && (p->acc.f > r->acc.f || r->acc.f != r->acc.f)) ||
+            (is_unsigned && p->acc.u > r->acc.u) ||
+            (!is_float && !is_unsigned && p->acc.i > r->acc.i)) {
+          r->acc = p->acc;
+        }
+        break;
+      default:
+        break;
+    }
+    nitems += p->nitems;
+  }
+
+  if (op == BLOSC_REDUCE_NONZERO) {
+    *(int64_t*)result = state.partials[0].acc.i;
+  }
+  else if (is_float) {
+    *(double*)result = state.partials[0].acc.f;
+  }
+  else if (is_unsigned) {
+    *(uint64_t*)result = state.partials[0].acc.u;
+  }
+  else {
+    *(int64_t*)result = state.partials[0].acc.i;
+  }
+
+  return rc;
+}
+
+int blosc_histogram_ctx(const void* src, int dtype, double lo, double hi,
+                        int nbins, int64_t* counts, int numinternalthreads)
+{
+  struct reduce_state state;
+  int64_t* hist;
+  int nthreads, i, j, rc;
+
+  if (nbins <= 0 || !(lo < hi)) {
+    fprintf(stderr, "Error.  Invalid histogram range or number of bins\n");
+    return -1;
+  }
+  state.itemsize = dtype_itemsize(dtype);
+  if (state.itemsize < 0) {
+    fprintf(stderr, "Error.  Unknown data type: %d\n", dtype);
+    return -1;
+  }
+  state.op = BLOSC_REDUCE_HISTOGRAM;
+  state.dtype = dtype;
+  state.lo = lo;
+  state.hi = hi;
+  state.nbins = nbins;
+  nthreads = (numinternalthreads > 0 &&
+              numinternalthreads <= BLOSC_MAX_THREADS) ? numinternalthreads : 1;
+
+  /* Every thread counts into its own set of bins */
+  hist = my_malloc_unaligned((size_t)nthreads * nbins * sizeof(int64_t));
+  if (hist == NULL) {
+    fprintf(stderr, "Error allocating memory!");
+    return -1;
+  }
+  memset(hist, 0, (size_t)nthreads * nbins * sizeof(int64_t));
+  memset(state.partials, 0, nthreads * sizeof(struct reduce_partial));
+  for (i = 0; i < nthreads; i++) {
+    state.partials[i].hist = hist + (size_t)i * nbins;
+  }
+
+  rc = blosc_run_reduction(src, &state, numinternalthreads);
+  if (rc >= 0) {
+    for (j = 0; j < nbins; j++) {
+      counts[j] = 0;
+      for (i = 0; i < nthreads; i++) {
+        counts[j] += state.partials[i].hist[j];
+      }
+    }
+  }
+
+  my_free(hist);
+  return rc;
+}
+
+/* Get items from `src`, using `workspace` as scratch memory if it is not
+   NULL */
+static int getitem(const void* src, int start, int nitems, void* dest,
+                   void* workspace, size_t wssize) {
   uint8_t *_src=NULL;               /* current pos for source buffer */
-  uint8_t version, compversion;     /* versions for compressed header */
+  struct blosc_header header;       /* header of the compressed buffer */
   uint8_t flags;                    /* flags for header */
   int32_t ntbytes = 0;              /* the number of uncompressed bytes */
   int32_t nblocks;                  /* number of total blocks in buffer */
   int32_t leftover;                 /* extra bytes at end of buffer */
-  uint8_t *bstarts;                 /* start pointers for each block */
-  int32_t typesize, blocksize, nbytes, compressedsize;
+  int32_t typesize, blocksize;
+  int64_t nbytes, compressedsize;
   int32_t j, bsize, bsize2, leftoverblock;
-  int32_t cbytes, startb, stopb;
-  int stop = start + nitems;
+  int32_t cbytes;
+  int64_t startb, stopb;
+  int64_t stop = (int64_t)start + nitems;
   uint8_t *tmp;
   uint8_t *tmp2;
   uint8_t *tmp3;
@@ -1592,57 +3950,53 @@ int blosc_getitem(const void* src, int start, int nitems, void* dest) {
   _src = (uint8_t *)(src);
 
   /* Read the header block */
-  version = _src[0];                        /* blosc format version */
-  compversion = _src[1];
-  flags = _src[2];                          /* flags */
-  typesize = (int32_t)_src[3];              /* typesize */
-  nbytes = sw32_(_src + 4);                 /* buffer size */
-  blocksize = sw32_(_src + 8);              /* block size */
-  compressedsize = sw32_(_src + 12); /* compressed buffer size */
-
-  if (version != BLOSC_VERSION_FORMAT)
+  if (read_header(_src, &header) < 0)
     return -9;
+  flags = header.flags;
+  typesize = header.typesize;
+  nbytes = header.nbytes;
+  blocksize = header.blocksize;
+  compressedsize = header.cbytes;
 
   if (blocksize <= 0 || blocksize > nbytes || blocksize > BLOSC_MAX_BLOCKSIZE ||
-      typesize <= 0 || typesize > BLOSC_MAX_TYPESIZE) {
+      typesize <= 0 || typesize > BLOSC_MAX_TYPESIZE ||
+      nbytes / blocksize >= INT32_MAX) {
     return -1;
   }
 
   /* Compute some params */
   /* Total blocks */
-  nblocks = nbytes / blocksize;
-  leftover = nbytes % blocksize;
+  nblocks = (int32_t)(nbytes / blocksize);
+  leftover = (int32_t)(nbytes % blocksize);
   nblocks = (leftover>0)? nblocks+1: nblocks;
 
-  /* Only initialize the fields blosc_d uses */
+  /* Only initialize the fields blosc_d and use_workspace() use */
+  context.compress = 0;
   context.typesize = typesize;
+  context.blocksize = blocksize;
   context.header_flags = &flags;
-  context.compversion = compversion;
+  context.compversion = header.versionlz;
   context.compressedsize = compressedsize;
-  if (flags & BLOSC_MEMCPYED) {
-    if (nbytes + BLOSC_MAX_OVERHEAD != compressedsize) {
-      return -1;
-    }
-  } else {
+  context.header_len = header.header_len;
+  context.bstart_size = header.bstart_size;
+  context.bstarts = _src + header.header_len;
+  context.src = _src;
+  context.sourcesize = nbytes;
+  context.nblocks = nblocks;
+  if (validate_block_layout(&context) < 0) {
+    return -1;
+  }
+  if (!(flags & BLOSC_MEMCPYED)) {
     ntbytes = initialize_decompress_func(&context);
     if (ntbytes != 0) return ntbytes;
 
-    if (nblocks >= (compressedsize - 16) / 4) {
+    if (nblocks >= (compressedsize - header.header_len) / header.bstart_size) {
       return -1;
     }
   }
 
-  ebsize = blocksize + typesize * (int32_t)sizeof(int32_t);
-  tmp = my_malloc(blocksize + ebsize + blocksize);
-  tmp2 = tmp + blocksize;
-  tmp3 = tmp + blocksize + ebsize;
-
-  _src += 16;
-  bstarts = _src;
-  _src += sizeof(int32_t)*nblocks;
-
   /* Check region boundaries */
-  if ((start < 0) || (start*typesize > nbytes)) {
+  if ((start < 0) || ((int64_t)start*typesize > nbytes)) {
     fprintf(stderr, "`start` out of bounds");
     return -1;
   }
@@ -1652,6 +4006,21 @@ int blosc_getitem(const void* src, int start, int nitems, void* dest) {
     return -1;
   }
 
+  if ((stop - start) * typesize > INT_MAX) {
+    fprintf(stderr, "`nitems` too large");
+    return -1;
+  }
+
+  if (workspace != NULL && use_workspace(&context, workspace, wssize) < 0) {
+    return -1;
+  }
+
+  ebsize = ext_blocksize(typesize, blocksize);
+  tmp = (context.workspace != NULL) ? context.workspace :
+        my_malloc(workspace_size(typesize, blocksize));
+  tmp2 = tmp + scratch_room(blocksize);
+  tmp3 = tmp2 + ebsize;
+
   for (j = 0; j < nblocks; j++) {
     bsize = blocksize;
     leftoverblock = 0;
@@ -1661,31 +4030,39 @@ int blosc_getitem(const void* src, int start, int nitems, void* dest) {
     }
 
     /* Compute start & stop for each block */
-    startb = start * typesize - j * blocksize;
-    stopb = stop * typesize - j * blocksize;
-    if ((startb >= (int)blocksize) || (stopb <= 0)) {
+    startb = (int64_t)start * typesize - (int64_t)j * blocksize;
+    stopb = stop * typesize - (int64_t)j * blocksize;
+    if ((startb >= blocksize) || (stopb <= 0)) {
       continue;
     }
     if (startb < 0) {
       startb = 0;
     }
-    if (stopb > (int)blocksize) {
+    if (stopb > blocksize) {
       stopb = blocksize;
     }
-    bsize2 = stopb - startb;
+    bsize2 = (int32_t)(stopb - startb);
 
     /* Do the actual data copy */
     if (flags & BLOSC_MEMCPYED) {
+      /* The whole block has to be checked */
+      cbytes = check_block(&context, j, (uint8_t *) src + header.header_len +
+                           (int64_t)j * blocksize, bsize);
+      if (cbytes < 0) {
+        ntbytes = cbytes;
+        break;
+      }
       /* We want to memcpy only */
       fastcopy((uint8_t *) dest + ntbytes,
-               (uint8_t *) src + BLOSC_MAX_OVERHEAD + j * blocksize + startb, bsize2);
+               (uint8_t *) src + header.header_len + (int64_t)j * blocksize + startb,
+               bsize2);
       cbytes = bsize2;
     }
     else {
       /* Regular decompression.  Put results in tmp2. */
-      cbytes = blosc_d(&context, bsize, leftoverblock,
-                       (uint8_t *)src, sw32_(bstarts + j * 4),
-                       tmp2, tmp, tmp3);
+      cbytes = blosc_d(&context, bsize, leftoverblock, j,
+                       (uint8_t *)src, get_bstart(&context, j),
+                       tmp2, tmp, tmp3, &context.stats);
       if (cbytes < 0) {
         ntbytes = cbytes;
         break;
@@ -1697,16 +4074,57 @@ int blosc_getitem(const void* src, int start, int nitems, void* dest) {
     ntbytes += cbytes;
   }
 
-  my_free(tmp);
+  if (tmp != context.workspace) {
+    my_free(tmp);
+  }
+  PUBLISH_STATS(&context.stats);
 
   return ntbytes;
 }
 
+int blosc_getitem(const void* src, int start, int nitems, void* dest) {
+  return getitem(src, start, nitems, dest, NULL, 0);
+}
+
+int blosc_getitem_ws(const void* src, int start, int nitems, void* dest,
+                     void* workspace, size_t wssize) {
+  return getitem(src, start, nitems, dest, workspace, wssize);
+}
+
+/* Make sure the scratch memory of a thread fits the blocks of the
+   current job.  It is allocated by the thread itself, so that its pages
+   are first touched (and placed) by the CPU that uses them. */
+static int thread_scratch(struct thread_context* context, int32_t blocksize,
+                          int32_t ebsize)
+{
+  /* Scatter-gather lists need room for a block spanning fragments */
+  size_t gsize = (context->parent_context->iov != NULL) ? (size_t)blocksize : 0;
+  size_t bsroom = (size_t)scratch_room(blocksize);
+  size_t croom = (size_t)codec_room(context->parent_context);
+  size_t size = bsroom + 2 * (size_t)ebsize + croom + gsize;
+
+  if (size > context->tmp_size) {
+    my_free(context->tmp);
+    context->tmp = my_malloc(size);
+    if (context->tmp == NULL) {
+      context->tmp_size = 0;
+      return -1;
+    }
+    context->tmp_size = size;
+  }
+  context->tmp2 = context->tmp + bsroom;
+  context->tmp3 = context->tmp2 + ebsize;
+  context->codec_tmp = context->tmp3 + ebsize;
+  context->gather = context->codec_tmp + croom;
+  return 0;
+}
+
 /* Decompress & unshuffle several blocks in a single thread */
 static void *t_blosc(void *ctxt)
 {
   struct thread_context* context = (struct thread_context*)ctxt;
-  int32_t cbytes, ntdest;
+  int32_t cbytes;
+  int64_t ntdest;
   int32_t tblocks;              /* number of blocks per thread */
   int32_t leftover2;
   int32_t tblock;               /* limit block on a thread */
@@ -1716,20 +4134,33 @@ static void *t_blosc(void *ctxt)
   int32_t blocksize;
   int32_t ebsize;
   int32_t compress;
-  int32_t maxbytes;
-  int32_t ntbytes;
+  int64_t maxbytes;
+  int64_t ntbytes;
+  int64_t boffset;              /* offset of the block in the uncompressed buffer */
+  const uint8_t *bsrc;
+  uint8_t *bdest;
+  int codec;                    /* codec of the block, for the trace events */
+  int32_t header_len;
   int32_t flags;
   int32_t nblocks;
   int32_t leftover;
-  uint8_t *bstarts;
   const uint8_t *src;
   uint8_t *dest;
   uint8_t *tmp;
   uint8_t *tmp2;
   uint8_t *tmp3;
+  struct reduce_state *reduce;
+  struct phase_stats *stats = &context->stats;
   int rc;
   (void)rc;  // just to avoid 'unused-variable' warning
 
+  /* Pin the thread before it touches its scratch memory, so that the
+     memory is placed on the node of the thread */
+  if (context->cpu >= 0 && blosc_internal_pin_thread(context->cpu) < 0) {
+    fprintf(stderr, "Warning: cannot pin thread %d to CPU %d\n",
+            context->tid, context->cpu);
+  }
+
   while(1)
   {
     /* Synchronization point for all threads (wait for initialization) */
@@ -1739,25 +4170,26 @@ static void *t_blosc(void *ctxt)
     {
       break;
     }
+    trace_event(BLOSC_TRACE_THREAD_WAKEUP, context->parent_context->compress,
+                context->tid, -1, -1, 0, 0);
 
     /* Get parameters for this thread before entering the main loop */
     blocksize = context->parent_context->blocksize;
-    ebsize = blocksize + context->parent_context->typesize * (int32_t)sizeof(int32_t);
+    ebsize = ext_blocksize(context->parent_context->typesize, blocksize);
     compress = context->parent_context->compress;
     flags = *(context->parent_context->header_flags);
     maxbytes = context->parent_context->destsize;
     nblocks = context->parent_context->nblocks;
     leftover = context->parent_context->leftover;
-    bstarts = context->parent_context->bstarts;
+    header_len = context->parent_context->header_len;
     src = context->parent_context->src;
     dest = context->parent_context->dest;
+    reduce = context->parent_context->reduce;
 
-    if (blocksize > context->tmpblocksize)
-    {
-      my_free(context->tmp);
-      context->tmp = my_malloc(blocksize + ebsize + blocksize);
-      context->tmp2 = context->tmp + blocksize;
-      context->tmp3 = context->tmp + blocksize + ebsize;
+    if (thread_scratch(context, blocksize, ebsize) < 0) {
+      pthread_mutex_lock(&context->parent_context->count_mutex);
+      context->parent_context->thread_giveup_code = -1;
+      pthread_mutex_unlock(&context->parent_context->count_mutex);
     }
 
     tmp = context->tmp;
@@ -1776,7 +4208,8 @@ static void *t_blosc(void *ctxt)
     }
     else {
       /* Decompression can happen using any order.  We choose
-       sequential block order on each thread */
+       sequential block order on each thread, so that every thread
+       writes a contiguous part of dest (from its own node, if pinned) */
 
       /* Blocks per thread */
       tblocks = nblocks / context->parent_context->numthreads;
@@ -1793,39 +4226,101 @@ static void *t_blosc(void *ctxt)
     /* Loop over blocks */
     leftoverblock = 0;
     while ((nblock_ < tblock) && context->parent_context->thread_giveup_code > 0) {
+      boffset = (int64_t)nblock_ * blocksize;
       bsize = blocksize;
       if (nblock_ == (nblocks - 1) && (leftover > 0)) {
         bsize = leftover;
         leftoverblock = 1;
       }
+      codec = compress ? -1 : dblock_codec(context->parent_context, nblock_);
+      trace_event(BLOSC_TRACE_BLOCK_START, compress, context->tid, nblock_,
+                  codec, bsize, 0);
       if (compress) {
+        bsrc = source_block(context->parent_context, boffset, bsize,
+                            context->gather);
+        if (context->parent_context->checksums != NULL) {
+          store_checksum(context->parent_context, nblock_, bsrc, bsize);
+        }
         if (flags & BLOSC_MEMCPYED) {
-          /* We want to memcpy only */
-          fastcopy(dest + BLOSC_MAX_OVERHEAD + nblock_ * blocksize,
-                   src + nblock_ * blocksize, bsize);
+          /* We want to memcpy only (a sink takes `src` as is) */
+          if (context->parent_context->sink == NULL) {
+            TIMED(stats, copy,
+                  copy_block(context->parent_context,
+                             dest + header_len + boffset, bsrc, bsize));
+          }
           cbytes = bsize;
         }
+        else if (context->parent_context->sink != NULL) {
+          /* Compress into the stage of this thread */
+          cbytes = sink_block(context->parent_context, context->tid, nblock_,
+                              bsize, leftoverblock, ebsize, bsrc, tmp, tmp3,
+                              context->codec_tmp, stats);
+        }
         else {
           /* Regular compression */
           cbytes = blosc_c(context->parent_context, bsize, leftoverblock, 0, ebsize,
-                           src+nblock_*blocksize, tmp2, tmp, tmp3);
+                           bsrc, tmp2, tmp, tmp3, context->codec_tmp, stats);
+        }
+      }
+      else if (reduce != NULL) {
+        /* Reduce the block instead of writing it to dest */
+        if (flags & BLOSC_MEMCPYED) {
+          cbytes = check_block(context->parent_context, nblock_,
+                               src + header_len + boffset, bsize);
+          if (cbytes == 0) {
+            reduce_memcpyed_block(reduce, &reduce->partials[context->tid],
+                                  src + header_len + boffset, bsize, tmp3);
+            cbytes = bsize;
+          }
+        }
+        else {
+          if (nblock_ + 1 < tblock) {
+            prefetch_block(context->parent_context, nblock_ + 1);
+          }
+          cbytes = blosc_d(context->parent_context, bsize, leftoverblock,
+                           nblock_, src,
+                           get_bstart(context->parent_context, nblock_),
+                           tmp3, tmp, tmp2, stats);
+          if (cbytes > 0) {
+            reduce_block(reduce, &reduce->partials[context->tid], tmp3, cbytes);
+          }
         }
       }
       else {
+        bdest = dest_block(context->parent_context, boffset, bsize, tmp3);
         if (flags & BLOSC_MEMCPYED) {
           /* We want to memcpy only */
-          fastcopy(dest + nblock_ * blocksize,
-                   src + BLOSC_MAX_OVERHEAD + nblock_ * blocksize, bsize);
-          cbytes = bsize;
+          TIMED(stats, copy,
+                copy_block(context->parent_context, bdest,
+                           src + header_len + boffset, bsize));
+          cbytes = check_block(context->parent_context, nblock_, bdest, bsize);
+          if (cbytes == 0) {
+            cbytes = bsize;
+          }
         }
         else {
+          if (nblock_ + 1 < tblock) {
+            prefetch_block(context->parent_context, nblock_ + 1);
+          }
           cbytes = blosc_d(context->parent_context, bsize, leftoverblock,
-                           src, sw32_(bstarts + nblock_ * 4),
-                           dest+nblock_*blocksize,
-                           tmp, tmp2);
+                           nblock_, src,
+                           get_bstart(context->parent_context, nblock_),
+                           bdest, tmp, tmp2, stats);
+        }
+        if (bdest == tmp3 && cbytes > 0) {
+          scatter_block(context->parent_context, bdest, boffset, bsize);
         }
       }
 
+      if (compress && cbytes > 0) {
+        codec = block_codec(context->parent_context,
+                            (context->parent_context->sink != NULL) ?
+                            context->parent_context->sink->blocks[nblock_] :
+                            tmp2);
+      }
+      trace_event(BLOSC_TRACE_BLOCK_END, compress, context->tid, nblock_, codec,
+                  bsize, cbytes);
+
       /* Check whether current thread has to giveup */
       if (context->parent_context->thread_giveup_code <= 0) {
         break;
@@ -1844,7 +4339,7 @@ static void *t_blosc(void *ctxt)
         /* Start critical section */
         pthread_mutex_lock(&context->parent_context->count_mutex);
         ntdest = context->parent_context->num_output_bytes;
-        _sw32(bstarts + nblock_ * 4, ntdest); /* update block start counter */
+        set_bstart(context->parent_context, nblock_, ntdest); /* update block start counter */
         if ( (cbytes == 0) || (ntdest+cbytes > maxbytes) ) {
           context->parent_context->thread_giveup_code = 0;  /* incompressible buffer */
           pthread_mutex_unlock(&context->parent_context->count_mutex);
@@ -1857,7 +4352,11 @@ static void *t_blosc(void *ctxt)
         /* End of critical section */
 
         /* Copy the compressed buffer to destination */
-        fastcopy(dest + ntdest, tmp2, cbytes);
+        if (context->parent_context->sink == NULL) {
+          TIMED(stats, copy,
+                copy_block(context->parent_context, dest + ntdest, tmp2,
+                           cbytes));
+        }
       }
       else {
         nblock_++;
@@ -1875,6 +4374,15 @@ static void *t_blosc(void *ctxt)
       pthread_mutex_unlock(&context->parent_context->count_mutex);
     }
 
+#if defined(BLOSC_ENABLE_STATS)
+    /* Hand the stats of the job to the context, with the time this
+       thread starts waiting for the others */
+    pthread_mutex_lock(&context->parent_context->count_mutex);
+    merge_stats(&context->parent_context->stats, stats);
+    context->parent_context->stats.arrivals += stats_clock();
+    pthread_mutex_unlock(&context->parent_context->count_mutex);
+#endif  /* BLOSC_ENABLE_STATS */
+
     /* Meeting point for all threads (wait for finalization) */
     WAIT_FINISH(NULL, context->parent_context);
   }
@@ -1891,7 +4399,6 @@ static int init_threads(struct blosc_context* context)
 {
   int32_t tid;
   int rc2;
-  int32_t ebsize;
   struct thread_context* thread_context;
 
   /* Initialize mutex and condition variable objects */
@@ -1926,11 +4433,15 @@ static int init_threads(struct blosc_context* context)
     thread_context->parent_context = context;
     thread_context->tid = tid;
 
-    ebsize = context->blocksize + context->typesize * (int32_t)sizeof(int32_t);
-    thread_context->tmp = my_malloc(context->blocksize + ebsize + context->blocksize);
-    thread_context->tmp2 = thread_context->tmp + context->blocksize;
-    thread_context->tmp3 = thread_context->tmp + context->blocksize + ebsize;
-    thread_context->tmpblocksize = context->blocksize;
+    /* The scratch memory is allocated by the thread itself */
+    thread_context->tmp = NULL;
+    thread_context->tmp2 = NULL;
+    thread_context->tmp3 = NULL;
+    thread_context->codec_tmp = NULL;
+    thread_context->tmp_size = 0;
+    thread_context->cpu = (g_affinity_ncpus > 0) ?
+                          g_affinity_cpus[tid % g_affinity_ncpus] : -1;
+    RESET_STATS(&thread_context->stats);
 
 #if !defined(_WIN32)
     rc2 = pthread_create(&context->threads[tid], &context->ct_attr, t_blosc, (void *)thread_context);
@@ -2113,28 +4624,170 @@ void blosc_cbuffer_sizes(const void *cbuffer, size_t *nbytes,
                          size_t *cbytes, size_t *blocksize)
 {
   uint8_t *_src = (uint8_t *)(cbuffer);    /* current pos for source buffer */
-  uint8_t version = _src[0];               /* version of header */
+  struct blosc_header header;
 
-  if (version != BLOSC_VERSION_FORMAT) {
+  if (read_header(_src, &header) < 0) {
     *nbytes = *blocksize = *cbytes = 0;
     return;
   }
 
   /* Read the interesting values */
-  *nbytes = (size_t)sw32_(_src + 4);       /* uncompressed buffer size */
-  *blocksize = (size_t)sw32_(_src + 8);    /* block size */
-  *cbytes = (size_t)sw32_(_src + 12);      /* compressed buffer size */
+  *nbytes = (size_t)header.nbytes;         /* uncompressed buffer size */
+  *blocksize = (size_t)header.blocksize;   /* block size */
+  *cbytes = (size_t)header.cbytes;         /* compressed buffer size */
 }
 
 int blosc_cbuffer_validate(const void* cbuffer, size_t cbytes, size_t* nbytes) {
   size_t header_cbytes, header_blocksize;
+  uint8_t version;
   if (cbytes < BLOSC_MIN_HEADER_LENGTH) return -1;
+  version = ((const uint8_t*)cbuffer)[0];
+  if (version == BLOSC_VERSION_FORMAT_EXTENDED &&
+      cbytes < BLOSC_EXTENDED_HEADER_LENGTH) return -1;
   blosc_cbuffer_sizes(cbuffer, nbytes, &header_cbytes, &header_blocksize);
   if (header_cbytes != cbytes) return -1;
-  if (*nbytes > BLOSC_MAX_BUFFERSIZE) return -1;
+  if (version == BLOSC_VERSION_FORMAT_EXTENDED) {
+    if ((int64_t)*nbytes < 0 ||
+        (uint64_t)*nbytes > (uint64_t)BLOSC_MAX_BUFFERSIZE_EXTENDED) return -1;
+  }
+  else if (*nbytes > BLOSC_MAX_BUFFERSIZE) return -1;
   return 0;
 }
 
+/* Set up `context` for reading the compressed buffer `cbuffer` in
+   place.  Returns 0 for empty buffers, 1 for the rest and a negative
+   value if the buffer is not valid. */
+static int view_context(struct blosc_context* context, const void* cbuffer,
+                        size_t cbytes)
+{
+  size_t nbytes;
+
+  if (blosc_cbuffer_validate(cbuffer, cbytes, &nbytes) < 0) {
+    return -1;
+  }
+  context->threads_started = 0;
+  return initialize_context_decompression(context, cbuffer, NULL, nbytes, 1);
+}
+
+/* The data of the block `j` if it is stored as is (unfiltered, in a
+   single split that the codec left uncompressed), or NULL */
+static const uint8_t* raw_block(const struct blosc_context* context,
+                                int32_t j, int32_t bsize,
+                                int32_t leftoverblock)
+{
+  uint8_t flags = *(context->header_flags);
+  int32_t typesize = context->typesize;
+  int64_t offset = get_bstart(context, j);
+  int32_t cbytes;
+
+  if ((flags & BLOSC_BLOCKFILTERS) == BLOSC_BLOCKFILTERS) {
+    /* The block starts with its own flags */
+    if (offset < 0 || offset >= context->compressedsize) {
+      return NULL;
+    }
+    flags = context->src[offset];
+    offset += 1;
+    if ((flags & BLOSC_BLOCKFILTERS) == BLOSC_BLOCKFILTERS) {
+      return NULL;
+    }
+  }
+  /* The same conditions as in blosc_d() */
+  if (((flags & BLOSC_DOSHUFFLE) && typesize > 1) ||
+      ((flags & BLOSC_DOBITSHUFFLE) && bsize >= typesize)) {
+    return NULL;
+  }
+  if (!(flags & 0x10) && typesize > 1 && typesize <= MAX_SPLITS &&
+      (bsize / typesize) >= MIN_BUFFERSIZE && !leftoverblock) {
+    return NULL;    /* several splits */
+  }
+  if (offset < 0 || offset > context->compressedsize - (int64_t)sizeof(int32_t)) {
+    return NULL;
+  }
+  cbytes = sw32_(context->src + offset);
+  offset += sizeof(int32_t);
+  if (cbytes != bsize || cbytes > context->compressedsize - offset) {
+    return NULL;
+  }
+  return context->src + offset;
+}
+
+int blosc_cbuffer_view(const void* cbuffer, size_t cbytes, const void** data,
+                       size_t* nbytes)
+{
+  struct blosc_context context;
+  const uint8_t* block;
+  int32_t j, bsize;
+  int rc;
+
+  *data = NULL;
+  *nbytes = 0;
+  rc = view_context(&context, cbuffer, cbytes);
+  if (rc < 0) {
+    return rc;
+  }
+  if (rc == 0) {
+    /* Nothing to copy from an empty buffer either */
+    *data = (const uint8_t*)cbuffer + context.header_len;
+    return 1;
+  }
+  if (!(*(context.header_flags) & BLOSC_MEMCPYED)) {
+    return 0;
+  }
+
+  /* Verify the blocks, as decompressing them would */
+  for (j = 0; j < context.nblocks; j++) {
+    bsize = context.blocksize;
+    if (j == context.nblocks - 1 && context.leftover > 0) {
+      bsize = context.leftover;
+    }
+    block = context.src + context.header_len + (int64_t)j * context.blocksize;
+    if (check_block(&context, j, block, bsize) < 0) {
+      return -1;
+    }
+  }
+  *data = context.src + context.header_len;
+  *nbytes = (size_t)context.sourcesize;
+  return 1;
+}
+
+int blosc_cbuffer_block_view(const void* cbuffer, size_t cbytes, int nblock,
+                             const void** data, size_t* nbytes)
+{
+  struct blosc_context context;
+  const uint8_t* block;
+  int32_t bsize, leftoverblock;
+  int rc;
+
+  *data = NULL;
+  *nbytes = 0;
+  rc = view_context(&context, cbuffer, cbytes);
+  if (rc <= 0 || nblock < 0 || nblock >= context.nblocks) {
+    return -1;
+  }
+  bsize = context.blocksize;
+  leftoverblock = 0;
+  if (nblock == context.nblocks - 1 && context.leftover > 0) {
+    bsize = context.leftover;
+    leftoverblock = 1;
+  }
+
+  if (*(context.header_flags) & BLOSC_MEMCPYED) {
+    block = context.src + context.header_len + (int64_t)nblock * context.blocksize;
+  }
+  else {
+    block = raw_block(&context, nblock, bsize, leftoverblock);
+    if (block == NULL) {
+      return 0;
+    }
+  }
+  if (check_block(&context, nblock, block, bsize) < 0) {
+    return -1;
+  }
+  *data = block;
+  *nbytes = (size_t)bsize;
+  return 1;
+}
+
 /* Return `typesize` and `flags` from a compressed buffer. */
 void blosc_cbuffer_metainfo(const void *cbuffer, size_t *typesize,
                             int *flags)
@@ -2143,13 +4796,15 @@ void blosc_cbuffer_metainfo(const void *cbuffer, size_t *typesize,
 
   uint8_t version = _src[0];               /* version of header */
 
-  if (version != BLOSC_VERSION_FORMAT) {
+  if (version != BLOSC_VERSION_FORMAT &&
+      version != BLOSC_VERSION_FORMAT_EXTENDED &&
+      version != BLOSC_VERSION_FORMAT_BLOCKFILTERS) {
     *flags = *typesize = 0;
     return;
   }
 
   /* Read the interesting values */
-  *flags = (int)_src[2] & 7;             /* first three flags */
+  *flags = (int)_src[2] & 0xf;           /* first four flags */
   *typesize = (size_t)_src[3];           /* typesize */
 }
 
@@ -2199,6 +4854,86 @@ void blosc_set_splitmode(int mode)
   g_splitmode = mode;
 }
 
+void blosc_set_checksum(int checksum)
+{
+  g_checksum = checksum ? 1 : 0;
+}
+
+void blosc_set_hugepages(int hugepages)
+{
+  g_hugepages = hugepages ? 1 : 0;
+}
+
+int blosc_set_affinity(int policy, const int* cores, int ncores)
+{
+  int cpus[BLOSC_MAX_THREADS];
+  int ncpus;
+
+  ncpus = blosc_internal_affinity_cpus(policy, cores, ncores, cpus,
+                                       BLOSC_MAX_THREADS);
+  if (ncpus < 0) {
+    fprintf(stderr, "Error.  Cannot pin the threads with affinity policy %d "
+                    "(or the given CPUs) on this platform\n", policy);
+    return -1;
+  }
+  memcpy(g_affinity_cpus, cpus, (size_t)ncpus * sizeof(int));
+  g_affinity_ncpus = ncpus;
+
+  /* Restart the global pool with the new placement */
+  if (g_initlib) {
+    pthread_mutex_lock(global_comp_mutex);
+    blosc_release_threadpool(g_global_context);
+    pthread_mutex_unlock(global_comp_mutex);
+  }
+  return 0;
+}
+
+void blosc_set_trace_callback(blosc_trace_callback callback, void* user_data)
+{
+  g_trace_user_data = user_data;
+  g_trace_callback = callback;
+}
+
+int blosc_get_stats(blosc_stats* stats)
+{
+#if defined(BLOSC_ENABLE_STATS)
+  stats->filter_cycles = STATS_LOAD(g_stats.filter_cycles);
+  stats->codec_cycles = STATS_LOAD(g_stats.codec_cycles);
+  stats->copy_cycles = STATS_LOAD(g_stats.copy_cycles);
+  stats->wait_cycles = STATS_LOAD(g_stats.wait_cycles);
+  stats->incompressible_splits = STATS_LOAD(g_stats.incompressible_splits);
+  stats->memcpy_fallbacks = STATS_LOAD(g_stats.memcpy_fallbacks);
+  stats->recompressions = STATS_LOAD(g_stats.recompressions);
+  return 0;
+#else
+  memset(stats, 0, sizeof(blosc_stats));
+  return -1;
+#endif
+}
+
+void blosc_reset_stats(void)
+{
+#if defined(BLOSC_ENABLE_STATS)
+  STATS_CLEAR(g_stats.filter_cycles);
+  STATS_CLEAR(g_stats.codec_cycles);
+  STATS_CLEAR(g_stats.copy_cycles);
+  STATS_CLEAR(g_stats.wait_cycles);
+  STATS_CLEAR(g_stats.incompressible_splits);
+  STATS_CLEAR(g_stats.memcpy_fallbacks);
+  STATS_CLEAR(g_stats.recompressions);
+#endif
+}
+
+void* blosc_malloc(size_t size)
+{
+  return my_malloc(size);
+}
+
+void blosc_free(void* ptr)
+{
+  my_free(ptr);
+}
+
 /* Child global context is invalid and pool threads no longer exist post-fork.
  * Discard the old, inconsistent global context and global context mutex and
  * mark as uninitialized.  Subsequent calls through `blosc_*` interfaces will
@@ -2215,6 +4950,7 @@ void blosc_atfork_child(void) {
   my_free(global_comp_mutex);
   global_comp_mutex = NULL;
 
+  my_free(g_global_context->scratch);
   my_free(g_global_context);
   g_global_context = NULL;
 
@@ -2230,6 +4966,8 @@ void blosc_init(void)
 
   g_global_context = (struct blosc_context*)my_malloc(sizeof(struct blosc_context));
   g_global_context->threads_started = 0;
+  g_global_context->scratch = NULL;
+  g_global_context->scratch_size = 0;
 
   #if !defined(_WIN32)
   /* atfork handlers are only be registered once, though multiple re-inits may
@@ -2251,6 +4989,7 @@ void blosc_destroy(void)
   g_initlib = 0;
 
   blosc_release_threadpool(g_global_context);
+  my_free(g_global_context->scratch);
   my_free(g_global_context);
   g_global_context = NULL;
 
@@ -2313,5 +5052,32 @@ int blosc_free_resources(void)
   /* Return if Blosc is not initialized */
   if (!g_initlib) return -1;
 
+  pthread_mutex_lock(global_comp_mutex);
+  my_free(g_global_context->scratch);
+  g_global_context->scratch = NULL;
+  g_global_context->scratch_size = 0;
+  pthread_mutex_unlock(global_comp_mutex);
+
   return blosc_release_threadpool(g_global_context);
 }
+
+int blosc_set_allocator(const blosc_allocator* allocator)
+{
+  if (g_initlib) {
+    fprintf(stderr, "The allocator cannot be changed while Blosc is "
+                    "initialized; call blosc_destroy() first\n");
+    return -1;
+  }
+  if (allocator == NULL) {
+    /* Back to the system allocator */
+    memset(&g_allocator, 0, sizeof(g_allocator));
+    return 0;
+  }
+  if (allocator->malloc_func == NULL || allocator->aligned_malloc_func == NULL ||
+      allocator->free_func == NULL) {
+    fprintf(stderr, "All the functions of the allocator must be set\n");
+    return -1;
+  }
+  g_allocator = *allocator;
+  return 0;
+}
@@ -10,6 +10,7 @@
 
 #include <limits.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include "blosc-export.h"
 
 #ifdef __cplusplus
@@ -27,6 +28,14 @@ extern "C" {
 
 /* The *_FORMAT symbols should be just 1-byte long */
 #define BLOSC_VERSION_FORMAT    2   /* Blosc format version, starting at 1 */
+/* The formats below have bit 7 set, so that they are above any version
+   of the Blosc2 format (which goes upwards from 3) and every Blosc2
+   reader rejects them instead of misreading them (see
+   README_CHUNK_FORMAT.rst) */
+/* Blosc format version for the extended header with 64-bit sizes */
+#define BLOSC_VERSION_FORMAT_EXTENDED  0x83
+/* Blosc format version for the 16-byte header with per-block filters */
+#define BLOSC_VERSION_FORMAT_BLOCKFILTERS  0x84
 
 /* Minimum header length */
 #define BLOSC_MIN_HEADER_LENGTH 16
@@ -39,6 +48,28 @@ extern "C" {
 /* Maximum source buffer size to be compressed */
 #define BLOSC_MAX_BUFFERSIZE (INT_MAX - BLOSC_MAX_OVERHEAD)
 
+/* Length of the extended header (see blosc_compress_ctx64) */
+#define BLOSC_EXTENDED_HEADER_LENGTH 32
+
+/* The maximum overhead during compression in the extended format */
+#define BLOSC_MAX_OVERHEAD_EXTENDED BLOSC_EXTENDED_HEADER_LENGTH
+
+/* Maximum source buffer size to be compressed in the extended format */
+#define BLOSC_MAX_BUFFERSIZE_EXTENDED (INT64_MAX - BLOSC_MAX_OVERHEAD_EXTENDED)
+
+/* The maximum size of the per-block checksums of `nbytes` (see
+   blosc_set_checksum()): 4 bytes for every block, which are at least 128
+   bytes long (or a single byte for buffers smaller than their typesize) */
+#define BLOSC_MAX_CHECKSUMS_SIZE(nbytes) \
+  (4 * ((nbytes) < 256 ? (nbytes) : (nbytes) / 128 + 1))
+
+/* The maximum overhead during compression with per-block checksums, in
+   the regular and in the extended format */
+#define BLOSC_MAX_OVERHEAD_CHECKSUMS(nbytes) \
+  (BLOSC_MAX_OVERHEAD + BLOSC_MAX_CHECKSUMS_SIZE(nbytes))
+#define BLOSC_MAX_OVERHEAD_EXTENDED_CHECKSUMS(nbytes) \
+  (BLOSC_MAX_OVERHEAD_EXTENDED + BLOSC_MAX_CHECKSUMS_SIZE(nbytes))
+
 /* Maximum typesize before considering source buffer as a stream of bytes */
 #define BLOSC_MAX_TYPESIZE 255         /* Cannot be larger than 255 */
 
@@ -54,11 +85,14 @@ extern "C" {
 #define BLOSC_NOSHUFFLE   0  /* no shuffle */
 #define BLOSC_SHUFFLE     1  /* byte-wise shuffle */
 #define BLOSC_BITSHUFFLE  2  /* bit-wise shuffle */
+#define BLOSC_AUTOSHUFFLE 3  /* filter (and codec) chosen per block */
 
 /* Codes for internal flags (see blosc_cbuffer_metainfo) */
 #define BLOSC_DOSHUFFLE    0x1	/* byte-wise shuffle */
 #define BLOSC_MEMCPYED     0x2	/* plain copy */
 #define BLOSC_DOBITSHUFFLE 0x4  /* bit-wise shuffle */
+#define BLOSC_CHECKSUMMED  0x8  /* per-block CRC32C checksums */
+#define BLOSC_BLOCKFILTERS (BLOSC_DOSHUFFLE | BLOSC_DOBITSHUFFLE)  /* both: per-block filters */
 
 /* Codes for the different compressors shipped with Blosc */
 #define BLOSC_BLOSCLZ   0
@@ -116,6 +150,35 @@ extern "C" {
 #define BLOSC_AUTO_SPLIT 3
 #define BLOSC_FORWARD_COMPAT_SPLIT 4
 
+/* Policies for pinning the threads to CPUs (see blosc_set_affinity) */
+#define BLOSC_AFFINITY_NONE     0  /* let the OS place the threads */
+#define BLOSC_AFFINITY_COMPACT  1  /* fill the CPUs of a node first */
+#define BLOSC_AFFINITY_SCATTER  2  /* spread the threads over the nodes */
+
+/* Codes for the data types understood by reductions (see blosc_reduce_ctx) */
+#define BLOSC_INT8      0
+#define BLOSC_UINT8     1
+#define BLOSC_INT16     2
+#define BLOSC_UINT16    3
+#define BLOSC_INT32     4
+#define BLOSC_UINT32    5
+#define BLOSC_INT64     6
+#define BLOSC_UINT64    7
+#define BLOSC_FLOAT32   8
+#define BLOSC_FLOAT64   9
+
+/* Codes for reduction operations (see blosc_reduce_ctx) */
+#define BLOSC_REDUCE_SUM        0  /* sum of items */
+#define BLOSC_REDUCE_MIN        1  /* minimum item (NaNs are skipped) */
+#define BLOSC_REDUCE_MAX        2  /* maximum item (NaNs are skipped) */
+#define BLOSC_REDUCE_NONZERO    3  /* number of non-zero items */
+#define BLOSC_REDUCE_HISTOGRAM  4  /* only for blosc_histogram_ctx */
+
+/* Access pattern hints for memory-mapped files (see blosc_mmap_open) */
+#define BLOSC_MMAP_NORMAL      0  /* no hint */
+#define BLOSC_MMAP_SEQUENTIAL  1  /* chunks are read in order; read ahead */
+#define BLOSC_MMAP_RANDOM      2  /* sparse reads; do not read ahead */
+
 /**
   Initialize the Blosc library environment.
 
@@ -149,6 +212,14 @@ BLOSC_EXPORT void blosc_destroy(void);
   should be applied or not.  BLOSC_NOSHUFFLE means not applying it,
   BLOSC_SHUFFLE means applying it at a byte level and BLOSC_BITSHUFFLE
   at a bit level (slower but may achieve better entropy alignment).
+  BLOSC_AUTOSHUFFLE tries all of them on every block and keeps the one
+  that compresses best, so that a buffer mixing regions with different
+  structure gets the right filter for each of them.  In this mode,
+  blocks that compress about as well with a faster codec (LZ4, or
+  BloscLZ if LZ4 is not available) than with a zlib, zstd or LZ4HC one
+  use the faster one, which pays off at decompression.  Compression is
+  several times slower, and the buffers cannot be read by Blosc
+  versions before 1.21.7.
 
   `typesize` is the number of bytes for the atomic type in binary
   `src` buffer.  This is mainly useful for the shuffle filters.
@@ -158,7 +229,9 @@ BLOSC_EXPORT void blosc_destroy(void);
 
   The `dest` buffer must have at least the size of `destsize`.  Blosc
   guarantees that if you set `destsize` to, at least,
-  (`nbytes` + BLOSC_MAX_OVERHEAD), the compression will always succeed.
+  (`nbytes` + BLOSC_MAX_OVERHEAD), the compression will always succeed
+  (or to `nbytes` + BLOSC_MAX_OVERHEAD_CHECKSUMS(`nbytes`) with
+  checksums, see blosc_set_checksum()).
   The `src` buffer and the `dest` buffer can not overlap.
 
   Compression is memory safe and guaranteed not to write the `dest`
@@ -182,7 +255,7 @@ BLOSC_EXPORT void blosc_destroy(void);
   BLOSC_CLEVEL=(INTEGER): This will overwrite the `clevel` parameter
   before the compression process starts.
 
-  BLOSC_SHUFFLE=[NOSHUFFLE | SHUFFLE | BITSHUFFLE]: This will
+  BLOSC_SHUFFLE=[NOSHUFFLE | SHUFFLE | BITSHUFFLE | AUTOSHUFFLE]: This will
   overwrite the `doshuffle` parameter before the compression process
   starts.
 
@@ -213,6 +286,9 @@ BLOSC_EXPORT void blosc_destroy(void);
   This will call blosc_set_splitmode() with the different supported values.
   See blosc_set_splitmode() docstrings for more info on each mode.
 
+  BLOSC_CHECKSUM=(INTEGER): This will call blosc_set_checksum() with the
+  value, so any value larger than 0 stores per-block checksums.
+
   BLOSC_WARN=(INTEGER): This will print some warning message on stderr
   showing more info in situations where data inputs cannot be compressed.
   The values can range from 1 (less verbose) to 10 (full verbose).  0 is
@@ -279,6 +355,33 @@ BLOSC_EXPORT int blosc_compress_ctx(int clevel, int doshuffle, size_t typesize,
 */
 BLOSC_EXPORT int blosc_decompress(const void *src, void *dest, size_t destsize);
 
+/**
+  Context interface to blosc compression into the extended format.  It
+  takes the same parameters as blosc_compress_ctx(), but the buffer is
+  written with a 32-byte header (BLOSC_VERSION_FORMAT_EXTENDED) where the
+  sizes and block offsets are 64-bit, so `nbytes` is not limited to
+  BLOSC_MAX_BUFFERSIZE.  This allows compressing multi-GB buffers in a
+  single call using all the `numinternalthreads`.
+
+  `destsize` should be at least `nbytes` + BLOSC_MAX_OVERHEAD_EXTENDED
+  for the compression to always succeed.
+
+  Buffers in the extended format can be read by blosc_decompress_ctx64()
+  and, when they are smaller than 2 GB, by the rest of the decompression
+  functions of this library.  Older Blosc versions reject them because of
+  their format version.
+
+  Returns the number of bytes compressed into `dest`, 0 if the data is
+  not compressible into `destsize` or a negative value on errors.
+*/
+BLOSC_EXPORT int64_t blosc_compress_ctx64(int clevel, int doshuffle,
+                                          size_t typesize, size_t nbytes,
+                                          const void* src, void* dest,
+                                          size_t destsize,
+                                          const char* compressor,
+                                          size_t blocksize,
+                                          int numinternalthreads);
+
 /**
   Context interface to blosc decompression. This does not require a
   call to blosc_init() and can be called from multithreaded
@@ -301,6 +404,18 @@ BLOSC_EXPORT int blosc_decompress(const void *src, void *dest, size_t destsize);
 BLOSC_EXPORT int blosc_decompress_ctx(const void *src, void *dest,
                                       size_t destsize, int numinternalthreads);
 
+/**
+  Like blosc_decompress_ctx(), but able to decompress buffers in the
+  extended format that are larger than 2 GB.  Buffers in the classic
+  format are decompressed too.
+
+  Returns the number of bytes decompressed or 0 (zero) or a negative
+  value on errors.
+*/
+BLOSC_EXPORT int64_t blosc_decompress_ctx64(const void *src, void *dest,
+                                            size_t destsize,
+                                            int numinternalthreads);
+
 /**
   Get `nitems` (of typesize size) in `src` buffer starting in `start`.
   The items are returned in `dest` buffer, which has to have enough
@@ -311,6 +426,174 @@ BLOSC_EXPORT int blosc_decompress_ctx(const void *src, void *dest,
   */
 BLOSC_EXPORT int blosc_getitem(const void *src, int start, int nitems, void *dest);
 
+/**
+  Return the size of the workspace that blosc_compress_ctx_ws() needs
+  for compressing `nbytes` with these parameters (the same ones as for
+  blosc_compress_ctx()), or a negative value if they are not valid.
+  The size only depends on the blocksize and the typesize (plus the
+  tables of BloscLZ from clevel 8 on), so a workspace can be reused for
+  all the buffers compressed alike.
+*/
+BLOSC_EXPORT int blosc_compress_workspace_size(int clevel, int doshuffle,
+                                               size_t typesize, size_t nbytes,
+                                               const char* compressor,
+                                               size_t blocksize);
+
+/**
+  Return the size of the workspace that blosc_decompress_ctx_ws() and
+  blosc_getitem_ws() need for the compressed buffer `src`, or a negative
+  value if its header is not valid.  Every buffer with the same
+  blocksize and typesize needs the same size.
+*/
+BLOSC_EXPORT int blosc_decompress_workspace_size(const void *src);
+
+/**
+  Like blosc_compress_ctx() with a single thread, but using the
+  `wssize` bytes at `workspace` as scratch memory instead of allocating
+  it, so that compressing does not allocate memory from the heap
+  (except inside the zlib, zstd and lz4hc codec libraries).  See
+  blosc_compress_workspace_size() for the size needed.  Aligning the
+  workspace to 32 bytes is not required but makes it faster.
+
+  The workspace can be reused across calls but not shared between calls
+  running at the same time.  If it is NULL, the scratch memory is
+  allocated as in blosc_compress_ctx().  Returns -1 if `wssize` is too
+  small, and otherwise the same as blosc_compress_ctx().
+*/
+BLOSC_EXPORT int blosc_compress_ctx_ws(int clevel, int doshuffle,
+                                       size_t typesize, size_t nbytes,
+                                       const void* src, void* dest,
+                                       size_t destsize, const char* compressor,
+                                       size_t blocksize, void* workspace,
+                                       size_t wssize);
+
+/**
+  Like blosc_decompress_ctx() with a single thread, but using the
+  `wssize` bytes at `workspace` as scratch memory (see
+  blosc_compress_ctx_ws()).  See blosc_decompress_workspace_size() for
+  the size needed.
+*/
+BLOSC_EXPORT int blosc_decompress_ctx_ws(const void *src, void *dest,
+                                         size_t destsize, void* workspace,
+                                         size_t wssize);
+
+/**
+  Like blosc_getitem(), but using the `wssize` bytes at `workspace` as
+  scratch memory (see blosc_compress_ctx_ws()).  See
+  blosc_decompress_workspace_size() for the size needed.
+*/
+BLOSC_EXPORT int blosc_getitem_ws(const void *src, int start, int nitems,
+                                  void *dest, void* workspace, size_t wssize);
+
+/**
+  A fragment of a buffer given as a scatter-gather list.  It has the
+  same layout as the POSIX `struct iovec`.
+ */
+typedef struct blosc_iovec {
+  void* iov_base;
+  size_t iov_len;
+} blosc_iovec;
+
+/**
+  Compress the concatenation of the `iovcnt` fragments in `iov` as
+  blosc_compress_ctx() does with a contiguous source, without copying
+  them together first.  The blocks that lie within a fragment are
+  compressed in place, and only the ones spanning fragment boundaries
+  are gathered into scratch memory.  Fragments may have any size
+  (including 0).
+
+  Returns the same as blosc_compress_ctx().
+ */
+BLOSC_EXPORT int blosc_compress_ctx_iov(int clevel, int doshuffle,
+                                        size_t typesize,
+                                        const blosc_iovec* iov, int iovcnt,
+                                        void* dest, size_t destsize,
+                                        const char* compressor,
+                                        size_t blocksize,
+                                        int numinternalthreads);
+
+/**
+  Decompress `src` into the `iovcnt` fragments in `iov`, filling them in
+  order, as blosc_decompress_ctx() does with a contiguous destination.
+  The blocks that lie within a fragment are decompressed in place, and
+  only the ones spanning fragment boundaries are staged in scratch
+  memory and then scattered.
+
+  Returns the same as blosc_decompress_ctx(), the fragments together
+  being the destination.
+ */
+BLOSC_EXPORT int blosc_decompress_ctx_iov(const void* src,
+                                          const blosc_iovec* iov, int iovcnt,
+                                          int numinternalthreads);
+
+/**
+  Compute in `margin` how many bytes past the decompressed size a buffer
+  must have so that the compressed buffer `src`, placed at its tail, can
+  be decompressed in place with blosc_decompress_inplace().  Only the
+  header and the block starts of `src` are read, so they are enough to
+  size the buffer before loading the whole compressed data into it.
+
+  Returns 0 on success and a negative value if `src` is not valid.
+ */
+BLOSC_EXPORT int blosc_decompress_inplace_margin(const void* src,
+                                                 size_t* margin);
+
+/**
+  Decompress the `cbytes` bytes at the tail of `buffer` (of `bufsize`
+  bytes) into its start, so that the peak memory is about the
+  decompressed size instead of the compressed plus the decompressed
+  sizes.  `bufsize` has to be at least the decompressed size plus the
+  margin given by blosc_decompress_inplace_margin().  The blocks are
+  decompressed front to back, in a single thread, and each one only
+  overwrites compressed data that has already been consumed.
+
+  Returns the number of bytes decompressed, or a negative value if the
+  buffer is not valid or too small.  The compressed data is lost in any
+  case once the decompression has started.
+ */
+BLOSC_EXPORT int blosc_decompress_inplace(void* buffer, size_t bufsize,
+                                          size_t cbytes);
+
+/**
+  Compute a reduction over all the items in the compressed buffer `src`
+  without materializing the decompressed buffer.  Every block is
+  decompressed into a thread-local scratch buffer and reduced while it is
+  still in cache; blocks that were stored as plain copies are reduced
+  directly from `src`.
+
+  `dtype` is one of the BLOSC_INT8 ... BLOSC_FLOAT64 codes and `op` one of
+  BLOSC_REDUCE_SUM, BLOSC_REDUCE_MIN, BLOSC_REDUCE_MAX or
+  BLOSC_REDUCE_NONZERO.  The size of the buffer and of its blocks must be
+  a multiple of the size of `dtype`.
+
+  The result is written to `result`, which must point to an `int64_t` for
+  signed integer types, an `uint64_t` for unsigned ones and a `double` for
+  floating point ones.  BLOSC_REDUCE_NONZERO always writes an `int64_t`.
+  Integer sums wrap around on overflow.
+
+  `numinternalthreads`: number of threads to use internally.  As with
+  blosc_decompress_ctx(), this does not require a call to blosc_init().
+
+  Returns the number of items reduced or a negative value if some error
+  happens.
+  */
+BLOSC_EXPORT int blosc_reduce_ctx(const void *src, int dtype, int op,
+                                  void *result, int numinternalthreads);
+
+/**
+  Compute a histogram of the items (of type `dtype`, see
+  blosc_reduce_ctx()) in the compressed buffer `src`.  The range
+  [`lo`, `hi`) is divided into `nbins` equal bins and the number of items
+  falling in each of them is stored in `counts`, which must have room for
+  `nbins` values.  Items out of the range are not counted.
+
+  Returns the number of items visited or a negative value if some error
+  happens.
+  */
+BLOSC_EXPORT int blosc_histogram_ctx(const void *src, int dtype,
+                                     double lo, double hi, int nbins,
+                                     int64_t *counts, int numinternalthreads);
+
 /**
   Returns the current number of threads that are used for
   compression/decompression.
@@ -404,14 +687,45 @@ BLOSC_EXPORT int blosc_get_complib_info(const char *compname, char **complib, ch
 
 
 /**
-  Free possible memory temporaries and thread resources.  Use this
-  when you are not going to use Blosc for a long while.  In case of
+  Free possible memory temporaries and thread resources.  The scratch
+  buffers of blosc_compress() and blosc_decompress() are kept between
+  calls until then.  Use this when you are not going to use Blosc for a
+  long while.  In case of
   problems releasing the resources, it returns a negative number, else
   it returns 0.
   */
 BLOSC_EXPORT int blosc_free_resources(void);
 
 
+/**
+  The functions that Blosc uses for allocating its memory: contexts,
+  thread and scratch buffers, and the state of the zlib and zstd
+  codecs.  `aligned_malloc_func` must return memory aligned to
+  `alignment` (a power of two), and `free_func` is passed the memory
+  returned by any of the other two (never NULL).  `user_data` is passed
+  to all of them.  The super-chunks and memory maps, and the streams
+  (except for their chunk buffers), still use the C library allocator.
+*/
+typedef struct blosc_allocator {
+  void* (*malloc_func)(size_t size, void* user_data);
+  void* (*aligned_malloc_func)(size_t size, size_t alignment, void* user_data);
+  void (*free_func)(void* ptr, void* user_data);
+  void* user_data;
+} blosc_allocator;
+
+/**
+  Make Blosc allocate its memory with `allocator`, or with the C library
+  again if it is NULL.  The functions are copied, so `allocator` does
+  not need to outlive this call.
+
+  The allocator can only be changed when no memory from the previous
+  one is in use: before blosc_init() (or before any call to the context
+  functions) or after blosc_destroy().  Returns 0 on success or a
+  negative value if Blosc is initialized or a function is missing.
+  */
+BLOSC_EXPORT int blosc_set_allocator(const blosc_allocator* allocator);
+
+
 /**
   Return information about a compressed buffer, namely the number of
   uncompressed bytes (`nbytes`) and compressed (`cbytes`).  It also
@@ -434,7 +748,9 @@ BLOSC_EXPORT void blosc_cbuffer_sizes(const void *cbuffer, size_t *nbytes,
 
   On success, returns 0 and sets *nbytes to the size of the uncompressed data.
   This does not guarantee that the decompression function won't return an error,
-  but does guarantee that it is safe to attempt decompression.
+  but does guarantee that it is safe to attempt decompression.  Buffers in the
+  extended format larger than 2 GB can only be decompressed with
+  blosc_decompress_ctx64.
 
   On failure, returns -1.
  */
@@ -449,9 +765,14 @@ BLOSC_EXPORT int blosc_cbuffer_validate(const void* cbuffer, size_t cbytes,
     * bit 0: whether the shuffle filter has been applied or not
     * bit 1: whether the internal buffer is a pure memcpy or not
     * bit 2: whether the bit shuffle filter has been applied or not
+    * bit 3: whether the blocks carry CRC32C checksums or not
+
+  When both bits 0 and 2 are set (``(flags & BLOSC_BLOCKFILTERS) ==
+  BLOSC_BLOCKFILTERS``), the buffer has been compressed with
+  BLOSC_AUTOSHUFFLE and every block records its own filter and codec.
 
-  You can use the `BLOSC_DOSHUFFLE`, `BLOSC_DOBITSHUFFLE` and
-  `BLOSC_MEMCPYED` symbols for extracting the interesting bits
+  You can use the `BLOSC_DOSHUFFLE`, `BLOSC_DOBITSHUFFLE`,
+  `BLOSC_MEMCPYED` and `BLOSC_CHECKSUMMED` symbols for extracting the interesting bits
   (e.g. ``flags & BLOSC_DOSHUFFLE`` says whether the buffer is
   byte-shuffled or not).
 
@@ -483,6 +804,358 @@ BLOSC_EXPORT void blosc_cbuffer_versions(const void *cbuffer, int *version,
   */
 BLOSC_EXPORT const char *blosc_cbuffer_complib(const void *cbuffer);
 
+/**
+  Get the uncompressed data of the `cbytes` long compressed buffer
+  `cbuffer` in place, without copying it, if the buffer stores it as is
+  (the BLOSC_MEMCPYED flag, as for incompressible data or `clevel` 0).
+  On return, `*data` points to the `*nbytes` bytes of data inside
+  `cbuffer`, which are only valid as long as `cbuffer` is.  If the buffer
+  carries checksums, they are verified first.
+
+  Returns 1 if `*data` and `*nbytes` have been set, 0 if the buffer has
+  to be decompressed (with `*data` set to NULL), or a negative value if
+  the buffer is not valid or its checksums do not match.
+  */
+BLOSC_EXPORT int blosc_cbuffer_view(const void* cbuffer, size_t cbytes,
+                                    const void** data, size_t* nbytes);
+
+/**
+  Like blosc_cbuffer_view(), but for the block number `nblock` alone.
+  Besides the blocks of memcpyed buffers, this works for the blocks that
+  were stored unfiltered and in a single split that the codec left
+  uncompressed (see blosc_cbuffer_sizes() for the blocksize).
+
+  Returns 1 if `*data` and `*nbytes` have been set, 0 if the block has to
+  be decompressed, or a negative value if the buffer is not valid,
+  `nblock` is out of range or the checksum of the block does not match.
+  */
+BLOSC_EXPORT int blosc_cbuffer_block_view(const void* cbuffer, size_t cbytes,
+                                          int nblock, const void** data,
+                                          size_t* nbytes);
+
+
+
+/*********************************************************************
+
+  Super-chunk functions.  A super-chunk is a sequence of compressed
+  chunks, kept either in memory or in a file, plus an index of them
+  that allows getting any range of items without decompressing more
+  chunks (or blocks) than needed.
+
+*********************************************************************/
+
+typedef struct blosc_schunk blosc_schunk;
+
+/**
+  Create a new, empty, super-chunk in memory.
+
+  The `clevel`, `doshuffle`, `typesize` and `compressor` parameters are
+  used for compressing the buffers appended with
+  blosc_schunk_append_buffer(), as in blosc_compress_ctx().  The
+  `numinternalthreads` threads are used for (de-)compressing.
+
+  Returns NULL if the parameters are not valid.
+  */
+BLOSC_EXPORT blosc_schunk* blosc_schunk_new(int clevel, int doshuffle,
+                                            size_t typesize,
+                                            const char* compressor,
+                                            int numinternalthreads);
+
+/**
+  Create a new, empty, super-chunk stored in the file at `path`.  If
+  the file exists, it is overwritten.  The rest of the parameters are
+  as in blosc_schunk_new().
+
+  The index of the chunks is written to the file by blosc_schunk_free().
+  Files that were not freed are still readable, but opening them
+  requires a walk over all the chunks.
+
+  Returns NULL if the parameters are not valid or the file cannot be
+  created.
+  */
+BLOSC_EXPORT blosc_schunk* blosc_schunk_create_file(const char* path,
+                                                    int clevel, int doshuffle,
+                                                    size_t typesize,
+                                                    const char* compressor,
+                                                    int numinternalthreads);
+
+/**
+  Open the super-chunk stored in the file at `path` for reading and
+  appending, using `numinternalthreads` threads.  The compression
+  parameters are the ones the file was created with.
+
+  Returns NULL if the file cannot be opened or is not a super-chunk.
+  */
+BLOSC_EXPORT blosc_schunk* blosc_schunk_open_file(const char* path,
+                                                  int numinternalthreads);
+
+/**
+  Free the resources of a super-chunk.  For super-chunks in a file, the
+  index is written and the file is closed.
+
+  Returns 0 on success or a negative value if the index could not be
+  written.
+  */
+BLOSC_EXPORT int blosc_schunk_free(blosc_schunk* schunk);
+
+/**
+  Compress the `nbytes` of `src` as a new chunk at the end of the
+  super-chunk.  `nbytes` must be a multiple of the typesize of the
+  super-chunk.  Buffers that might not fit in the regular format with
+  their checksums (of about 2 GB) are stored in the extended format.
+
+  Returns the new number of chunks or a negative value on error.
+  */
+BLOSC_EXPORT int64_t blosc_schunk_append_buffer(blosc_schunk* schunk,
+                                                const void* src,
+                                                size_t nbytes);
+
+/**
+  Append a copy of the already compressed `chunk` at the end of the
+  super-chunk.  Its uncompressed size must be a multiple of the typesize
+  of the super-chunk, and its own typesize must divide it.
+
+  Returns the new number of chunks or a negative value on error.
+  */
+BLOSC_EXPORT int64_t blosc_schunk_append_chunk(blosc_schunk* schunk,
+                                               const void* chunk);
+
+/**
+  Get the number of chunks of a super-chunk and its uncompressed and
+  compressed sizes (the latter counts the chunks only).
+
+  This function should always succeed.
+  */
+BLOSC_EXPORT void blosc_schunk_sizes(const blosc_schunk* schunk,
+                                     int64_t* nchunks, int64_t* nbytes,
+                                     int64_t* cbytes);
+
+/**
+  Decompress the chunk number `nchunk` of a super-chunk into `dest`,
+  of `destsize` bytes.
+
+  Returns the number of bytes decompressed or a negative value on error.
+  */
+BLOSC_EXPORT int64_t blosc_schunk_decompress_chunk(blosc_schunk* schunk,
+                                                   int64_t nchunk,
+                                                   void* dest,
+                                                   size_t destsize);
+
+/**
+  Get `nitems` items (of the typesize of the super-chunk) starting at
+  item `start` of the super-chunk into `dest`.  Ranges can span any
+  number of chunks; only the blocks containing the range are read and
+  decompressed, and the chunks are decompressed in parallel.
+
+  Returns the number of bytes copied to `dest` or a negative value on
+  error.
+  */
+BLOSC_EXPORT int64_t blosc_schunk_getitem(blosc_schunk* schunk,
+                                          int64_t start, int64_t nitems,
+                                          void* dest);
+
+
+
+/*********************************************************************
+
+  Memory-mapped files.  These functions read files made of one or more
+  Blosc chunks stored back to back straight from a read-only mapping,
+  so only the pages actually touched are read from disk and there is no
+  intermediate copy of the compressed data.
+
+*********************************************************************/
+
+typedef struct blosc_mmap blosc_mmap;
+
+/**
+  Map the file at `path` for reading its chunks.  `advice` is one of
+  BLOSC_MMAP_NORMAL, BLOSC_MMAP_SEQUENTIAL or BLOSC_MMAP_RANDOM and is
+  passed to the OS as a hint about the access pattern to come.
+
+  The chunk headers are validated lazily, when a chunk (or one after
+  it) is first accessed.  Chunks after an invalid or truncated one are
+  not accessible.
+
+  Returns NULL if the file cannot be mapped.
+  */
+BLOSC_EXPORT blosc_mmap* blosc_mmap_open(const char* path, int advice);
+
+/**
+  Change the access pattern hint of a mapped file.
+
+  Returns 0 on success or a negative value if `advice` is not known.
+  */
+BLOSC_EXPORT int blosc_mmap_advise(blosc_mmap* map, int advice);
+
+/**
+  Unmap a file.  Pointers returned by blosc_mmap_chunk() are not valid
+  anymore.
+  */
+BLOSC_EXPORT void blosc_mmap_close(blosc_mmap* map);
+
+/**
+  Return the number of valid chunks in a mapped file.  This validates
+  all the chunk headers.
+  */
+BLOSC_EXPORT int64_t blosc_mmap_nchunks(blosc_mmap* map);
+
+/**
+  Return a pointer to the chunk number `nchunk` inside the mapping, and
+  its compressed size in `cbytes` (if not NULL), for using with the rest
+  of the API.
+
+  Returns NULL if the chunk does not exist.
+  */
+BLOSC_EXPORT const void* blosc_mmap_chunk(blosc_mmap* map, int64_t nchunk,
+                                          size_t* cbytes);
+
+/**
+  Decompress the chunk number `nchunk` of a mapped file into `dest`, of
+  `destsize` bytes, using `numinternalthreads` threads.  The OS is asked
+  to read in all the pages of the chunk up front.
+
+  Returns the number of bytes decompressed or a negative value on error.
+  */
+BLOSC_EXPORT int64_t blosc_mmap_decompress(blosc_mmap* map, int64_t nchunk,
+                                           void* dest, size_t destsize,
+                                           int numinternalthreads);
+
+/**
+  Get `nitems` items starting at item `start` of the chunk number
+  `nchunk` of a mapped file, as in blosc_getitem().  Only the pages of
+  the blocks containing the items are touched.
+
+  Returns the number of bytes copied to `dest` or a negative value on
+  error.
+  */
+BLOSC_EXPORT int blosc_mmap_getitem(blosc_mmap* map, int64_t nchunk,
+                                    int start, int nitems, void* dest);
+
+
+
+/*********************************************************************
+
+  Streaming functions.  Data is pushed into a stream in pieces of any
+  size, and the resulting chunks (compressed or decompressed) are passed
+  to a sink callback as soon as they are ready, so streams of unbounded
+  length are processed in constant memory.
+
+*********************************************************************/
+
+/**
+  Sink callback for streams.  Receives `size` bytes at `data`, which are
+  only valid during the call, and the `user_data` given when creating
+  the stream.  It must return 0 on success or a negative value for
+  aborting the stream, which is reported by the next stream call.
+  */
+typedef int (*blosc_stream_sink)(const void* data, size_t size,
+                                 void* user_data);
+
+typedef struct blosc_cstream blosc_cstream;
+typedef struct blosc_dstream blosc_dstream;
+
+/**
+  Create a compression stream.  The data written to the stream is
+  gathered into chunks of `chunksize` bytes (rounded up to a multiple of
+  `typesize`; 0 means 4 MB), which are compressed as in
+  blosc_compress_ctx() and passed to `sink`.
+
+  Each full chunk is compressed by a background thread (using
+  `numinternalthreads` more threads) while the next one is being
+  filled, so `sink` is called from that thread, one chunk at a time and
+  in order.
+
+  Returns NULL if the parameters are not valid.
+  */
+BLOSC_EXPORT blosc_cstream* blosc_cstream_new(int clevel, int doshuffle,
+                                              size_t typesize,
+                                              const char* compressor,
+                                              size_t chunksize,
+                                              int numinternalthreads,
+                                              blosc_stream_sink sink,
+                                              void* user_data);
+
+/**
+  Write the `nbytes` of `src` to a compression stream.  This only blocks
+  when a chunk is full and the previous one is still being compressed.
+
+  Returns 0 on success or a negative value if the compression or the
+  sink failed.
+  */
+BLOSC_EXPORT int blosc_cstream_write(blosc_cstream* cs, const void* src,
+                                     size_t nbytes);
+
+/**
+  Compress the data written so far to a compression stream, even if it
+  does not fill a chunk, and wait until all the chunks have been passed
+  to the sink.
+
+  Returns 0 on success or a negative value on error.
+  */
+BLOSC_EXPORT int blosc_cstream_flush(blosc_cstream* cs);
+
+/**
+  Flush and free a compression stream.
+
+  Returns 0 on success or a negative value on error.
+  */
+BLOSC_EXPORT int blosc_cstream_free(blosc_cstream* cs);
+
+/**
+  Create a decompression stream.  The chunks written to the stream, in
+  pieces of any size, are decompressed using `numinternalthreads`
+  threads and passed to `sink` as soon as they are complete.
+
+  Returns NULL if the parameters are not valid.
+  */
+BLOSC_EXPORT blosc_dstream* blosc_dstream_new(int numinternalthreads,
+                                              blosc_stream_sink sink,
+                                              void* user_data);
+
+/**
+  Write the `nbytes` of `src`, a piece of a sequence of chunks, to a
+  decompression stream.  The `sink` is called from this function.
+
+  Returns 0 on success or a negative value if the data is not a valid
+  sequence of chunks or the sink failed.
+  */
+BLOSC_EXPORT int blosc_dstream_write(blosc_dstream* ds, const void* src,
+                                     size_t nbytes);
+
+/**
+  Free a decompression stream.
+
+  Returns 0 on success or a negative value if there was an error or the
+  stream ended in the middle of a chunk.
+  */
+BLOSC_EXPORT int blosc_dstream_free(blosc_dstream* ds);
+
+/**
+  Compress `src` as in blosc_compress_ctx(), but pass the compressed
+  buffer to `sink` instead of writing it to a destination buffer, so
+  that no memory has to be set aside for the worst case (`nbytes` +
+  BLOSC_MAX_OVERHEAD).  The compressed blocks are kept in memory that
+  grows with their actual sizes, in segments of every thread, and are
+  passed to `sink` in order once the whole buffer is compressed.
+
+  The first call to `sink` gets the whole header, so
+  blosc_cbuffer_sizes() can tell from it how many compressed bytes will
+  follow (including the header), for allocating an exact-size buffer.
+  `sink` is called from the calling thread.
+
+  Returns the number of compressed bytes passed to `sink`, 0 if the
+  buffer is too large for the format, or a negative value on error or
+  if `sink` failed.
+  */
+BLOSC_EXPORT int blosc_compress_ctx_sink(int clevel, int doshuffle,
+                                         size_t typesize, size_t nbytes,
+                                         const void* src,
+                                         const char* compressor,
+                                         size_t blocksize,
+                                         int numinternalthreads,
+                                         blosc_stream_sink sink,
+                                         void* user_data);
+
 
 
 /*********************************************************************
@@ -526,6 +1199,166 @@ BLOSC_EXPORT void blosc_set_blocksize(size_t blocksize);
  */
 BLOSC_EXPORT void blosc_set_splitmode(int splitmode);
 
+/**
+  Enable (1) or disable (0) per-block checksums for the next compressions.
+
+  When enabled, a CRC32C of every uncompressed block is stored in the
+  compressed buffer (right after the block starts, or after the data for
+  memcpyed buffers) and the BLOSC_CHECKSUMMED flag is set.  Decompression
+  and blosc_getitem() verify the checksums in the worker threads and
+  fail with a negative value on a mismatch.
+
+  Data that does not compress is stored as is, followed by the
+  checksums, so `dest` has to be BLOSC_MAX_OVERHEAD_CHECKSUMS(`nbytes`)
+  bytes larger than `nbytes` (instead of BLOSC_MAX_OVERHEAD) for
+  compression to always succeed.  Compressing such data into a smaller
+  `dest` fails with a negative value instead of dropping the
+  checksums.
+
+  The CRC32C is computed with the SSE4.2 instruction when the CPU has it.
+
+  If not called, checksums are disabled.
+ */
+BLOSC_EXPORT void blosc_set_checksum(int checksum);
+
+/**
+  Enable (1) or disable (0) huge pages for the large buffers that Blosc
+  allocates from now on, like the scratch buffers of the threads (about
+  3 times the blocksize each).  Buffers of 2 MB or more are then
+  allocated 2 MB-aligned, rounded up to whole 2 MB pages, and marked with
+  madvise(MADV_HUGEPAGE), which saves TLB misses when filtering and
+  (de)compressing large blocks.
+
+  This is a hint: where transparent huge pages are not available (or
+  not on Linux), or the aligned allocation fails, the buffers are
+  allocated as usual.  Measure before enabling it (see
+  bench/hugepage_bench.c): with blocks of a large power of two the
+  strided accesses of bitshuffle can conflict in the caches once the
+  pages are physically contiguous, which may cost more than the TLB
+  misses saved.  Buffers already allocated are not affected, so
+  call blosc_free_resources() to get new ones.
+
+  If not called, huge pages are disabled.
+ */
+BLOSC_EXPORT void blosc_set_hugepages(int hugepages);
+
+/**
+  Allocate `size` bytes the way Blosc allocates its own buffers: aligned
+  to 32 bytes, with the allocator in blosc_set_allocator() and, for large
+  sizes, backed by huge pages if blosc_set_hugepages() enabled them.
+  This is meant for large source and destination buffers, which are
+  as TLB-heavy as the internal ones.
+
+  Returns NULL if the memory cannot be allocated.  The memory must be
+  released with blosc_free().
+ */
+BLOSC_EXPORT void* blosc_malloc(size_t size);
+
+/**
+  Release memory allocated by blosc_malloc().
+ */
+BLOSC_EXPORT void blosc_free(void* ptr);
+
+/**
+  Pin the threads of the pools to CPUs.  With BLOSC_AFFINITY_COMPACT the
+  threads go to the CPUs of one NUMA node (or package) before moving to
+  the next one, and with BLOSC_AFFINITY_SCATTER they go round robin over
+  the nodes, on separate physical cores first.  Only the CPUs the process
+  is allowed to run on are used.  If `cores` is not NULL, its `ncores`
+  CPUs are used instead, in that order, whatever the `policy`.  Thread
+  `i` of a pool is pinned to the `i % n`th of the `n` CPUs.
+
+  Every thread allocates its scratch memory after being pinned, so with
+  the first-touch policy of the OS it lands on the node of the thread.
+  The blocks of a decompression are split in contiguous runs, one per
+  thread, so each thread also writes its part of the destination from
+  its own node.
+
+  The global pool is restarted so that it uses the new placement; pools
+  of the *_ctx() functions use it on their next call.  This function is
+  not thread-safe: do not call it while other threads use Blosc.
+
+  Returns 0 on success, or a negative value if the policy or the CPUs
+  are not valid, or pinning threads is not supported on this platform
+  (only Linux is, for now), in which case the placement is not changed.
+
+  If not called, the threads are not pinned (BLOSC_AFFINITY_NONE).
+ */
+BLOSC_EXPORT int blosc_set_affinity(int policy, const int* cores, int ncores);
+
+/**
+  Time spent in every phase of the (de)compression and events counted
+  since the last blosc_reset_stats(), summed over all the threads and
+  calls (with or without a context).  Times are in ticks of the
+  timestamp counter: CPU cycles on x86, nanoseconds elsewhere.
+ */
+typedef struct blosc_stats {
+  uint64_t filter_cycles;          /* (un)shuffling and (un)bitshuffling */
+  uint64_t codec_cycles;           /* running the codecs */
+  uint64_t copy_cycles;            /* copying data stored as is */
+  uint64_t wait_cycles;            /* threads waiting for the others */
+  uint64_t incompressible_splits;  /* splits stored as is when compressing */
+  uint64_t memcpy_fallbacks;       /* buffers stored as is, uncompressed */
+  uint64_t recompressions;         /* second passes copying a buffer that did
+                                      not compress */
+} blosc_stats;
+
+/**
+  Fill `stats` with the totals since the last blosc_reset_stats().
+
+  The timings are only collected when Blosc is built with the
+  ENABLE_STATS CMake option (which defines BLOSC_ENABLE_STATS), and
+  cost nothing otherwise.  Returns 0 on success and -1, with `stats`
+  zeroed, if Blosc was built without them.
+ */
+BLOSC_EXPORT int blosc_get_stats(blosc_stats* stats);
+
+/**
+  Reset the totals returned by blosc_get_stats().
+ */
+BLOSC_EXPORT void blosc_reset_stats(void);
+
+/* Events passed to the trace callback */
+#define BLOSC_TRACE_CHUNK_START    0  /* a buffer starts (de)compressing */
+#define BLOSC_TRACE_CHUNK_END      1  /* a buffer is done */
+#define BLOSC_TRACE_BLOCK_START    2  /* a block starts (de)compressing */
+#define BLOSC_TRACE_BLOCK_END      3  /* a block is done */
+#define BLOSC_TRACE_THREAD_WAKEUP  4  /* a pool thread starts working */
+
+/**
+  An event passed to the trace callback.  Fields that do not apply to
+  the event are -1 (nblock, codec) or 0 (nbytes, result).
+ */
+typedef struct blosc_trace_event {
+  int type;          /* one of BLOSC_TRACE_* */
+  int compress;      /* 1 when compressing, 0 when decompressing */
+  int tid;           /* pool thread, or -1 for the calling thread */
+  int32_t nblock;    /* index of the block */
+  int codec;         /* BLOSC_*_FORMAT of the block, -1 if stored as is */
+  int64_t nbytes;    /* uncompressed size of the buffer or block */
+  int64_t result;    /* bytes produced (0 for an incompressible block
+                        when compressing) or a negative error code */
+} blosc_trace_event;
+
+typedef void (*blosc_trace_callback)(const blosc_trace_event* event,
+                                     void* user_data);
+
+/**
+  Call `callback` with `user_data` at the start and end of every buffer
+  and block (de)compressed, and whenever a pool thread wakes up to
+  work, so that latency outliers can be attributed to specific blocks
+  and threads.  Pass NULL to remove it.
+
+  The callback runs in the pool threads concurrently, so it must be
+  thread-safe and cheap.  Set it while no (de)compression is running.
+
+  The same events are available as static probes (`blosc:chunk__start`,
+  `blosc:block__end`...) when Blosc is built where sys/sdt.h exists;
+  otherwise the probes are compiled out.
+ */
+BLOSC_EXPORT void blosc_set_trace_callback(blosc_trace_callback callback,
+                                           void* user_data);
+
 
 #ifdef __cplusplus
 }
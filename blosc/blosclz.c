@@ -19,6 +19,28 @@
 #include "blosclz.h"
 #include "fastcopy.h"
 #include "blosc-common.h"
+#include "shuffle.h"
+
+#if defined(_WIN32)
+#include "win32/pthread.h"
+#else
+#include <pthread.h>
+#endif
+
+/*
+ * This file is compiled a second time with AVX2 enabled from
+ * blosclz-avx2.c.  Each build names its entry points after the target it
+ * has been compiled for (and uses the matching copy_match() variant), and
+ * the baseline one also provides the blosclz_compress() and
+ * blosclz_decompress() dispatchers at the end.
+ */
+#if defined(BLOSCLZ_AVX2_VARIANT)
+#define BLOSCLZ_VARIANT(name) name##_avx2
+#define copy_match copy_match_avx2
+#else
+#define BLOSCLZ_VARIANT(name) name##_generic
+#define copy_match copy_match_generic
+#endif
 
 
 /*
@@ -54,6 +76,17 @@
 #define HASH_LOG (14U)
 #define HASH_LOG2 (12U)
 
+/* The hash chains of the high compression mode link the positions in a
+   window of 1 << CHAIN_LOG bytes (the heads can still be further away).
+   CHAIN_DEPTH_<clevel> is the number of candidates tried per position. */
+#define CHAIN_LOG (15U)
+#define CHAIN_DEPTH_8 (4)
+#define CHAIN_DEPTH_9 (16)
+
+#if (1U << HASH_LOG) * 4 + (1U << CHAIN_LOG) * 2 > BLOSCLZ_WORKSPACE_SIZE
+#error "BLOSCLZ_WORKSPACE_SIZE cannot hold the tables of compress_hc()"
+#endif
+
 // This is used in LZ4 and seems to work pretty well here too
 #define HASH_FUNCTION(v, s, h) {      \
   (v) = ((s) * 2654435761U) >> (32U - (h)); \
@@ -87,7 +120,7 @@ static uint8_t *get_run_32(uint8_t *ip, const uint8_t *ip_bound, const uint8_t *
 #endif
 
 #if defined(__SSE2__)
-uint8_t *get_run_16(uint8_t *ip, const uint8_t *ip_bound, const uint8_t *ref) {
+static uint8_t *get_run_16(uint8_t *ip, const uint8_t *ip_bound, const uint8_t *ref) {
   uint8_t x = ip[-1];
 
   while (ip < (ip_bound - sizeof(__m128i))) {
@@ -143,7 +176,7 @@ static uint8_t *get_run(uint8_t *ip, const uint8_t *ip_bound, const uint8_t *ref
 
 
 /* Return the byte that starts to differ */
-uint8_t *get_match(uint8_t *ip, const uint8_t *ip_bound, const uint8_t *ref) {
+static uint8_t *get_match(uint8_t *ip, const uint8_t *ip_bound, const uint8_t *ref) {
 #if !defined(BLOSC_STRICT_ALIGN)
   while (ip < (ip_bound - sizeof(int64_t))) {
     if (*(int64_t*)ref != *(int64_t*)ip) {
@@ -418,8 +451,199 @@ static double get_cratio(uint8_t* ibase, int maxlen, int minlen, int ipshift) {
 }
 
 
-int blosclz_compress(const int clevel, const void* input, int length,
-                     void* output, int maxout, const int split_block) {
+/* Insert the position `ip` in the hash chains */
+#define CHAIN_INSERT(ip) {                                            \
+  uint32_t pos_ = (uint32_t)((ip) - ibase);                           \
+  uint32_t hval_;                                                     \
+  seq = BLOSCLZ_READU32(ip);                                          \
+  HASH_FUNCTION(hval_, seq, HASH_LOG)                                 \
+  delta = pos_ - htab[hval_];                                         \
+  chain[pos_ & chain_mask] = (uint16_t)((delta <= 0xFFFFU) ? delta : 0); \
+  htab[hval_] = pos_;                                                 \
+}
+
+/* Find the longest match for the position `ip` (which must have been
+   inserted already) among `depth` candidates in the hash chains.  Returns
+   the (biased) length as encoded by blosclz_compress() or 0 if none is
+   worth encoding, and sets `*distance_` to the (biased) distance. */
+static unsigned find_longest_match(uint8_t* ibase, uint8_t* ip, uint8_t* ip_bound,
+                                   const uint16_t* chain, int depth,
+                                   unsigned ipshift, unsigned minlen,
+                                   unsigned* distance_) {
+  const uint32_t chain_mask = (1U << CHAIN_LOG) - 1;
+  uint32_t pos = (uint32_t)(ip - ibase);
+  uint32_t cand = pos;
+  uint32_t seq = BLOSCLZ_READU32(ip);
+  unsigned best_len = 0;
+  unsigned distance, len;
+  uint16_t delta;
+  uint8_t* end;
+
+  while (depth-- > 0) {
+    if (pos - cand > chain_mask) {
+      /* The chain slot of `cand` may have been reused already */
+      break;
+    }
+    delta = chain[cand & chain_mask];
+    if (delta == 0) {
+      break;
+    }
+    cand -= delta;
+    distance = pos - cand;
+    if (distance >= MAX_FARDISTANCE) {
+      break;
+    }
+    if (BLOSCLZ_READU32(ibase + cand) != seq) {
+      continue;
+    }
+    /* distance is biased; zero distance means a run */
+    end = get_run_or_match(ip + 4, ip_bound, ibase + cand + 4, distance == 1);
+    len = (unsigned)(end - ipshift - ip);
+    /* Encoding short lengths is expensive during decompression */
+    if (len < minlen || (len <= 5 && distance - 1 >= MAX_DISTANCE)) {
+      continue;
+    }
+    /* Nearer matches are cheaper to encode, so only take longer ones */
+    if (len > best_len) {
+      best_len = len;
+      *distance_ = distance - 1;
+      if (end > ip_bound) {
+        /* cannot do any better */
+        break;
+      }
+    }
+  }
+  return best_len;
+}
+
+
+/* High compression mode of blosclz_compress(): search the matches in hash
+   chains and encode them lazily (i.e. emit a literal instead when the next
+   position has a longer match).  The output is a regular BloscLZ stream.
+   The tables are kept in `workspace` (see BLOSCLZ_WORKSPACE_SIZE). */
+static int compress_hc(const int clevel, uint8_t* ibase, int length,
+                       uint8_t* output, int maxout, unsigned ipshift,
+                       unsigned minlen, void* workspace) {
+  const uint32_t chain_mask = (1U << CHAIN_LOG) - 1;
+  const int depth = (clevel == 9) ? CHAIN_DEPTH_9 : CHAIN_DEPTH_8;
+  uint8_t* ip = ibase;
+  uint8_t* ip_bound = ibase + length - 1;
+  uint8_t* ip_limit = ibase + length - 12;
+  uint8_t* op = output;
+  const uint8_t* op_limit = op + maxout;
+  uint8_t* inserted = ibase;   /* positions before this are in the chains */
+  uint32_t seq, delta;
+  uint8_t copy;
+  unsigned len, distance, next_len, next_distance;
+
+  /* The chains only link positions inserted already, so only the heads
+     need to be cleared */
+  uint32_t* htab = (uint32_t*)workspace;
+  uint16_t* chain = (uint16_t*)(htab + (1U << (uint8_t)HASH_LOG));
+  memset(htab, 0, (1U << (uint8_t)HASH_LOG) * sizeof(uint32_t));
+
+  /* we start with literal copy */
+  copy = 4;
+  *op++ = MAX_COPY - 1;
+  *op++ = *ip++;
+  *op++ = *ip++;
+  *op++ = *ip++;
+  *op++ = *ip++;
+
+  /* main loop */
+  while (BLOSCLZ_LIKELY(ip < ip_limit)) {
+    uint8_t* anchor = ip;
+
+    while (inserted <= ip) {
+      CHAIN_INSERT(inserted)
+      inserted++;
+    }
+    len = find_longest_match(ibase, ip, ip_bound, chain, depth,
+                             ipshift, minlen, &distance);
+    if (len == 0) {
+      LITERAL(ip, op, op_limit, anchor, copy)
+      continue;
+    }
+
+    /* Lazy matching: prefer a literal if the next position does better */
+    if (ip + 1 < ip_limit) {
+      CHAIN_INSERT(inserted)
+      inserted++;
+      next_len = find_longest_match(ibase, ip + 1, ip_bound, chain, depth,
+                                    ipshift, minlen, &next_distance);
+      if (next_len > len) {
+        LITERAL(ip, op, op_limit, anchor, copy)
+        continue;
+      }
+    }
+
+    /* if we have copied something, adjust the copy count */
+    if (copy)
+      /* copy is biased, '0' means 1 byte copy */
+      *(op - copy - 1) = (uint8_t)(copy - 1);
+    else
+      /* back, to overwrite the copy count */
+      op--;
+    /* reset literal counter */
+    copy = 0;
+
+    /* the match covers the biased length plus 2 bytes */
+    ip = anchor + len + 2;
+
+    /* encode the match */
+    if (distance < MAX_DISTANCE) {
+      if (len < 7) {
+        MATCH_SHORT(op, op_limit, len, distance)
+      } else {
+        MATCH_LONG(op, op_limit, len, distance)
+      }
+    } else {
+      /* far away, but not yet in the another galaxy... */
+      distance -= MAX_DISTANCE;
+      if (len < 7) {
+        MATCH_SHORT_FAR(op, op_limit, len, distance)
+      } else {
+        MATCH_LONG_FAR(op, op_limit, len, distance)
+      }
+    }
+
+    if (BLOSCLZ_UNLIKELY(op + 1 > op_limit))
+      goto out;
+
+    /* assuming literal copy */
+    *op++ = MAX_COPY - 1;
+  }
+
+  /* left-over as literal copy */
+  while (BLOSCLZ_UNLIKELY(ip <= ip_bound)) {
+    if (BLOSCLZ_UNLIKELY(op + 2 > op_limit)) goto out;
+    *op++ = *ip++;
+    copy++;
+    if (BLOSCLZ_UNLIKELY(copy == MAX_COPY)) {
+      copy = 0;
+      *op++ = MAX_COPY - 1;
+    }
+  }
+
+  /* if we have copied something, adjust the copy length */
+  if (copy)
+    *(op - copy - 1) = (uint8_t)(copy - 1);
+  else
+    op--;
+
+  /* marker for blosclz */
+  *output |= (1U << 5U);
+
+  return (int)(op - output);
+
+  out:
+  return 0;
+}
+
+
+int BLOSCLZ_VARIANT(blosclz_compress)(const int clevel, const void* input, int length,
+                     void* output, int maxout, const int split_block,
+                     void* workspace) {
   uint8_t* ibase = (uint8_t*)input;
 
   // Experiments say that checking 1/4 of the buffer is enough to figure out approx cratio
@@ -474,6 +698,11 @@ int blosclz_compress(const int clevel, const void* input, int length,
     return 0;
   }
 
+  if (clevel >= BLOSCLZ_HC_LEVEL && workspace != NULL) {
+    return compress_hc(clevel, ibase, length, (uint8_t*)output, maxout,
+                       ipshift, minlen, workspace);
+  }
+
   // Initialize the hash table
   uint32_t htab[1U << (uint8_t)HASH_LOG];
   memset(htab, 0, (1U << hashlog) * sizeof(uint32_t));
@@ -568,16 +797,7 @@ int blosclz_compress(const int clevel, const void* input, int length,
     seq = BLOSCLZ_READU32(ip);
     HASH_FUNCTION(hval, seq, hashlog)
     htab[hval] = (uint32_t) (ip++ - ibase);
-    if (clevel == 9) {
-      // In some situations, including a second hash proves to be useful,
-      // but not in others.  Activating here in max clevel only.
-      seq >>= 8U;
-      HASH_FUNCTION(hval, seq, hashlog)
-      htab[hval] = (uint32_t) (ip++ - ibase);
-    }
-    else {
-      ip++;
-    }
+    ip++;
 
     if (BLOSCLZ_UNLIKELY(op + 1 > op_limit))
       goto out;
@@ -676,7 +896,7 @@ static inline void wild_copy(uint8_t *out, const uint8_t* from, uint8_t* end) {
   do { memcpy(d,s,8); d+=8; s+=8; } while (d<e);
 }
 
-int blosclz_decompress(const void* input, int length, void* output, int maxout) {
+int BLOSCLZ_VARIANT(blosclz_decompress)(const void* input, int length, void* output, int maxout) {
   const uint8_t* ip = (const uint8_t*)input;
   const uint8_t* ip_limit = ip + length;
   uint8_t* op = (uint8_t*)output;
@@ -787,3 +1007,44 @@ int blosclz_decompress(const void* input, int length, void* output, int maxout)
 
   return (int)(op - (uint8_t*)output);
 }
+
+
+#if !defined(BLOSCLZ_AVX2_VARIANT)
+
+typedef int (*blosclz_compress_func)(const int, const void*, int, void*, int,
+                                     int, void*);
+typedef int (*blosclz_decompress_func)(const void*, int, void*, int);
+
+/*  The codec variants selected for the host processor.
+    These are only safe to use once `blosclz_initialized` is set. */
+static blosclz_compress_func host_compress;
+static blosclz_decompress_func host_decompress;
+
+/*  Flag indicating whether the variants have been selected. */
+static pthread_once_t blosclz_initialized = PTHREAD_ONCE_INIT;
+
+static void set_host_blosclz(void) {
+  host_compress = blosclz_compress_generic;
+  host_decompress = blosclz_decompress_generic;
+#if defined(BLOSCLZ_AVX2_ENABLED)
+  if (blosc_internal_cpu_features() & BLOSC_HAVE_AVX2) {
+    host_compress = blosclz_compress_avx2;
+    host_decompress = blosclz_decompress_avx2;
+  }
+#endif  /* BLOSCLZ_AVX2_ENABLED */
+}
+
+int blosclz_compress(const int clevel, const void* input, int length,
+                     void* output, int maxout, const int split_block,
+                     void* workspace) {
+  pthread_once(&blosclz_initialized, &set_host_blosclz);
+  return host_compress(clevel, input, length, output, maxout, split_block,
+                       workspace);
+}
+
+int blosclz_decompress(const void* input, int length, void* output, int maxout) {
+  pthread_once(&blosclz_initialized, &set_host_blosclz);
+  return host_decompress(input, length, output, maxout);
+}
+
+#endif  /* !BLOSCLZ_AVX2_VARIANT */
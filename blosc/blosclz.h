@@ -24,6 +24,12 @@ extern "C" {
 
 #define BLOSCLZ_VERSION_STRING "2.5.1"
 
+/* The first opt_level of the high compression mode */
+#define BLOSCLZ_HC_LEVEL 8
+/* The scratch memory that the high compression mode needs for its hash
+   table and hash chains */
+#define BLOSCLZ_WORKSPACE_SIZE ((1 << 14) * 4 + (1 << 15) * 2)
+
 
 /**
   Compress a block of data in the input buffer and returns the size of
@@ -43,10 +49,15 @@ extern "C" {
   and will be silently set to 1.
 
   The input buffer and the output buffer can not overlap.
+
+  From BLOSCLZ_HC_LEVEL on, `workspace` must point to
+  BLOSCLZ_WORKSPACE_SIZE bytes of scratch memory aligned to 4 bytes (it
+  is not used otherwise).  If it is NULL, the regular mode is used.
 */
 
 int blosclz_compress(int opt_level, const void* input, int length,
-                     void* output, int maxout, int split_block);
+                     void* output, int maxout, int split_block,
+                     void* workspace);
 
 /**
   Decompress a block of compressed data and returns the size of the
@@ -62,6 +73,21 @@ int blosclz_compress(int opt_level, const void* input, int length,
 
 int blosclz_decompress(const void* input, int length, void* output, int maxout);
 
+/*
+  The variants of the routines above compiled for the baseline target and
+  with AVX2 enabled.  blosclz_compress() and blosclz_decompress() select
+  the best one for the host processor the first time they are called.
+*/
+
+int blosclz_compress_generic(int opt_level, const void* input, int length,
+                             void* output, int maxout, int split_block,
+                             void* workspace);
+int blosclz_compress_avx2(int opt_level, const void* input, int length,
+                          void* output, int maxout, int split_block,
+                          void* workspace);
+int blosclz_decompress_generic(const void* input, int length, void* output, int maxout);
+int blosclz_decompress_avx2(const void* input, int length, void* output, int maxout);
+
 #if defined (__cplusplus)
 }
 #endif
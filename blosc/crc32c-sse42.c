@@ -0,0 +1,54 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "crc32c.h"
+
+/* Define dummy functions if SSE4.2 is not available for the compilation target and compiler. */
+#if !defined(__SSE4_2__)
+
+uint32_t
+blosc_internal_crc32c_sse42(const uint8_t* buf, size_t len) {
+  abort();
+}
+
+#else /* defined(__SSE4_2__) */
+
+#include <string.h>
+#include <nmmintrin.h>
+
+uint32_t
+blosc_internal_crc32c_sse42(const uint8_t* buf, size_t len) {
+#if defined(__x86_64__) || defined(_M_X64)
+  uint64_t crc = 0xffffffff;
+  uint64_t word;
+
+  /* Consume 8 bytes per instruction */
+  while (len >= 8) {
+    memcpy(&word, buf, 8);
+    crc = _mm_crc32_u64(crc, word);
+    buf += 8;
+    len -= 8;
+  }
+#else
+  uint32_t crc = 0xffffffff;
+  uint32_t word;
+
+  while (len >= 4) {
+    memcpy(&word, buf, 4);
+    crc = _mm_crc32_u32(crc, word);
+    buf += 4;
+    len -= 4;
+  }
+#endif
+  while (len > 0) {
+    crc = _mm_crc32_u8((uint32_t)crc, *buf);
+    buf++;
+    len--;
+  }
+  return (uint32_t)crc ^ 0xffffffff;
+}
+
+#endif /* !defined(__SSE4_2__) */
@@ -0,0 +1,91 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "crc32c.h"
+#include "shuffle.h"
+
+#if defined(_WIN32)
+#include "win32/pthread.h"
+#else
+#include <pthread.h>
+#endif
+
+
+/* The CRC32C polynomial, reversed */
+#define CRC32C_POLY 0x82f63b78
+
+/* Tables for the slice-by-8 routine */
+static uint32_t crc32c_table[8][256];
+
+typedef uint32_t(*crc32c_func)(const uint8_t*, size_t);
+
+/*  The dynamically-chosen CRC32C implementation.
+    This is only safe to use once `crc32c_initialized` is set. */
+static crc32c_func host_crc32c;
+
+/*  Flag indicating whether the implementation has been initialized. */
+static pthread_once_t crc32c_initialized = PTHREAD_ONCE_INIT;
+
+static void init_crc32c(void) {
+  uint32_t crc;
+  int n, k;
+
+  for (n = 0; n < 256; n++) {
+    crc = (uint32_t)n;
+    for (k = 0; k < 8; k++) {
+      crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+    }
+    crc32c_table[0][n] = crc;
+  }
+  for (n = 0; n < 256; n++) {
+    crc = crc32c_table[0][n];
+    for (k = 1; k < 8; k++) {
+      crc = crc32c_table[0][crc & 0xff] ^ (crc >> 8);
+      crc32c_table[k][n] = crc;
+    }
+  }
+
+  host_crc32c = blosc_internal_crc32c_generic;
+#if defined(CRC32C_SSE42_ENABLED)
+  if (blosc_internal_cpu_features() & BLOSC_HAVE_SSE42) {
+    host_crc32c = blosc_internal_crc32c_sse42;
+  }
+#endif  /* defined(CRC32C_SSE42_ENABLED) */
+}
+
+uint32_t
+blosc_internal_crc32c_generic(const uint8_t* buf, size_t len) {
+  uint32_t crc = 0xffffffff;
+  uint32_t lo, hi;
+
+  pthread_once(&crc32c_initialized, &init_crc32c);
+
+  /* Process 8 bytes at a time (byte loads keep this endian-neutral) */
+  while (len >= 8) {
+    lo = crc ^ ((uint32_t)buf[0] | ((uint32_t)buf[1] << 8) |
+                ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24));
+    hi = (uint32_t)buf[4] | ((uint32_t)buf[5] << 8) |
+         ((uint32_t)buf[6] << 16) | ((uint32_t)buf[7] << 24);
+    crc = crc32c_table[7][lo & 0xff] ^ crc32c_table[6][(lo >> 8) & 0xff] ^
+          crc32c_table[5][(lo >> 16) & 0xff] ^ crc32c_table[4][lo >> 24] ^
+          crc32c_table[3][hi & 0xff] ^ crc32c_table[2][(hi >> 8) & 0xff] ^
+          crc32c_table[1][(hi >> 16) & 0xff] ^ crc32c_table[0][hi >> 24];
+    buf += 8;
+    len -= 8;
+  }
+  while (len > 0) {
+    crc = crc32c_table[0][(crc ^ *buf) & 0xff] ^ (crc >> 8);
+    buf++;
+    len--;
+  }
+  return crc ^ 0xffffffff;
+}
+
+uint32_t
+blosc_internal_crc32c(const uint8_t* buf, size_t len) {
+  pthread_once(&crc32c_initialized, &init_crc32c);
+  return host_crc32c(buf, len);
+}
@@ -0,0 +1,40 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* CRC32C (Castagnoli) checksums for the blocks of a compressed buffer. */
+
+#ifndef BLOSC_CRC32C_H
+#define BLOSC_CRC32C_H
+
+#include "blosc-common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+  Return the CRC32C of the `len` bytes at `buf`.  This function
+  dynamically dispatches to the SSE4.2 `crc32` instruction when the host
+  processor supports it, and uses a portable slice-by-8 routine
+  otherwise.
+*/
+BLOSC_NO_EXPORT uint32_t blosc_internal_crc32c(const uint8_t* buf, size_t len);
+
+/**
+  Portable slice-by-8 CRC32C routine.
+*/
+BLOSC_NO_EXPORT uint32_t blosc_internal_crc32c_generic(const uint8_t* buf, size_t len);
+
+/**
+  SSE4.2-accelerated CRC32C routine.
+*/
+BLOSC_NO_EXPORT uint32_t blosc_internal_crc32c_sse42(const uint8_t* buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BLOSC_CRC32C_H */
@@ -0,0 +1,10 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* The fastcopy routines compiled with AVX2 enabled, for run-time dispatch. */
+
+#define FASTCOPY_AVX2_VARIANT
+#include "fastcopy.c"
@@ -20,6 +20,26 @@
 
 #include <assert.h>
 #include "blosc-common.h"
+#include "fastcopy.h"
+#include "shuffle.h"
+
+#if defined(_WIN32)
+#include "win32/pthread.h"
+#else
+#include <pthread.h>
+#endif
+
+/*
+ * This file is compiled a second time with AVX2 enabled from
+ * fastcopy-avx2.c.  Each build names its entry points after the target
+ * it has been compiled for, and the baseline one also provides the
+ * fastcopy() dispatcher at the end.
+ */
+#if defined(FASTCOPY_AVX2_VARIANT)
+#define FASTCOPY_VARIANT(name) name##_avx2
+#else
+#define FASTCOPY_VARIANT(name) name##_generic
+#endif
 
 /*
  * Use inlined functions for supported systems.
@@ -494,7 +514,7 @@ static inline unsigned char *chunk_memcpy_unaligned(unsigned char *out, const un
 
 
 /* Byte by byte semantics: copy LEN bytes from FROM and write them to OUT. Return OUT + LEN. */
-unsigned char *fastcopy(unsigned char *out, const unsigned char *from, unsigned len) {
+unsigned char *FASTCOPY_VARIANT(fastcopy)(unsigned char *out, const unsigned char *from, unsigned len) {
   switch (len) {
     case 32:
       return copy_32_bytes(out, from);
@@ -527,7 +547,7 @@ unsigned char *fastcopy(unsigned char *out, const unsigned char *from, unsigned
 
 
 /* Copy a run */
-unsigned char* copy_match(unsigned char *out, const unsigned char *from, unsigned len) {
+unsigned char* FASTCOPY_VARIANT(copy_match)(unsigned char *out, const unsigned char *from, unsigned len) {
 #if defined(__AVX2__)
   unsigned sz = sizeof(__m256i);
 #elif defined(__SSE2__)
@@ -547,7 +567,7 @@ unsigned char* copy_match(unsigned char *out, const unsigned char *from, unsigne
   // If out and from are away more than the size of the copy, then a fastcopy is safe
   unsigned overlap_dist = (unsigned) (out - from);
   if (overlap_dist > sz) {
-    return fastcopy(out, from, len);
+    return FASTCOPY_VARIANT(fastcopy)(out, from, len);
   }
 
   // Otherwise we need to be more careful so as not to overwrite destination
@@ -637,3 +657,66 @@ unsigned char* copy_match(unsigned char *out, const unsigned char *from, unsigne
 
   return out;
 }
+
+
+#if !defined(FASTCOPY_AVX2_VARIANT)
+
+typedef unsigned char* (*fastcopy_func)(unsigned char*, const unsigned char*, unsigned);
+
+/*  The fastcopy variant selected for the host processor.
+    This is only safe to use once `fastcopy_initialized` is set. */
+static fastcopy_func host_fastcopy;
+
+/*  Flag indicating whether the variant has been selected. */
+static pthread_once_t fastcopy_initialized = PTHREAD_ONCE_INIT;
+
+static void set_host_fastcopy(void) {
+  host_fastcopy = fastcopy_generic;
+#if defined(FASTCOPY_AVX2_ENABLED)
+  if (blosc_internal_cpu_features() & BLOSC_HAVE_AVX2) {
+    host_fastcopy = fastcopy_avx2;
+  }
+#endif  /* FASTCOPY_AVX2_ENABLED */
+}
+
+unsigned char *fastcopy(unsigned char *out, const unsigned char *from, unsigned len) {
+  pthread_once(&fastcopy_initialized, &set_host_fastcopy);
+  return host_fastcopy(out, from, len);
+}
+
+/* Copy with non-temporal stores.  These bypass the caches and skip the
+   read-for-ownership of the destination lines, at the price of having to
+   write whole aligned vectors, so the unaligned head and the tail are
+   copied with fastcopy(). */
+unsigned char *fastcopy_stream(unsigned char *out, const unsigned char *from, unsigned len) {
+#if defined(__SSE2__)
+  unsigned head = (unsigned)((sizeof(__m128i) - ((uintptr_t)out % sizeof(__m128i))) % sizeof(__m128i));
+  __m128i a, b, c, d;
+
+  if (len < 4 * sizeof(__m128i) + head) {
+    return fastcopy(out, from, len);
+  }
+  out = fastcopy(out, from, head);
+  from += head;
+  len -= head;
+  for (; len >= 4 * sizeof(__m128i); len -= 4 * sizeof(__m128i)) {
+    a = _mm_loadu_si128((const __m128i *)from);
+    b = _mm_loadu_si128((const __m128i *)from + 1);
+    c = _mm_loadu_si128((const __m128i *)from + 2);
+    d = _mm_loadu_si128((const __m128i *)from + 3);
+    _mm_stream_si128((__m128i *)out, a);
+    _mm_stream_si128((__m128i *)out + 1, b);
+    _mm_stream_si128((__m128i *)out + 2, c);
+    _mm_stream_si128((__m128i *)out + 3, d);
+    from += 4 * sizeof(__m128i);
+    out += 4 * sizeof(__m128i);
+  }
+  /* Make the streamed data visible to other threads before returning */
+  _mm_sfence();
+  return fastcopy(out, from, len);
+#else
+  return fastcopy(out, from, len);
+#endif  /* __SSE2__ */
+}
+
+#endif  /* !FASTCOPY_AVX2_VARIANT */
@@ -10,10 +10,24 @@
 #ifndef BLOSC_FASTCOPY_H
 #define BLOSC_FASTCOPY_H
 
-/* Same semantics than memcpy() */
-unsigned char *fastcopy(unsigned char *out, const unsigned char *from, unsigned len);
+#include "blosc-export.h"
 
-/* Same as fastcopy() but without overwriting origin or destination when they overlap */
-unsigned char* copy_match(unsigned char *out, const unsigned char *from, unsigned len);
+/* Same semantics than memcpy().  Dispatches to the best variant below
+   for the host processor. */
+BLOSC_NO_EXPORT unsigned char *fastcopy(unsigned char *out, const unsigned char *from, unsigned len);
+
+/* The variants compiled for the baseline target and with AVX2 enabled */
+BLOSC_NO_EXPORT unsigned char *fastcopy_generic(unsigned char *out, const unsigned char *from, unsigned len);
+BLOSC_NO_EXPORT unsigned char *fastcopy_avx2(unsigned char *out, const unsigned char *from, unsigned len);
+
+/* Same semantics than memcpy(), but writing OUT with non-temporal stores
+   where available, so that it does not evict the working set from the
+   caches.  Meant for destinations larger than the last level cache. */
+BLOSC_NO_EXPORT unsigned char *fastcopy_stream(unsigned char *out, const unsigned char *from, unsigned len);
+
+/* Same as fastcopy() but without overwriting origin or destination when they overlap.
+   There is no dispatcher for these: callers are multi-versioned themselves. */
+BLOSC_NO_EXPORT unsigned char* copy_match_generic(unsigned char *out, const unsigned char *from, unsigned len);
+BLOSC_NO_EXPORT unsigned char* copy_match_avx2(unsigned char *out, const unsigned char *from, unsigned len);
 
 #endif //BLOSC_FASTCOPY_H
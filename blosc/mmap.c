@@ -0,0 +1,318 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Memory-mapped reading of files made of Blosc chunks.
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "blosc.h"
+#include "blosc-common.h"
+
+#if defined(_WIN32)
+  #include <windows.h>
+  #include "win32/pthread.h"
+#else
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <pthread.h>
+#endif
+
+
+/* Minimum number of entries of the chunk offsets */
+#define MMAP_MIN_OFFSETS 16
+
+
+struct blosc_mmap {
+  const uint8_t* base;            /* Start of the mapping */
+  int64_t size;                   /* Size of the file */
+  int64_t nchunks;                /* Number of chunks validated so far */
+  int64_t allocated;              /* Number of offsets allocated */
+  int64_t* offsets;               /* Offsets of the validated chunks (nchunks + 1) */
+  int complete;                   /* Whether all the chunks have been validated */
+  pthread_mutex_t mutex;          /* Protects the lazy validation */
+#if defined(_WIN32)
+  HANDLE file;
+  HANDLE mapping;
+#endif
+};
+
+
+/* Apply an access pattern hint to the whole mapping */
+static int advise(blosc_mmap* map, int advice)
+{
+#if defined(_WIN32)
+  /* Windows has no equivalent of madvise() for file views */
+  (void)map;
+  return (advice >= BLOSC_MMAP_NORMAL && advice <= BLOSC_MMAP_RANDOM) ? 0 : -1;
+#else
+  int madv;
+
+  switch (advice) {
+    case BLOSC_MMAP_NORMAL:
+      madv = MADV_NORMAL;
+      break;
+    case BLOSC_MMAP_SEQUENTIAL:
+      madv = MADV_SEQUENTIAL;
+      break;
+    case BLOSC_MMAP_RANDOM:
+      madv = MADV_RANDOM;
+      break;
+    default:
+      fprintf(stderr, "Unknown mmap advice: %d\n", advice);
+      return -1;
+  }
+  if (map->size == 0) {
+    return 0;
+  }
+  /* Hints are just that, so failures are not fatal */
+  madvise((void*)map->base, (size_t)map->size, madv);
+  return 0;
+#endif
+}
+
+/* Ask the OS to start reading in the pages of a range that is about to
+   be read as a whole, so that the decompression threads do not have to
+   fault them in one at a time */
+static void willneed(blosc_mmap* map, int64_t offset, int64_t size)
+{
+#if defined(_WIN32)
+  /* PrefetchVirtualMemory() is only available from Windows 8 on */
+  (void)map;
+  (void)offset;
+  (void)size;
+#else
+  long pagesize = sysconf(_SC_PAGESIZE);
+  int64_t start = (pagesize > 0) ? offset - offset % pagesize : 0;
+
+  /* Hints are just that, so failures are not fatal */
+  madvise((void*)(map->base + start), (size_t)(offset + size - start),
+          MADV_WILLNEED);
+#endif
+}
+
+blosc_mmap* blosc_mmap_open(const char* path, int advice)
+{
+  blosc_mmap* map;
+
+  if (advice < BLOSC_MMAP_NORMAL || advice > BLOSC_MMAP_RANDOM) {
+    fprintf(stderr, "Unknown mmap advice: %d\n", advice);
+    return NULL;
+  }
+  map = calloc(1, sizeof(blosc_mmap));
+  if (map == NULL) {
+    fprintf(stderr, "Error allocating memory!");
+    return NULL;
+  }
+  map->offsets = malloc(MMAP_MIN_OFFSETS * sizeof(int64_t));
+  if (map->offsets == NULL) {
+    free(map);
+    fprintf(stderr, "Error allocating memory!");
+    return NULL;
+  }
+  map->allocated = MMAP_MIN_OFFSETS - 1;
+  map->offsets[0] = 0;
+
+#if defined(_WIN32)
+  {
+    LARGE_INTEGER size;
+
+    map->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (map->file == INVALID_HANDLE_VALUE || !GetFileSizeEx(map->file, &size)) {
+      fprintf(stderr, "Cannot open file '%s'\n", path);
+      goto error;
+    }
+    map->size = size.QuadPart;
+    if (map->size > 0) {
+      map->mapping = CreateFileMappingA(map->file, NULL, PAGE_READONLY, 0, 0, NULL);
+      if (map->mapping == NULL) {
+        fprintf(stderr, "Cannot map file '%s'\n", path);
+        goto error;
+      }
+      map->base = MapViewOfFile(map->mapping, FILE_MAP_READ, 0, 0, 0);
+      if (map->base == NULL) {
+        fprintf(stderr, "Cannot map file '%s'\n", path);
+        goto error;
+      }
+    }
+  }
+#else
+  {
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    void* base;
+
+    if (fd < 0 || fstat(fd, &st) != 0) {
+      fprintf(stderr, "Cannot open file '%s'\n", path);
+      if (fd >= 0) close(fd);
+      goto error;
+    }
+    map->size = (int64_t)st.st_size;
+    if (map->size > 0) {
+      base = mmap(NULL, (size_t)map->size, PROT_READ, MAP_SHARED, fd, 0);
+      if (base == MAP_FAILED) {
+        fprintf(stderr, "Cannot map file '%s'\n", path);
+        close(fd);
+        goto error;
+      }
+      map->base = base;
+    }
+    /* The mapping keeps its own reference to the file */
+    close(fd);
+  }
+#endif
+
+  pthread_mutex_init(&map->mutex, NULL);
+  advise(map, advice);
+  return map;
+
+  error:
+#if defined(_WIN32)
+  if (map->mapping != NULL) CloseHandle(map->mapping);
+  if (map->file != INVALID_HANDLE_VALUE && map->file != NULL) CloseHandle(map->file);
+#endif
+  free(map->offsets);
+  free(map);
+  return NULL;
+}
+
+int blosc_mmap_advise(blosc_mmap* map, int advice)
+{
+  return advise(map, advice);
+}
+
+void blosc_mmap_close(blosc_mmap* map)
+{
+  if (map == NULL) {
+    return;
+  }
+#if defined(_WIN32)
+  if (map->base != NULL) UnmapViewOfFile(map->base);
+  if (map->mapping != NULL) CloseHandle(map->mapping);
+  CloseHandle(map->file);
+#else
+  if (map->base != NULL) {
+    munmap((void*)map->base, (size_t)map->size);
+  }
+#endif
+  pthread_mutex_destroy(&map->mutex);
+  free(map->offsets);
+  free(map);
+}
+
+
+/* Validate the headers of the chunks up to `nchunk` (all of them if
+   negative) and return its offset and size.  Returns 0 if `nchunk`
+   exists and -1 otherwise. */
+static int validate_upto(blosc_mmap* map, int64_t nchunk, int64_t* offset_,
+                         int64_t* cbytes_)
+{
+  const uint8_t* chunk;
+  int64_t offset, remaining;
+  size_t nbytes, cbytes, blocksize;
+  int version;
+  int rc = 0;
+
+  pthread_mutex_lock(&map->mutex);
+  while (nchunk < 0 || map->nchunks <= nchunk) {
+    if (map->complete) {
+      rc = (nchunk < 0) ? 0 : -1;
+      break;
+    }
+    offset = map->offsets[map->nchunks];
+    remaining = map->size - offset;
+    if (remaining == 0) {
+      map->complete = 1;
+      continue;
+    }
+    chunk = map->base + offset;
+    version = (remaining < BLOSC_MIN_HEADER_LENGTH) ? 0 : chunk[0];
+    if (remaining < BLOSC_MIN_HEADER_LENGTH ||
+        (version == BLOSC_VERSION_FORMAT_EXTENDED &&
+         remaining < BLOSC_EXTENDED_HEADER_LENGTH)) {
+      fprintf(stderr, "Truncated chunk at offset %ld\n", (long)offset);
+      map->complete = 1;
+      continue;
+    }
+    blosc_cbuffer_sizes(chunk, &nbytes, &cbytes, &blocksize);
+    if (!BLOSC_KNOWN_VERSION(version) ||
+        (uint64_t)cbytes > (uint64_t)remaining ||
+        blosc_cbuffer_validate(chunk, cbytes, &nbytes) < 0) {
+      fprintf(stderr, "Invalid chunk at offset %ld\n", (long)offset);
+      map->complete = 1;
+      continue;
+    }
+    if (map->nchunks == map->allocated) {
+      int64_t* offsets = realloc(map->offsets,
+                                 (size_t)(map->allocated * 2 + 1) * sizeof(int64_t));
+      if (offsets == NULL) {
+        fprintf(stderr, "Error allocating memory!");
+        rc = -1;
+        break;
+      }
+      map->offsets = offsets;
+      map->allocated *= 2;
+    }
+    map->offsets[map->nchunks + 1] = offset + (int64_t)cbytes;
+    map->nchunks++;
+  }
+  if (rc == 0 && nchunk >= 0) {
+    *offset_ = map->offsets[nchunk];
+    *cbytes_ = map->offsets[nchunk + 1] - map->offsets[nchunk];
+  }
+  pthread_mutex_unlock(&map->mutex);
+  return rc;
+}
+
+int64_t blosc_mmap_nchunks(blosc_mmap* map)
+{
+  if (validate_upto(map, -1, NULL, NULL) < 0) {
+    return -1;
+  }
+  return map->nchunks;
+}
+
+const void* blosc_mmap_chunk(blosc_mmap* map, int64_t nchunk, size_t* cbytes)
+{
+  int64_t offset, size;
+
+  if (nchunk < 0 || validate_upto(map, nchunk, &offset, &size) < 0) {
+    fprintf(stderr, "Chunk %ld not found\n", (long)nchunk);
+    return NULL;
+  }
+  if (cbytes != NULL) {
+    *cbytes = (size_t)size;
+  }
+  return map->base + offset;
+}
+
+int64_t blosc_mmap_decompress(blosc_mmap* map, int64_t nchunk, void* dest,
+                              size_t destsize, int numinternalthreads)
+{
+  size_t cbytes;
+  const void* chunk = blosc_mmap_chunk(map, nchunk, &cbytes);
+
+  if (chunk == NULL) {
+    return -1;
+  }
+  willneed(map, (const uint8_t*)chunk - map->base, (int64_t)cbytes);
+  return blosc_decompress_ctx64(chunk, dest, destsize, numinternalthreads);
+}
+
+int blosc_mmap_getitem(blosc_mmap* map, int64_t nchunk, int start, int nitems,
+                       void* dest)
+{
+  const void* chunk = blosc_mmap_chunk(map, nchunk, NULL);
+
+  if (chunk == NULL) {
+    return -1;
+  }
+  return blosc_getitem(chunk, start, nitems, dest);
+}
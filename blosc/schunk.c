@@ -0,0 +1,945 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Super-chunks: growing sequences of Blosc chunks, kept either in memory
+  or in a file, with an index for random access to any item.
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "blosc.h"
+#include "blosc-common.h"
+
+#if defined(_WIN32)
+  #include "win32/pthread.h"
+  #define schunk_fseek _fseeki64
+  #define schunk_ftell _ftelli64
+#else
+  #include <pthread.h>
+  #define schunk_fseek fseeko
+  #define schunk_ftell ftello
+#endif
+
+
+/* The layout of a super-chunk file is:
+
+     |   header   | chunk 0 | chunk 1 | ... |   index   |   footer   |
+
+   where the header has 16 bytes:
+
+     |-0-|-1-|-2-|-3-|-4-|-5-|-6-|-7-|-8-|-9-|-A-|-B-|-C-|-D-|-E-|-F-|
+     |              magic            | ^   ^   ^   ^ |   typesize    |
+                                       |   |   |   +--compressor code
+                                       |   |   +------doshuffle
+                                       |   +----------clevel
+                                       +--------------format version
+
+   the index has an (offset, nbytes, cbytes) entry of 3 int64 per chunk,
+   possibly followed by zero padding, and the footer has the offset of the index, the number of chunks (both
+   int64) and the magic again.  All the integers are little endian.
+
+   The index is only written when the super-chunk is freed, so files that
+   were not properly closed are recovered by walking the chunk headers. */
+#define SCHUNK_MAGIC          "bloscsck"
+#define SCHUNK_VERSION_FORMAT 1
+#define SCHUNK_HEADER_LENGTH  16
+#define SCHUNK_FOOTER_LENGTH  24
+#define SCHUNK_INDEX_ENTRY    24
+
+/* Minimum number of entries of the index */
+#define SCHUNK_MIN_INDEX 16
+
+
+struct blosc_schunk {
+  int clevel;                     /* Compression level for appended buffers */
+  int doshuffle;                  /* Shuffle filter for appended buffers */
+  int32_t typesize;               /* Size of the items */
+  int compcode;                   /* Compressor for appended buffers */
+  int numthreads;                 /* Number of threads to use */
+  int64_t nchunks;                /* Number of chunks */
+  int64_t allocated;              /* Number of entries allocated in the index */
+  int64_t* starts;                /* Uncompressed start of every chunk (nchunks + 1 entries) */
+  int64_t* cbytes;                /* Compressed size of every chunk */
+  int64_t* offsets;               /* Offset of every chunk in the file */
+  int64_t total_cbytes;           /* Sum of the compressed sizes of the chunks */
+  uint8_t** chunks;               /* The chunks, for super-chunks in memory */
+  FILE* file;                     /* The file, for super-chunks in a file */
+  int64_t end;                    /* Offset for the next chunk in the file */
+  int64_t footer;                 /* Offset of a footer to invalidate, or -1 */
+  int64_t min_size;               /* Size the footer has to end at, at least */
+  int dirty;                      /* Whether the file index has to be written */
+  pthread_mutex_t file_mutex;     /* Serializes seek + read/write pairs */
+};
+
+
+/* Copy 8 bytes from `*pa` to int64_t, for little endian values */
+static int64_t get_int64(const uint8_t* pa)
+{
+  uint64_t value = 0;
+  int i;
+
+  for (i = 7; i >= 0; i--) {
+    value = (value << 8) | pa[i];
+  }
+  return (int64_t)value;
+}
+
+/* Copy `value` to 8 bytes in `*dest` in little endian */
+static void put_int64(uint8_t* dest, int64_t value)
+{
+  int i;
+
+  for (i = 0; i < 8; i++) {
+    dest[i] = (uint8_t)((uint64_t)value >> (8 * i));
+  }
+}
+
+/* Copy 4 bytes from `*pa` to int32_t, for little endian values */
+static int32_t get_int32(const uint8_t* pa)
+{
+  return (int32_t)((uint32_t)pa[0] | ((uint32_t)pa[1] << 8) |
+                   ((uint32_t)pa[2] << 16) | ((uint32_t)pa[3] << 24));
+}
+
+
+/* Make room in the index for one more chunk */
+static int grow_index(blosc_schunk* schunk)
+{
+  int64_t allocated;
+  void* p;
+
+  if (schunk->nchunks < schunk->allocated) {
+    return 0;
+  }
+  allocated = schunk->allocated * 2;
+  if (allocated < SCHUNK_MIN_INDEX) {
+    allocated = SCHUNK_MIN_INDEX;
+  }
+
+  p = realloc(schunk->starts, (size_t)(allocated + 1) * sizeof(int64_t));
+  if (p == NULL) goto error;
+  schunk->starts = p;
+  p = realloc(schunk->cbytes, (size_t)allocated * sizeof(int64_t));
+  if (p == NULL) goto error;
+  schunk->cbytes = p;
+  p = realloc(schunk->offsets, (size_t)allocated * sizeof(int64_t));
+  if (p == NULL) goto error;
+  schunk->offsets = p;
+  if (schunk->file == NULL) {
+    p = realloc(schunk->chunks, (size_t)allocated * sizeof(uint8_t*));
+    if (p == NULL) goto error;
+    schunk->chunks = p;
+  }
+  schunk->allocated = allocated;
+  return 0;
+
+  error:
+  fprintf(stderr, "Error allocating memory!");
+  return -1;
+}
+
+/* Add a chunk to the index */
+static int64_t index_chunk(blosc_schunk* schunk, int64_t offset,
+                           int64_t nbytes, int64_t cbytes)
+{
+  int64_t n;
+
+  if (grow_index(schunk) < 0) {
+    return -1;
+  }
+  n = schunk->nchunks;
+  schunk->offsets[n] = offset;
+  schunk->cbytes[n] = cbytes;
+  schunk->starts[n + 1] = schunk->starts[n] + nbytes;
+  schunk->total_cbytes += cbytes;
+  schunk->nchunks = n + 1;
+  return schunk->nchunks;
+}
+
+
+/* Allocate a new super-chunk */
+static blosc_schunk* new_schunk(int clevel, int doshuffle, size_t typesize,
+                                int compcode, int numinternalthreads)
+{
+  blosc_schunk* schunk;
+
+  if (clevel < 0 || clevel > 9) {
+    fprintf(stderr, "`clevel` parameter must be between 0 and 9!\n");
+    return NULL;
+  }
+  if (doshuffle < BLOSC_NOSHUFFLE || doshuffle > BLOSC_AUTOSHUFFLE) {
+    fprintf(stderr, "`shuffle` parameter must be either 0, 1, 2 or 3!\n");
+    return NULL;
+  }
+  if (typesize <= 0 || typesize > INT32_MAX) {
+    fprintf(stderr, "`typesize` parameter must be greater than 0!\n");
+    return NULL;
+  }
+  if (compcode < 0) {
+    fprintf(stderr, "Compressor not supported\n");
+    return NULL;
+  }
+  if (numinternalthreads < 1 || numinternalthreads > BLOSC_MAX_THREADS) {
+    fprintf(stderr, "Error.  nthreads must be a positive integer <= %d\n",
+            BLOSC_MAX_THREADS);
+    return NULL;
+  }
+
+  schunk = calloc(1, sizeof(blosc_schunk));
+  if (schunk == NULL) {
+    fprintf(stderr, "Error allocating memory!");
+    return NULL;
+  }
+  schunk->clevel = clevel;
+  schunk->doshuffle = doshuffle;
+  schunk->typesize = (int32_t)typesize;
+  schunk->compcode = compcode;
+  schunk->numthreads = numinternalthreads;
+  schunk->footer = -1;
+  schunk->starts = calloc(1, sizeof(int64_t));
+  if (schunk->starts == NULL) {
+    free(schunk);
+    fprintf(stderr, "Error allocating memory!");
+    return NULL;
+  }
+  pthread_mutex_init(&schunk->file_mutex, NULL);
+  return schunk;
+}
+
+blosc_schunk* blosc_schunk_new(int clevel, int doshuffle, size_t typesize,
+                               const char* compressor, int numinternalthreads)
+{
+  return new_schunk(clevel, doshuffle, typesize,
+                    blosc_compname_to_compcode(compressor), numinternalthreads);
+}
+
+blosc_schunk* blosc_schunk_create_file(const char* path, int clevel,
+                                       int doshuffle, size_t typesize,
+                                       const char* compressor,
+                                       int numinternalthreads)
+{
+  blosc_schunk* schunk;
+  uint8_t header[SCHUNK_HEADER_LENGTH];
+
+  schunk = new_schunk(clevel, doshuffle, typesize,
+                      blosc_compname_to_compcode(compressor), numinternalthreads);
+  if (schunk == NULL) {
+    return NULL;
+  }
+
+  schunk->file = fopen(path, "w+b");
+  if (schunk->file == NULL) {
+    fprintf(stderr, "Cannot create super-chunk file '%s'\n", path);
+    blosc_schunk_free(schunk);
+    return NULL;
+  }
+
+  memcpy(header, SCHUNK_MAGIC, 8);
+  header[8] = SCHUNK_VERSION_FORMAT;
+  header[9] = (uint8_t)clevel;
+  header[10] = (uint8_t)doshuffle;
+  header[11] = (uint8_t)schunk->compcode;
+  header[12] = (uint8_t)(schunk->typesize);
+  header[13] = (uint8_t)(schunk->typesize >> 8);
+  header[14] = (uint8_t)(schunk->typesize >> 16);
+  header[15] = (uint8_t)(schunk->typesize >> 24);
+  if (fwrite(header, 1, SCHUNK_HEADER_LENGTH, schunk->file) != SCHUNK_HEADER_LENGTH) {
+    fprintf(stderr, "Cannot write super-chunk file '%s'\n", path);
+    blosc_schunk_free(schunk);
+    return NULL;
+  }
+  schunk->end = SCHUNK_HEADER_LENGTH;
+  /* Even an empty super-chunk gets an index */
+  schunk->dirty = 1;
+
+  return schunk;
+}
+
+/* Read the index at the end of a super-chunk file.  Returns 0 on success
+   and -1 if there is no valid index. */
+static int read_index(blosc_schunk* schunk, int64_t filesize)
+{
+  uint8_t footer[SCHUNK_FOOTER_LENGTH];
+  uint8_t entry[SCHUNK_INDEX_ENTRY];
+  int64_t index_offset, nchunks, i;
+
+  if (filesize < SCHUNK_HEADER_LENGTH + SCHUNK_FOOTER_LENGTH ||
+      schunk_fseek(schunk->file, filesize - SCHUNK_FOOTER_LENGTH, SEEK_SET) != 0 ||
+      fread(footer, 1, SCHUNK_FOOTER_LENGTH, schunk->file) != SCHUNK_FOOTER_LENGTH ||
+      memcmp(footer + 16, SCHUNK_MAGIC, 8) != 0) {
+    return -1;
+  }
+  index_offset = get_int64(footer);
+  nchunks = get_int64(footer + 8);
+  if (index_offset < SCHUNK_HEADER_LENGTH || nchunks < 0 ||
+      nchunks > (filesize - SCHUNK_FOOTER_LENGTH - index_offset) / SCHUNK_INDEX_ENTRY ||
+      schunk_fseek(schunk->file, index_offset, SEEK_SET) != 0) {
+    return -1;
+  }
+
+  for (i = 0; i < nchunks; i++) {
+    int64_t offset, nbytes, cbytes;
+    if (fread(entry, 1, SCHUNK_INDEX_ENTRY, schunk->file) != SCHUNK_INDEX_ENTRY) {
+      return -1;
+    }
+    offset = get_int64(entry);
+    nbytes = get_int64(entry + 8);
+    cbytes = get_int64(entry + 16);
+    if (offset < SCHUNK_HEADER_LENGTH || nbytes < 0 || cbytes <= 0 ||
+        offset > index_offset - cbytes) {
+      return -1;
+    }
+    if (index_chunk(schunk, offset, nbytes, cbytes) < 0) {
+      return -1;
+    }
+  }
+
+  schunk->end = index_offset;
+  schunk->footer = filesize - SCHUNK_FOOTER_LENGTH;
+  return 0;
+}
+
+/* Rebuild the index of a super-chunk file that was not properly closed
+   by walking the headers of its chunks */
+static int recover_index(blosc_schunk* schunk, int64_t filesize)
+{
+  uint8_t header[BLOSC_EXTENDED_HEADER_LENGTH];
+  int64_t offset = SCHUNK_HEADER_LENGTH;
+  size_t nbytes, cbytes, blocksize;
+  int version, versionlz;
+  size_t nread;
+
+  schunk->nchunks = 0;
+  schunk->total_cbytes = 0;
+  while (offset < filesize) {
+    if (schunk_fseek(schunk->file, offset, SEEK_SET) != 0) {
+      break;
+    }
+    memset(header, 0, sizeof(header));
+    nread = fread(header, 1, BLOSC_EXTENDED_HEADER_LENGTH, schunk->file);
+    if (nread < BLOSC_MIN_HEADER_LENGTH) {
+      break;
+    }
+    blosc_cbuffer_versions(header, &version, &versionlz);
+    blosc_cbuffer_sizes(header, &nbytes, &cbytes, &blocksize);
+    if (!BLOSC_KNOWN_VERSION(version) ||
+        (version == BLOSC_VERSION_FORMAT_EXTENDED &&
+         cbytes < BLOSC_EXTENDED_HEADER_LENGTH) ||
+        cbytes < BLOSC_MIN_HEADER_LENGTH ||
+        (int64_t)cbytes > filesize - offset ||
+        nbytes % schunk->typesize != 0) {
+      /* Not a chunk (or a truncated one), so we are done */
+      break;
+    }
+    if (index_chunk(schunk, offset, (int64_t)nbytes, (int64_t)cbytes) < 0) {
+      return -1;
+    }
+    offset += (int64_t)cbytes;
+  }
+
+  schunk->end = offset;
+  /* The footer has to be the last thing in the file, so pad the index
+     over any leftovers */
+  schunk->min_size = filesize;
+  schunk->dirty = 1;
+  return 0;
+}
+
+blosc_schunk* blosc_schunk_open_file(const char* path, int numinternalthreads)
+{
+  blosc_schunk* schunk;
+  FILE* file;
+  uint8_t header[SCHUNK_HEADER_LENGTH];
+  int64_t filesize;
+
+  file = fopen(path, "r+b");
+  if (file == NULL) {
+    fprintf(stderr, "Cannot open super-chunk file '%s'\n", path);
+    return NULL;
+  }
+  if (fread(header, 1, SCHUNK_HEADER_LENGTH, file) != SCHUNK_HEADER_LENGTH ||
+      memcmp(header, SCHUNK_MAGIC, 8) != 0 ||
+      header[8] != SCHUNK_VERSION_FORMAT) {
+    fprintf(stderr, "'%s' is not a super-chunk file\n", path);
+    fclose(file);
+    return NULL;
+  }
+
+  schunk = new_schunk(header[9], header[10], (size_t)get_int32(header + 12),
+                      header[11], numinternalthreads);
+  if (schunk == NULL) {
+    fclose(file);
+    return NULL;
+  }
+  schunk->file = file;
+
+  if (schunk_fseek(file, 0, SEEK_END) != 0 ||
+      (filesize = schunk_ftell(file)) < 0) {
+    blosc_schunk_free(schunk);
+    return NULL;
+  }
+  if (read_index(schunk, filesize) < 0) {
+    if (recover_index(schunk, filesize) < 0) {
+      blosc_schunk_free(schunk);
+      return NULL;
+    }
+  }
+
+  return schunk;
+}
+
+/* Write the index and the footer at the end of a super-chunk file */
+static int write_index(blosc_schunk* schunk)
+{
+  uint8_t entry[SCHUNK_INDEX_ENTRY];
+  uint8_t footer[SCHUNK_FOOTER_LENGTH];
+  int64_t i, pos;
+
+  if (schunk_fseek(schunk->file, schunk->end, SEEK_SET) != 0) {
+    return -1;
+  }
+  for (i = 0; i < schunk->nchunks; i++) {
+    put_int64(entry, schunk->offsets[i]);
+    put_int64(entry + 8, schunk->starts[i + 1] - schunk->starts[i]);
+    put_int64(entry + 16, schunk->cbytes[i]);
+    if (fwrite(entry, 1, SCHUNK_INDEX_ENTRY, schunk->file) != SCHUNK_INDEX_ENTRY) {
+      return -1;
+    }
+  }
+  memset(entry, 0, SCHUNK_INDEX_ENTRY);
+  pos = schunk->end + schunk->nchunks * SCHUNK_INDEX_ENTRY;
+  while (pos < schunk->min_size - SCHUNK_FOOTER_LENGTH) {
+    size_t n = (size_t)(schunk->min_size - SCHUNK_FOOTER_LENGTH - pos);
+    if (n > SCHUNK_INDEX_ENTRY) {
+      n = SCHUNK_INDEX_ENTRY;
+    }
+    if (fwrite(entry, 1, n, schunk->file) != n) {
+      return -1;
+    }
+    pos += (int64_t)n;
+  }
+  put_int64(footer, schunk->end);
+  put_int64(footer + 8, schunk->nchunks);
+  memcpy(footer + 16, SCHUNK_MAGIC, 8);
+  if (fwrite(footer, 1, SCHUNK_FOOTER_LENGTH, schunk->file) != SCHUNK_FOOTER_LENGTH) {
+    return -1;
+  }
+  return 0;
+}
+
+int blosc_schunk_free(blosc_schunk* schunk)
+{
+  int rc = 0;
+  int64_t i;
+
+  if (schunk == NULL) {
+    return 0;
+  }
+  if (schunk->file != NULL) {
+    if (schunk->dirty && write_index(schunk) < 0) {
+      fprintf(stderr, "Cannot write the index of the super-chunk file\n");
+      rc = -1;
+    }
+    if (fclose(schunk->file) != 0) {
+      rc = -1;
+    }
+  }
+  if (schunk->chunks != NULL) {
+    for (i = 0; i < schunk->nchunks; i++) {
+      free(schunk->chunks[i]);
+    }
+  }
+  pthread_mutex_destroy(&schunk->file_mutex);
+  free(schunk->chunks);
+  free(schunk->starts);
+  free(schunk->cbytes);
+  free(schunk->offsets);
+  free(schunk);
+  return rc;
+}
+
+
+/* Append a compressed chunk of `cbytes` to the super-chunk.  Chunks in
+   memory take the ownership of `chunk`. */
+static int64_t append_chunk(blosc_schunk* schunk, uint8_t* chunk,
+                            int64_t nbytes, int64_t cbytes)
+{
+  static const uint8_t zeros[SCHUNK_FOOTER_LENGTH] = {0};
+  int64_t offset = schunk->end;
+  int64_t rc;
+
+  if (schunk->file == NULL) {
+    rc = index_chunk(schunk, 0, nbytes, cbytes);
+    if (rc < 0) {
+      free(chunk);
+      return rc;
+    }
+    schunk->chunks[rc - 1] = chunk;
+    return rc;
+  }
+
+  pthread_mutex_lock(&schunk->file_mutex);
+  /* The index is to be overwritten, so make sure it is not taken as
+     valid if we are not closed properly */
+  if (schunk->footer >= 0) {
+    if (schunk_fseek(schunk->file, schunk->footer, SEEK_SET) != 0 ||
+        fwrite(zeros, 1, SCHUNK_FOOTER_LENGTH, schunk->file) != SCHUNK_FOOTER_LENGTH) {
+      pthread_mutex_unlock(&schunk->file_mutex);
+      return -1;
+    }
+    schunk->footer = -1;
+  }
+  if (schunk_fseek(schunk->file, offset, SEEK_SET) != 0 ||
+      fwrite(chunk, 1, (size_t)cbytes, schunk->file) != (size_t)cbytes) {
+    pthread_mutex_unlock(&schunk->file_mutex);
+    fprintf(stderr, "Cannot write to the super-chunk file\n");
+    return -1;
+  }
+  schunk->end += cbytes;
+  schunk->dirty = 1;
+  pthread_mutex_unlock(&schunk->file_mutex);
+
+  return index_chunk(schunk, offset, nbytes, cbytes);
+}
+
+int64_t blosc_schunk_append_buffer(blosc_schunk* schunk, const void* src,
+                                   size_t nbytes)
+{
+  const char* compname;
+  uint8_t* chunk;
+  size_t destsize;
+  int64_t cbytes;
+  int64_t rc;
+
+  if (nbytes % schunk->typesize != 0) {
+    fprintf(stderr, "Buffer size must be a multiple of typesize\n");
+    return -1;
+  }
+  blosc_compcode_to_compname(schunk->compcode, &compname);
+
+  /* Use the extended format only when needed, so that chunks can be read
+     by older versions.  There is room for the checksums, in case they are
+     enabled. */
+  if (nbytes + BLOSC_MAX_OVERHEAD_CHECKSUMS(nbytes) <= INT_MAX) {
+    destsize = nbytes + BLOSC_MAX_OVERHEAD_CHECKSUMS(nbytes);
+  }
+  else {
+    destsize = nbytes + BLOSC_MAX_OVERHEAD_EXTENDED_CHECKSUMS(nbytes);
+  }
+  chunk = malloc(destsize);
+  if (chunk == NULL) {
+    fprintf(stderr, "Error allocating memory!");
+    return -1;
+  }
+  if (destsize <= INT_MAX) {
+    cbytes = blosc_compress_ctx(schunk->clevel, schunk->doshuffle,
+                                schunk->typesize, nbytes, src, chunk, destsize,
+                                compname, 0, schunk->numthreads);
+  }
+  else {
+    cbytes = blosc_compress_ctx64(schunk->clevel, schunk->doshuffle,
+                                  schunk->typesize, nbytes, src, chunk, destsize,
+                                  compname, 0, schunk->numthreads);
+  }
+  if (cbytes <= 0) {
+    free(chunk);
+    return (cbytes < 0) ? cbytes : -1;
+  }
+
+  if (schunk->file != NULL) {
+    rc = append_chunk(schunk, chunk, (int64_t)nbytes, cbytes);
+    free(chunk);
+    return rc;
+  }
+  /* Do not keep the unused space around */
+  if ((size_t)cbytes < destsize) {
+    uint8_t* shrunk = realloc(chunk, (size_t)cbytes);
+    if (shrunk != NULL) {
+      chunk = shrunk;
+    }
+  }
+  return append_chunk(schunk, chunk, (int64_t)nbytes, cbytes);
+}
+
+int64_t blosc_schunk_append_chunk(blosc_schunk* schunk, const void* chunk)
+{
+  size_t nbytes, cbytes, blocksize, typesize;
+  int flags;
+  uint8_t* copy;
+
+  blosc_cbuffer_sizes(chunk, &nbytes, &cbytes, &blocksize);
+  blosc_cbuffer_metainfo(chunk, &typesize, &flags);
+  if (cbytes < BLOSC_MIN_HEADER_LENGTH || typesize == 0) {
+    fprintf(stderr, "Not a Blosc chunk\n");
+    return -1;
+  }
+  /* Items must not straddle chunks */
+  if (nbytes % schunk->typesize != 0 || schunk->typesize % typesize != 0) {
+    fprintf(stderr, "Chunk sizes must be a multiple of typesize\n");
+    return -1;
+  }
+
+  if (schunk->file != NULL) {
+    return append_chunk(schunk, (uint8_t*)chunk, (int64_t)nbytes, (int64_t)cbytes);
+  }
+  copy = malloc(cbytes);
+  if (copy == NULL) {
+    fprintf(stderr, "Error allocating memory!");
+    return -1;
+  }
+  memcpy(copy, chunk, cbytes);
+  return append_chunk(schunk, copy, (int64_t)nbytes, (int64_t)cbytes);
+}
+
+void blosc_schunk_sizes(const blosc_schunk* schunk, int64_t* nchunks,
+                        int64_t* nbytes, int64_t* cbytes)
+{
+  *nchunks = schunk->nchunks;
+  *nbytes = schunk->starts[schunk->nchunks];
+  *cbytes = schunk->total_cbytes;
+}
+
+
+/* Read `size` bytes at `offset` of the chunk `nchunk` of a file */
+static int read_chunk(blosc_schunk* schunk, int64_t nchunk, int64_t offset,
+                      int64_t size, uint8_t* dest)
+{
+  int rc = 0;
+
+  pthread_mutex_lock(&schunk->file_mutex);
+  if (schunk_fseek(schunk->file, schunk->offsets[nchunk] + offset, SEEK_SET) != 0 ||
+      fread(dest, 1, (size_t)size, schunk->file) != (size_t)size) {
+    fprintf(stderr, "Cannot read from the super-chunk file\n");
+    rc = -1;
+  }
+  pthread_mutex_unlock(&schunk->file_mutex);
+  return rc;
+}
+
+/* Decompress the chunk `nchunk` into `dest` */
+static int64_t decompress_chunk(blosc_schunk* schunk, int64_t nchunk,
+                                void* dest, size_t destsize, int nthreads)
+{
+  uint8_t* chunk;
+  int64_t rc;
+
+  if (schunk->file == NULL) {
+    return blosc_decompress_ctx64(schunk->chunks[nchunk], dest, destsize, nthreads);
+  }
+
+  chunk = malloc((size_t)schunk->cbytes[nchunk]);
+  if (chunk == NULL) {
+    fprintf(stderr, "Error allocating memory!");
+    return -1;
+  }
+  rc = read_chunk(schunk, nchunk, 0, schunk->cbytes[nchunk], chunk);
+  if (rc == 0) {
+    rc = blosc_decompress_ctx64(chunk, dest, destsize, nthreads);
+  }
+  free(chunk);
+  return rc;
+}
+
+/* The start of the block `j` in the `bstarts` of a chunk */
+static int64_t get_bstart(const uint8_t* bstarts, int64_t bstart_size,
+                          int64_t j)
+{
+  return (bstart_size == 8) ? get_int64(bstarts + j * 8) :
+                              get_int32(bstarts + j * 4);
+}
+
+/* Read from a file only the parts of the chunk `nchunk` that are needed
+   for getting the bytes in [start, stop).  The rest of the returned
+   buffer is left uninitialized. */
+static uint8_t* read_chunk_range(blosc_schunk* schunk, int64_t nchunk,
+                                 int64_t start, int64_t stop)
+{
+  int64_t cbytes = schunk->cbytes[nchunk];
+  int64_t nbytes = schunk->starts[nchunk + 1] - schunk->starts[nchunk];
+  size_t hnbytes, hcbytes, blocksize, typesize;
+  int version, versionlz, flags;
+  int64_t header_len, bstart_size, nblocks, first, last, lo, hi, csize;
+  int64_t j, bstart, top;
+  uint8_t* chunk;
+
+  chunk = malloc((size_t)cbytes);
+  if (chunk == NULL) {
+    fprintf(stderr, "Error allocating memory!");
+    return NULL;
+  }
+  header_len = (cbytes < BLOSC_EXTENDED_HEADER_LENGTH) ?
+               BLOSC_MIN_HEADER_LENGTH : BLOSC_EXTENDED_HEADER_LENGTH;
+  if (read_chunk(schunk, nchunk, 0, header_len, chunk) < 0) {
+    goto error;
+  }
+  blosc_cbuffer_versions(chunk, &version, &versionlz);
+  blosc_cbuffer_sizes(chunk, &hnbytes, &hcbytes, &blocksize);
+  blosc_cbuffer_metainfo(chunk, &typesize, &flags);
+  header_len = (version == BLOSC_VERSION_FORMAT_EXTENDED) ?
+               BLOSC_EXTENDED_HEADER_LENGTH : BLOSC_MIN_HEADER_LENGTH;
+  bstart_size = (version == BLOSC_VERSION_FORMAT_EXTENDED) ? 8 : 4;
+  if ((int64_t)hcbytes != cbytes || (int64_t)hnbytes != nbytes || blocksize == 0) {
+    fprintf(stderr, "Corrupted chunk in super-chunk file\n");
+    goto error;
+  }
+
+  nblocks = (nbytes + (int64_t)blocksize - 1) / (int64_t)blocksize;
+  first = start / (int64_t)blocksize;
+  last = (stop - 1) / (int64_t)blocksize;
+  /* Checksums cover whole blocks, so these have to be read entirely */
+  csize = (flags & BLOSC_CHECKSUMMED) ? nblocks * 4 : 0;
+  if (flags & BLOSC_MEMCPYED) {
+    lo = header_len + start;
+    hi = header_len + stop;
+    if (csize > 0) {
+      lo = header_len + first * (int64_t)blocksize;
+      hi = header_len + (last + 1) * (int64_t)blocksize;
+      if (hi > header_len + nbytes) {
+        hi = header_len + nbytes;
+      }
+      if (header_len + nbytes + csize > cbytes ||
+          read_chunk(schunk, nchunk, header_len + nbytes, csize,
+                     chunk + header_len + nbytes) < 0) {
+        goto error;
+      }
+    }
+  }
+  else {
+    /* Use the block starts for locating the compressed blocks needed */
+    if (header_len + nblocks * bstart_size + csize > cbytes ||
+        read_chunk(schunk, nchunk, header_len, nblocks * bstart_size + csize,
+                   chunk + header_len) < 0) {
+      goto error;
+    }
+    /* Threads store the blocks in any order, so a block ends at the
+       next block start, whichever block that is.  Read from the first
+       start of the blocks needed to the end of the one stored last. */
+    lo = cbytes;
+    top = -1;
+    for (j = first; j <= last; j++) {
+      bstart = get_bstart(chunk + header_len, bstart_size, j);
+      lo = (bstart < lo) ? bstart : lo;
+      top = (bstart > top) ? bstart : top;
+    }
+    hi = cbytes;
+    for (j = 0; j < nblocks; j++) {
+      bstart = get_bstart(chunk + header_len, bstart_size, j);
+      if (bstart > top && bstart < hi) {
+        hi = bstart;
+      }
+    }
+  }
+  if (lo < header_len || hi > cbytes || lo > hi ||
+      read_chunk(schunk, nchunk, lo, hi - lo, chunk + lo) < 0) {
+    goto error;
+  }
+  return chunk;
+
+  error:
+  free(chunk);
+  return NULL;
+}
+
+/* Get the bytes in [start, stop) of the chunk `nchunk` into `dest` by
+   decompressing the whole chunk into a temporary */
+static int64_t get_chunk_bytes_whole(blosc_schunk* schunk, int64_t nchunk,
+                                     int64_t start, int64_t stop,
+                                     uint8_t* dest, int nthreads)
+{
+  int64_t nbytes = schunk->starts[nchunk + 1] - schunk->starts[nchunk];
+  uint8_t* chunk;
+  int64_t rc;
+
+  chunk = malloc((size_t)nbytes);
+  if (chunk == NULL) {
+    fprintf(stderr, "Error allocating memory!");
+    return -1;
+  }
+  rc = decompress_chunk(schunk, nchunk, chunk, (size_t)nbytes, nthreads);
+  if (rc == nbytes) {
+    memcpy(dest, chunk + start, (size_t)(stop - start));
+    rc = stop - start;
+  }
+  free(chunk);
+  return (rc < 0) ? rc : ((rc == stop - start) ? rc : -1);
+}
+
+/* Get the bytes in [start, stop) of the chunk `nchunk` into `dest` */
+static int64_t get_chunk_bytes(blosc_schunk* schunk, int64_t nchunk,
+                               int64_t start, int64_t stop, uint8_t* dest,
+                               int nthreads)
+{
+  int64_t nbytes = schunk->starts[nchunk + 1] - schunk->starts[nchunk];
+  size_t ctypesize;
+  int flags;
+  uint8_t* chunk;
+  int64_t rc;
+
+  if (start == 0 && stop == nbytes) {
+    /* Whole chunk */
+    return decompress_chunk(schunk, nchunk, dest, (size_t)nbytes, nthreads);
+  }
+
+  if ((stop - start) > BLOSC_MAX_BUFFERSIZE) {
+    /* Too large for blosc_getitem(), so go through a temporary */
+    return get_chunk_bytes_whole(schunk, nchunk, start, stop, dest, nthreads);
+  }
+
+  chunk = (schunk->file == NULL) ? schunk->chunks[nchunk] :
+          read_chunk_range(schunk, nchunk, start, stop);
+  if (chunk == NULL) {
+    return -1;
+  }
+  /* blosc_getitem() works with the items of the chunk, which can be
+     past INT_MAX in extended chunks */
+  blosc_cbuffer_metainfo(chunk, &ctypesize, &flags);
+  if (start / (int64_t)ctypesize > INT_MAX) {
+    rc = get_chunk_bytes_whole(schunk, nchunk, start, stop, dest, nthreads);
+  }
+  else {
+    rc = blosc_getitem(chunk, (int)(start / (int64_t)ctypesize),
+                       (int)((stop - start) / (int64_t)ctypesize), dest);
+  }
+  if (schunk->file != NULL) {
+    free(chunk);
+  }
+  return rc;
+}
+
+/* Return the chunk containing the byte at `pos` */
+static int64_t find_chunk(const blosc_schunk* schunk, int64_t pos)
+{
+  int64_t lo = 0, hi = schunk->nchunks - 1, mid;
+
+  /* Find the first chunk ending past `pos` (skips empty chunks) */
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (schunk->starts[mid + 1] > pos) {
+      hi = mid;
+    }
+    else {
+      lo = mid + 1;
+    }
+  }
+  return lo;
+}
+
+
+/* Shared state for getting items spanning several chunks in parallel */
+struct schunk_job {
+  blosc_schunk* schunk;
+  int64_t start;                  /* First byte to get */
+  int64_t stop;                   /* Byte past the last one to get */
+  int64_t next;                   /* Next chunk to process */
+  int64_t last;                   /* Last chunk to process */
+  uint8_t* dest;
+  int64_t error;                  /* Error code, or 0 */
+  pthread_mutex_t mutex;
+};
+
+/* Get the bytes of chunks of a job until there are no more left */
+static void* schunk_worker(void* arg)
+{
+  struct schunk_job* job = (struct schunk_job*)arg;
+  blosc_schunk* schunk = job->schunk;
+  int64_t nchunk, cstart, lo, hi, rc, error;
+
+  while (1) {
+    pthread_mutex_lock(&job->mutex);
+    nchunk = job->next++;
+    error = job->error;
+    pthread_mutex_unlock(&job->mutex);
+    if (nchunk > job->last || error != 0) {
+      break;
+    }
+    cstart = schunk->starts[nchunk];
+    lo = (job->start > cstart) ? job->start : cstart;
+    hi = (job->stop < schunk->starts[nchunk + 1]) ? job->stop : schunk->starts[nchunk + 1];
+    if (lo >= hi) {
+      continue;
+    }
+    rc = get_chunk_bytes(schunk, nchunk, lo - cstart, hi - cstart,
+                         job->dest + (lo - job->start), 1);
+    if (rc != hi - lo) {
+      pthread_mutex_lock(&job->mutex);
+      job->error = (rc < 0) ? rc : -1;
+      pthread_mutex_unlock(&job->mutex);
+      break;
+    }
+  }
+  return NULL;
+}
+
+int64_t blosc_schunk_getitem(blosc_schunk* schunk, int64_t start,
+                             int64_t nitems, void* dest)
+{
+  struct schunk_job job;
+  pthread_t threads[BLOSC_MAX_THREADS];
+  int64_t first, last, nthreads, i;
+  int64_t nbytes = schunk->starts[schunk->nchunks];
+  int64_t rc;
+
+  if (start < 0 || nitems < 0 || start > nbytes / schunk->typesize ||
+      nitems > nbytes / schunk->typesize - start) {
+    fprintf(stderr, "`start`+`nitems` out of bounds\n");
+    return -1;
+  }
+  if (nitems == 0) {
+    return 0;
+  }
+
+  job.start = start * schunk->typesize;
+  job.stop = (start + nitems) * schunk->typesize;
+  first = find_chunk(schunk, job.start);
+  last = find_chunk(schunk, job.stop - 1);
+
+  if (first == last) {
+    /* A single chunk can use the internal threads */
+    rc = get_chunk_bytes(schunk, first, job.start - schunk->starts[first],
+                         job.stop - schunk->starts[first], dest,
+                         schunk->numthreads);
+    return (rc == job.stop - job.start) ? rc : ((rc < 0) ? rc : -1);
+  }
+
+  /* Decompress the chunks in parallel, one per thread at a time */
+  job.schunk = schunk;
+  job.next = first;
+  job.last = last;
+  job.dest = (uint8_t*)dest;
+  job.error = 0;
+  pthread_mutex_init(&job.mutex, NULL);
+  nthreads = last - first + 1;
+  if (nthreads > schunk->numthreads) {
+    nthreads = schunk->numthreads;
+  }
+  for (i = 1; i < nthreads; i++) {
+    if (pthread_create(&threads[i], NULL, schunk_worker, &job) != 0) {
+      break;
+    }
+  }
+  nthreads = i;
+  schunk_worker(&job);
+  for (i = 1; i < nthreads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  pthread_mutex_destroy(&job.mutex);
+
+  if (job.error != 0) {
+    return job.error;
+  }
+  return job.stop - job.start;
+}
+
+int64_t blosc_schunk_decompress_chunk(blosc_schunk* schunk, int64_t nchunk,
+                                      void* dest, size_t destsize)
+{
+  if (nchunk < 0 || nchunk >= schunk->nchunks) {
+    fprintf(stderr, "Chunk %ld out of bounds\n", (long)nchunk);
+    return -1;
+  }
+  return decompress_chunk(schunk, nchunk, dest, destsize, schunk->numthreads);
+}
@@ -339,6 +339,100 @@ shuffle16_tiled_avx2(uint8_t* const dest, const uint8_t* const src,
   }
 }
 
+/* Routine optimized for shuffling a buffer for a type size of 3, 5, 6 or 7
+   bytes.  The 16 * bytesoftype bytes of 16 elements are held in the same
+   lane of bytesoftype YMM registers, and every row is gathered from them
+   with one byte shuffle per register. */
+static void
+shuffle_gather_avx2(uint8_t* const dest, const uint8_t* const src,
+  const size_t vectorizable_elements, const size_t total_elements, const size_t bytesoftype)
+{
+  size_t j;
+  int k, l, q;
+  uint8_t mask[16];
+  __m256i shmask[7][7], ymm0[7], ymm1;
+
+  /* shmask[k][l] picks the bytes of row k found in the l-th register */
+  for (k = 0; k < (int)bytesoftype; k++) {
+    for (l = 0; l < (int)bytesoftype; l++) {
+      for (q = 0; q < 16; q++) {
+        const int pos = q * (int)bytesoftype + k;
+        mask[q] = (uint8_t)((pos / 16 == l) ? pos % 16 : 0x80);
+      }
+      shmask[k][l] = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i*)mask));
+    }
+  }
+
+  for (j = 0; j < vectorizable_elements; j += sizeof(__m256i)) {
+    /* Fetch elements j..j+15 in the low lanes and j+16..j+31 in the high ones */
+    for (l = 0; l < (int)bytesoftype; l++) {
+      ymm0[l] = _mm256_loadu2_m128i(
+        (__m128i*)(src + (j + 16) * bytesoftype + l * sizeof(__m128i)),
+        (__m128i*)(src + j * bytesoftype + l * sizeof(__m128i)));
+    }
+    /* Gather and store the rows */
+    for (k = 0; k < (int)bytesoftype; k++) {
+      ymm1 = _mm256_shuffle_epi8(ymm0[0], shmask[k][0]);
+      for (l = 1; l < (int)bytesoftype; l++) {
+        ymm1 = _mm256_or_si256(ymm1, _mm256_shuffle_epi8(ymm0[l], shmask[k][l]));
+      }
+      _mm256_storeu_si256((__m256i*)(dest + j + (k * total_elements)), ymm1);
+    }
+  }
+}
+
+/* Routine optimized for shuffling a buffer for a type size smaller than 16
+   bytes which has no dedicated kernel (9, 10, 11...).  Every element is
+   loaded along with the first bytes of the next ones (elements j..j+15 in
+   the low lanes and j+16..j+31 in the high lanes) and, after a 16x16 byte
+   transpose in each lane, only the rows for the bytes of the type are
+   stored.  The caller must ensure that reading 16 bytes at the last
+   element does not go past the end of the block. */
+static void
+shuffle16_partial_avx2(uint8_t* const dest, const uint8_t* const src,
+  const size_t vectorizable_elements, const size_t total_elements, const size_t bytesoftype)
+{
+  size_t j;
+  int k, l;
+  __m256i ymm0[16], ymm1[16];
+
+  for (j = 0; j < vectorizable_elements; j += sizeof(__m256i)) {
+    /* Fetch 16 bytes starting at each of the next 32 elements */
+    for (k = 0; k < 16; k++) {
+      ymm0[k] = _mm256_loadu2_m128i(
+        (__m128i*)(src + (j + 16 + k) * bytesoftype),
+        (__m128i*)(src + (j + k) * bytesoftype));
+    }
+    /* Transpose bytes */
+    for (k = 0, l = 0; k < 8; k++, l +=2) {
+      ymm1[k*2] = _mm256_unpacklo_epi8(ymm0[l], ymm0[l+1]);
+      ymm1[k*2+1] = _mm256_unpackhi_epi8(ymm0[l], ymm0[l+1]);
+    }
+    /* Transpose words */
+    for (k = 0, l = -2; k < 8; k++, l++) {
+      if ((k%2) == 0) l += 2;
+      ymm0[k*2] = _mm256_unpacklo_epi16(ymm1[l], ymm1[l+2]);
+      ymm0[k*2+1] = _mm256_unpackhi_epi16(ymm1[l], ymm1[l+2]);
+    }
+    /* Transpose double words */
+    for (k = 0, l = -4; k < 8; k++, l++) {
+      if ((k%4) == 0) l += 4;
+      ymm1[k*2] = _mm256_unpacklo_epi32(ymm0[l], ymm0[l+4]);
+      ymm1[k*2+1] = _mm256_unpackhi_epi32(ymm0[l], ymm0[l+4]);
+    }
+    /* Transpose quad words */
+    for (k = 0; k < 8; k++) {
+      ymm0[k*2] = _mm256_unpacklo_epi64(ymm1[k], ymm1[k+8]);
+      ymm0[k*2+1] = _mm256_unpackhi_epi64(ymm1[k], ymm1[k+8]);
+    }
+    /* Store the result vectors holding actual bytes of the type */
+    uint8_t* const dest_for_jth_element = dest + j;
+    for (k = 0; k < (int)bytesoftype; k++) {
+      _mm256_storeu_si256((__m256i*)(dest_for_jth_element + (k * total_elements)), ymm0[k]);
+    }
+  }
+}
+
 /* Routine optimized for unshuffling a buffer for a type size of 2 bytes. */
 static void
 unshuffle2_avx2(uint8_t* const dest, const uint8_t* const src,
@@ -649,6 +743,122 @@ unshuffle16_tiled_avx2(uint8_t* const dest, const uint8_t* const src,
   }
 }
 
+/* Routine optimized for unshuffling a buffer for a type size of 3, 5, 6 or
+   7 bytes.  The rows of 16 elements are held in the same lane of
+   bytesoftype YMM registers, and every 16 bytes of the output are gathered
+   from them with one byte shuffle per row. */
+static void
+unshuffle_gather_avx2(uint8_t* const dest, const uint8_t* const src,
+  const size_t vectorizable_elements, const size_t total_elements, const size_t bytesoftype)
+{
+  size_t i;
+  int k, l, q;
+  uint8_t mask[16];
+  __m256i shmask[7][7], ymm0[7], ymm1;
+
+  /* shmask[l][k] picks the bytes of the l-th output vector found in row k */
+  for (l = 0; l < (int)bytesoftype; l++) {
+    for (k = 0; k < (int)bytesoftype; k++) {
+      for (q = 0; q < 16; q++) {
+        const int pos = l * 16 + q;
+        mask[q] = (uint8_t)((pos % (int)bytesoftype == k) ? pos / (int)bytesoftype : 0x80);
+      }
+      shmask[l][k] = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i*)mask));
+    }
+  }
+
+  for (i = 0; i < vectorizable_elements; i += sizeof(__m256i)) {
+    /* Load the rows of the 32 elements into YMM registers. */
+    const uint8_t* const src_for_ith_element = src + i;
+    for (k = 0; k < (int)bytesoftype; k++) {
+      ymm0[k] = _mm256_loadu_si256((__m256i*)(src_for_ith_element + (k * total_elements)));
+    }
+    /* Gather the elements; the low lanes hold i..i+15, the high ones i+16..i+31 */
+    for (l = 0; l < (int)bytesoftype; l++) {
+      ymm1 = _mm256_shuffle_epi8(ymm0[0], shmask[l][0]);
+      for (k = 1; k < (int)bytesoftype; k++) {
+        ymm1 = _mm256_or_si256(ymm1, _mm256_shuffle_epi8(ymm0[k], shmask[l][k]));
+      }
+      _mm256_storeu2_m128i(
+        (__m128i*)(dest + (i + 16) * bytesoftype + l * sizeof(__m128i)),
+        (__m128i*)(dest + i * bytesoftype + l * sizeof(__m128i)), ymm1);
+    }
+  }
+}
+
+/* Routine optimized for unshuffling a buffer for a type size smaller than
+   16 bytes which has no dedicated kernel.  The rows of the missing bytes
+   are zeroed and, after a 16x16 byte transpose in each lane, every element
+   is stored as 16 bytes, in increasing order, so that the extra bytes are
+   overwritten by the next element.  The caller must ensure that storing 16
+   bytes at the last element does not go past the end of the block, and
+   must overwrite the bytes after it. */
+static void
+unshuffle16_partial_avx2(uint8_t* const dest, const uint8_t* const src,
+  const size_t vectorizable_elements, const size_t total_elements, const size_t bytesoftype)
+{
+  static const int store_order[16] = {0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15};
+  size_t i;
+  int j;
+  __m256i ymm0[16], ymm1[16];
+
+  for (i = 0; i < vectorizable_elements; i += sizeof(__m256i)) {
+    /* Load the rows of the 32 elements into YMM registers. */
+    const uint8_t* const src_for_ith_element = src + i;
+    for (j = 0; j < (int)bytesoftype; j++) {
+      ymm0[j] = _mm256_loadu_si256((__m256i*)(src_for_ith_element + (j * total_elements)));
+    }
+    for (j = (int)bytesoftype; j < 16; j++) {
+      ymm0[j] = _mm256_setzero_si256();
+    }
+    /* Shuffle bytes */
+    for (j = 0; j < 8; j++) {
+      ymm1[j] = _mm256_unpacklo_epi8(ymm0[j*2], ymm0[j*2+1]);
+      ymm1[8+j] = _mm256_unpackhi_epi8(ymm0[j*2], ymm0[j*2+1]);
+    }
+    /* Shuffle 2-byte words */
+    for (j = 0; j < 8; j++) {
+      ymm0[j] = _mm256_unpacklo_epi16(ymm1[j*2], ymm1[j*2+1]);
+      ymm0[8+j] = _mm256_unpackhi_epi16(ymm1[j*2], ymm1[j*2+1]);
+    }
+    /* Shuffle 4-byte dwords */
+    for (j = 0; j < 8; j++) {
+      ymm1[j] = _mm256_unpacklo_epi32(ymm0[j*2], ymm0[j*2+1]);
+      ymm1[8+j] = _mm256_unpackhi_epi32(ymm0[j*2], ymm0[j*2+1]);
+    }
+    /* Shuffle 8-byte qwords */
+    for (j = 0; j < 8; j++) {
+      ymm0[j] = _mm256_unpacklo_epi64(ymm1[j*2], ymm1[j*2+1]);
+      ymm0[8+j] = _mm256_unpackhi_epi64(ymm1[j*2], ymm1[j*2+1]);
+    }
+    /* Store the elements in increasing order: first the low lanes... */
+    for (j = 0; j < 16; j++) {
+      _mm_storeu_si128((__m128i*)(dest + (i + j) * bytesoftype),
+                       _mm256_castsi256_si128(ymm0[store_order[j]]));
+    }
+    /* ...then the high ones */
+    for (j = 0; j < 16; j++) {
+      _mm_storeu_si128((__m128i*)(dest + (i + 16 + j) * bytesoftype),
+                       _mm256_extracti128_si256(ymm0[store_order[j]], 1));
+    }
+  }
+}
+
+/* Number of elements of a type size smaller than 16 bytes that the partial
+   kernels can process, reading or writing 16 bytes at every element without
+   going past the end of the block, as a multiple of the step of the loops. */
+static size_t
+partial_vectorizable_elements(const size_t bytesoftype, const size_t blocksize)
+{
+  size_t nelems;
+
+  if (blocksize < sizeof(__m128i)) {
+    return 0;
+  }
+  nelems = (blocksize - sizeof(__m128i)) / bytesoftype + 1;
+  return nelems - (nelems % sizeof(__m256i));
+}
+
 /* Shuffle a block.  This can never fail. */
 void
 blosc_internal_shuffle_avx2(const size_t bytesoftype, const size_t blocksize,
@@ -687,11 +897,24 @@ blosc_internal_shuffle_avx2(const size_t bytesoftype, const size_t blocksize,
   case 16:
     shuffle16_avx2(_dest, _src, vectorizable_elements, total_elements);
     break;
+  case 3:
+  case 5:
+  case 6:
+  case 7:
+    shuffle_gather_avx2(_dest, _src, vectorizable_elements, total_elements, bytesoftype);
+    break;
   default:
     /* For types larger than 16 bytes, use the AVX2 tiled shuffle. */
     if (bytesoftype > sizeof(__m128i)) {
       shuffle16_tiled_avx2(_dest, _src, vectorizable_elements, total_elements, bytesoftype);
     }
+    else if (bytesoftype > 1) {
+      /* The partial kernel needs a vectorizable region of its own */
+      const size_t partial_elements = partial_vectorizable_elements(bytesoftype, blocksize);
+      shuffle16_partial_avx2(_dest, _src, partial_elements, total_elements, bytesoftype);
+      shuffle_generic_inline(bytesoftype, partial_elements * bytesoftype, blocksize, _src, _dest);
+      return;
+    }
     else {
       /* Non-optimized shuffle */
       blosc_internal_shuffle_generic(bytesoftype, blocksize, _src, _dest);
@@ -747,11 +970,24 @@ blosc_internal_unshuffle_avx2(const size_t bytesoftype, const size_t blocksize,
   case 16:
     unshuffle16_avx2(_dest, _src, vectorizable_elements, total_elements);
     break;
+  case 3:
+  case 5:
+  case 6:
+  case 7:
+    unshuffle_gather_avx2(_dest, _src, vectorizable_elements, total_elements, bytesoftype);
+    break;
   default:
     /* For types larger than 16 bytes, use the AVX2 tiled unshuffle. */
     if (bytesoftype > sizeof(__m128i)) {
       unshuffle16_tiled_avx2(_dest, _src, vectorizable_elements, total_elements, bytesoftype);
     }
+    else if (bytesoftype > 1) {
+      /* The partial kernel needs a vectorizable region of its own */
+      const size_t partial_elements = partial_vectorizable_elements(bytesoftype, blocksize);
+      unshuffle16_partial_avx2(_dest, _src, partial_elements, total_elements, bytesoftype);
+      unshuffle_generic_inline(bytesoftype, partial_elements * bytesoftype, blocksize, _src, _dest);
+      return;
+    }
     else {
       /* Non-optimized unshuffle */
       blosc_internal_unshuffle_generic(bytesoftype, blocksize, _src, _dest);
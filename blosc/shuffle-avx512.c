@@ -0,0 +1,634 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "shuffle-generic.h"
+#include "shuffle-avx2.h"
+#include "shuffle-avx512.h"
+
+/* Define dummy functions if AVX512BW is not available for the compilation target and compiler. */
+#if !defined(__AVX512BW__)
+#include <stdlib.h>
+
+void
+blosc_internal_shuffle_avx512(const size_t bytesoftype, const size_t blocksize,
+                              const uint8_t* const _src, uint8_t* const _dest) {
+  abort();
+}
+
+void
+blosc_internal_unshuffle_avx512(const size_t bytesoftype, const size_t blocksize,
+                                const uint8_t* const _src, uint8_t* const _dest) {
+  abort();
+}
+
+#else /* defined(__AVX512BW__) */
+
+#include <immintrin.h>
+
+/* The kernels below work on 64 elements at a time.  Every 128-bit lane of
+   a ZMM register runs the same byte transpose as the SSE2 kernels, over
+   16 consecutive elements, so the only extra work is moving the 16-byte
+   pieces of the input between lanes before (or after) the transpose. */
+
+/* Transpose the 128-bit lanes of in[0], in[stride], in[2*stride] and
+   in[3*stride], so that lane i of out[k] is lane k of in[i*stride]. */
+static inline void
+transpose_lanes_avx512(const __m512i* const in, const int stride, __m512i* const out)
+{
+  const __m512i t0 = _mm512_shuffle_i64x2(in[0], in[stride], 0x44);
+  const __m512i t1 = _mm512_shuffle_i64x2(in[0], in[stride], 0xee);
+  const __m512i t2 = _mm512_shuffle_i64x2(in[2 * stride], in[3 * stride], 0x44);
+  const __m512i t3 = _mm512_shuffle_i64x2(in[2 * stride], in[3 * stride], 0xee);
+
+  out[0] = _mm512_shuffle_i64x2(t0, t2, 0x88);
+  out[1] = _mm512_shuffle_i64x2(t0, t2, 0xdd);
+  out[2] = _mm512_shuffle_i64x2(t1, t3, 0x88);
+  out[3] = _mm512_shuffle_i64x2(t1, t3, 0xdd);
+}
+
+/* Load four (possibly distant) 16-byte pieces into the lanes of a ZMM register. */
+static inline __m512i
+loadu4_m128i_avx512(const uint8_t* const p0, const uint8_t* const p1,
+                    const uint8_t* const p2, const uint8_t* const p3)
+{
+  __m512i zmm = _mm512_castsi128_si512(_mm_loadu_si128((const __m128i*)p0));
+  zmm = _mm512_inserti32x4(zmm, _mm_loadu_si128((const __m128i*)p1), 1);
+  zmm = _mm512_inserti32x4(zmm, _mm_loadu_si128((const __m128i*)p2), 2);
+  return _mm512_inserti32x4(zmm, _mm_loadu_si128((const __m128i*)p3), 3);
+}
+
+/* Store the lanes of a ZMM register into four (possibly distant) 16-byte pieces. */
+static inline void
+storeu4_m128i_avx512(uint8_t* const p0, uint8_t* const p1,
+                     uint8_t* const p2, uint8_t* const p3, const __m512i zmm)
+{
+  _mm_storeu_si128((__m128i*)p0, _mm512_castsi512_si128(zmm));
+  _mm_storeu_si128((__m128i*)p1, _mm512_extracti32x4_epi32(zmm, 1));
+  _mm_storeu_si128((__m128i*)p2, _mm512_extracti32x4_epi32(zmm, 2));
+  _mm_storeu_si128((__m128i*)p3, _mm512_extracti32x4_epi32(zmm, 3));
+}
+
+/* Gather the 16-byte pieces of 64 elements loaded in zmm0[0..bytesoftype-1]
+   so that lane i of zmm1[k] holds the k-th piece of elements 16i..16i+15. */
+static inline void
+gather_lanes_avx512(const __m512i* const zmm0, __m512i* const zmm1, const int bytesoftype)
+{
+  int g;
+
+  for (g = 0; g < bytesoftype / 4; g++) {
+    transpose_lanes_avx512(zmm0 + g, bytesoftype / 4, zmm1 + 4 * g);
+  }
+}
+
+/* Inverse of gather_lanes_avx512(), storing the 64 elements in `dest`. */
+static inline void
+scatter_lanes_avx512(const __m512i* const zmm1, uint8_t* const dest, const int bytesoftype)
+{
+  int g, k;
+  __m512i zmm0[4];
+
+  for (g = 0; g < bytesoftype / 4; g++) {
+    transpose_lanes_avx512(zmm1 + 4 * g, 1, zmm0);
+    for (k = 0; k < 4; k++) {
+      _mm512_storeu_si512((__m512i*)(dest + (g + k * (bytesoftype / 4)) * sizeof(__m512i)), zmm0[k]);
+    }
+  }
+}
+
+/* Routine optimized for shuffling a buffer for a type size of 2 bytes. */
+static void
+shuffle2_avx512(uint8_t* const dest, const uint8_t* const src,
+  const size_t vectorizable_elements, const size_t total_elements)
+{
+  static const size_t bytesoftype = 2;
+  size_t j;
+  int k;
+  __m512i zmm0[2], zmm1[2];
+
+  for (j = 0; j < vectorizable_elements; j += sizeof(__m512i)) {
+    /* Fetch 64 elements (128 bytes) and gather 16 elements per lane. */
+    for (k = 0; k < 2; k++) {
+      zmm0[k] = _mm512_loadu_si512((__m512i*)(src + (j * bytesoftype) + (k * sizeof(__m512i))));
+    }
+    zmm1[0] = _mm512_shuffle_i64x2(zmm0[0], zmm0[1], 0x88);
+    zmm1[1] = _mm512_shuffle_i64x2(zmm0[0], zmm0[1], 0xdd);
+    /* Transpose bytes, words and double words. */
+    for (k = 0; k < 2; k++) {
+      zmm0[k] = _mm512_shufflelo_epi16(zmm1[k], 0xd8);
+      zmm0[k] = _mm512_shufflehi_epi16(zmm0[k], 0xd8);
+      zmm0[k] = _mm512_shuffle_epi32(zmm0[k], (_MM_PERM_ENUM)0xd8);
+      zmm1[k] = _mm512_shuffle_epi32(zmm0[k], (_MM_PERM_ENUM)0x4e);
+      zmm0[k] = _mm512_unpacklo_epi8(zmm0[k], zmm1[k]);
+      zmm0[k] = _mm512_shuffle_epi32(zmm0[k], (_MM_PERM_ENUM)0xd8);
+      zmm1[k] = _mm512_shuffle_epi32(zmm0[k], (_MM_PERM_ENUM)0x4e);
+      zmm0[k] = _mm512_unpacklo_epi16(zmm0[k], zmm1[k]);
+      zmm0[k] = _mm512_shuffle_epi32(zmm0[k], (_MM_PERM_ENUM)0xd8);
+    }
+    /* Transpose quad words */
+    zmm1[0] = _mm512_unpacklo_epi64(zmm0[0], zmm0[1]);
+    zmm1[1] = _mm512_unpackhi_epi64(zmm0[0], zmm0[1]);
+    /* Store the result vectors */
+    uint8_t* const dest_for_jth_element = dest + j;
+    for (k = 0; k < 2; k++) {
+      _mm512_storeu_si512((__m512i*)(dest_for_jth_element + (k * total_elements)), zmm1[k]);
+    }
+  }
+}
+
+/* Routine optimized for shuffling a buffer for a type size of 4 bytes. */
+static void
+shuffle4_avx512(uint8_t* const dest, const uint8_t* const src,
+  const size_t vectorizable_elements, const size_t total_elements)
+{
+  static const size_t bytesoftype = 4;
+  size_t i;
+  int j;
+  __m512i zmm0[4], zmm1[4];
+
+  for (i = 0; i < vectorizable_elements; i += sizeof(__m512i)) {
+    /* Fetch 64 elements (256 bytes) and gather 16 elements per lane. */
+    for (j = 0; j < 4; j++) {
+      zmm1[j] = _mm512_loadu_si512((__m512i*)(src + (i * bytesoftype) + (j * sizeof(__m512i))));
+    }
+    gather_lanes_avx512(zmm1, zmm0, 4);
+    /* Transpose bytes and words. */
+    for (j = 0; j < 4; j++) {
+      zmm1[j] = _mm512_shuffle_epi32(zmm0[j], (_MM_PERM_ENUM)0xd8);
+      zmm0[j] = _mm512_shuffle_epi32(zmm0[j], (_MM_PERM_ENUM)0x8d);
+      zmm0[j] = _mm512_unpacklo_epi8(zmm1[j], zmm0[j]);
+      zmm1[j] = _mm512_shuffle_epi32(zmm0[j], (_MM_PERM_ENUM)0x04e);
+      zmm0[j] = _mm512_unpacklo_epi16(zmm0[j], zmm1[j]);
+    }
+    /* Transpose double words */
+    for (j = 0; j < 2; j++) {
+      zmm1[j*2] = _mm512_unpacklo_epi32(zmm0[j*2], zmm0[j*2+1]);
+      zmm1[j*2+1] = _mm512_unpackhi_epi32(zmm0[j*2], zmm0[j*2+1]);
+    }
+    /* Transpose quad words */
+    for (j = 0; j < 2; j++) {
+      zmm0[j*2] = _mm512_unpacklo_epi64(zmm1[j], zmm1[j+2]);
+      zmm0[j*2+1] = _mm512_unpackhi_epi64(zmm1[j], zmm1[j+2]);
+    }
+    /* Store the result vectors */
+    uint8_t* const dest_for_ith_element = dest + i;
+    for (j = 0; j < 4; j++) {
+      _mm512_storeu_si512((__m512i*)(dest_for_ith_element + (j * total_elements)), zmm0[j]);
+    }
+  }
+}
+
+/* Routine optimized for shuffling a buffer for a type size of 8 bytes. */
+static void
+shuffle8_avx512(uint8_t* const dest, const uint8_t* const src,
+  const size_t vectorizable_elements, const size_t total_elements)
+{
+  static const size_t bytesoftype = 8;
+  size_t j;
+  int k, l;
+  __m512i zmm0[8], zmm1[8];
+
+  for (j = 0; j < vectorizable_elements; j += sizeof(__m512i)) {
+    /* Fetch 64 elements (512 bytes) and gather 16 elements per lane. */
+    for (k = 0; k < 8; k++) {
+      zmm1[k] = _mm512_loadu_si512((__m512i*)(src + (j * bytesoftype) + (k * sizeof(__m512i))));
+    }
+    gather_lanes_avx512(zmm1, zmm0, 8);
+    /* Transpose bytes. */
+    for (k = 0; k < 8; k++) {
+      zmm1[k] = _mm512_shuffle_epi32(zmm0[k], (_MM_PERM_ENUM)0x4e);
+      zmm1[k] = _mm512_unpacklo_epi8(zmm0[k], zmm1[k]);
+    }
+    /* Transpose words */
+    for (k = 0, l = 0; k < 4; k++, l +=2) {
+      zmm0[k*2] = _mm512_unpacklo_epi16(zmm1[l], zmm1[l+1]);
+      zmm0[k*2+1] = _mm512_unpackhi_epi16(zmm1[l], zmm1[l+1]);
+    }
+    /* Transpose double words */
+    for (k = 0, l = 0; k < 4; k++, l++) {
+      if (k == 2) l += 2;
+      zmm1[k*2] = _mm512_unpacklo_epi32(zmm0[l], zmm0[l+2]);
+      zmm1[k*2+1] = _mm512_unpackhi_epi32(zmm0[l], zmm0[l+2]);
+    }
+    /* Transpose quad words */
+    for (k = 0; k < 4; k++) {
+      zmm0[k*2] = _mm512_unpacklo_epi64(zmm1[k], zmm1[k+4]);
+      zmm0[k*2+1] = _mm512_unpackhi_epi64(zmm1[k], zmm1[k+4]);
+    }
+    /* Store the result vectors */
+    uint8_t* const dest_for_jth_element = dest + j;
+    for (k = 0; k < 8; k++) {
+      _mm512_storeu_si512((__m512i*)(dest_for_jth_element + (k * total_elements)), zmm0[k]);
+    }
+  }
+}
+
+/* Transpose the bytes of 16 ZMM registers holding 16-byte pieces of 16
+   elements per lane (zmm0 is the input and the output). */
+static inline void
+transpose16_avx512(__m512i* const zmm0, __m512i* const zmm1)
+{
+  int k, l;
+
+  /* Transpose bytes */
+  for (k = 0, l = 0; k < 8; k++, l +=2) {
+    zmm1[k*2] = _mm512_unpacklo_epi8(zmm0[l], zmm0[l+1]);
+    zmm1[k*2+1] = _mm512_unpackhi_epi8(zmm0[l], zmm0[l+1]);
+  }
+  /* Transpose words */
+  for (k = 0, l = -2; k < 8; k++, l++) {
+    if ((k%2) == 0) l += 2;
+    zmm0[k*2] = _mm512_unpacklo_epi16(zmm1[l], zmm1[l+2]);
+    zmm0[k*2+1] = _mm512_unpackhi_epi16(zmm1[l], zmm1[l+2]);
+  }
+  /* Transpose double words */
+  for (k = 0, l = -4; k < 8; k++, l++) {
+    if ((k%4) == 0) l += 4;
+    zmm1[k*2] = _mm512_unpacklo_epi32(zmm0[l], zmm0[l+4]);
+    zmm1[k*2+1] = _mm512_unpackhi_epi32(zmm0[l], zmm0[l+4]);
+  }
+  /* Transpose quad words */
+  for (k = 0; k < 8; k++) {
+    zmm0[k*2] = _mm512_unpacklo_epi64(zmm1[k], zmm1[k+8]);
+    zmm0[k*2+1] = _mm512_unpackhi_epi64(zmm1[k], zmm1[k+8]);
+  }
+}
+
+/* Routine optimized for shuffling a buffer for a type size of 16 bytes. */
+static void
+shuffle16_avx512(uint8_t* const dest, const uint8_t* const src,
+  const size_t vectorizable_elements, const size_t total_elements)
+{
+  static const size_t bytesoftype = 16;
+  size_t j;
+  int k;
+  __m512i zmm0[16], zmm1[16];
+
+  for (j = 0; j < vectorizable_elements; j += sizeof(__m512i)) {
+    /* Fetch 64 elements (1024 bytes) and gather 16 elements per lane. */
+    for (k = 0; k < 16; k++) {
+      zmm1[k] = _mm512_loadu_si512((__m512i*)(src + (j * bytesoftype) + (k * sizeof(__m512i))));
+    }
+    gather_lanes_avx512(zmm1, zmm0, 16);
+    transpose16_avx512(zmm0, zmm1);
+    /* Store the result vectors */
+    uint8_t* const dest_for_jth_element = dest + j;
+    for (k = 0; k < 16; k++) {
+      _mm512_storeu_si512((__m512i*)(dest_for_jth_element + (k * total_elements)), zmm0[k]);
+    }
+  }
+}
+
+/* Routine optimized for shuffling a buffer for a type size larger than 16 bytes. */
+static void
+shuffle16_tiled_avx512(uint8_t* const dest, const uint8_t* const src,
+  const size_t vectorizable_elements, const size_t total_elements, const size_t bytesoftype)
+{
+  size_t j;
+  const size_t vecs_per_el_rem = bytesoftype % sizeof(__m128i);
+  int k;
+  __m512i zmm0[16], zmm1[16];
+
+  for (j = 0; j < vectorizable_elements; j += sizeof(__m512i)) {
+    /* Advance the offset into the type by the vector size (in bytes), unless this is
+    the initial iteration and the type size is not a multiple of the vector size.
+    In that case, only advance by the number of bytes necessary so that the number
+    of remaining bytes in the type will be a multiple of the vector size. */
+    size_t offset_into_type;
+    for (offset_into_type = 0; offset_into_type < bytesoftype;
+      offset_into_type += (offset_into_type == 0 && vecs_per_el_rem > 0 ? vecs_per_el_rem : sizeof(__m128i))) {
+
+      /* Fetch elements in groups of 1024 bytes, 16 elements per lane */
+      const uint8_t* const src_with_offset = src + offset_into_type;
+      for (k = 0; k < 16; k++) {
+        zmm0[k] = loadu4_m128i_avx512(
+          src_with_offset + (j + k) * bytesoftype,
+          src_with_offset + (j + 16 + k) * bytesoftype,
+          src_with_offset + (j + 32 + k) * bytesoftype,
+          src_with_offset + (j + 48 + k) * bytesoftype);
+      }
+      transpose16_avx512(zmm0, zmm1);
+      /* Store the result vectors */
+      uint8_t* const dest_for_jth_element = dest + j;
+      for (k = 0; k < 16; k++) {
+        _mm512_storeu_si512((__m512i*)(dest_for_jth_element + (total_elements * (offset_into_type + k))), zmm0[k]);
+      }
+    }
+  }
+}
+
+/* Routine optimized for unshuffling a buffer for a type size of 2 bytes. */
+static void
+unshuffle2_avx512(uint8_t* const dest, const uint8_t* const src,
+  const size_t vectorizable_elements, const size_t total_elements)
+{
+  static const size_t bytesoftype = 2;
+  size_t i;
+  int j;
+  __m512i zmm0[2], zmm1[2];
+
+  /* Indices of the quad words for interleaving the lanes of two registers */
+  const __m512i lo_lanes = _mm512_set_epi64(11, 10, 3, 2, 9, 8, 1, 0);
+  const __m512i hi_lanes = _mm512_set_epi64(15, 14, 7, 6, 13, 12, 5, 4);
+
+  for (i = 0; i < vectorizable_elements; i += sizeof(__m512i)) {
+    /* Load 64 elements (128 bytes) into 2 ZMM registers. */
+    const uint8_t* const src_for_ith_element = src + i;
+    for (j = 0; j < 2; j++) {
+      zmm0[j] = _mm512_loadu_si512((__m512i*)(src_for_ith_element + (j * total_elements)));
+    }
+    /* Shuffle bytes */
+    zmm1[0] = _mm512_unpacklo_epi8(zmm0[0], zmm0[1]);
+    zmm1[1] = _mm512_unpackhi_epi8(zmm0[0], zmm0[1]);
+    /* Put the lanes back in element order */
+    zmm0[0] = _mm512_permutex2var_epi64(zmm1[0], lo_lanes, zmm1[1]);
+    zmm0[1] = _mm512_permutex2var_epi64(zmm1[0], hi_lanes, zmm1[1]);
+    /* Store the result vectors */
+    _mm512_storeu_si512((__m512i*)(dest + (i * bytesoftype) + (0 * sizeof(__m512i))), zmm0[0]);
+    _mm512_storeu_si512((__m512i*)(dest + (i * bytesoftype) + (1 * sizeof(__m512i))), zmm0[1]);
+  }
+}
+
+/* Routine optimized for unshuffling a buffer for a type size of 4 bytes. */
+static void
+unshuffle4_avx512(uint8_t* const dest, const uint8_t* const src,
+  const size_t vectorizable_elements, const size_t total_elements)
+{
+  static const size_t bytesoftype = 4;
+  size_t i;
+  int j;
+  __m512i zmm0[4], zmm1[4];
+
+  for (i = 0; i < vectorizable_elements; i += sizeof(__m512i)) {
+    /* Load 64 elements (256 bytes) into 4 ZMM registers. */
+    const uint8_t* const src_for_ith_element = src + i;
+    for (j = 0; j < 4; j++) {
+      zmm0[j] = _mm512_loadu_si512((__m512i*)(src_for_ith_element + (j * total_elements)));
+    }
+    /* Shuffle bytes */
+    for (j = 0; j < 2; j++) {
+      zmm1[j] = _mm512_unpacklo_epi8(zmm0[j*2], zmm0[j*2+1]);
+      zmm1[2+j] = _mm512_unpackhi_epi8(zmm0[j*2], zmm0[j*2+1]);
+    }
+    /* Shuffle 2-byte words */
+    for (j = 0; j < 2; j++) {
+      zmm0[j] = _mm512_unpacklo_epi16(zmm1[j*2], zmm1[j*2+1]);
+      zmm0[2+j] = _mm512_unpackhi_epi16(zmm1[j*2], zmm1[j*2+1]);
+    }
+    /* Put the pieces in proper order and store them */
+    zmm1[0] = zmm0[0];
+    zmm1[1] = zmm0[2];
+    zmm1[2] = zmm0[1];
+    zmm1[3] = zmm0[3];
+    scatter_lanes_avx512(zmm1, dest + (i * bytesoftype), 4);
+  }
+}
+
+/* Routine optimized for unshuffling a buffer for a type size of 8 bytes. */
+static void
+unshuffle8_avx512(uint8_t* const dest, const uint8_t* const src,
+  const size_t vectorizable_elements, const size_t total_elements)
+{
+  static const size_t bytesoftype = 8;
+  size_t i;
+  int j;
+  __m512i zmm0[8], zmm1[8];
+
+  for (i = 0; i < vectorizable_elements; i += sizeof(__m512i)) {
+    /* Load 64 elements (512 bytes) into 8 ZMM registers. */
+    const uint8_t* const src_for_ith_element = src + i;
+    for (j = 0; j < 8; j++) {
+      zmm0[j] = _mm512_loadu_si512((__m512i*)(src_for_ith_element + (j * total_elements)));
+    }
+    /* Shuffle bytes */
+    for (j = 0; j < 4; j++) {
+      zmm1[j] = _mm512_unpacklo_epi8(zmm0[j*2], zmm0[j*2+1]);
+      zmm1[4+j] = _mm512_unpackhi_epi8(zmm0[j*2], zmm0[j*2+1]);
+    }
+    /* Shuffle 2-byte words */
+    for (j = 0; j < 4; j++) {
+      zmm0[j] = _mm512_unpacklo_epi16(zmm1[j*2], zmm1[j*2+1]);
+      zmm0[4+j] = _mm512_unpackhi_epi16(zmm1[j*2], zmm1[j*2+1]);
+    }
+    /* Shuffle 4-byte dwords */
+    for (j = 0; j < 4; j++) {
+      zmm1[j] = _mm512_unpacklo_epi32(zmm0[j*2], zmm0[j*2+1]);
+      zmm1[4+j] = _mm512_unpackhi_epi32(zmm0[j*2], zmm0[j*2+1]);
+    }
+    /* Put the pieces in proper order and store them */
+    zmm0[0] = zmm1[0];
+    zmm0[1] = zmm1[4];
+    zmm0[2] = zmm1[2];
+    zmm0[3] = zmm1[6];
+    zmm0[4] = zmm1[1];
+    zmm0[5] = zmm1[5];
+    zmm0[6] = zmm1[3];
+    zmm0[7] = zmm1[7];
+    scatter_lanes_avx512(zmm0, dest + (i * bytesoftype), 8);
+  }
+}
+
+/* Untranspose the bytes of 16 ZMM registers, each holding the same byte of
+   16 elements per lane (zmm1 is the input and the output).  The 16-byte
+   piece of the k-th element of every lane ends up in zmm1[unshuffle16_order[k]]. */
+static const int unshuffle16_order[16] = {0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15};
+
+static inline void
+untranspose16_avx512(__m512i* const zmm1, __m512i* const zmm2)
+{
+  int j;
+
+  /* Shuffle bytes */
+  for (j = 0; j < 8; j++) {
+    zmm2[j] = _mm512_unpacklo_epi8(zmm1[j*2], zmm1[j*2+1]);
+    zmm2[8+j] = _mm512_unpackhi_epi8(zmm1[j*2], zmm1[j*2+1]);
+  }
+  /* Shuffle 2-byte words */
+  for (j = 0; j < 8; j++) {
+    zmm1[j] = _mm512_unpacklo_epi16(zmm2[j*2], zmm2[j*2+1]);
+    zmm1[8+j] = _mm512_unpackhi_epi16(zmm2[j*2], zmm2[j*2+1]);
+  }
+  /* Shuffle 4-byte dwords */
+  for (j = 0; j < 8; j++) {
+    zmm2[j] = _mm512_unpacklo_epi32(zmm1[j*2], zmm1[j*2+1]);
+    zmm2[8+j] = _mm512_unpackhi_epi32(zmm1[j*2], zmm1[j*2+1]);
+  }
+  /* Shuffle 8-byte qwords */
+  for (j = 0; j < 8; j++) {
+    zmm1[j] = _mm512_unpacklo_epi64(zmm2[j*2], zmm2[j*2+1]);
+    zmm1[8+j] = _mm512_unpackhi_epi64(zmm2[j*2], zmm2[j*2+1]);
+  }
+}
+
+/* Routine optimized for unshuffling a buffer for a type size of 16 bytes. */
+static void
+unshuffle16_avx512(uint8_t* const dest, const uint8_t* const src,
+  const size_t vectorizable_elements, const size_t total_elements)
+{
+  static const size_t bytesoftype = 16;
+  size_t i;
+  int j;
+  __m512i zmm1[16], zmm2[16];
+
+  for (i = 0; i < vectorizable_elements; i += sizeof(__m512i)) {
+    /* Load 64 elements (1024 bytes) into 16 ZMM registers. */
+    const uint8_t* const src_for_ith_element = src + i;
+    for (j = 0; j < 16; j++) {
+      zmm1[j] = _mm512_loadu_si512((__m512i*)(src_for_ith_element + (j * total_elements)));
+    }
+    untranspose16_avx512(zmm1, zmm2);
+    /* Put the pieces in proper order and store them */
+    for (j = 0; j < 16; j++) {
+      zmm2[j] = zmm1[unshuffle16_order[j]];
+    }
+    scatter_lanes_avx512(zmm2, dest + (i * bytesoftype), 16);
+  }
+}
+
+/* Routine optimized for unshuffling a buffer for a type size larger than 16 bytes. */
+static void
+unshuffle16_tiled_avx512(uint8_t* const dest, const uint8_t* const orig,
+  const size_t vectorizable_elements, const size_t total_elements, const size_t bytesoftype)
+{
+  size_t i;
+  const size_t vecs_per_el_rem = bytesoftype % sizeof(__m128i);
+  int j;
+  __m512i zmm1[16], zmm2[16];
+
+  /* The unshuffle loops are inverted (compared to shuffle16_tiled_avx512)
+     to optimize cache utilization. */
+  size_t offset_into_type;
+  for (offset_into_type = 0; offset_into_type < bytesoftype;
+    offset_into_type += (offset_into_type == 0 && vecs_per_el_rem > 0 ? vecs_per_el_rem : sizeof(__m128i))) {
+    for (i = 0; i < vectorizable_elements; i += sizeof(__m512i)) {
+      /* Load the next 64 bytes of 16 rows in 16 ZMM registers */
+      const uint8_t* const src_for_ith_element = orig + i;
+      for (j = 0; j < 16; j++) {
+        zmm1[j] = _mm512_loadu_si512((__m512i*)(src_for_ith_element + (total_elements * (offset_into_type + j))));
+      }
+      untranspose16_avx512(zmm1, zmm2);
+      /* Store the result vectors in proper order */
+      uint8_t* const dest_with_offset = dest + offset_into_type;
+      for (j = 0; j < 16; j++) {
+        storeu4_m128i_avx512(
+          dest_with_offset + (i + j) * bytesoftype,
+          dest_with_offset + (i + 16 + j) * bytesoftype,
+          dest_with_offset + (i + 32 + j) * bytesoftype,
+          dest_with_offset + (i + 48 + j) * bytesoftype,
+          zmm1[unshuffle16_order[j]]);
+      }
+    }
+  }
+}
+
+/* Shuffle a block.  This can never fail. */
+void
+blosc_internal_shuffle_avx512(const size_t bytesoftype, const size_t blocksize,
+                              const uint8_t* const _src, uint8_t* const _dest) {
+  const size_t vectorized_chunk_size = bytesoftype * sizeof(__m512i);
+
+  /* If the block size is too small to be vectorized with ZMM registers,
+     or there is no AVX512 kernel for this type size, use the AVX2
+     implementation (AVX512BW processors always have AVX2). */
+  if (blocksize < vectorized_chunk_size ||
+      (bytesoftype != 2 && bytesoftype != 4 && bytesoftype != 8 &&
+       bytesoftype < sizeof(__m128i))) {
+    blosc_internal_shuffle_avx2(bytesoftype, blocksize, _src, _dest);
+    return;
+  }
+
+  /* If the blocksize is not a multiple of both the typesize and
+     the vector size, round the blocksize down to the next value
+     which is a multiple of both. The vectorized shuffle can be
+     used for that portion of the data, and the naive implementation
+     can be used for the remaining portion. */
+  const size_t vectorizable_bytes = blocksize - (blocksize % vectorized_chunk_size);
+
+  const size_t vectorizable_elements = vectorizable_bytes / bytesoftype;
+  const size_t total_elements = blocksize / bytesoftype;
+
+  /* Optimized shuffle implementations */
+  switch (bytesoftype)
+  {
+  case 2:
+    shuffle2_avx512(_dest, _src, vectorizable_elements, total_elements);
+    break;
+  case 4:
+    shuffle4_avx512(_dest, _src, vectorizable_elements, total_elements);
+    break;
+  case 8:
+    shuffle8_avx512(_dest, _src, vectorizable_elements, total_elements);
+    break;
+  case 16:
+    shuffle16_avx512(_dest, _src, vectorizable_elements, total_elements);
+    break;
+  default:
+    /* For types larger than 16 bytes, use the AVX512 tiled shuffle. */
+    shuffle16_tiled_avx512(_dest, _src, vectorizable_elements, total_elements, bytesoftype);
+  }
+
+  /* If the buffer had any bytes at the end which couldn't be handled
+     by the vectorized implementations, use the non-optimized version
+     to finish them up. */
+  if (vectorizable_bytes < blocksize) {
+    shuffle_generic_inline(bytesoftype, vectorizable_bytes, blocksize, _src, _dest);
+  }
+}
+
+/* Unshuffle a block.  This can never fail. */
+void
+blosc_internal_unshuffle_avx512(const size_t bytesoftype, const size_t blocksize,
+                                const uint8_t* const _src, uint8_t* const _dest) {
+  const size_t vectorized_chunk_size = bytesoftype * sizeof(__m512i);
+
+  /* If the block size is too small to be vectorized with ZMM registers,
+     or there is no AVX512 kernel for this type size, use the AVX2
+     implementation (AVX512BW processors always have AVX2). */
+  if (blocksize < vectorized_chunk_size ||
+      (bytesoftype != 2 && bytesoftype != 4 && bytesoftype != 8 &&
+       bytesoftype < sizeof(__m128i))) {
+    blosc_internal_unshuffle_avx2(bytesoftype, blocksize, _src, _dest);
+    return;
+  }
+
+  /* If the blocksize is not a multiple of both the typesize and
+     the vector size, round the blocksize down to the next value
+     which is a multiple of both. The vectorized unshuffle can be
+     used for that portion of the data, and the naive implementation
+     can be used for the remaining portion. */
+  const size_t vectorizable_bytes = blocksize - (blocksize % vectorized_chunk_size);
+
+  const size_t vectorizable_elements = vectorizable_bytes / bytesoftype;
+  const size_t total_elements = blocksize / bytesoftype;
+
+  /* Optimized unshuffle implementations */
+  switch (bytesoftype)
+  {
+  case 2:
+    unshuffle2_avx512(_dest, _src, vectorizable_elements, total_elements);
+    break;
+  case 4:
+    unshuffle4_avx512(_dest, _src, vectorizable_elements, total_elements);
+    break;
+  case 8:
+    unshuffle8_avx512(_dest, _src, vectorizable_elements, total_elements);
+    break;
+  case 16:
+    unshuffle16_avx512(_dest, _src, vectorizable_elements, total_elements);
+    break;
+  default:
+    /* For types larger than 16 bytes, use the AVX512 tiled unshuffle. */
+    unshuffle16_tiled_avx512(_dest, _src, vectorizable_elements, total_elements, bytesoftype);
+  }
+
+  /* If the buffer had any bytes at the end which couldn't be handled
+     by the vectorized implementations, use the non-optimized version
+     to finish them up. */
+  if (vectorizable_bytes < blocksize) {
+    unshuffle_generic_inline(bytesoftype, vectorizable_bytes, blocksize, _src, _dest);
+  }
+}
+
+#endif /* !defined(__AVX512BW__) */
@@ -0,0 +1,34 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* AVX512BW-accelerated shuffle/unshuffle routines. */
+
+#ifndef SHUFFLE_AVX512_H
+#define SHUFFLE_AVX512_H
+
+#include "blosc-common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+  AVX512BW-accelerated shuffle routine.
+*/
+BLOSC_NO_EXPORT void blosc_internal_shuffle_avx512(const size_t bytesoftype, const size_t blocksize,
+                                                   const uint8_t* const _src, uint8_t* const _dest);
+
+/**
+  AVX512BW-accelerated unshuffle routine.
+*/
+BLOSC_NO_EXPORT void blosc_internal_unshuffle_avx512(const size_t bytesoftype, const size_t blocksize,
+                                                     const uint8_t* const _src, uint8_t* const _dest);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SHUFFLE_AVX512_H */
@@ -269,6 +269,56 @@ shuffle16_tiled_sse2(uint8_t* const dest, const uint8_t* const src,
   }
 }
 
+/* Routine optimized for shuffling a buffer for a type size smaller than 16
+   bytes which has no dedicated kernel (3, 5, 6, 7, 9...).  Every element is
+   loaded along with the first bytes of the next ones and, after the same
+   transpose as in shuffle16_sse2, only the rows for the bytes of the type
+   are stored.  The caller must ensure that reading 16 bytes at the last
+   element does not go past the end of the block. */
+static void
+shuffle16_partial_sse2(uint8_t* const dest, const uint8_t* const src,
+  const size_t vectorizable_elements, const size_t total_elements, const size_t bytesoftype)
+{
+  size_t j;
+  int k, l;
+  uint8_t* dest_for_jth_element;
+  __m128i xmm0[16], xmm1[16];
+
+  for (j = 0; j < vectorizable_elements; j += sizeof(__m128i)) {
+    /* Fetch 16 bytes starting at each of the next 16 elements */
+    for (k = 0; k < 16; k++) {
+      xmm0[k] = _mm_loadu_si128((__m128i*)(src + (j + k) * bytesoftype));
+    }
+    /* Transpose bytes */
+    for (k = 0, l = 0; k < 8; k++, l +=2) {
+      xmm1[k*2] = _mm_unpacklo_epi8(xmm0[l], xmm0[l+1]);
+      xmm1[k*2+1] = _mm_unpackhi_epi8(xmm0[l], xmm0[l+1]);
+    }
+    /* Transpose words */
+    for (k = 0, l = -2; k < 8; k++, l++) {
+      if ((k%2) == 0) l += 2;
+      xmm0[k*2] = _mm_unpacklo_epi16(xmm1[l], xmm1[l+2]);
+      xmm0[k*2+1] = _mm_unpackhi_epi16(xmm1[l], xmm1[l+2]);
+    }
+    /* Transpose double words */
+    for (k = 0, l = -4; k < 8; k++, l++) {
+      if ((k%4) == 0) l += 4;
+      xmm1[k*2] = _mm_unpacklo_epi32(xmm0[l], xmm0[l+4]);
+      xmm1[k*2+1] = _mm_unpackhi_epi32(xmm0[l], xmm0[l+4]);
+    }
+    /* Transpose quad words */
+    for (k = 0; k < 8; k++) {
+      xmm0[k*2] = _mm_unpacklo_epi64(xmm1[k], xmm1[k+8]);
+      xmm0[k*2+1] = _mm_unpackhi_epi64(xmm1[k], xmm1[k+8]);
+    }
+    /* Store the result vectors holding actual bytes of the type */
+    dest_for_jth_element = dest + j;
+    for (k = 0; k < (int)bytesoftype; k++) {
+      _mm_storeu_si128((__m128i*)(dest_for_jth_element + (k * total_elements)), xmm0[k]);
+    }
+  }
+}
+
 /* Routine optimized for unshuffling a buffer for a type size of 2 bytes. */
 static void
 unshuffle2_sse2(uint8_t* const dest, const uint8_t* const src,
@@ -522,6 +572,73 @@ unshuffle16_tiled_sse2(uint8_t* const dest, const uint8_t* const orig,
   }
 }
 
+/* Routine optimized for unshuffling a buffer for a type size smaller than
+   16 bytes which has no dedicated kernel.  The rows of the missing bytes
+   are zeroed and, after the same transpose as in unshuffle16_sse2, every
+   element is stored as 16 bytes, in increasing order, so that the extra
+   bytes are overwritten by the next element.  The caller must ensure that
+   storing 16 bytes at the last element does not go past the end of the
+   block, and must overwrite the bytes after it. */
+static void
+unshuffle16_partial_sse2(uint8_t* const dest, const uint8_t* const src,
+  const size_t vectorizable_elements, const size_t total_elements, const size_t bytesoftype)
+{
+  static const int store_order[16] = {0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15};
+  size_t i;
+  int j;
+  __m128i xmm1[16], xmm2[16];
+
+  for (i = 0; i < vectorizable_elements; i += sizeof(__m128i)) {
+    /* Load the rows of the 16 elements into XMM registers. */
+    const uint8_t* const src_for_ith_element = src + i;
+    for (j = 0; j < (int)bytesoftype; j++) {
+      xmm1[j] = _mm_loadu_si128((__m128i*)(src_for_ith_element + (j * total_elements)));
+    }
+    for (j = (int)bytesoftype; j < 16; j++) {
+      xmm1[j] = _mm_setzero_si128();
+    }
+    /* Shuffle bytes */
+    for (j = 0; j < 8; j++) {
+      xmm2[j] = _mm_unpacklo_epi8(xmm1[j*2], xmm1[j*2+1]);
+      xmm2[8+j] = _mm_unpackhi_epi8(xmm1[j*2], xmm1[j*2+1]);
+    }
+    /* Shuffle 2-byte words */
+    for (j = 0; j < 8; j++) {
+      xmm1[j] = _mm_unpacklo_epi16(xmm2[j*2], xmm2[j*2+1]);
+      xmm1[8+j] = _mm_unpackhi_epi16(xmm2[j*2], xmm2[j*2+1]);
+    }
+    /* Shuffle 4-byte dwords */
+    for (j = 0; j < 8; j++) {
+      xmm2[j] = _mm_unpacklo_epi32(xmm1[j*2], xmm1[j*2+1]);
+      xmm2[8+j] = _mm_unpackhi_epi32(xmm1[j*2], xmm1[j*2+1]);
+    }
+    /* Shuffle 8-byte qwords */
+    for (j = 0; j < 8; j++) {
+      xmm1[j] = _mm_unpacklo_epi64(xmm2[j*2], xmm2[j*2+1]);
+      xmm1[8+j] = _mm_unpackhi_epi64(xmm2[j*2], xmm2[j*2+1]);
+    }
+    /* Store the elements in increasing order */
+    for (j = 0; j < 16; j++) {
+      _mm_storeu_si128((__m128i*)(dest + (i + j) * bytesoftype), xmm1[store_order[j]]);
+    }
+  }
+}
+
+/* Number of elements of a type size smaller than 16 bytes that the partial
+   kernels can process, reading or writing 16 bytes at every element without
+   going past the end of the block, as a multiple of the step of the loops. */
+static size_t
+partial_vectorizable_elements(const size_t bytesoftype, const size_t blocksize)
+{
+  size_t nelems;
+
+  if (blocksize < sizeof(__m128i)) {
+    return 0;
+  }
+  nelems = (blocksize - sizeof(__m128i)) / bytesoftype + 1;
+  return nelems - (nelems % sizeof(__m128i));
+}
+
 /* Shuffle a block.  This can never fail. */
 void
 blosc_internal_shuffle_sse2(const size_t bytesoftype, const size_t blocksize,
@@ -562,6 +679,13 @@ blosc_internal_shuffle_sse2(const size_t bytesoftype, const size_t blocksize,
     if (bytesoftype > sizeof(__m128i)) {
       shuffle16_tiled_sse2(_dest, _src, vectorizable_elements, total_elements, bytesoftype);
     }
+    else if (bytesoftype > 1) {
+      /* The partial kernel needs a vectorizable region of its own */
+      const size_t partial_elements = partial_vectorizable_elements(bytesoftype, blocksize);
+      shuffle16_partial_sse2(_dest, _src, partial_elements, total_elements, bytesoftype);
+      shuffle_generic_inline(bytesoftype, partial_elements * bytesoftype, blocksize, _src, _dest);
+      return;
+    }
     else {
       /* Non-optimized shuffle */
       blosc_internal_shuffle_generic(bytesoftype, blocksize, _src, _dest);
@@ -620,6 +744,13 @@ blosc_internal_unshuffle_sse2(const size_t bytesoftype, const size_t blocksize,
     if (bytesoftype > sizeof(__m128i)) {
       unshuffle16_tiled_sse2(_dest, _src, vectorizable_elements, total_elements, bytesoftype);
     }
+    else if (bytesoftype > 1) {
+      /* The partial kernel needs a vectorizable region of its own */
+      const size_t partial_elements = partial_vectorizable_elements(bytesoftype, blocksize);
+      unshuffle16_partial_sse2(_dest, _src, partial_elements, total_elements, bytesoftype);
+      unshuffle_generic_inline(bytesoftype, partial_elements * bytesoftype, blocksize, _src, _dest);
+      return;
+    }
     else {
       /* Non-optimized unshuffle */
       blosc_internal_unshuffle_generic(bytesoftype, blocksize, _src, _dest);
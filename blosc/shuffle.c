@@ -16,8 +16,13 @@
 
 #if defined(_WIN32)
 #include "win32/pthread.h"
+#include <windows.h>
 #else
 #include <pthread.h>
+#include <unistd.h>
+#endif
+#if defined(__APPLE__)
+#include <sys/sysctl.h>
 #endif
 
 #if !defined(__clang__) && defined(__GNUC__) && defined(__GNUC_MINOR__) && \
@@ -29,6 +34,11 @@
 /*  Include hardware-accelerated shuffle/unshuffle routines based on
     the target architecture. Note that a target architecture may support
     more than one type of acceleration!*/
+#if defined(SHUFFLE_AVX512_ENABLED)
+  #include "shuffle-avx512.h"
+  #include "bitshuffle-avx512.h"
+#endif  /* defined(SHUFFLE_AVX512_ENABLED) */
+
 #if defined(SHUFFLE_AVX2_ENABLED)
   #include "shuffle-avx2.h"
   #include "bitshuffle-avx2.h"
@@ -60,17 +70,12 @@ typedef struct shuffle_implementation {
   bitunshuffle_func bitunshuffle;
 } shuffle_implementation_t;
 
-typedef enum {
-  BLOSC_HAVE_NOTHING = 0,
-  BLOSC_HAVE_SSE2 = 1,
-  BLOSC_HAVE_AVX2 = 2
-} blosc_cpu_features;
-
 /*  Detect hardware and set function pointers to the best shuffle/unshuffle
     implementations supported by the host processor for Intel/i686
      */
 #if (defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)) \
-    && (defined(SHUFFLE_AVX2_ENABLED) || defined(SHUFFLE_SSE2_ENABLED))
+    && (defined(SHUFFLE_AVX512_ENABLED) || defined(SHUFFLE_AVX2_ENABLED) || \
+        defined(SHUFFLE_SSE2_ENABLED))
 
 /*  Disabled the __builtin_cpu_supports() call, as it has issues with
     new versions of gcc (like 5.3.1 in forthcoming ubuntu/xenial:
@@ -250,8 +255,9 @@ static blosc_cpu_features blosc_get_cpu_features(void) {
     ymm_state_enabled = (xcr0_contents & (1UL << 2)) != 0;
 
     /*  Require support for both the upper 256-bits of zmm0-zmm15 to be
-        restored as well as all of zmm16-zmm31 and the opmask registers. */
-    zmm_state_enabled = (xcr0_contents & 0x70) == 0x70;
+        restored as well as all of zmm16-zmm31 and the opmask registers
+        (bits 5 to 7 of XCR0). */
+    zmm_state_enabled = (xcr0_contents & 0xe0) == 0xe0;
   }
 #endif /* defined(_XCR_XFEATURE_ENABLED_MASK) */
 
@@ -281,6 +287,13 @@ static blosc_cpu_features blosc_get_cpu_features(void) {
   if (xmm_state_enabled && ymm_state_enabled && avx2_available) {
     result |= BLOSC_HAVE_AVX2;
   }
+  if (xmm_state_enabled && ymm_state_enabled && zmm_state_enabled &&
+      avx512bw_available) {
+    result |= BLOSC_HAVE_AVX512BW;
+  }
+  if (sse42_available) {
+    result |= BLOSC_HAVE_SSE42;
+  }
   return result;
 }
 #endif
@@ -298,10 +311,70 @@ static blosc_cpu_features blosc_get_cpu_features(void) {
 
 #endif
 
-static shuffle_implementation_t get_shuffle_implementation(void) {
-  blosc_cpu_features cpu_features = blosc_get_cpu_features();
+/*  Size in bytes of the last level cache of the host processor, or 0 if it
+    cannot be determined. */
+static size_t blosc_get_llc_size(void) {
+#if defined(_WIN32)
+  SYSTEM_LOGICAL_PROCESSOR_INFORMATION* info;
+  DWORD len = 0;
+  DWORD i, n;
+  size_t size = 0;
+  int level = 0;
+
+  GetLogicalProcessorInformation(NULL, &len);
+  info = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION*)malloc(len);
+  if (info == NULL) {
+    return 0;
+  }
+  if (GetLogicalProcessorInformation(info, &len)) {
+    n = len / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION);
+    for (i = 0; i < n; i++) {
+      if (info[i].Relationship == RelationCache &&
+          info[i].Cache.Level >= level) {
+        level = info[i].Cache.Level;
+        size = info[i].Cache.Size;
+      }
+    }
+  }
+  free(info);
+  return size;
+#elif defined(__APPLE__)
+  uint64_t size = 0;
+  size_t len = sizeof(size);
+  if (sysctlbyname("hw.l3cachesize", &size, &len, NULL, 0) != 0 || size == 0) {
+    len = sizeof(size);
+    if (sysctlbyname("hw.l2cachesize", &size, &len, NULL, 0) != 0) {
+      size = 0;
+    }
+  }
+  return (size_t)size;
+#elif defined(_SC_LEVEL3_CACHE_SIZE) && defined(_SC_LEVEL2_CACHE_SIZE)
+  long size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+  if (size <= 0) {
+    size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+  }
+  return (size > 0) ? (size_t)size : 0;
+#else
+  return 0;
+#endif
+}
+
+static shuffle_implementation_t
+get_shuffle_implementation(blosc_cpu_features cpu_features) {
   shuffle_implementation_t impl_generic;
 
+#if defined(SHUFFLE_AVX512_ENABLED)
+  if (cpu_features & BLOSC_HAVE_AVX512BW) {
+    shuffle_implementation_t impl_avx512;
+    impl_avx512.name = "avx512";
+    impl_avx512.shuffle = (shuffle_func)blosc_internal_shuffle_avx512;
+    impl_avx512.unshuffle = (unshuffle_func)blosc_internal_unshuffle_avx512;
+    impl_avx512.bitshuffle = (bitshuffle_func)blosc_internal_bshuf_trans_bit_elem_avx512;
+    impl_avx512.bitunshuffle = (bitunshuffle_func)blosc_internal_bshuf_untrans_bit_elem_avx512;
+    return impl_avx512;
+  }
+#endif  /* defined(SHUFFLE_AVX512_ENABLED) */
+
 #if defined(SHUFFLE_AVX2_ENABLED)
   if (cpu_features & BLOSC_HAVE_AVX2) {
     shuffle_implementation_t impl_avx2;
@@ -344,8 +417,14 @@ static pthread_once_t implementation_initialized = PTHREAD_ONCE_INIT;
     This is only safe to use once `implementation_initialized` is set. */
 static shuffle_implementation_t host_implementation;
 
+/*  The features of the host processor, detected along with the above. */
+static blosc_cpu_features host_cpu_features;
+static size_t host_llc_size;
+
 static void set_host_implementation(void) {
-  host_implementation = get_shuffle_implementation();
+  host_cpu_features = blosc_get_cpu_features();
+  host_llc_size = blosc_get_llc_size();
+  host_implementation = get_shuffle_implementation(host_cpu_features);
 }
 
 /*  Initialize the shuffle implementation, if necessary. */
@@ -362,6 +441,20 @@ void init_shuffle_implementation(void) {
   pthread_once(&implementation_initialized, &set_host_implementation);
 }
 
+/*  Features of the host processor, for other hardware-accelerated routines. */
+int
+blosc_internal_cpu_features(void) {
+  init_shuffle_implementation();
+  return (int)host_cpu_features;
+}
+
+/*  Size of the last level cache of the host processor. */
+size_t
+blosc_internal_llc_size(void) {
+  init_shuffle_implementation();
+  return host_llc_size;
+}
+
 /*  Shuffle a block by dynamically dispatching to the appropriate
     hardware-accelerated routine at run-time. */
 void
@@ -21,6 +21,27 @@
 extern "C" {
 #endif
 
+/* Hardware features of the host processor (a bit mask of them). */
+typedef enum {
+  BLOSC_HAVE_NOTHING = 0,
+  BLOSC_HAVE_SSE2 = 1,
+  BLOSC_HAVE_AVX2 = 2,
+  BLOSC_HAVE_SSE42 = 4,
+  BLOSC_HAVE_AVX512BW = 8
+} blosc_cpu_features;
+
+/**
+  Return the features of the host processor as a mask of the above.
+  The detection is only done once.
+*/
+BLOSC_NO_EXPORT int blosc_internal_cpu_features(void);
+
+/**
+  Return the size in bytes of the last level cache of the host processor,
+  or 0 if it cannot be determined.  The detection is only done once.
+*/
+BLOSC_NO_EXPORT size_t blosc_internal_llc_size(void);
+
 /**
   Primary shuffle and bitshuffle routines.
   This function dynamically dispatches to the appropriate hardware-accelerated
@@ -0,0 +1,496 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Streaming compression and decompression: data is pushed in pieces of
+  any size and chunks are handed to a sink callback as they are ready.
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "blosc.h"
+#include "blosc-common.h"
+
+#if defined(_WIN32)
+  #include "win32/pthread.h"
+#else
+  #include <pthread.h>
+#endif
+
+
+/* Default size of the chunks of a compression stream */
+#define STREAM_DEFAULT_CHUNKSIZE (4 * 1024 * 1024)
+
+
+/* A compression stream fills one buffer while the previous one is
+   compressed and handed to the sink by a background thread */
+struct blosc_cstream {
+  int clevel;
+  int doshuffle;
+  size_t typesize;
+  const char* compname;
+  int numthreads;
+  size_t chunksize;               /* Uncompressed size of the chunks */
+  blosc_stream_sink sink;
+  void* user_data;
+  uint8_t* bufs[2];               /* Buffers for the uncompressed chunks */
+  int current;                    /* Buffer being filled */
+  size_t filled;                  /* Bytes in the buffer being filled */
+  uint8_t* cdest;                 /* Buffer for the compressed chunks */
+  pthread_t worker;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  int busy;                       /* Whether the worker has a chunk */
+  int pending;                    /* Buffer handed to the worker */
+  size_t pending_size;            /* Bytes in the buffer handed to the worker */
+  int stop;                       /* Whether the worker has to finish */
+  int error;                      /* First error found, or 0 */
+};
+
+
+/* Compress the chunks submitted to a stream and pass them to the sink */
+static void* cstream_worker(void* arg)
+{
+  blosc_cstream* cs = (blosc_cstream*)arg;
+  const uint8_t* buf;
+  size_t size;
+  int cbytes, rc;
+
+  while (1) {
+    pthread_mutex_lock(&cs->mutex);
+    while (!cs->busy && !cs->stop) {
+      pthread_cond_wait(&cs->cond, &cs->mutex);
+    }
+    if (!cs->busy) {
+      pthread_mutex_unlock(&cs->mutex);
+      break;
+    }
+    buf = cs->bufs[cs->pending];
+    size = cs->pending_size;
+    pthread_mutex_unlock(&cs->mutex);
+
+    cbytes = blosc_compress_ctx(cs->clevel, cs->doshuffle, cs->typesize, size,
+                                buf, cs->cdest,
+                                size + BLOSC_MAX_OVERHEAD_CHECKSUMS(size),
+                                cs->compname, 0, cs->numthreads);
+    if (cbytes <= 0) {
+      rc = (cbytes < 0) ? cbytes : -1;
+    }
+    else {
+      rc = cs->sink(cs->cdest, (size_t)cbytes, cs->user_data);
+    }
+
+    pthread_mutex_lock(&cs->mutex);
+    if (rc < 0 && cs->error == 0) {
+      cs->error = rc;
+    }
+    cs->busy = 0;
+    pthread_cond_broadcast(&cs->cond);
+    pthread_mutex_unlock(&cs->mutex);
+  }
+  return NULL;
+}
+
+blosc_cstream* blosc_cstream_new(int clevel, int doshuffle, size_t typesize,
+                                 const char* compressor, size_t chunksize,
+                                 int numinternalthreads,
+                                 blosc_stream_sink sink, void* user_data)
+{
+  blosc_cstream* cs;
+  int compcode = blosc_compname_to_compcode(compressor);
+
+  if (clevel < 0 || clevel > 9) {
+    fprintf(stderr, "`clevel` parameter must be between 0 and 9!\n");
+    return NULL;
+  }
+  if (doshuffle < BLOSC_NOSHUFFLE || doshuffle > BLOSC_AUTOSHUFFLE) {
+    fprintf(stderr, "`shuffle` parameter must be either 0, 1, 2 or 3!\n");
+    return NULL;
+  }
+  if (compcode < 0) {
+    fprintf(stderr, "Compressor not supported\n");
+    return NULL;
+  }
+  if (numinternalthreads < 1 || numinternalthreads > BLOSC_MAX_THREADS) {
+    fprintf(stderr, "Error.  nthreads must be a positive integer <= %d\n",
+            BLOSC_MAX_THREADS);
+    return NULL;
+  }
+  if (typesize == 0) {
+    fprintf(stderr, "`typesize` parameter must be greater than 0!\n");
+    return NULL;
+  }
+  if (sink == NULL) {
+    fprintf(stderr, "A sink is needed for the stream\n");
+    return NULL;
+  }
+  if (chunksize == 0) {
+    chunksize = STREAM_DEFAULT_CHUNKSIZE;
+  }
+  /* Do not split items between chunks */
+  chunksize = (chunksize + typesize - 1) / typesize * typesize;
+  if (chunksize > BLOSC_MAX_BUFFERSIZE) {
+    fprintf(stderr, "`chunksize` cannot be larger than %d bytes\n",
+            BLOSC_MAX_BUFFERSIZE);
+    return NULL;
+  }
+
+  cs = calloc(1, sizeof(blosc_cstream));
+  if (cs == NULL) {
+    fprintf(stderr, "Error allocating memory!");
+    return NULL;
+  }
+  cs->clevel = clevel;
+  cs->doshuffle = doshuffle;
+  cs->typesize = typesize;
+  blosc_compcode_to_compname(compcode, &cs->compname);
+  cs->numthreads = numinternalthreads;
+  cs->chunksize = chunksize;
+  cs->sink = sink;
+  cs->user_data = user_data;
+  /* The chunks go through blosc_malloc() for huge pages */
+  cs->bufs[0] = blosc_malloc(chunksize);
+  cs->bufs[1] = blosc_malloc(chunksize);
+  /* (with room for the checksums, in case they are enabled) */
+  cs->cdest = blosc_malloc(chunksize + BLOSC_MAX_OVERHEAD_CHECKSUMS(chunksize));
+  if (cs->bufs[0] == NULL || cs->bufs[1] == NULL || cs->cdest == NULL) {
+    fprintf(stderr, "Error allocating memory!");
+    goto error;
+  }
+
+  pthread_mutex_init(&cs->mutex, NULL);
+  pthread_cond_init(&cs->cond, NULL);
+  if (pthread_create(&cs->worker, NULL, cstream_worker, cs) != 0) {
+    fprintf(stderr, "ERROR; return code from pthread_create() is not 0\n");
+    pthread_mutex_destroy(&cs->mutex);
+    pthread_cond_destroy(&cs->cond);
+    goto error;
+  }
+  return cs;
+
+  error:
+  blosc_free(cs->bufs[0]);
+  blosc_free(cs->bufs[1]);
+  blosc_free(cs->cdest);
+  free(cs);
+  return NULL;
+}
+
+/* Hand the buffer being filled to the worker, once it is done with the
+   previous one */
+static int cstream_submit(blosc_cstream* cs)
+{
+  int rc;
+
+  pthread_mutex_lock(&cs->mutex);
+  while (cs->busy) {
+    pthread_cond_wait(&cs->cond, &cs->mutex);
+  }
+  rc = cs->error;
+  if (rc == 0) {
+    cs->pending = cs->current;
+    cs->pending_size = cs->filled;
+    cs->busy = 1;
+    pthread_cond_broadcast(&cs->cond);
+  }
+  pthread_mutex_unlock(&cs->mutex);
+
+  cs->current ^= 1;
+  cs->filled = 0;
+  return rc;
+}
+
+int blosc_cstream_write(blosc_cstream* cs, const void* src, size_t nbytes)
+{
+  const uint8_t* _src = (const uint8_t*)src;
+  size_t n;
+  int rc;
+
+  while (nbytes > 0) {
+    n = cs->chunksize - cs->filled;
+    if (n > nbytes) {
+      n = nbytes;
+    }
+    memcpy(cs->bufs[cs->current] + cs->filled, _src, n);
+    cs->filled += n;
+    _src += n;
+    nbytes -= n;
+    if (cs->filled == cs->chunksize) {
+      rc = cstream_submit(cs);
+      if (rc < 0) {
+        return rc;
+      }
+    }
+  }
+  return 0;
+}
+
+int blosc_cstream_flush(blosc_cstream* cs)
+{
+  int rc;
+
+  if (cs->filled > 0) {
+    rc = cstream_submit(cs);
+    if (rc < 0) {
+      return rc;
+    }
+  }
+  pthread_mutex_lock(&cs->mutex);
+  while (cs->busy) {
+    pthread_cond_wait(&cs->cond, &cs->mutex);
+  }
+  rc = cs->error;
+  pthread_mutex_unlock(&cs->mutex);
+  return rc;
+}
+
+int blosc_cstream_free(blosc_cstream* cs)
+{
+  int rc;
+
+  if (cs == NULL) {
+    return 0;
+  }
+  rc = blosc_cstream_flush(cs);
+
+  pthread_mutex_lock(&cs->mutex);
+  cs->stop = 1;
+  pthread_cond_broadcast(&cs->cond);
+  pthread_mutex_unlock(&cs->mutex);
+  pthread_join(cs->worker, NULL);
+
+  pthread_mutex_destroy(&cs->mutex);
+  pthread_cond_destroy(&cs->cond);
+  blosc_free(cs->bufs[0]);
+  blosc_free(cs->bufs[1]);
+  blosc_free(cs->cdest);
+  free(cs);
+  return rc;
+}
+
+
+/* A decompression stream gathers the bytes of a chunk, starting with its
+   header, and decompresses it as soon as it is complete */
+struct blosc_dstream {
+  int numthreads;
+  blosc_stream_sink sink;
+  void* user_data;
+  uint8_t* chunk;                 /* Buffer for gathering a chunk */
+  size_t chunk_allocated;
+  size_t filled;                  /* Bytes of the current chunk gathered */
+  size_t needed;                  /* Bytes needed for the header or the chunk */
+  int have_header;                /* Whether the header has been parsed */
+  size_t nbytes;                  /* Uncompressed size of the current chunk */
+  uint8_t* dest;                  /* Buffer for the decompressed chunks */
+  size_t dest_allocated;
+  int error;                      /* First error found, or 0 */
+};
+
+
+blosc_dstream* blosc_dstream_new(int numinternalthreads,
+                                 blosc_stream_sink sink, void* user_data)
+{
+  blosc_dstream* ds;
+
+  if (sink == NULL) {
+    fprintf(stderr, "A sink is needed for the stream\n");
+    return NULL;
+  }
+  if (numinternalthreads < 1 || numinternalthreads > BLOSC_MAX_THREADS) {
+    fprintf(stderr, "Error.  nthreads must be a positive integer <= %d\n",
+            BLOSC_MAX_THREADS);
+    return NULL;
+  }
+  ds = calloc(1, sizeof(blosc_dstream));
+  if (ds == NULL) {
+    fprintf(stderr, "Error allocating memory!");
+    return NULL;
+  }
+  ds->numthreads = numinternalthreads;
+  ds->sink = sink;
+  ds->user_data = user_data;
+  ds->chunk = malloc(BLOSC_EXTENDED_HEADER_LENGTH);
+  if (ds->chunk == NULL) {
+    free(ds);
+    fprintf(stderr, "Error allocating memory!");
+    return NULL;
+  }
+  ds->chunk_allocated = BLOSC_EXTENDED_HEADER_LENGTH;
+  ds->needed = BLOSC_MIN_HEADER_LENGTH;
+  return ds;
+}
+
+/* Make `*buf` at least `size` bytes long.  Buffers whose contents need
+   not be kept are allocated with blosc_malloc(). */
+static int ensure_size(uint8_t** buf, size_t* allocated, size_t size,
+                       int keep)
+{
+  uint8_t* p;
+
+  if (size <= *allocated) {
+    return 0;
+  }
+  if (keep) {
+    p = realloc(*buf, size);
+  }
+  else {
+    blosc_free(*buf);
+    p = blosc_malloc(size);
+  }
+  if (p == NULL) {
+    if (!keep) {
+      *buf = NULL;
+      *allocated = 0;
+    }
+    fprintf(stderr, "Error allocating memory!");
+    return -1;
+  }
+  *buf = p;
+  *allocated = size;
+  return 0;
+}
+
+/* Parse the header gathered so far.  Returns the number of bytes of the
+   whole chunk, 0 if more header bytes are needed or a negative value if
+   this is not a chunk. */
+static int64_t parse_header(blosc_dstream* ds, const uint8_t* header,
+                            size_t available)
+{
+  size_t nbytes, cbytes, blocksize;
+  size_t header_len;
+
+  if (header[0] == BLOSC_VERSION_FORMAT_EXTENDED) {
+    header_len = BLOSC_EXTENDED_HEADER_LENGTH;
+  }
+  else {
+    header_len = BLOSC_MIN_HEADER_LENGTH;
+  }
+  if (available < header_len) {
+    ds->needed = header_len;
+    return 0;
+  }
+  blosc_cbuffer_sizes(header, &nbytes, &cbytes, &blocksize);
+  if (!BLOSC_KNOWN_VERSION(header[0]) ||
+      cbytes < header_len ||
+      blosc_cbuffer_validate(header, cbytes, &nbytes) < 0) {
+    fprintf(stderr, "Invalid chunk in the stream\n");
+    return -1;
+  }
+  ds->nbytes = nbytes;
+  return (int64_t)cbytes;
+}
+
+/* Decompress a whole chunk and pass it to the sink */
+static int dstream_emit(blosc_dstream* ds, const uint8_t* chunk)
+{
+  int64_t rc;
+
+  if (ds->nbytes == 0) {
+    return 0;
+  }
+  if (ensure_size(&ds->dest, &ds->dest_allocated, ds->nbytes, 0) < 0) {
+    return -1;
+  }
+  rc = blosc_decompress_ctx64(chunk, ds->dest, ds->nbytes, ds->numthreads);
+  if (rc < 0 || (size_t)rc != ds->nbytes) {
+    return (rc < 0) ? (int)rc : -1;
+  }
+  return ds->sink(ds->dest, ds->nbytes, ds->user_data);
+}
+
+int blosc_dstream_write(blosc_dstream* ds, const void* src, size_t nbytes)
+{
+  const uint8_t* _src = (const uint8_t*)src;
+  int64_t cbytes;
+  size_t n;
+  int rc;
+
+  if (ds->error < 0) {
+    return ds->error;
+  }
+  while (nbytes > 0) {
+    /* Whole chunks at the start of the input need no copy */
+    if (ds->filled == 0 && nbytes >= BLOSC_MIN_HEADER_LENGTH) {
+      cbytes = parse_header(ds, _src, nbytes);
+      if (cbytes < 0) {
+        ds->error = (int)cbytes;
+        return ds->error;
+      }
+      if (cbytes > 0 && (size_t)cbytes <= nbytes) {
+        rc = dstream_emit(ds, _src);
+        if (rc < 0) {
+          ds->error = rc;
+          return rc;
+        }
+        _src += cbytes;
+        nbytes -= (size_t)cbytes;
+        continue;
+      }
+      ds->needed = BLOSC_MIN_HEADER_LENGTH;
+    }
+
+    /* Gather the header first, then the rest of the chunk */
+    n = ds->needed - ds->filled;
+    if (n > nbytes) {
+      n = nbytes;
+    }
+    memcpy(ds->chunk + ds->filled, _src, n);
+    ds->filled += n;
+    _src += n;
+    nbytes -= n;
+    if (ds->filled < ds->needed) {
+      break;
+    }
+    if (!ds->have_header) {
+      cbytes = parse_header(ds, ds->chunk, ds->filled);
+      if (cbytes < 0) {
+        ds->error = (int)cbytes;
+        return ds->error;
+      }
+      if (cbytes == 0) {
+        /* The extended header is longer */
+        continue;
+      }
+      ds->have_header = 1;
+      if ((size_t)cbytes > ds->filled) {
+        if (ensure_size(&ds->chunk, &ds->chunk_allocated, (size_t)cbytes, 1) < 0) {
+          ds->error = -1;
+          return ds->error;
+        }
+        ds->needed = (size_t)cbytes;
+        continue;
+      }
+    }
+    /* The chunk is complete */
+    rc = dstream_emit(ds, ds->chunk);
+    if (rc < 0) {
+      ds->error = rc;
+      return rc;
+    }
+    ds->filled = 0;
+    ds->needed = BLOSC_MIN_HEADER_LENGTH;
+    ds->have_header = 0;
+  }
+  return 0;
+}
+
+int blosc_dstream_free(blosc_dstream* ds)
+{
+  int rc;
+
+  if (ds == NULL) {
+    return 0;
+  }
+  rc = ds->error;
+  if (rc == 0 && ds->filled > 0) {
+    fprintf(stderr, "The stream ends in the middle of a chunk\n");
+    rc = -1;
+  }
+  free(ds->chunk);
+  blosc_free(ds->dest);
+  free(ds);
+  return rc;
+}
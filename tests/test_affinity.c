@@ -0,0 +1,152 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for pinning the threads of the pools to CPUs.
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+int tests_run = 0;
+
+/* Global vars */
+int32_t *src, *dest;
+uint8_t *comp;
+size_t size = 4 * 1024 * 1024;      /* must be divisible by 4 */
+size_t typesize = 4;
+
+
+/* Roundtrip with the global and the context functions, with blocks of
+   several sizes so that the scratch memory of the threads has to grow */
+static const char *roundtrip(void) {
+  static const int blocksizes[] = {16 * 1024, 256 * 1024, 32 * 1024};
+  size_t i;
+  int cbytes, nbytes;
+
+  blosc_set_nthreads(3);
+  for (i = 0; i < sizeof(blocksizes) / sizeof(blocksizes[0]); i++) {
+    blosc_set_blocksize((size_t)blocksizes[i]);
+    cbytes = blosc_compress(5, BLOSC_SHUFFLE, typesize, size, src, comp,
+                            size + BLOSC_MAX_OVERHEAD);
+    mu_assert("ERROR: compression failed", cbytes > 0);
+    memset(dest, 0, size);
+    nbytes = blosc_decompress(comp, dest, size);
+    mu_assert("ERROR: decompression failed", nbytes == (int)size);
+    mu_assert("ERROR: roundtrip failed", memcmp(src, dest, size) == 0);
+
+    cbytes = blosc_compress_ctx(5, BLOSC_BITSHUFFLE, typesize, size, src, comp,
+                                size + BLOSC_MAX_OVERHEAD, "lz4",
+                                (size_t)blocksizes[i], 4);
+    mu_assert("ERROR: compression with context failed", cbytes > 0);
+    memset(dest, 0, size);
+    nbytes = blosc_decompress_ctx(comp, dest, size, 4);
+    mu_assert("ERROR: decompression with context failed", nbytes == (int)size);
+    mu_assert("ERROR: roundtrip failed", memcmp(src, dest, size) == 0);
+  }
+  blosc_set_blocksize(0);
+
+  return 0;
+}
+
+
+/* Check that invalid placements are rejected */
+static const char *test_invalid(void) {
+  static const int bad_cores[] = {0, -1};
+
+  mu_assert("ERROR: unknown policy accepted", blosc_set_affinity(99, NULL, 0) < 0);
+  mu_assert("ERROR: negative CPU accepted",
+            blosc_set_affinity(BLOSC_AFFINITY_NONE, bad_cores, 2) < 0);
+  mu_assert("ERROR: empty list of CPUs accepted",
+            blosc_set_affinity(BLOSC_AFFINITY_NONE, bad_cores, 0) < 0);
+  mu_assert("ERROR: no affinity not accepted",
+            blosc_set_affinity(BLOSC_AFFINITY_NONE, NULL, 0) == 0);
+
+  return 0;
+}
+
+
+/* Check the threads without affinity */
+static const char *test_none(void) {
+  return roundtrip();
+}
+
+
+#if defined(__linux__)
+/* Check the compact and scatter policies */
+static const char *test_policies(void) {
+  const char *result;
+
+  mu_assert("ERROR: compact policy not accepted",
+            blosc_set_affinity(BLOSC_AFFINITY_COMPACT, NULL, 0) == 0);
+  result = roundtrip();
+  if (result != 0) {
+    return result;
+  }
+  mu_assert("ERROR: scatter policy not accepted",
+            blosc_set_affinity(BLOSC_AFFINITY_SCATTER, NULL, 0) == 0);
+  return roundtrip();
+}
+
+
+/* Check an explicit list of CPUs, with more threads than CPUs */
+static const char *test_cores(void) {
+  static const int cores[] = {0};
+  const char *result;
+
+  mu_assert("ERROR: list of CPUs not accepted",
+            blosc_set_affinity(BLOSC_AFFINITY_NONE, cores, 1) == 0);
+  result = roundtrip();
+  mu_assert("ERROR: affinity not reset",
+            blosc_set_affinity(BLOSC_AFFINITY_NONE, NULL, 0) == 0);
+  return result;
+}
+#endif
+
+
+static const char *all_tests(void) {
+  mu_run_test(test_invalid);
+  mu_run_test(test_none);
+#if defined(__linux__)
+  mu_run_test(test_policies);
+  mu_run_test(test_cores);
+#endif
+
+  return 0;
+}
+
+#define BUFFER_ALIGN_SIZE   32
+
+int main(int argc, char **argv) {
+  const char *result;
+  size_t i;
+
+  printf("STARTING TESTS for %s", argv[0]);
+
+  blosc_init();
+
+  /* Initialize buffers */
+  src = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  dest = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  comp = blosc_test_malloc(BUFFER_ALIGN_SIZE, size + BLOSC_MAX_OVERHEAD);
+  for (i = 0; i < size / typesize; i++) {
+    src[i] = (int32_t)(i * 3 + (i % 17));
+  }
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != 0) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  blosc_test_free(src);
+  blosc_test_free(dest);
+  blosc_test_free(comp);
+  blosc_destroy();
+
+  return result != 0;
+}
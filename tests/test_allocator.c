@@ -0,0 +1,175 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for the user-provided allocator.
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+int tests_run = 0;
+
+/* Global vars */
+int32_t *src, *dest;
+uint8_t *comp;
+size_t size = 1024 * 1024;      /* must be divisible by 4 */
+size_t typesize = 4;
+
+/* Counters of the allocator */
+struct counters {
+  int allocs;
+  int frees;
+};
+struct counters counters;
+
+
+static void* test_aligned_malloc(size_t size_, size_t alignment, void* user_data) {
+  struct counters* c = (struct counters*)user_data;
+
+  c->allocs++;
+  /* Some aligned_alloc() implementations want a multiple of the alignment */
+  size_ = (size_ + alignment - 1) / alignment * alignment;
+  return blosc_test_malloc(alignment, size_);
+}
+
+static void* test_malloc(size_t size_, void* user_data) {
+  return test_aligned_malloc(size_, sizeof(void*), user_data);
+}
+
+static void test_free(void* ptr, void* user_data) {
+  struct counters* c = (struct counters*)user_data;
+
+  c->frees++;
+  blosc_test_free(ptr);
+}
+
+
+/* Check that all the memory goes through the allocator, for every codec,
+   some clevels and both the global and the context functions */
+static const char *test_all_memory(void) {
+  static const char* compressors[] = {"blosclz", "lz4", "lz4hc", "snappy",
+                                      "zlib", "zstd"};
+  static const int clevels[] = {5, 9};
+  blosc_allocator allocator = {test_malloc, test_aligned_malloc, test_free,
+                               &counters};
+  size_t c, l;
+  int cbytes, nbytes;
+
+  mu_assert("ERROR: allocator not set", blosc_set_allocator(&allocator) == 0);
+  blosc_init();
+  mu_assert("ERROR: allocator changed while initialized",
+            blosc_set_allocator(NULL) < 0);
+  blosc_set_nthreads(2);
+
+  for (c = 0; c < sizeof(compressors) / sizeof(compressors[0]); c++) {
+    if (blosc_set_compressor(compressors[c]) < 0) {
+      continue;     /* not available in this build */
+    }
+    for (l = 0; l < sizeof(clevels) / sizeof(clevels[0]); l++) {
+      cbytes = blosc_compress(clevels[l], BLOSC_SHUFFLE, typesize, size, src,
+                              comp, size + BLOSC_MAX_OVERHEAD);
+      mu_assert("ERROR: compression failed", cbytes > 0);
+      nbytes = blosc_decompress(comp, dest, size);
+      mu_assert("ERROR: decompression failed", nbytes == (int)size);
+      mu_assert("ERROR: roundtrip failed", memcmp(src, dest, size) == 0);
+
+      cbytes = blosc_compress_ctx(clevels[l], BLOSC_BITSHUFFLE, typesize, size,
+                                  src, comp, size + BLOSC_MAX_OVERHEAD,
+                                  compressors[c], 0, 2);
+      mu_assert("ERROR: compression with context failed", cbytes > 0);
+      nbytes = blosc_decompress_ctx(comp, dest, size, 1);
+      mu_assert("ERROR: decompression with context failed",
+                nbytes == (int)size);
+      mu_assert("ERROR: roundtrip failed", memcmp(src, dest, size) == 0);
+    }
+  }
+
+  blosc_destroy();
+  mu_assert("ERROR: the allocator was not used", counters.allocs > 0);
+  mu_assert("ERROR: memory leaked or not freed by the allocator",
+            counters.allocs == counters.frees);
+  mu_assert("ERROR: allocator not reset", blosc_set_allocator(NULL) == 0);
+
+  return 0;
+}
+
+
+/* Check that the global functions reuse their scratch memory, also for
+   the tables of the high compression mode of BloscLZ */
+static const char *test_scratch_reuse(void) {
+  blosc_allocator allocator = {test_malloc, test_aligned_malloc, test_free,
+                               &counters};
+  int cbytes, nbytes, allocs;
+
+  memset(&counters, 0, sizeof(counters));
+  mu_assert("ERROR: allocator not set", blosc_set_allocator(&allocator) == 0);
+  blosc_init();
+  blosc_set_nthreads(1);
+  blosc_set_compressor("blosclz");
+
+  cbytes = blosc_compress(9, BLOSC_SHUFFLE, typesize, size, src, comp,
+                          size + BLOSC_MAX_OVERHEAD);
+  mu_assert("ERROR: compression failed", cbytes > 0);
+  allocs = counters.allocs;
+  cbytes = blosc_compress(5, BLOSC_SHUFFLE, typesize, size, src, comp,
+                          size + BLOSC_MAX_OVERHEAD);
+  mu_assert("ERROR: compression failed", cbytes > 0);
+  cbytes = blosc_compress(9, BLOSC_SHUFFLE, typesize, size, src, comp,
+                          size + BLOSC_MAX_OVERHEAD);
+  mu_assert("ERROR: compression failed", cbytes > 0);
+  nbytes = blosc_decompress(comp, dest, size);
+  mu_assert("ERROR: decompression failed", nbytes == (int)size);
+  mu_assert("ERROR: scratch memory not reused", counters.allocs == allocs);
+
+  /* It is released on request */
+  mu_assert("ERROR: resources not freed", blosc_free_resources() == 0);
+  mu_assert("ERROR: scratch memory not freed", counters.frees > 0);
+
+  blosc_destroy();
+  mu_assert("ERROR: memory leaked", counters.allocs == counters.frees);
+  blosc_set_allocator(NULL);
+
+  return 0;
+}
+
+
+static const char *all_tests(void) {
+  mu_run_test(test_all_memory);
+  mu_run_test(test_scratch_reuse);
+
+  return 0;
+}
+
+#define BUFFER_ALIGN_SIZE   32
+
+int main(int argc, char **argv) {
+  const char *result;
+  size_t i;
+
+  printf("STARTING TESTS for %s", argv[0]);
+
+  /* Initialize buffers */
+  src = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  dest = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  comp = blosc_test_malloc(BUFFER_ALIGN_SIZE, size + BLOSC_MAX_OVERHEAD);
+  for (i = 0; i < size / typesize; i++) {
+    src[i] = (int32_t)(i * 3 + (i % 17));
+  }
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != 0) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  blosc_test_free(src);
+  blosc_test_free(dest);
+  blosc_test_free(comp);
+
+  return result != 0;
+}
@@ -0,0 +1,169 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for the per-block filters (BLOSC_AUTOSHUFFLE).
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+int tests_run = 0;
+
+/* The latest format version that Blosc2 reads (as of Blosc2 2.x).  Both
+   shuffle bits mean an extended header there, so buffers with per-block
+   filters need a version above it. */
+#define BLOSC2_VERSION_FORMAT 5
+
+/* Global vars */
+uint8_t *src, *dest, *dest2;
+size_t size = 1024 * 1024;      /* must be divisible by 8 */
+size_t typesize = 4;
+size_t blocksize = 32 * 1024;
+
+
+/* A buffer mixing regions with different structure: text, a smooth
+   float array, zero padding and a ramp of integers */
+static void fill_mixed(void) {
+  static const char text[] = "A single chunk often mixes headers, float arrays, "
+                             "and zero padding. ";
+  float *fsrc = (float*)(src + size / 4);
+  int32_t *isrc = (int32_t*)(src + 3 * size / 4);
+  size_t i;
+
+  for (i = 0; i < size / 4; i++) {
+    src[i] = (uint8_t)text[(i * 7 + i / 97) % (sizeof(text) - 1)];
+  }
+  for (i = 0; i < size / 16; i++) {
+    fsrc[i] = (float)i * 0.25f + (float)(i % 13);
+  }
+  memset(src + size / 2, 0, size / 4);
+  for (i = 0; i < size / 16; i++) {
+    isrc[i] = (int32_t)(i * 3);
+  }
+}
+
+
+/* Check roundtrips of every codec, both serial and threaded */
+static const char *test_roundtrip(void) {
+  static const char* compressors[] = {"blosclz", "lz4", "lz4hc", "zlib", "zstd"};
+  size_t c, nthreads;
+  int cbytes, nbytes, version, versionlz, flags;
+  size_t typesize_;
+  float items[16];
+
+  for (c = 0; c < sizeof(compressors) / sizeof(compressors[0]); c++) {
+    if (blosc_compname_to_compcode(compressors[c]) < 0) {
+      continue;     /* not available in this build */
+    }
+    for (nthreads = 1; nthreads <= 2; nthreads++) {
+      cbytes = blosc_compress_ctx(5, BLOSC_AUTOSHUFFLE, typesize, size, src, dest,
+                                  size + BLOSC_MAX_OVERHEAD, compressors[c],
+                                  blocksize, (int)nthreads);
+      mu_assert("ERROR: mixed data should be compressed",
+                cbytes > 0 && cbytes < (int)size / 2);
+      blosc_cbuffer_versions(dest, &version, &versionlz);
+      mu_assert("ERROR: bad format version",
+                version == BLOSC_VERSION_FORMAT_BLOCKFILTERS);
+      mu_assert("ERROR: format version readable by Blosc2",
+                version > BLOSC2_VERSION_FORMAT);
+      blosc_cbuffer_metainfo(dest, &typesize_, &flags);
+      mu_assert("ERROR: per-block filters not flagged",
+                (flags & BLOSC_BLOCKFILTERS) == BLOSC_BLOCKFILTERS);
+      nbytes = blosc_decompress_ctx(dest, dest2, size, (int)nthreads);
+      mu_assert("ERROR: bad roundtrip", nbytes == (int)size);
+      mu_assert("ERROR: bad roundtrip data", memcmp(src, dest2, size) == 0);
+      nbytes = blosc_getitem(dest, (int)(size / 16 + 1000), 16, items);
+      mu_assert("ERROR: bad getitem", nbytes == (int)sizeof(items));
+      mu_assert("ERROR: bad getitem data",
+                memcmp(items, src + size / 4 + 4000, sizeof(items)) == 0);
+    }
+  }
+
+  return 0;
+}
+
+
+/* Check that choosing per block does not lose against any fixed filter */
+static const char *test_best_filter(void) {
+  int doshuffle, cbytes, auto_cbytes;
+
+  auto_cbytes = blosc_compress_ctx(5, BLOSC_AUTOSHUFFLE, typesize, size, src, dest,
+                                   size + BLOSC_MAX_OVERHEAD, "blosclz",
+                                   blocksize, 1);
+  mu_assert("ERROR: mixed data should be compressed", auto_cbytes > 0);
+  for (doshuffle = BLOSC_NOSHUFFLE; doshuffle <= BLOSC_BITSHUFFLE; doshuffle++) {
+    cbytes = blosc_compress_ctx(5, doshuffle, typesize, size, src, dest,
+                                size + BLOSC_MAX_OVERHEAD, "blosclz",
+                                blocksize, 1);
+    /* Every block pays one byte for its flags */
+    mu_assert("ERROR: a fixed filter compresses better",
+              auto_cbytes <= cbytes + (int)(size / blocksize));
+  }
+
+  return 0;
+}
+
+
+/* Check the extended format */
+static const char *test_extended(void) {
+  int64_t cbytes, nbytes;
+  int version, versionlz;
+
+  cbytes = blosc_compress_ctx64(5, BLOSC_AUTOSHUFFLE, typesize, size, src, dest,
+                                size + BLOSC_MAX_OVERHEAD_EXTENDED, "blosclz",
+                                blocksize, 2);
+  mu_assert("ERROR: mixed data should be compressed",
+            cbytes > 0 && cbytes < (int64_t)size / 2);
+  blosc_cbuffer_versions(dest, &version, &versionlz);
+  mu_assert("ERROR: bad format version", version == BLOSC_VERSION_FORMAT_EXTENDED);
+  mu_assert("ERROR: format version readable by Blosc2",
+            version > BLOSC2_VERSION_FORMAT);
+  nbytes = blosc_decompress_ctx64(dest, dest2, size, 2);
+  mu_assert("ERROR: bad roundtrip", nbytes == (int64_t)size);
+  mu_assert("ERROR: bad roundtrip data", memcmp(src, dest2, size) == 0);
+
+  return 0;
+}
+
+
+static const char *all_tests(void) {
+  mu_run_test(test_roundtrip);
+  mu_run_test(test_best_filter);
+  mu_run_test(test_extended);
+
+  return 0;
+}
+
+#define BUFFER_ALIGN_SIZE   32
+
+int main(int argc, char **argv) {
+  const char *result;
+
+  printf("STARTING TESTS for %s", argv[0]);
+
+  blosc_init();
+
+  /* Initialize buffers */
+  src = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  dest = blosc_test_malloc(BUFFER_ALIGN_SIZE, size + BLOSC_MAX_OVERHEAD_EXTENDED);
+  dest2 = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  fill_mixed();
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != 0) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  blosc_test_free(src);
+  blosc_test_free(dest);
+  blosc_test_free(dest2);
+  blosc_destroy();
+
+  return result != 0;
+}
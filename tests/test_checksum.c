@@ -0,0 +1,232 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for the per-block checksums.
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+int tests_run = 0;
+
+/* Global vars */
+void *src, *dest, *dest2;
+size_t size = 1000 * 1000;
+int64_t sum;
+
+
+/* Check roundtrips of checksummed buffers */
+static const char *test_roundtrip(void) {
+  size_t typesize, nbytes;
+  int clevel, nthreads, flags, cbytes;
+  int64_t rsum;
+
+  blosc_set_checksum(1);
+  for (clevel = 0; clevel <= 5; clevel += 5) {
+    for (nthreads = 1; nthreads <= 4; nthreads += 3) {
+      cbytes = blosc_compress_ctx(clevel, BLOSC_SHUFFLE, 4, size, src, dest,
+                                  size + BLOSC_MAX_OVERHEAD_CHECKSUMS(size),
+                                  "blosclz", 16 * 1024, nthreads);
+      mu_assert("ERROR: cannot compress", cbytes > 0);
+      blosc_cbuffer_metainfo(dest, &typesize, &flags);
+      mu_assert("ERROR: checksums not flagged", flags & BLOSC_CHECKSUMMED);
+      mu_assert("ERROR: buffer does not validate",
+                blosc_cbuffer_validate(dest, (size_t)cbytes, &nbytes) == 0);
+
+      memset(dest2, 0, size);
+      mu_assert("ERROR: bad decompressed size",
+                blosc_decompress_ctx(dest, dest2, size, nthreads) == (int)size);
+      mu_assert("ERROR: bad roundtrip", memcmp(src, dest2, size) == 0);
+      mu_assert("ERROR: bad getitem",
+                blosc_getitem(dest, 5000, 10000, dest2) == 40000);
+      mu_assert("ERROR: bad getitem data",
+                memcmp((int32_t *)src + 5000, dest2, 40000) == 0);
+      mu_assert("ERROR: cannot reduce",
+                blosc_reduce_ctx(dest, BLOSC_INT32, BLOSC_REDUCE_SUM,
+                                 &rsum, nthreads) == (int)(size / 4));
+      mu_assert("ERROR: bad reduction", rsum == sum);
+    }
+  }
+  blosc_set_checksum(0);
+
+  return 0;
+}
+
+
+/* Check that corrupted data is detected */
+static const char *test_corruption(void) {
+  size_t nbytes, cbytes_, blocksize;
+  int clevel, nthreads, cbytes, nblocks;
+  int64_t rsum;
+
+  blosc_set_checksum(1);
+  for (clevel = 0; clevel <= 5; clevel += 5) {
+    for (nthreads = 1; nthreads <= 4; nthreads += 3) {
+      cbytes = blosc_compress_ctx(clevel, BLOSC_SHUFFLE, 4, size, src, dest,
+                                  size + BLOSC_MAX_OVERHEAD_CHECKSUMS(size),
+                                  "blosclz", 16 * 1024, nthreads);
+      mu_assert("ERROR: cannot compress", cbytes > 0);
+      blosc_cbuffer_sizes(dest, &nbytes, &cbytes_, &blocksize);
+      nblocks = (int)((nbytes + blocksize - 1) / blocksize);
+      /* Flip a bit of the checksum of the last block (it is the last word
+         for memcpyed buffers and follows the bstarts otherwise) */
+      if (clevel == 0) {
+        ((uint8_t *)dest)[cbytes - 1] ^= 0x10;
+      }
+      else {
+        ((uint8_t *)dest)[BLOSC_MIN_HEADER_LENGTH + 4 * nblocks +
+                          4 * (nblocks - 1) + 3] ^= 0x10;
+      }
+      mu_assert("ERROR: corrupted buffer decompressed",
+                blosc_decompress_ctx(dest, dest2, size, nthreads) < 0);
+      mu_assert("ERROR: corrupted buffer reduced",
+                blosc_reduce_ctx(dest, BLOSC_INT32, BLOSC_REDUCE_SUM,
+                                 &rsum, nthreads) < 0);
+      mu_assert("ERROR: corrupted block got",
+                blosc_getitem(dest, (int)(size / 4) - 10, 10, dest2) < 0);
+      /* Other blocks are still fine */
+      mu_assert("ERROR: sane block not got",
+                blosc_getitem(dest, 0, 10, dest2) == 40);
+    }
+  }
+
+  /* Corrupt the data of a memcpyed buffer */
+  cbytes = blosc_compress_ctx(0, BLOSC_NOSHUFFLE, 4, size, src, dest,
+                              size + BLOSC_MAX_OVERHEAD_CHECKSUMS(size),
+                              "blosclz", 16 * 1024, 1);
+  mu_assert("ERROR: cannot compress", cbytes > 0);
+  ((uint8_t *)dest)[BLOSC_MIN_HEADER_LENGTH + 12345] ^= 1;
+  mu_assert("ERROR: corrupted data decompressed",
+            blosc_decompress_ctx(dest, dest2, size, 1) < 0);
+  blosc_set_checksum(0);
+
+  return 0;
+}
+
+
+/* Check that checksums are off by default and never dropped */
+static const char *test_flags(void) {
+  size_t typesize, nbytes, cbytes, blocksize;
+  int flags, csize;
+
+  csize = blosc_compress_ctx(5, BLOSC_SHUFFLE, 4, size, src, dest,
+                             size + BLOSC_MAX_OVERHEAD, "blosclz", 0, 1);
+  mu_assert("ERROR: cannot compress", csize > 0);
+  blosc_cbuffer_metainfo(dest, &typesize, &flags);
+  mu_assert("ERROR: checksums on by default", !(flags & BLOSC_CHECKSUMMED));
+
+  /* A memcpyed buffer without room for the checksums fails */
+  blosc_set_checksum(1);
+  csize = blosc_compress_ctx(0, BLOSC_SHUFFLE, 4, size, src, dest,
+                             size + BLOSC_MAX_OVERHEAD, "blosclz", 0, 1);
+  mu_assert("ERROR: checksums dropped", csize < 0);
+  csize = blosc_compress_ctx(0, BLOSC_SHUFFLE, 4, size, src, dest,
+                             size + BLOSC_MAX_OVERHEAD_CHECKSUMS(size),
+                             "blosclz", 128, 1);
+  mu_assert("ERROR: no room for the checksums of the smallest blocks",
+            csize > (int)(size + BLOSC_MAX_OVERHEAD));
+  blosc_cbuffer_metainfo(dest, &typesize, &flags);
+  mu_assert("ERROR: checksums dropped", flags & BLOSC_CHECKSUMMED);
+  mu_assert("ERROR: cannot decompress",
+            blosc_decompress_ctx(dest, dest2, size, 1) == (int)size);
+
+  /* Also for buffers smaller than their typesize, with a byte per block */
+  csize = blosc_compress_ctx(5, BLOSC_SHUFFLE, 200, 100, src, dest,
+                             100 + BLOSC_MAX_OVERHEAD_CHECKSUMS(100),
+                             "blosclz", 0, 1);
+  mu_assert("ERROR: no room for the checksums of a small buffer",
+            csize == 100 + BLOSC_MAX_OVERHEAD_CHECKSUMS(100));
+  mu_assert("ERROR: cannot decompress a small buffer",
+            blosc_decompress_ctx(dest, dest2, 100, 1) == 100);
+
+  /* Truncated checksums are detected */
+  csize = blosc_compress_ctx(0, BLOSC_SHUFFLE, 4, size, src, dest,
+                             size + BLOSC_MAX_OVERHEAD_CHECKSUMS(size),
+                             "blosclz", 0, 1);
+  blosc_cbuffer_sizes(dest, &nbytes, &cbytes, &blocksize);
+  mu_assert("ERROR: bad compressed size", (size_t)csize == cbytes);
+  csize -= 4;
+  memcpy((uint8_t *)dest + 12, &csize, sizeof(csize));  /* little endian */
+  mu_assert("ERROR: truncated checksums accepted",
+            blosc_decompress_ctx(dest, dest2, size, 1) < 0);
+  blosc_set_checksum(0);
+
+  return 0;
+}
+
+
+/* Check that super-chunks keep the checksums of data stored as is */
+static const char *test_schunk(void) {
+  blosc_schunk* schunk;
+  int64_t nchunks, nbytes, cbytes;
+
+  blosc_set_checksum(1);
+  schunk = blosc_schunk_new(0, BLOSC_SHUFFLE, 4, "blosclz", 1);
+  mu_assert("ERROR: cannot create super-chunk", schunk != NULL);
+  mu_assert("ERROR: cannot append", blosc_schunk_append_buffer(schunk, src,
+                                                               size) == 1);
+  blosc_set_checksum(0);
+  blosc_schunk_sizes(schunk, &nchunks, &nbytes, &cbytes);
+  mu_assert("ERROR: checksums dropped",
+            cbytes > (int64_t)(size + BLOSC_MAX_OVERHEAD));
+  mu_assert("ERROR: cannot decompress",
+            blosc_schunk_decompress_chunk(schunk, 0, dest2, size) ==
+            (int64_t)size);
+  mu_assert("ERROR: roundtrip failed", memcmp(src, dest2, size) == 0);
+  blosc_schunk_free(schunk);
+
+  return 0;
+}
+
+
+static const char *all_tests(void) {
+  mu_run_test(test_roundtrip);
+  mu_run_test(test_corruption);
+  mu_run_test(test_flags);
+  mu_run_test(test_schunk);
+
+  return 0;
+}
+
+#define BUFFER_ALIGN_SIZE   32
+
+int main(int argc, char **argv) {
+  int32_t *_src;
+  const char *result;
+  size_t i;
+
+  printf("STARTING TESTS for %s", argv[0]);
+
+  blosc_init();
+
+  /* Initialize buffers */
+  src = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  dest = blosc_test_malloc(BUFFER_ALIGN_SIZE,
+                           size + BLOSC_MAX_OVERHEAD_CHECKSUMS(size));
+  dest2 = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  _src = (int32_t *)src;
+  sum = 0;
+  for (i = 0; i < (size / 4); i++) {
+    _src[i] = (int32_t)(i * 7 % 1000);
+    sum += _src[i];
+  }
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != 0) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  blosc_test_free(src);
+  blosc_test_free(dest);
+  blosc_test_free(dest2);
+
+  blosc_destroy();
+
+  return result != 0;
+}
@@ -0,0 +1,207 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for the extended (64-bit) format.
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+int tests_run = 0;
+
+/* Global vars */
+void *src, *srccpy, *dest, *dest2;
+size_t size = 1000 * 1000;
+
+
+/* Check the extended header */
+static const char *test_extended_header(void) {
+  int64_t cbytes;
+  size_t nbytes_, cbytes_, blocksize_;
+  int version, versionlz;
+
+  cbytes = blosc_compress_ctx64(5, BLOSC_SHUFFLE, 4, size, src, dest,
+                                size + BLOSC_MAX_OVERHEAD_EXTENDED, "blosclz",
+                                0, 1);
+  mu_assert("ERROR: cbytes is not positive", cbytes > 0);
+  blosc_cbuffer_versions(dest, &version, &versionlz);
+  mu_assert("ERROR: not the extended format",
+            version == BLOSC_VERSION_FORMAT_EXTENDED);
+  blosc_cbuffer_sizes(dest, &nbytes_, &cbytes_, &blocksize_);
+  mu_assert("ERROR: bad nbytes", nbytes_ == size);
+  mu_assert("ERROR: bad cbytes", (int64_t)cbytes_ == cbytes);
+  mu_assert("ERROR: bad blocksize", blocksize_ > 0 && blocksize_ <= size);
+  mu_assert("ERROR: buffer does not validate",
+            blosc_cbuffer_validate(dest, (size_t)cbytes, &nbytes_) == 0);
+  mu_assert("ERROR: truncated header validates",
+            blosc_cbuffer_validate(dest, BLOSC_MIN_HEADER_LENGTH, &nbytes_) < 0);
+
+  return 0;
+}
+
+
+/* Check roundtrips through the extended format */
+static const char *test_extended_roundtrip(void) {
+  int clevel, nthreads;
+  int64_t cbytes, nbytes;
+
+  /* clevel 0 gives a memcpyed buffer */
+  for (clevel = 0; clevel < 10; clevel += 3) {
+    for (nthreads = 1; nthreads <= 4; nthreads += 3) {
+      cbytes = blosc_compress_ctx64(clevel, BLOSC_SHUFFLE, 4, size, src, dest,
+                                    size + BLOSC_MAX_OVERHEAD_EXTENDED,
+                                    "blosclz", 16 * 1024, nthreads);
+      mu_assert("ERROR: cbytes is not positive", cbytes > 0);
+      memset(dest2, 0, size);
+      nbytes = blosc_decompress_ctx64(dest, dest2, size, nthreads);
+      mu_assert("ERROR: bad nbytes (ctx64)", nbytes == (int64_t)size);
+      mu_assert("ERROR: bad roundtrip (ctx64)", memcmp(srccpy, dest2, size) == 0);
+
+      /* Small extended buffers can be read by the classic API too */
+      memset(dest2, 0, size);
+      mu_assert("ERROR: bad nbytes (ctx)",
+                blosc_decompress_ctx(dest, dest2, size, nthreads) == (int)size);
+      mu_assert("ERROR: bad roundtrip (ctx)", memcmp(srccpy, dest2, size) == 0);
+      mu_assert("ERROR: bad getitem",
+                blosc_getitem(dest, 1000, 10, dest2) == 40);
+      mu_assert("ERROR: bad getitem data",
+                memcmp((int32_t *)srccpy + 1000, dest2, 40) == 0);
+    }
+  }
+
+  /* The classic format is still readable by the 64-bit API */
+  cbytes = blosc_compress_ctx(5, BLOSC_SHUFFLE, 4, size, src, dest,
+                              size + BLOSC_MAX_OVERHEAD, "blosclz", 0, 1);
+  mu_assert("ERROR: cbytes is not positive", cbytes > 0);
+  nbytes = blosc_decompress_ctx64(dest, dest2, size, 1);
+  mu_assert("ERROR: bad nbytes (classic)", nbytes == (int64_t)size);
+  mu_assert("ERROR: bad roundtrip (classic)", memcmp(srccpy, dest2, size) == 0);
+
+  return 0;
+}
+
+
+/* Check that a buffer larger than 2 GB compresses in a single call */
+static const char *test_extended_large(void) {
+  size_t large = (size_t)INT_MAX + 1 + 1000 * 1000;
+  size_t csize = 64 * 1000 * 1000;
+  size_t nbytes_, cbytes_, blocksize_;
+  uint8_t *lsrc, *ldest;
+  int64_t cbytes;
+  int32_t item;
+  size_t i;
+
+  if (sizeof(size_t) < 8) {
+    return 0;
+  }
+  /* Untouched pages of a calloc'ed buffer are not backed by memory */
+  lsrc = calloc(large, 1);
+  ldest = malloc(csize);
+  if (lsrc == NULL || ldest == NULL) {
+    free(lsrc);
+    free(ldest);
+    return 0;
+  }
+  for (i = 0; i < large; i += large / 7) {
+    lsrc[i] = (uint8_t)(i % 251 + 1);
+  }
+  lsrc[large - 1] = 42;
+
+  cbytes = blosc_compress_ctx64(5, BLOSC_SHUFFLE, 4, large, lsrc, ldest, csize,
+                                "blosclz", 0, 2);
+  mu_assert("ERROR: large buffer not compressed", cbytes > 0);
+  blosc_cbuffer_sizes(ldest, &nbytes_, &cbytes_, &blocksize_);
+  mu_assert("ERROR: bad large nbytes", nbytes_ == large);
+  mu_assert("ERROR: bad large cbytes", (int64_t)cbytes_ == cbytes);
+
+  /* The classic API refuses it cleanly */
+  mu_assert("ERROR: classic decompression accepted a large buffer",
+            blosc_decompress_ctx(ldest, lsrc, large, 1) <= 0);
+
+  /* Items past the 2 GB boundary are reachable */
+  mu_assert("ERROR: bad large getitem",
+            blosc_getitem(ldest, (int)(large / 4 - 1), 1, &item) == 4);
+  mu_assert("ERROR: bad large getitem data", ((uint8_t *)&item)[3] == 42);
+
+  free(lsrc);
+  free(ldest);
+  return 0;
+}
+
+
+/* Check errors */
+static const char *test_extended_errors(void) {
+  int64_t cbytes;
+
+  /* Not enough room for the extended header */
+  cbytes = blosc_compress_ctx64(5, BLOSC_SHUFFLE, 4, size, src, dest,
+                                BLOSC_MAX_OVERHEAD_EXTENDED - 1, "blosclz", 0, 1);
+  mu_assert("ERROR: cbytes is not 0", cbytes == 0);
+
+  cbytes = blosc_compress_ctx64(5, BLOSC_SHUFFLE, 4, size, src, dest,
+                                size + BLOSC_MAX_OVERHEAD_EXTENDED, "blosclz",
+                                0, 1);
+  mu_assert("ERROR: cbytes is not positive", cbytes > 0);
+  mu_assert("ERROR: too small destsize accepted",
+            blosc_decompress_ctx64(dest, dest2, size - 1, 1) < 0);
+
+  /* Format versions from the future are rejected */
+  ((uint8_t *)dest)[0] = BLOSC_VERSION_FORMAT_BLOCKFILTERS + 1;
+  mu_assert("ERROR: future version accepted",
+            blosc_decompress_ctx64(dest, dest2, size, 1) < 0);
+
+  return 0;
+}
+
+
+static const char *all_tests(void) {
+  mu_run_test(test_extended_header);
+  mu_run_test(test_extended_roundtrip);
+  mu_run_test(test_extended_large);
+  mu_run_test(test_extended_errors);
+
+  return 0;
+}
+
+#define BUFFER_ALIGN_SIZE   32
+
+int main(int argc, char **argv) {
+  int32_t *_src;
+  const char *result;
+  size_t i;
+
+  printf("STARTING TESTS for %s", argv[0]);
+
+  blosc_init();
+
+  /* Initialize buffers */
+  src = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  srccpy = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  dest = blosc_test_malloc(BUFFER_ALIGN_SIZE, size + BLOSC_MAX_OVERHEAD_EXTENDED);
+  dest2 = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  _src = (int32_t *)src;
+  for (i = 0; i < (size / 4); i++) {
+    _src[i] = (int32_t)(i * 3 % 1000);
+  }
+  memcpy(srccpy, src, size);
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != 0) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  blosc_test_free(src);
+  blosc_test_free(srccpy);
+  blosc_test_free(dest);
+  blosc_test_free(dest2);
+
+  blosc_destroy();
+
+  return result != 0;
+}
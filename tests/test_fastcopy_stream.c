@@ -0,0 +1,97 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for the copy with non-temporal (streaming) stores.
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+#include "../blosc/fastcopy.h"
+
+int tests_run = 0;
+
+/* Global vars */
+uint8_t *src, *dest;
+size_t size = 64 * 1024;
+
+#define GUARD 64
+
+
+/* Check copies of every misalignment of the destination and source,
+   for lengths around the size of the streamed vectors */
+static const char *test_alignments(void) {
+  static const unsigned lengths[] = {0, 1, 15, 16, 17, 63, 64, 65, 79, 80,
+                                     127, 128, 129, 1000, 4096, 4099};
+  unsigned doff, soff, l, len;
+  uint8_t *ret;
+
+  for (doff = 0; doff < 16; doff++) {
+    for (soff = 0; soff < 16; soff += 5) {
+      for (l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+        len = lengths[l];
+        memset(dest, 0xa5, len + 2 * GUARD);
+        ret = fastcopy_stream(dest + GUARD + doff, src + soff, len);
+        mu_assert("ERROR: bad returned pointer", ret == dest + GUARD + doff + len);
+        mu_assert("ERROR: bad copy", memcmp(dest + GUARD + doff, src + soff, len) == 0);
+        mu_assert("ERROR: write before the destination",
+                  dest[GUARD + doff - 1] == 0xa5);
+        mu_assert("ERROR: write past the destination",
+                  dest[GUARD + doff + len] == 0xa5);
+      }
+    }
+  }
+
+  return 0;
+}
+
+
+/* Check that large copies match fastcopy() */
+static const char *test_large(void) {
+  size_t len = size - 2 * GUARD;
+
+  memset(dest, 0, size);
+  fastcopy_stream(dest + 3, src + 1, (unsigned)len);
+  mu_assert("ERROR: bad large copy", memcmp(dest + 3, src + 1, len) == 0);
+
+  return 0;
+}
+
+
+static const char *all_tests(void) {
+  mu_run_test(test_alignments);
+  mu_run_test(test_large);
+
+  return 0;
+}
+
+#define BUFFER_ALIGN_SIZE   32
+
+int main(int argc, char **argv) {
+  const char *result;
+  size_t i;
+
+  printf("STARTING TESTS for %s", argv[0]);
+
+  /* Initialize buffers */
+  src = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  dest = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  for (i = 0; i < size; i++) {
+    src[i] = (uint8_t)(i * 7 + (i >> 8));
+  }
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != 0) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  blosc_test_free(src);
+  blosc_test_free(dest);
+
+  return result != 0;
+}
@@ -0,0 +1,104 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for the buffers backed by huge pages.
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+int tests_run = 0;
+
+/* Global vars */
+int32_t *src, *dest;
+uint8_t *comp;
+size_t size = 8 * 1024 * 1024;      /* must be divisible by 4 */
+size_t typesize = 4;
+
+#define HUGEPAGE_SIZE (2 * 1024 * 1024)
+
+
+/* Check the alignment of the buffers from blosc_malloc() */
+static const char *test_malloc(void) {
+  uint8_t *small, *large;
+
+  small = blosc_malloc(1000);
+  large = blosc_malloc(3 * HUGEPAGE_SIZE + 1);
+  mu_assert("ERROR: cannot allocate", small != NULL && large != NULL);
+  mu_assert("ERROR: small buffer not aligned", ((uintptr_t)small % 32) == 0);
+#if defined(__linux__)
+  mu_assert("ERROR: large buffer not aligned to a huge page",
+            ((uintptr_t)large % HUGEPAGE_SIZE) == 0);
+#else
+  mu_assert("ERROR: large buffer not aligned", ((uintptr_t)large % 32) == 0);
+#endif
+  /* The whole size must be usable */
+  memset(small, 1, 1000);
+  memset(large, 1, 3 * HUGEPAGE_SIZE + 1);
+  blosc_free(small);
+  blosc_free(large);
+
+  return 0;
+}
+
+
+/* Check roundtrips with scratch buffers in huge pages */
+static const char *test_roundtrip(void) {
+  int nthreads, cbytes, nbytes;
+
+  for (nthreads = 1; nthreads <= 2; nthreads++) {
+    /* 1 MB blocks make thread scratch buffers larger than a huge page */
+    cbytes = blosc_compress_ctx(5, BLOSC_BITSHUFFLE, typesize, size, src, comp,
+                                size + BLOSC_MAX_OVERHEAD, "blosclz",
+                                1024 * 1024, nthreads);
+    mu_assert("ERROR: compression failed", cbytes > 0);
+    nbytes = blosc_decompress_ctx(comp, dest, size, nthreads);
+    mu_assert("ERROR: decompression failed", nbytes == (int)size);
+    mu_assert("ERROR: roundtrip failed", memcmp(src, dest, size) == 0);
+  }
+
+  return 0;
+}
+
+
+static const char *all_tests(void) {
+  mu_run_test(test_malloc);
+  mu_run_test(test_roundtrip);
+
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  const char *result;
+  size_t i;
+
+  printf("STARTING TESTS for %s", argv[0]);
+
+  blosc_set_hugepages(1);
+
+  /* Initialize buffers */
+  src = blosc_malloc(size);
+  dest = blosc_malloc(size);
+  comp = blosc_malloc(size + BLOSC_MAX_OVERHEAD);
+  for (i = 0; i < size / typesize; i++) {
+    src[i] = (int32_t)(i * 3 + (i % 17));
+  }
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != 0) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  blosc_free(src);
+  blosc_free(dest);
+  blosc_free(comp);
+  blosc_set_hugepages(0);
+
+  return result != 0;
+}
@@ -0,0 +1,155 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for the compressibility probe.
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+int tests_run = 0;
+
+/* Global vars */
+uint8_t *src, *dest, *dest2;
+size_t size = 1024 * 1024;
+size_t typesize = 8;
+
+
+/* Fill the first `nbytes` of `src` with pseudo-random bytes */
+static void fill_random(size_t nbytes) {
+  uint32_t seed = 1;
+  size_t i;
+
+  for (i = 0; i < nbytes; i++) {
+    seed = seed * 1103515245 + 12345;
+    src[i] = (uint8_t)(seed >> 23);
+  }
+}
+
+
+/* Check that random data is stored as is (memcpyed) by every codec */
+static const char *test_random(void) {
+  static const char* compressors[] = {"blosclz", "lz4", "lz4hc", "zlib", "zstd"};
+  size_t c, nbytes, cbytes, blocksize;
+  int cbytes_, flags;
+
+  fill_random(size);
+  for (c = 0; c < sizeof(compressors) / sizeof(compressors[0]); c++) {
+    if (blosc_set_compressor(compressors[c]) < 0) {
+      continue;     /* not available in this build */
+    }
+    cbytes_ = blosc_compress(5, BLOSC_SHUFFLE, typesize, size, src, dest,
+                             size + BLOSC_MAX_OVERHEAD);
+    mu_assert("ERROR: random data should not be compressed",
+              cbytes_ == (int)(size + BLOSC_MAX_OVERHEAD));
+    blosc_cbuffer_sizes(dest, &nbytes, &cbytes, &blocksize);
+    blosc_cbuffer_metainfo(dest, &typesize, &flags);
+    mu_assert("ERROR: random data should be memcpyed", flags & BLOSC_MEMCPYED);
+    mu_assert("ERROR: bad roundtrip",
+              blosc_decompress(dest, dest2, size) == (int)size);
+    mu_assert("ERROR: bad roundtrip data", memcmp(src, dest2, size) == 0);
+  }
+
+  return 0;
+}
+
+
+/* Check that a compressible buffer with random parts is still compressed */
+static const char *test_partly_random(void) {
+  int32_t *isrc = (int32_t*)src;
+  size_t i;
+  int cbytes;
+
+  fill_random(size);
+  for (i = 0; i < size / (2 * sizeof(int32_t)); i++) {
+    isrc[i] = (int32_t)i;
+  }
+  if (blosc_set_compressor("lz4") < 0) {
+    return 0;     /* not available in this build */
+  }
+  cbytes = blosc_compress(5, BLOSC_SHUFFLE, typesize, size, src, dest,
+                          size + BLOSC_MAX_OVERHEAD);
+  mu_assert("ERROR: partly random data should be compressed",
+            cbytes > 0 && cbytes < (int)(3 * size / 4));
+  mu_assert("ERROR: bad roundtrip",
+            blosc_decompress(dest, dest2, size) == (int)size);
+  mu_assert("ERROR: bad roundtrip data", memcmp(src, dest2, size) == 0);
+
+  return 0;
+}
+
+
+/* Check that data whose bytes look random, but that compresses once
+   shuffled, is compressed with the filters that expose it */
+static const char *test_shuffle_compressible(void) {
+  static const char* compressors[] = {"blosclz", "lz4", "lz4hc", "zlib", "zstd"};
+  static const int filters[] = {BLOSC_SHUFFLE, BLOSC_BITSHUFFLE,
+                                BLOSC_AUTOSHUFFLE};
+  uint64_t *lsrc = (uint64_t*)src;
+  size_t c, f, i;
+  int cbytes;
+
+  /* A Weyl sequence: flat histogram and no repeats in the raw bytes */
+  for (i = 0; i < size / sizeof(uint64_t); i++) {
+    lsrc[i] = (uint64_t)i * 0x9E3779B97F4A7C15ULL;
+  }
+  for (c = 0; c < sizeof(compressors) / sizeof(compressors[0]); c++) {
+    if (blosc_set_compressor(compressors[c]) < 0) {
+      continue;     /* not available in this build */
+    }
+    for (f = 0; f < sizeof(filters) / sizeof(filters[0]); f++) {
+      cbytes = blosc_compress(5, filters[f], typesize, size, src, dest,
+                              size + BLOSC_MAX_OVERHEAD);
+      mu_assert("ERROR: shuffle-compressible data should be compressed",
+                cbytes > 0 && cbytes < (int)(size / 4));
+      mu_assert("ERROR: bad roundtrip",
+                blosc_decompress(dest, dest2, size) == (int)size);
+      mu_assert("ERROR: bad roundtrip data", memcmp(src, dest2, size) == 0);
+    }
+  }
+
+  return 0;
+}
+
+
+static const char *all_tests(void) {
+  mu_run_test(test_random);
+  mu_run_test(test_partly_random);
+  mu_run_test(test_shuffle_compressible);
+
+  return 0;
+}
+
+#define BUFFER_ALIGN_SIZE   32
+
+int main(int argc, char **argv) {
+  const char *result;
+
+  printf("STARTING TESTS for %s", argv[0]);
+
+  blosc_init();
+  blosc_set_nthreads(1);
+
+  /* Initialize buffers */
+  src = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  dest = blosc_test_malloc(BUFFER_ALIGN_SIZE, size + BLOSC_MAX_OVERHEAD);
+  dest2 = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != 0) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  blosc_test_free(src);
+  blosc_test_free(dest);
+  blosc_test_free(dest2);
+  blosc_destroy();
+
+  return result != 0;
+}
@@ -0,0 +1,203 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for the decompression in place.
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+int tests_run = 0;
+
+/* Global vars */
+int32_t *src, *noise, *mixed;
+uint8_t *comp, *buffer;
+size_t size = 1024 * 1024;      /* must be divisible by 4 */
+size_t typesize = 4;
+
+
+/* Compress `nbytes` of `buf`, load it at the tail of a buffer with the
+   margin and decompress it there */
+static const char *check_inplace(const int32_t* buf, size_t nbytes,
+                                 const char* compressor, int doshuffle,
+                                 size_t blocksize, int nthreads) {
+  size_t margin, margin2, bufsize;
+  int cbytes, dbytes;
+  size_t nbstarts;
+
+  cbytes = blosc_compress_ctx(5, doshuffle, typesize, nbytes, buf, comp,
+                              2 * nbytes + BLOSC_MAX_OVERHEAD, compressor,
+                              blocksize, nthreads);
+  mu_assert("ERROR: compression failed", cbytes > 0);
+  mu_assert("ERROR: margin not computed",
+            blosc_decompress_inplace_margin(comp, &margin) == 0);
+  bufsize = nbytes + margin;
+  mu_assert("ERROR: margin cannot hold the compressed buffer",
+            bufsize >= (size_t)cbytes);
+
+  /* The header and the bstarts are enough for the margin */
+  nbstarts = (nbytes + blocksize - 1) / blocksize * sizeof(int32_t);
+  if (BLOSC_MAX_OVERHEAD + nbstarts < (size_t)cbytes) {
+    memset(buffer, 0, (size_t)cbytes);
+    memcpy(buffer, comp, BLOSC_MAX_OVERHEAD + nbstarts);
+    mu_assert("ERROR: margin not computed from the bstarts",
+              blosc_decompress_inplace_margin(buffer, &margin2) == 0);
+    mu_assert("ERROR: margins differ", margin2 == margin);
+  }
+
+  memcpy(buffer + bufsize - cbytes, comp, (size_t)cbytes);
+  dbytes = blosc_decompress_inplace(buffer, bufsize, (size_t)cbytes);
+  mu_assert("ERROR: decompression in place failed", dbytes == (int)nbytes);
+  mu_assert("ERROR: roundtrip failed", memcmp(buf, buffer, nbytes) == 0);
+
+  if (margin > 0) {
+    /* One byte less would overwrite data before it is read, or would
+       not even hold the compressed buffer */
+    if (bufsize > (size_t)cbytes) {
+      memcpy(buffer + bufsize - 1 - cbytes, comp, (size_t)cbytes);
+    }
+    mu_assert("ERROR: too small buffer accepted",
+              blosc_decompress_inplace(buffer, bufsize - 1, (size_t)cbytes) < 0);
+  }
+
+  return 0;
+}
+
+
+/* Check every codec and filter, for buffers compressed serially and
+   with threads (which store the blocks in any order) */
+static const char *test_codecs(void) {
+  static const char* compressors[] = {"blosclz", "lz4", "lz4hc", "snappy",
+                                      "zlib", "zstd"};
+  static const int filters[] = {BLOSC_NOSHUFFLE, BLOSC_SHUFFLE,
+                                BLOSC_BITSHUFFLE, BLOSC_AUTOSHUFFLE};
+  size_t c, f;
+  const char* result;
+  int nthreads;
+
+  for (c = 0; c < sizeof(compressors) / sizeof(compressors[0]); c++) {
+    if (blosc_compname_to_compcode(compressors[c]) < 0) {
+      continue;     /* not available in this build */
+    }
+    for (f = 0; f < sizeof(filters) / sizeof(filters[0]); f++) {
+      for (nthreads = 1; nthreads <= 3; nthreads += 2) {
+        result = check_inplace(src, size, compressors[c], filters[f],
+                               32 * 1024, nthreads);
+        if (result != 0) {
+          return result;
+        }
+      }
+    }
+  }
+
+  return 0;
+}
+
+
+/* Check incompressible data, a leftover block, incompressible blocks
+   mixed with compressible ones and the checksums */
+static const char *test_memcpyed(void) {
+  const char* result;
+  int checksum;
+
+  for (checksum = 0; checksum <= 1; checksum++) {
+    blosc_set_checksum(checksum);
+    result = check_inplace(noise, size, "lz4", BLOSC_NOSHUFFLE, 64 * 1024, 3);
+    if (result == 0) {
+      result = check_inplace(src, size - 12, "blosclz", BLOSC_SHUFFLE,
+                             64 * 1024, 1);
+    }
+    if (result == 0) {
+      result = check_inplace(mixed, size, "zstd", BLOSC_NOSHUFFLE, 16 * 1024, 1);
+    }
+    if (result != 0) {
+      blosc_set_checksum(0);
+      return result;
+    }
+  }
+  blosc_set_checksum(0);
+
+  return 0;
+}
+
+
+/* Check empty and invalid buffers */
+static const char *test_edge_cases(void) {
+  size_t margin;
+  int cbytes;
+
+  cbytes = blosc_compress_ctx(5, BLOSC_SHUFFLE, typesize, 0, src, comp,
+                              BLOSC_MAX_OVERHEAD, "blosclz", 0, 1);
+  mu_assert("ERROR: compression of an empty buffer failed", cbytes > 0);
+  mu_assert("ERROR: margin of an empty buffer",
+            blosc_decompress_inplace_margin(comp, &margin) == 0 &&
+            margin == (size_t)cbytes);
+  memcpy(buffer, comp, (size_t)cbytes);
+  mu_assert("ERROR: decompression of an empty buffer failed",
+            blosc_decompress_inplace(buffer, (size_t)cbytes, (size_t)cbytes) == 0);
+
+  mu_assert("ERROR: compressed size larger than the buffer accepted",
+            blosc_decompress_inplace(buffer, 10, 20) < 0);
+  memset(buffer, 0xff, BLOSC_MAX_OVERHEAD);
+  mu_assert("ERROR: invalid header accepted",
+            blosc_decompress_inplace_margin(buffer, &margin) < 0);
+  mu_assert("ERROR: invalid buffer accepted",
+            blosc_decompress_inplace(buffer, BLOSC_MAX_OVERHEAD,
+                                     BLOSC_MAX_OVERHEAD) < 0);
+
+  return 0;
+}
+
+
+static const char *all_tests(void) {
+  mu_run_test(test_codecs);
+  mu_run_test(test_memcpyed);
+  mu_run_test(test_edge_cases);
+
+  return 0;
+}
+
+#define BUFFER_ALIGN_SIZE   32
+
+int main(int argc, char **argv) {
+  const char *result;
+  size_t i;
+  uint32_t seed = 1;
+
+  printf("STARTING TESTS for %s", argv[0]);
+
+  blosc_init();
+
+  /* Initialize buffers */
+  src = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  noise = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  mixed = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  comp = blosc_test_malloc(BUFFER_ALIGN_SIZE, 2 * size + BLOSC_MAX_OVERHEAD);
+  buffer = blosc_test_malloc(BUFFER_ALIGN_SIZE, 2 * size + BLOSC_MAX_OVERHEAD);
+  for (i = 0; i < size / typesize; i++) {
+    src[i] = (int32_t)(i * 3 + (i % 17));
+    seed = seed * 1103515245 + 12345;
+    noise[i] = (int32_t)seed;
+    mixed[i] = (i / 4096) % 2 ? noise[i] : src[i];
+  }
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != 0) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  blosc_test_free(src);
+  blosc_test_free(noise);
+  blosc_test_free(mixed);
+  blosc_test_free(comp);
+  blosc_test_free(buffer);
+  blosc_destroy();
+
+  return result != 0;
+}
@@ -0,0 +1,224 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for the scatter-gather lists.
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+int tests_run = 0;
+
+/* Global vars */
+int32_t *src, *noise, *dest;
+uint8_t *comp, *comp2, *frags;
+size_t size = 1024 * 1024;      /* must be divisible by 4 */
+size_t typesize = 4;
+size_t blocksize = 32 * 1024;
+
+#define MAX_FRAGMENTS 64
+
+/* Fragment sizes (repeated until the buffer is covered): some smaller
+   than a block, some larger, empty ones and one that is a whole block */
+static const size_t layout1[] = {1000, 0, 70000, 32 * 1024, 5, 300000, 0};
+static const size_t layout2[] = {128 * 1024, 77777, 1};
+
+/* Split `size` bytes at `base` into fragments following `layout` */
+static int split(uint8_t* base, const size_t* layout, int nlayout,
+                 blosc_iovec* iov) {
+  size_t offset = 0, len;
+  int n = 0;
+
+  while (offset < size && n < MAX_FRAGMENTS) {
+    len = layout[n % nlayout];
+    if (len > size - offset) {
+      len = size - offset;
+    }
+    iov[n].iov_base = base + offset;
+    iov[n].iov_len = len;
+    offset += len;
+    n++;
+  }
+  return n;
+}
+
+
+/* Compress `buf` from fragments, check it against the contiguous
+   compression and decompress it into other fragments */
+static const char *check_iov(const int32_t* buf, const char* compressor,
+                             int doshuffle, int nthreads) {
+  blosc_iovec in[MAX_FRAGMENTS], out[MAX_FRAGMENTS];
+  int nin, nout, cbytes, cbytes2, nbytes;
+
+  nin = split((uint8_t*)buf, layout1, sizeof(layout1) / sizeof(layout1[0]), in);
+  cbytes = blosc_compress_ctx_iov(5, doshuffle, typesize, in, nin, comp,
+                                  size + BLOSC_MAX_OVERHEAD_CHECKSUMS(size),
+                                  compressor, blocksize, nthreads);
+  mu_assert("ERROR: compression of fragments failed", cbytes > 0);
+  cbytes2 = blosc_compress_ctx(5, doshuffle, typesize, size, buf, comp2,
+                               size + BLOSC_MAX_OVERHEAD_CHECKSUMS(size),
+                               compressor, blocksize, nthreads);
+  mu_assert("ERROR: compressed sizes differ", cbytes == cbytes2);
+  if (nthreads == 1) {
+    /* Threads may store the blocks in any order */
+    mu_assert("ERROR: compressed buffers differ",
+              memcmp(comp, comp2, (size_t)cbytes) == 0);
+  }
+
+  nout = split(frags, layout2, sizeof(layout2) / sizeof(layout2[0]), out);
+  memset(frags, 0, size);
+  nbytes = blosc_decompress_ctx_iov(comp, out, nout, nthreads);
+  mu_assert("ERROR: decompression into fragments failed", nbytes == (int)size);
+  mu_assert("ERROR: roundtrip failed", memcmp(buf, frags, size) == 0);
+
+  return 0;
+}
+
+
+/* Check every codec and filter, serial and with threads */
+static const char *test_codecs(void) {
+  static const char* compressors[] = {"blosclz", "lz4", "lz4hc", "snappy",
+                                      "zlib", "zstd"};
+  static const int filters[] = {BLOSC_NOSHUFFLE, BLOSC_SHUFFLE,
+                                BLOSC_BITSHUFFLE, BLOSC_AUTOSHUFFLE};
+  size_t c, f;
+  const char* result;
+  int nthreads;
+
+  for (c = 0; c < sizeof(compressors) / sizeof(compressors[0]); c++) {
+    if (blosc_compname_to_compcode(compressors[c]) < 0) {
+      continue;     /* not available in this build */
+    }
+    for (f = 0; f < sizeof(filters) / sizeof(filters[0]); f++) {
+      for (nthreads = 1; nthreads <= 3; nthreads += 2) {
+        result = check_iov(src, compressors[c], filters[f], nthreads);
+        if (result != 0) {
+          return result;
+        }
+      }
+    }
+  }
+
+  return 0;
+}
+
+
+/* Check incompressible data, which is copied, with and without checksums */
+static const char *test_memcpyed(void) {
+  const char* result;
+  int nthreads, checksum;
+
+  for (checksum = 0; checksum <= 1; checksum++) {
+    blosc_set_checksum(checksum);
+    for (nthreads = 1; nthreads <= 3; nthreads += 2) {
+      result = check_iov(noise, "lz4", BLOSC_NOSHUFFLE, nthreads);
+      if (result == 0) {
+        result = check_iov(src, "blosclz", BLOSC_SHUFFLE, nthreads);
+      }
+      if (result != 0) {
+        blosc_set_checksum(0);
+        return result;
+      }
+    }
+  }
+  blosc_set_checksum(0);
+
+  return 0;
+}
+
+
+/* Check a single fragment, an empty list and invalid lists */
+static const char *test_edge_cases(void) {
+  blosc_iovec iov[2];
+  int cbytes, nbytes;
+
+  iov[0].iov_base = src;
+  iov[0].iov_len = size;
+  cbytes = blosc_compress_ctx_iov(5, BLOSC_SHUFFLE, typesize, iov, 1, comp,
+                                  size + BLOSC_MAX_OVERHEAD, "blosclz", 0, 1);
+  mu_assert("ERROR: compression of a single fragment failed", cbytes > 0);
+  iov[0].iov_base = dest;
+  nbytes = blosc_decompress_ctx_iov(comp, iov, 1, 1);
+  mu_assert("ERROR: decompression into a fragment failed", nbytes == (int)size);
+  mu_assert("ERROR: roundtrip failed", memcmp(src, dest, size) == 0);
+
+  /* Too small for the whole buffer */
+  iov[0].iov_len = size / 2;
+  iov[1].iov_base = (uint8_t*)dest + size / 2;
+  iov[1].iov_len = size / 2 - 1;
+  nbytes = blosc_decompress_ctx_iov(comp, iov, 2, 1);
+  mu_assert("ERROR: too small fragments accepted", nbytes < 0);
+
+  cbytes = blosc_compress_ctx_iov(5, BLOSC_SHUFFLE, typesize, NULL, 0, comp,
+                                  BLOSC_MAX_OVERHEAD, "blosclz", 0, 1);
+  mu_assert("ERROR: compression of an empty list failed",
+            cbytes == BLOSC_MAX_OVERHEAD);
+  nbytes = blosc_decompress_ctx_iov(comp, NULL, 0, 1);
+  mu_assert("ERROR: decompression into an empty list failed", nbytes == 0);
+
+  iov[0].iov_base = NULL;
+  iov[0].iov_len = 10;
+  mu_assert("ERROR: NULL fragment accepted",
+            blosc_compress_ctx_iov(5, BLOSC_SHUFFLE, typesize, iov, 1, comp,
+                                   size + BLOSC_MAX_OVERHEAD, "blosclz", 0,
+                                   1) < 0);
+  mu_assert("ERROR: negative count accepted",
+            blosc_decompress_ctx_iov(comp, iov, -1, 1) < 0);
+
+  return 0;
+}
+
+
+static const char *all_tests(void) {
+  mu_run_test(test_codecs);
+  mu_run_test(test_memcpyed);
+  mu_run_test(test_edge_cases);
+
+  return 0;
+}
+
+#define BUFFER_ALIGN_SIZE   32
+
+int main(int argc, char **argv) {
+  const char *result;
+  size_t i;
+  uint32_t seed = 1;
+
+  printf("STARTING TESTS for %s", argv[0]);
+
+  blosc_init();
+
+  /* Initialize buffers */
+  src = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  noise = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  dest = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  frags = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  comp = blosc_test_malloc(BUFFER_ALIGN_SIZE, 2 * size + BLOSC_MAX_OVERHEAD);
+  comp2 = blosc_test_malloc(BUFFER_ALIGN_SIZE, 2 * size + BLOSC_MAX_OVERHEAD);
+  for (i = 0; i < size / typesize; i++) {
+    src[i] = (int32_t)(i * 3 + (i % 17));
+    seed = seed * 1103515245 + 12345;
+    noise[i] = (int32_t)seed;
+  }
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != 0) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  blosc_test_free(src);
+  blosc_test_free(noise);
+  blosc_test_free(dest);
+  blosc_test_free(frags);
+  blosc_test_free(comp);
+  blosc_test_free(comp2);
+  blosc_destroy();
+
+  return result != 0;
+}
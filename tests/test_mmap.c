@@ -0,0 +1,169 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for memory-mapped files of chunks.
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+int tests_run = 0;
+
+/* Global vars */
+void *src, *dest, *chunk;
+size_t size = 500 * 1000;
+int64_t cbytes[3];
+const char *filename = "test_mmap.bin";
+
+
+/* Write a file with a classic, an extended and a memcpyed chunk, and
+   optionally a truncated one */
+static int write_chunks(int truncated) {
+  FILE *file = fopen(filename, "wb");
+  int i;
+
+  if (file == NULL) {
+    return -1;
+  }
+  for (i = 0; i < 3; i++) {
+    if (i == 0) {
+      cbytes[i] = blosc_compress_ctx(5, BLOSC_SHUFFLE, 4, size, src, chunk,
+                                     size + BLOSC_MAX_OVERHEAD, "blosclz", 0, 1);
+    }
+    else {
+      cbytes[i] = blosc_compress_ctx64(i == 1 ? 5 : 0, BLOSC_SHUFFLE, 4, size,
+                                       src, chunk, size + BLOSC_MAX_OVERHEAD_EXTENDED,
+                                       "blosclz", 0, 1);
+    }
+    if (cbytes[i] <= 0 ||
+        fwrite(chunk, 1, (size_t)cbytes[i], file) != (size_t)cbytes[i]) {
+      fclose(file);
+      return -1;
+    }
+  }
+  if (truncated) {
+    fwrite(chunk, 1, (size_t)cbytes[2] / 2, file);
+  }
+  fclose(file);
+  return 0;
+}
+
+
+/* Check reading chunks through the mapping */
+static const char *test_mmap_read(void) {
+  blosc_mmap *map;
+  const void *pchunk;
+  size_t cbytes_, nbytes_;
+  int advice, i;
+
+  mu_assert("ERROR: cannot write the file", write_chunks(0) == 0);
+  for (advice = BLOSC_MMAP_NORMAL; advice <= BLOSC_MMAP_RANDOM; advice++) {
+    map = blosc_mmap_open(filename, advice);
+    mu_assert("ERROR: cannot map the file", map != NULL);
+
+    /* Out of order access validates the chunks before */
+    memset(dest, 0, size);
+    mu_assert("ERROR: bad getitem",
+              blosc_mmap_getitem(map, 2, 1000, 10, dest) == 40);
+    mu_assert("ERROR: bad getitem data",
+              memcmp((int32_t *)src + 1000, dest, 40) == 0);
+    for (i = 0; i < 3; i++) {
+      memset(dest, 0, size);
+      mu_assert("ERROR: bad decompressed size",
+                blosc_mmap_decompress(map, i, dest, size, 2) == (int64_t)size);
+      mu_assert("ERROR: bad decompressed data", memcmp(src, dest, size) == 0);
+      pchunk = blosc_mmap_chunk(map, i, &cbytes_);
+      mu_assert("ERROR: chunk not found", pchunk != NULL);
+      mu_assert("ERROR: bad chunk size", (int64_t)cbytes_ == cbytes[i]);
+      mu_assert("ERROR: chunk does not validate",
+                blosc_cbuffer_validate(pchunk, cbytes_, &nbytes_) == 0);
+    }
+    mu_assert("ERROR: bad nchunks", blosc_mmap_nchunks(map) == 3);
+    mu_assert("ERROR: chunk past the end found",
+              blosc_mmap_chunk(map, 3, NULL) == NULL);
+    mu_assert("ERROR: cannot change the advice",
+              blosc_mmap_advise(map, BLOSC_MMAP_SEQUENTIAL) == 0);
+    blosc_mmap_close(map);
+  }
+
+  return 0;
+}
+
+
+/* Check files with a truncated chunk, empty files and missing files */
+static const char *test_mmap_errors(void) {
+  blosc_mmap *map;
+  FILE *file;
+
+  mu_assert("ERROR: cannot write the file", write_chunks(1) == 0);
+  map = blosc_mmap_open(filename, BLOSC_MMAP_RANDOM);
+  mu_assert("ERROR: cannot map the file", map != NULL);
+  mu_assert("ERROR: truncated chunk counted", blosc_mmap_nchunks(map) == 3);
+  mu_assert("ERROR: truncated chunk decompressed",
+            blosc_mmap_decompress(map, 3, dest, size, 1) < 0);
+  mu_assert("ERROR: bad advice accepted", blosc_mmap_advise(map, 42) < 0);
+  blosc_mmap_close(map);
+
+  file = fopen(filename, "wb");
+  fclose(file);
+  map = blosc_mmap_open(filename, BLOSC_MMAP_NORMAL);
+  mu_assert("ERROR: cannot map an empty file", map != NULL);
+  mu_assert("ERROR: chunks in an empty file", blosc_mmap_nchunks(map) == 0);
+  blosc_mmap_close(map);
+  remove(filename);
+
+  mu_assert("ERROR: missing file mapped",
+            blosc_mmap_open("missing_mmap.bin", BLOSC_MMAP_NORMAL) == NULL);
+  mu_assert("ERROR: bad advice accepted",
+            blosc_mmap_open(filename, 42) == NULL);
+
+  return 0;
+}
+
+
+static const char *all_tests(void) {
+  mu_run_test(test_mmap_read);
+  mu_run_test(test_mmap_errors);
+
+  return 0;
+}
+
+#define BUFFER_ALIGN_SIZE   32
+
+int main(int argc, char **argv) {
+  int32_t *_src;
+  const char *result;
+  size_t i;
+
+  printf("STARTING TESTS for %s", argv[0]);
+
+  blosc_init();
+
+  /* Initialize buffers */
+  src = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  dest = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  chunk = blosc_test_malloc(BUFFER_ALIGN_SIZE, size + BLOSC_MAX_OVERHEAD_EXTENDED);
+  _src = (int32_t *)src;
+  for (i = 0; i < (size / 4); i++) {
+    _src[i] = (int32_t)(i * 11 % 1000);
+  }
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != 0) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  blosc_test_free(src);
+  blosc_test_free(dest);
+  blosc_test_free(chunk);
+
+  blosc_destroy();
+
+  return result != 0;
+}
@@ -0,0 +1,205 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for the blosc_reduce_ctx() and blosc_histogram_ctx()
+  functions.
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+int tests_run = 0;
+
+/* Global vars */
+void *src, *dest;
+int cbytes;
+size_t nitems = 100 * 1000;
+size_t blocksize = 16 * 1024;   /* several blocks per buffer */
+int nthreads[] = {1, 3};
+
+
+/* Compress `src` as int32 items */
+static int compress_int32(int clevel, int doshuffle) {
+  return blosc_compress_ctx(clevel, doshuffle, sizeof(int32_t),
+                            nitems * sizeof(int32_t), src, dest,
+                            nitems * sizeof(int32_t) + BLOSC_MAX_OVERHEAD,
+                            "blosclz", blocksize, 1);
+}
+
+
+/* Check sum, min, max and nonzero for int32 items */
+static const char *test_reduce_int32(void) {
+  int32_t *_src = (int32_t *)src;
+  int64_t sum = 0, nonzero = 0, result;
+  int32_t min = _src[0], max = _src[0];
+  size_t i, t;
+  int clevel;
+
+  for (i = 0; i < nitems; i++) {
+    sum += _src[i];
+    nonzero += (_src[i] != 0);
+    if (_src[i] < min) min = _src[i];
+    if (_src[i] > max) max = _src[i];
+  }
+
+  /* clevel 0 gives a memcpyed buffer */
+  for (clevel = 0; clevel < 10; clevel += 5) {
+    cbytes = compress_int32(clevel, BLOSC_SHUFFLE);
+    mu_assert("ERROR: cbytes is not positive", cbytes > 0);
+    for (t = 0; t < sizeof(nthreads) / sizeof(int); t++) {
+      mu_assert("ERROR: bad number of items",
+                blosc_reduce_ctx(dest, BLOSC_INT32, BLOSC_REDUCE_SUM, &result,
+                                 nthreads[t]) == (int)nitems);
+      mu_assert("ERROR: bad sum", result == sum);
+      blosc_reduce_ctx(dest, BLOSC_INT32, BLOSC_REDUCE_MIN, &result, nthreads[t]);
+      mu_assert("ERROR: bad min", result == min);
+      blosc_reduce_ctx(dest, BLOSC_INT32, BLOSC_REDUCE_MAX, &result, nthreads[t]);
+      mu_assert("ERROR: bad max", result == max);
+      blosc_reduce_ctx(dest, BLOSC_INT32, BLOSC_REDUCE_NONZERO, &result, nthreads[t]);
+      mu_assert("ERROR: bad nonzero", result == nonzero);
+    }
+  }
+
+  return 0;
+}
+
+
+/* Check reductions over float64 items, including NaNs */
+static const char *test_reduce_float64(void) {
+  double *_src = (double *)src;
+  size_t n = nitems / 2;
+  double sum = 0, result;
+  size_t i;
+
+  for (i = 0; i < n; i++) {
+    _src[i] = (double)(i % 1000) - 500.;
+    sum += _src[i];
+  }
+
+  cbytes = blosc_compress_ctx(5, BLOSC_SHUFFLE, sizeof(double), n * sizeof(double),
+                              src, dest, n * sizeof(double) + BLOSC_MAX_OVERHEAD,
+                              "blosclz", blocksize, 1);
+  mu_assert("ERROR: cbytes is not positive", cbytes > 0);
+  blosc_reduce_ctx(dest, BLOSC_FLOAT64, BLOSC_REDUCE_SUM, &result, 3);
+  mu_assert("ERROR: bad float sum", result == sum);
+
+  /* NaNs are skipped by min and max, even as first item */
+  _src[0] = 0. / 0.;
+  cbytes = blosc_compress_ctx(5, BLOSC_SHUFFLE, sizeof(double), n * sizeof(double),
+                              src, dest, n * sizeof(double) + BLOSC_MAX_OVERHEAD,
+                              "blosclz", blocksize, 1);
+  mu_assert("ERROR: cbytes is not positive", cbytes > 0);
+  blosc_reduce_ctx(dest, BLOSC_FLOAT64, BLOSC_REDUCE_MIN, &result, 1);
+  mu_assert("ERROR: bad float min", result == -500.);
+  blosc_reduce_ctx(dest, BLOSC_FLOAT64, BLOSC_REDUCE_MAX, &result, 3);
+  mu_assert("ERROR: bad float max", result == 499.);
+
+  return 0;
+}
+
+
+/* Check the histogram of int32 items */
+static const char *test_histogram(void) {
+  int32_t *_src = (int32_t *)src;
+  int64_t counts[10], total = 0;
+  size_t i, t;
+  int j;
+
+  for (i = 0; i < nitems; i++) {
+    _src[i] = (int32_t)(i % 200);
+  }
+  cbytes = compress_int32(5, BLOSC_SHUFFLE);
+  mu_assert("ERROR: cbytes is not positive", cbytes > 0);
+
+  for (t = 0; t < sizeof(nthreads) / sizeof(int); t++) {
+    mu_assert("ERROR: bad number of items",
+              blosc_histogram_ctx(dest, BLOSC_INT32, 0., 100., 10, counts,
+                                  nthreads[t]) == (int)nitems);
+    for (j = 0; j < 10; j++) {
+      mu_assert("ERROR: bad bin count", counts[j] == (int64_t)nitems / 20);
+      total += counts[j];
+    }
+    mu_assert("ERROR: out of range items were counted",
+              total == (int64_t)nitems / 2 * (t + 1));
+  }
+
+  return 0;
+}
+
+
+/* Check that wrong parameters are rejected */
+static const char *test_reduce_errors(void) {
+  int64_t result, counts[4];
+
+  cbytes = compress_int32(5, BLOSC_SHUFFLE);
+  mu_assert("ERROR: cbytes is not positive", cbytes > 0);
+  mu_assert("ERROR: bad dtype accepted",
+            blosc_reduce_ctx(dest, 42, BLOSC_REDUCE_SUM, &result, 1) < 0);
+  mu_assert("ERROR: bad op accepted",
+            blosc_reduce_ctx(dest, BLOSC_INT32, 42, &result, 1) < 0);
+  mu_assert("ERROR: histogram op accepted",
+            blosc_reduce_ctx(dest, BLOSC_INT32, BLOSC_REDUCE_HISTOGRAM,
+                             &result, 1) < 0);
+  mu_assert("ERROR: reinterpreting as int64 rejected",
+            blosc_reduce_ctx(dest, BLOSC_INT64, BLOSC_REDUCE_SUM, &result, 1) >= 0);
+  mu_assert("ERROR: empty histogram range accepted",
+            blosc_histogram_ctx(dest, BLOSC_INT32, 1., 1., 4, counts, 1) < 0);
+
+  /* Items that straddle the end of the buffer */
+  cbytes = blosc_compress_ctx(5, BLOSC_SHUFFLE, 1, 1001, src, dest,
+                              1001 + BLOSC_MAX_OVERHEAD, "blosclz", 0, 1);
+  mu_assert("ERROR: cbytes is not positive", cbytes > 0);
+  mu_assert("ERROR: partial items accepted",
+            blosc_reduce_ctx(dest, BLOSC_INT32, BLOSC_REDUCE_SUM, &result, 1) < 0);
+
+  return 0;
+}
+
+
+static const char *all_tests(void) {
+  mu_run_test(test_reduce_int32);
+  mu_run_test(test_reduce_float64);
+  mu_run_test(test_histogram);
+  mu_run_test(test_reduce_errors);
+
+  return 0;
+}
+
+#define BUFFER_ALIGN_SIZE   32
+
+int main(int argc, char **argv) {
+  int32_t *_src;
+  const char *result;
+  size_t i;
+
+  printf("STARTING TESTS for %s", argv[0]);
+
+  blosc_init();
+
+  /* Initialize buffers */
+  src = blosc_test_malloc(BUFFER_ALIGN_SIZE, nitems * sizeof(int32_t));
+  dest = blosc_test_malloc(BUFFER_ALIGN_SIZE,
+                           nitems * sizeof(int32_t) + BLOSC_MAX_OVERHEAD);
+  _src = (int32_t *)src;
+  for (i = 0; i < nitems; i++) {
+    _src[i] = (int32_t)((i * 7919) % 1000) - 300;
+  }
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != 0) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  blosc_test_free(src);
+  blosc_test_free(dest);
+
+  blosc_destroy();
+
+  return result != 0;
+}
@@ -0,0 +1,339 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for super-chunks.
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+int tests_run = 0;
+
+/* Global vars */
+void *src, *dest, *chunk;
+size_t chunksize = 200 * 1000;            /* bytes per chunk */
+int nchunks = 10;
+const char *filename = "test_schunk.bsc";
+
+
+/* Append all the chunks of `src` to `schunk` */
+static int64_t fill_schunk(blosc_schunk *schunk) {
+  int64_t rc = 0;
+  int i;
+
+  for (i = 0; i < nchunks; i++) {
+    rc = blosc_schunk_append_buffer(schunk, (uint8_t *)src + i * chunksize,
+                                    chunksize);
+    if (rc != i + 1) {
+      return -1;
+    }
+  }
+  return rc;
+}
+
+/* Check ranges of items, including ones that span several chunks */
+static const char *check_getitem(blosc_schunk *schunk) {
+  int64_t starts[] = {0, 1000, 49990, 49999, 120000, 0};
+  int64_t nitems[] = {10, 50000, 20, 1, 300000, 500000};
+  size_t i;
+
+  for (i = 0; i < sizeof(starts) / sizeof(int64_t); i++) {
+    memset(dest, 0, (size_t)nitems[i] * 4);
+    mu_assert("ERROR: bad getitem size",
+              blosc_schunk_getitem(schunk, starts[i], nitems[i], dest) == nitems[i] * 4);
+    mu_assert("ERROR: bad getitem data",
+              memcmp((int32_t *)src + starts[i], dest, (size_t)nitems[i] * 4) == 0);
+  }
+  return 0;
+}
+
+
+/* Check super-chunks in memory */
+static const char *test_schunk_memory(void) {
+  blosc_schunk *schunk;
+  int64_t nchunks_, nbytes_, cbytes_;
+  const char *msg;
+  int nthreads;
+  int cbytes;
+
+  for (nthreads = 1; nthreads <= 4; nthreads += 3) {
+    schunk = blosc_schunk_new(5, BLOSC_SHUFFLE, 4, "blosclz", nthreads);
+    mu_assert("ERROR: cannot create super-chunk", schunk != NULL);
+    mu_assert("ERROR: cannot append", fill_schunk(schunk) == nchunks);
+
+    /* A chunk compressed elsewhere */
+    cbytes = blosc_compress_ctx(0, BLOSC_NOSHUFFLE, 4, chunksize,
+                                (uint8_t *)src + nchunks * chunksize, chunk,
+                                chunksize + BLOSC_MAX_OVERHEAD, "blosclz", 0, 1);
+    mu_assert("ERROR: cbytes is not positive", cbytes > 0);
+    mu_assert("ERROR: cannot append a chunk",
+              blosc_schunk_append_chunk(schunk, chunk) == nchunks + 1);
+
+    blosc_schunk_sizes(schunk, &nchunks_, &nbytes_, &cbytes_);
+    mu_assert("ERROR: bad nchunks", nchunks_ == nchunks + 1);
+    mu_assert("ERROR: bad nbytes", nbytes_ == (int64_t)chunksize * (nchunks + 1));
+    mu_assert("ERROR: bad cbytes", cbytes_ > 0 && cbytes_ < nbytes_);
+
+    mu_assert("ERROR: bad chunk size",
+              blosc_schunk_decompress_chunk(schunk, 3, dest, chunksize) == (int64_t)chunksize);
+    mu_assert("ERROR: bad chunk data",
+              memcmp((uint8_t *)src + 3 * chunksize, dest, chunksize) == 0);
+    msg = check_getitem(schunk);
+    if (msg != NULL) {
+      return msg;
+    }
+
+    mu_assert("ERROR: cannot free", blosc_schunk_free(schunk) == 0);
+  }
+
+  return 0;
+}
+
+
+/* Check super-chunks in a file, reopening them */
+static const char *test_schunk_file(void) {
+  blosc_schunk *schunk;
+  int64_t nchunks_, nbytes_, cbytes_;
+  const char *msg;
+
+  schunk = blosc_schunk_create_file(filename, 5, BLOSC_SHUFFLE, 4, "blosclz", 3);
+  mu_assert("ERROR: cannot create super-chunk file", schunk != NULL);
+  mu_assert("ERROR: cannot append", fill_schunk(schunk) == nchunks);
+  msg = check_getitem(schunk);
+  if (msg != NULL) {
+    return msg;
+  }
+  mu_assert("ERROR: cannot free", blosc_schunk_free(schunk) == 0);
+
+  schunk = blosc_schunk_open_file(filename, 2);
+  mu_assert("ERROR: cannot open super-chunk file", schunk != NULL);
+  blosc_schunk_sizes(schunk, &nchunks_, &nbytes_, &cbytes_);
+  mu_assert("ERROR: bad nchunks", nchunks_ == nchunks);
+  mu_assert("ERROR: bad nbytes", nbytes_ == (int64_t)chunksize * nchunks);
+  msg = check_getitem(schunk);
+  if (msg != NULL) {
+    return msg;
+  }
+
+  /* Append after reopening */
+  mu_assert("ERROR: cannot append after reopening",
+            blosc_schunk_append_buffer(schunk, (uint8_t *)src + nchunks * chunksize,
+                                       chunksize) == nchunks + 1);
+  mu_assert("ERROR: cannot free", blosc_schunk_free(schunk) == 0);
+
+  schunk = blosc_schunk_open_file(filename, 1);
+  mu_assert("ERROR: cannot reopen super-chunk file", schunk != NULL);
+  blosc_schunk_sizes(schunk, &nchunks_, &nbytes_, &cbytes_);
+  mu_assert("ERROR: bad nchunks after append", nchunks_ == nchunks + 1);
+  mu_assert("ERROR: bad last chunk size",
+            blosc_schunk_decompress_chunk(schunk, nchunks, dest, chunksize) == (int64_t)chunksize);
+  mu_assert("ERROR: bad last chunk data",
+            memcmp((uint8_t *)src + nchunks * chunksize, dest, chunksize) == 0);
+  mu_assert("ERROR: cannot free", blosc_schunk_free(schunk) == 0);
+
+  return 0;
+}
+
+
+/* Store the blocks of the chunk `in` (compressed serially) in reverse
+   order into `out`, as threads may do */
+static void reverse_blocks(const uint8_t *in, uint8_t *out) {
+  size_t nbytes, cbytes, blocksize;
+  int32_t j, nblocks, bstart, bstop, pos;
+
+  blosc_cbuffer_sizes(in, &nbytes, &cbytes, &blocksize);
+  nblocks = (int32_t)((nbytes + blocksize - 1) / blocksize);
+  pos = BLOSC_MIN_HEADER_LENGTH + nblocks * 4;
+  memcpy(out, in, (size_t)pos);
+  for (j = nblocks - 1; j >= 0; j--) {
+    memcpy(&bstart, in + BLOSC_MIN_HEADER_LENGTH + j * 4, 4);
+    if (j + 1 < nblocks) {
+      memcpy(&bstop, in + BLOSC_MIN_HEADER_LENGTH + (j + 1) * 4, 4);
+    }
+    else {
+      bstop = (int32_t)cbytes;
+    }
+    memcpy(out + pos, in + bstart, (size_t)(bstop - bstart));
+    memcpy(out + BLOSC_MIN_HEADER_LENGTH + j * 4, &pos, 4);
+    pos += bstop - bstart;
+  }
+}
+
+/* Check small ranges from every block of a file with chunks compressed
+   by several threads, which store the blocks in any order */
+static const char *test_schunk_file_threads(void) {
+  blosc_schunk *schunk;
+  size_t size = chunksize * nchunks;
+  int64_t start, nitems = 10;
+  uint8_t *serial;
+  int cbytes;
+
+  schunk = blosc_schunk_create_file(filename, 5, BLOSC_SHUFFLE, 4, "blosclz", 8);
+  mu_assert("ERROR: cannot create super-chunk file", schunk != NULL);
+  serial = malloc(size + BLOSC_MAX_OVERHEAD);
+  mu_assert("ERROR: cannot allocate", serial != NULL);
+  cbytes = blosc_compress_ctx(5, BLOSC_SHUFFLE, 4, size, src, serial,
+                              size + BLOSC_MAX_OVERHEAD, "blosclz", 64 * 1024, 8);
+  mu_assert("ERROR: compression failed", cbytes > 0);
+  mu_assert("ERROR: cannot append a chunk",
+            blosc_schunk_append_chunk(schunk, serial) == 1);
+  /* The same blocks in reverse order, for not depending on timing */
+  cbytes = blosc_compress_ctx(5, BLOSC_SHUFFLE, 4, size, src, serial,
+                              size + BLOSC_MAX_OVERHEAD, "blosclz", 64 * 1024, 1);
+  mu_assert("ERROR: compression failed", cbytes > 0);
+  reverse_blocks(serial, chunk);
+  mu_assert("ERROR: cannot append a chunk",
+            blosc_schunk_append_chunk(schunk, chunk) == 2);
+  free(serial);
+  mu_assert("ERROR: cannot free", blosc_schunk_free(schunk) == 0);
+
+  schunk = blosc_schunk_open_file(filename, 8);
+  mu_assert("ERROR: cannot open super-chunk file", schunk != NULL);
+  for (start = 0; start + nitems <= (int64_t)size / 2; start += 997) {
+    mu_assert("ERROR: bad getitem size",
+              blosc_schunk_getitem(schunk, start, nitems, dest) == nitems * 4);
+    mu_assert("ERROR: bad getitem data",
+              memcmp((int32_t *)src + start % (size / 4), dest,
+                     (size_t)nitems * 4) == 0);
+  }
+  mu_assert("ERROR: cannot free", blosc_schunk_free(schunk) == 0);
+  remove(filename);
+
+  return 0;
+}
+
+
+/* Check that files without an index are recovered */
+static const char *test_schunk_recover(void) {
+  blosc_schunk *schunk;
+  int64_t nchunks_, nbytes_, cbytes_;
+  const char *msg;
+  FILE *file;
+  long size;
+
+  /* Chop the index and the footer off */
+  schunk = blosc_schunk_create_file(filename, 5, BLOSC_SHUFFLE, 4, "blosclz", 1);
+  mu_assert("ERROR: cannot create super-chunk file", schunk != NULL);
+  mu_assert("ERROR: cannot append", fill_schunk(schunk) == nchunks);
+  blosc_schunk_sizes(schunk, &nchunks_, &nbytes_, &cbytes_);
+  mu_assert("ERROR: cannot free", blosc_schunk_free(schunk) == 0);
+  size = 16 + (long)cbytes_;
+  file = fopen(filename, "rb");
+  mu_assert("ERROR: cannot read the file", file != NULL);
+  fseek(file, 0, SEEK_END);
+  mu_assert("ERROR: no index in the file", ftell(file) > size);
+  fclose(file);
+  /* Rewrite just the header and the chunks */
+  {
+    uint8_t *contents = malloc((size_t)size);
+    file = fopen(filename, "rb");
+    mu_assert("ERROR: cannot read the file",
+              fread(contents, 1, (size_t)size, file) == (size_t)size);
+    fclose(file);
+    file = fopen(filename, "wb");
+    fwrite(contents, 1, (size_t)size, file);
+    fclose(file);
+    free(contents);
+  }
+
+  schunk = blosc_schunk_open_file(filename, 2);
+  mu_assert("ERROR: cannot open a file without index", schunk != NULL);
+  blosc_schunk_sizes(schunk, &nchunks_, &nbytes_, &cbytes_);
+  mu_assert("ERROR: bad recovered nchunks", nchunks_ == nchunks);
+  mu_assert("ERROR: bad recovered nbytes", nbytes_ == (int64_t)chunksize * nchunks);
+  msg = check_getitem(schunk);
+  if (msg != NULL) {
+    return msg;
+  }
+  mu_assert("ERROR: cannot free", blosc_schunk_free(schunk) == 0);
+
+  /* The index has been written back */
+  schunk = blosc_schunk_open_file(filename, 1);
+  mu_assert("ERROR: cannot reopen a recovered file", schunk != NULL);
+  blosc_schunk_sizes(schunk, &nchunks_, &nbytes_, &cbytes_);
+  mu_assert("ERROR: bad nchunks after recovery", nchunks_ == nchunks);
+  mu_assert("ERROR: cannot free", blosc_schunk_free(schunk) == 0);
+
+  remove(filename);
+  return 0;
+}
+
+
+/* Check errors */
+static const char *test_schunk_errors(void) {
+  blosc_schunk *schunk;
+  int32_t item;
+
+  mu_assert("ERROR: bad clevel accepted",
+            blosc_schunk_new(10, BLOSC_SHUFFLE, 4, "blosclz", 1) == NULL);
+  mu_assert("ERROR: bad compressor accepted",
+            blosc_schunk_new(5, BLOSC_SHUFFLE, 4, "nocomp", 1) == NULL);
+  mu_assert("ERROR: missing file opened",
+            blosc_schunk_open_file("missing_schunk.bsc", 1) == NULL);
+
+  schunk = blosc_schunk_new(5, BLOSC_SHUFFLE, 4, "blosclz", 1);
+  mu_assert("ERROR: cannot create super-chunk", schunk != NULL);
+  mu_assert("ERROR: partial items accepted",
+            blosc_schunk_append_buffer(schunk, src, 1001) < 0);
+  mu_assert("ERROR: cannot append", fill_schunk(schunk) == nchunks);
+  mu_assert("ERROR: out of bounds items accepted",
+            blosc_schunk_getitem(schunk, (int64_t)chunksize * nchunks / 4, 1, &item) < 0);
+  mu_assert("ERROR: negative start accepted",
+            blosc_schunk_getitem(schunk, -1, 1, &item) < 0);
+  mu_assert("ERROR: out of bounds chunk accepted",
+            blosc_schunk_decompress_chunk(schunk, nchunks, dest, chunksize) < 0);
+  mu_assert("ERROR: cannot free", blosc_schunk_free(schunk) == 0);
+
+  return 0;
+}
+
+
+static const char *all_tests(void) {
+  mu_run_test(test_schunk_memory);
+  mu_run_test(test_schunk_file);
+  mu_run_test(test_schunk_file_threads);
+  mu_run_test(test_schunk_recover);
+  mu_run_test(test_schunk_errors);
+
+  return 0;
+}
+
+#define BUFFER_ALIGN_SIZE   32
+
+int main(int argc, char **argv) {
+  int32_t *_src;
+  const char *result;
+  size_t i, size = chunksize * (nchunks + 1);
+
+  printf("STARTING TESTS for %s", argv[0]);
+
+  blosc_init();
+
+  /* Initialize buffers */
+  src = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  dest = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  chunk = blosc_test_malloc(BUFFER_ALIGN_SIZE, size + BLOSC_MAX_OVERHEAD);
+  _src = (int32_t *)src;
+  for (i = 0; i < (size / 4); i++) {
+    _src[i] = (int32_t)(i * 7 % 1000 + i / 1000);
+  }
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != 0) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  blosc_test_free(src);
+  blosc_test_free(dest);
+  blosc_test_free(chunk);
+
+  blosc_destroy();
+
+  return result != 0;
+}
@@ -13,8 +13,8 @@
 #include "../blosc/shuffle.h"
 #include "../blosc/shuffle-generic.h"
 
-/* Include accelerated shuffles if supported by this compiler.
-   TODO: Need to also do run-time CPU feature support here. */
+/* Include accelerated shuffles if supported by this compiler.  Whether the
+   host processor supports them is checked at run-time. */
 
 #if defined(SHUFFLE_AVX2_ENABLED)
   #include "../blosc/shuffle-avx2.h"
@@ -26,6 +26,11 @@ static int test_shuffle_roundtrip_avx2(size_t type_size, size_t num_elements,
   size_t buffer_alignment, int test_type)
 {
 #if defined(SHUFFLE_AVX2_ENABLED)
+  if (!(blosc_internal_cpu_features() & BLOSC_HAVE_AVX2)) {
+    /* The host processor cannot run the kernels */
+    return EXIT_SUCCESS;
+  }
+
   size_t buffer_size = type_size * num_elements;
 
   /* Allocate memory for the test. */
@@ -0,0 +1,152 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Roundtrip tests for the AVX512BW-accelerated shuffle/unshuffle and
+  bitshuffle/bitunshuffle.
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+#include "../blosc/shuffle.h"
+#include "../blosc/shuffle-generic.h"
+#include "../blosc/bitshuffle-generic.h"
+
+/* Include accelerated shuffles if supported by this compiler.  Whether the
+   host processor supports them is checked at run-time. */
+
+#if defined(SHUFFLE_AVX512_ENABLED)
+  #include "../blosc/shuffle-avx512.h"
+  #include "../blosc/bitshuffle-avx512.h"
+#endif  /* defined(SHUFFLE_AVX512_ENABLED) */
+
+
+/** Roundtrip tests for the AVX512BW-accelerated shuffle/unshuffle. */
+static int test_shuffle_roundtrip_avx512(size_t type_size, size_t num_elements,
+  size_t buffer_alignment, int test_type)
+{
+#if defined(SHUFFLE_AVX512_ENABLED)
+  if (!(blosc_internal_cpu_features() & BLOSC_HAVE_AVX512BW)) {
+    /* The host processor cannot run the kernels */
+    return EXIT_SUCCESS;
+  }
+
+  /* Bitshuffle works on multiples of 8 elements */
+  if (test_type >= 3) {
+    num_elements -= num_elements % 8;
+  }
+  size_t buffer_size = type_size * num_elements;
+
+  /* Allocate memory for the test. */
+  void* original = blosc_test_malloc(buffer_alignment, buffer_size);
+  void* shuffled = blosc_test_malloc(buffer_alignment, buffer_size);
+  void* unshuffled = blosc_test_malloc(buffer_alignment, buffer_size);
+  void* tmp = blosc_test_malloc(buffer_alignment, buffer_size);
+
+  /* Fill the input data buffer with random values. */
+  blosc_test_fill_random(original, buffer_size);
+
+  /* Shuffle/unshuffle, selecting the implementations based on the test type. */
+  switch(test_type)
+  {
+    case 0:
+      /* avx512/avx512 */
+      blosc_internal_shuffle_avx512(type_size, buffer_size, original, shuffled);
+      blosc_internal_unshuffle_avx512(type_size, buffer_size, shuffled, unshuffled);
+      break;
+    case 1:
+      /* generic/avx512 */
+      blosc_internal_shuffle_generic(type_size, buffer_size, original, shuffled);
+      blosc_internal_unshuffle_avx512(type_size, buffer_size, shuffled, unshuffled);
+      break;
+    case 2:
+      /* avx512/generic */
+      blosc_internal_shuffle_avx512(type_size, buffer_size, original, shuffled);
+      blosc_internal_unshuffle_generic(type_size, buffer_size, shuffled, unshuffled);
+      break;
+    case 3:
+      /* bitshuffle avx512/avx512 */
+      blosc_internal_bshuf_trans_bit_elem_avx512(original, shuffled, num_elements, type_size, tmp);
+      blosc_internal_bshuf_untrans_bit_elem_avx512(shuffled, unshuffled, num_elements, type_size, tmp);
+      break;
+    case 4:
+      /* bitshuffle scal/avx512 */
+      blosc_internal_bshuf_trans_bit_elem_scal(original, shuffled, num_elements, type_size, tmp);
+      blosc_internal_bshuf_untrans_bit_elem_avx512(shuffled, unshuffled, num_elements, type_size, tmp);
+      break;
+    default:
+      fprintf(stderr, "Invalid test type specified (%d).", test_type);
+      return EXIT_FAILURE;
+  }
+
+  /* The round-tripped data matches the original data when the
+     result of memcmp is 0. */
+  int exit_code = memcmp(original, unshuffled, buffer_size) ?
+    EXIT_FAILURE : EXIT_SUCCESS;
+
+  /* Free allocated memory. */
+  blosc_test_free(original);
+  blosc_test_free(shuffled);
+  blosc_test_free(unshuffled);
+  blosc_test_free(tmp);
+
+  return exit_code;
+#else
+  return EXIT_SUCCESS;
+#endif /* defined(SHUFFLE_AVX512_ENABLED) */
+}
+
+
+/** Required number of arguments to this test, including the executable name. */
+#define TEST_ARG_COUNT  5
+
+int main(int argc, char **argv)
+{
+  uint32_t type_size;
+  uint32_t num_elements;
+  uint32_t buffer_align_size;
+  uint32_t test_type;
+
+  /*  argv[1]: sizeof(element type)
+      argv[2]: number of elements
+      argv[3]: buffer alignment
+      argv[4]: test type
+  */
+
+  /*  Verify the correct number of command-line args have been specified. */
+  if (TEST_ARG_COUNT != argc)
+  {
+    blosc_test_print_bad_argcount_msg(TEST_ARG_COUNT, argc);
+    return EXIT_FAILURE;
+  }
+
+  /* Parse arguments */
+  if (!blosc_test_parse_uint32_t(argv[1], &type_size) || (type_size < 1))
+  {
+    blosc_test_print_bad_arg_msg(1);
+    return EXIT_FAILURE;
+  }
+
+  if (!blosc_test_parse_uint32_t(argv[2], &num_elements) || (num_elements < 1))
+  {
+    blosc_test_print_bad_arg_msg(2);
+    return EXIT_FAILURE;
+  }
+
+  if (!blosc_test_parse_uint32_t(argv[3], &buffer_align_size)
+    || (buffer_align_size & (buffer_align_size - 1))
+    || (buffer_align_size < sizeof(void*)))
+  {
+    blosc_test_print_bad_arg_msg(3);
+    return EXIT_FAILURE;
+  }
+
+  if (!blosc_test_parse_uint32_t(argv[4], &test_type) || (test_type > 4))
+  {
+    blosc_test_print_bad_arg_msg(4);
+    return EXIT_FAILURE;
+  }
+
+  /* Run the test. */
+  return test_shuffle_roundtrip_avx512(type_size, num_elements, buffer_align_size, test_type);
+}
@@ -0,0 +1,216 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for the compression into a sink.
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+int tests_run = 0;
+
+/* Global vars */
+int32_t *src, *noise, *dest;
+uint8_t *comp;
+size_t size = 4 * 1024 * 1024;      /* must be divisible by 4 */
+size_t typesize = 4;
+
+/* A buffer of the exact compressed size, filled by the sink */
+struct output {
+  uint8_t* data;
+  size_t cbytes;
+  size_t filled;
+  int ncalls;
+  int fail_at;              /* call that fails, or 0 */
+};
+
+
+static int exact_sink(const void* data, size_t size_, void* user_data) {
+  struct output* out = (struct output*)user_data;
+  size_t nbytes, cbytes, blocksize;
+
+  out->ncalls++;
+  if (out->ncalls == out->fail_at) {
+    return -7;
+  }
+  if (out->data == NULL) {
+    /* The first call has the header */
+    if (size_ < BLOSC_MIN_HEADER_LENGTH) {
+      return -1;
+    }
+    blosc_cbuffer_sizes(data, &nbytes, &cbytes, &blocksize);
+    out->data = malloc(cbytes);
+    out->cbytes = cbytes;
+    out->filled = 0;
+  }
+  if (out->filled + size_ > out->cbytes) {
+    return -1;
+  }
+  memcpy(out->data + out->filled, data, size_);
+  out->filled += size_;
+  return 0;
+}
+
+/* Compress `buf` into a sink and check it against blosc_compress_ctx() */
+static const char *check_sink(const int32_t* buf, size_t nbytes,
+                              const char* compressor, int doshuffle,
+                              int nthreads) {
+  struct output out = {NULL, 0, 0, 0, 0};
+  int cbytes, ccbytes, dbytes;
+
+  cbytes = blosc_compress_ctx_sink(5, doshuffle, typesize, nbytes, buf,
+                                   compressor, 0, nthreads, exact_sink, &out);
+  mu_assert("ERROR: compression into a sink failed", cbytes > 0);
+  mu_assert("ERROR: sink did not get the whole buffer",
+            out.data != NULL && out.filled == (size_t)cbytes &&
+            out.cbytes == (size_t)cbytes);
+
+  /* With room for the checksums of a copied buffer too */
+  ccbytes = blosc_compress_ctx(5, doshuffle, typesize, nbytes, buf, comp,
+                               2 * nbytes + BLOSC_MAX_OVERHEAD, compressor, 0,
+                               nthreads);
+  mu_assert("ERROR: compressed sizes differ", ccbytes == cbytes);
+  if (nthreads == 1) {
+    /* Threads may store the blocks in any order */
+    mu_assert("ERROR: compressed buffers differ",
+              memcmp(out.data, comp, (size_t)cbytes) == 0);
+  }
+
+  dbytes = blosc_decompress_ctx(out.data, dest, nbytes, nthreads);
+  mu_assert("ERROR: decompression failed", dbytes == (int)nbytes);
+  mu_assert("ERROR: roundtrip failed", memcmp(buf, dest, nbytes) == 0);
+  free(out.data);
+
+  return 0;
+}
+
+
+/* Check every codec and filter, serial and with threads */
+static const char *test_codecs(void) {
+  static const char* compressors[] = {"blosclz", "lz4", "lz4hc", "snappy",
+                                      "zlib", "zstd"};
+  static const int filters[] = {BLOSC_SHUFFLE, BLOSC_BITSHUFFLE,
+                                BLOSC_AUTOSHUFFLE};
+  size_t c, f;
+  const char* result;
+  int nthreads;
+
+  for (c = 0; c < sizeof(compressors) / sizeof(compressors[0]); c++) {
+    if (blosc_compname_to_compcode(compressors[c]) < 0) {
+      continue;     /* not available in this build */
+    }
+    for (f = 0; f < sizeof(filters) / sizeof(filters[0]); f++) {
+      for (nthreads = 1; nthreads <= 3; nthreads += 2) {
+        result = check_sink(src, size, compressors[c], filters[f], nthreads);
+        if (result != 0) {
+          return result;
+        }
+      }
+    }
+  }
+
+  return 0;
+}
+
+
+/* Check incompressible and small buffers, which are stored as is */
+static const char *test_memcpyed(void) {
+  const char* result;
+  int nthreads;
+
+  for (nthreads = 1; nthreads <= 3; nthreads += 2) {
+    result = check_sink(noise, size, "lz4", BLOSC_NOSHUFFLE, nthreads);
+    if (result != 0) {
+      return result;
+    }
+  }
+  result = check_sink(src, 40, "blosclz", BLOSC_SHUFFLE, 1);
+  if (result != 0) {
+    return result;
+  }
+  return check_sink(src, 0, "blosclz", BLOSC_SHUFFLE, 1);
+}
+
+
+/* Check the block checksums */
+static const char *test_checksums(void) {
+  const char* result;
+
+  blosc_set_checksum(1);
+  result = check_sink(src, size, "blosclz", BLOSC_SHUFFLE, 3);
+  if (result == 0) {
+    result = check_sink(noise, size, "blosclz", BLOSC_SHUFFLE, 1);
+  }
+  blosc_set_checksum(0);
+
+  return result;
+}
+
+
+/* Check that the errors of the sink are reported */
+static const char *test_sink_error(void) {
+  struct output out = {NULL, 0, 0, 0, 2};
+  int cbytes;
+
+  cbytes = blosc_compress_ctx_sink(5, BLOSC_SHUFFLE, typesize, size, src,
+                                   "blosclz", 16 * 1024, 2, exact_sink, &out);
+  mu_assert("ERROR: sink error not reported", cbytes < 0);
+  free(out.data);
+  mu_assert("ERROR: missing sink accepted",
+            blosc_compress_ctx_sink(5, BLOSC_SHUFFLE, typesize, size, src,
+                                    "blosclz", 0, 1, NULL, NULL) < 0);
+
+  return 0;
+}
+
+
+static const char *all_tests(void) {
+  mu_run_test(test_codecs);
+  mu_run_test(test_memcpyed);
+  mu_run_test(test_checksums);
+  mu_run_test(test_sink_error);
+
+  return 0;
+}
+
+#define BUFFER_ALIGN_SIZE   32
+
+int main(int argc, char **argv) {
+  const char *result;
+  size_t i;
+  uint32_t seed = 1;
+
+  printf("STARTING TESTS for %s", argv[0]);
+
+  blosc_init();
+
+  /* Initialize buffers */
+  src = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  noise = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  dest = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  comp = blosc_test_malloc(BUFFER_ALIGN_SIZE, 2 * size + BLOSC_MAX_OVERHEAD);
+  for (i = 0; i < size / typesize; i++) {
+    src[i] = (int32_t)(i * 3 + (i % 17));
+    seed = seed * 1103515245 + 12345;
+    noise[i] = (int32_t)seed;
+  }
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != 0) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  blosc_test_free(src);
+  blosc_test_free(noise);
+  blosc_test_free(dest);
+  blosc_test_free(comp);
+  blosc_destroy();
+
+  return result != 0;
+}
@@ -0,0 +1,155 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for the per-phase timings and counters.
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+int tests_run = 0;
+
+/* Global vars */
+int32_t *src, *noise, *dest;
+uint8_t *comp;
+size_t size = 4 * 1024 * 1024;      /* must be divisible by 4 */
+size_t typesize = 4;
+int enabled;                        /* whether the stats are compiled in */
+
+
+/* Check that the stats start from zero after a reset */
+static const char *test_reset(void) {
+  blosc_stats stats;
+  int cbytes;
+
+  cbytes = blosc_compress_ctx(5, BLOSC_SHUFFLE, typesize, size, src, comp,
+                              size + BLOSC_MAX_OVERHEAD, "lz4", 0, 1);
+  mu_assert("ERROR: compression failed", cbytes > 0);
+  blosc_reset_stats();
+  mu_assert("ERROR: stats not available",
+            blosc_get_stats(&stats) == (enabled ? 0 : -1));
+  mu_assert("ERROR: stats not reset",
+            stats.filter_cycles == 0 && stats.codec_cycles == 0 &&
+            stats.copy_cycles == 0 && stats.wait_cycles == 0 &&
+            stats.incompressible_splits == 0 &&
+            stats.memcpy_fallbacks == 0 && stats.recompressions == 0);
+
+  return 0;
+}
+
+
+/* Check the filter and codec timings of a roundtrip, with threads */
+static const char *test_phases(void) {
+  blosc_stats stats;
+  int cbytes, nbytes;
+
+  if (!enabled) {
+    return 0;
+  }
+  blosc_reset_stats();
+  cbytes = blosc_compress_ctx(5, BLOSC_SHUFFLE, typesize, size, src, comp,
+                              size + BLOSC_MAX_OVERHEAD, "lz4", 0, 4);
+  mu_assert("ERROR: compression failed", cbytes > 0 && cbytes < (int)size);
+  nbytes = blosc_decompress_ctx(comp, dest, size, 4);
+  mu_assert("ERROR: decompression failed", nbytes == (int)size);
+  mu_assert("ERROR: roundtrip failed", memcmp(src, dest, size) == 0);
+
+  blosc_get_stats(&stats);
+  mu_assert("ERROR: no filter time", stats.filter_cycles > 0);
+  mu_assert("ERROR: no codec time", stats.codec_cycles > 0);
+  mu_assert("ERROR: fallback counted for compressible data",
+            stats.memcpy_fallbacks == 0 && stats.recompressions == 0);
+
+  return 0;
+}
+
+
+/* Check the counters for incompressible data, with the global context */
+static const char *test_incompressible(void) {
+  blosc_stats stats;
+  int cbytes, nbytes;
+
+  if (!enabled) {
+    return 0;
+  }
+  blosc_reset_stats();
+  blosc_set_nthreads(1);
+  blosc_set_compressor("blosclz");
+  cbytes = blosc_compress(5, BLOSC_NOSHUFFLE, typesize, size, noise, comp,
+                          size + BLOSC_MAX_OVERHEAD);
+  mu_assert("ERROR: compression failed", cbytes == (int)size + BLOSC_MAX_OVERHEAD);
+  nbytes = blosc_decompress(comp, dest, size);
+  mu_assert("ERROR: decompression failed", nbytes == (int)size);
+
+  blosc_get_stats(&stats);
+  mu_assert("ERROR: fallback not counted", stats.memcpy_fallbacks == 1);
+  mu_assert("ERROR: no copy time", stats.copy_cycles > 0);
+  mu_assert("ERROR: no time in the filters", stats.filter_cycles == 0);
+
+  /* Compressible blocks mixed with incompressible ones store some
+     splits as is */
+  blosc_reset_stats();
+  memcpy(dest, noise, size / 2);
+  memcpy((uint8_t*)dest + size / 2, src, size / 2);
+  cbytes = blosc_compress(5, BLOSC_NOSHUFFLE, typesize, size, dest, comp,
+                          size + BLOSC_MAX_OVERHEAD);
+  mu_assert("ERROR: compression failed", cbytes > 0);
+  blosc_get_stats(&stats);
+  mu_assert("ERROR: incompressible splits not counted",
+            stats.incompressible_splits > 0);
+
+  return 0;
+}
+
+
+static const char *all_tests(void) {
+  mu_run_test(test_reset);
+  mu_run_test(test_phases);
+  mu_run_test(test_incompressible);
+
+  return 0;
+}
+
+#define BUFFER_ALIGN_SIZE   32
+
+int main(int argc, char **argv) {
+  const char *result;
+  blosc_stats stats;
+  size_t i;
+  uint32_t seed = 1;
+
+  printf("STARTING TESTS for %s", argv[0]);
+
+  blosc_init();
+  enabled = (blosc_get_stats(&stats) == 0);
+
+  /* Initialize buffers */
+  src = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  noise = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  dest = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  comp = blosc_test_malloc(BUFFER_ALIGN_SIZE, size + BLOSC_MAX_OVERHEAD);
+  for (i = 0; i < size / typesize; i++) {
+    src[i] = (int32_t)(i * 3 + (i % 17));
+    seed = seed * 1103515245 + 12345;
+    noise[i] = (int32_t)seed;
+  }
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != 0) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  blosc_test_free(src);
+  blosc_test_free(noise);
+  blosc_test_free(dest);
+  blosc_test_free(comp);
+  blosc_destroy();
+
+  return result != 0;
+}
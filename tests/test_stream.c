@@ -0,0 +1,236 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for compression and decompression streams.
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+int tests_run = 0;
+
+/* Global vars */
+uint8_t *src, *cdata, *dest;
+size_t size = 3 * 1000 * 1000 + 7;
+size_t csize, dsize;
+int nchunks;
+
+
+/* Sink gathering the compressed chunks in `cdata` */
+static int compressed_sink(const void *data, size_t nbytes, void *user_data) {
+  size_t *pos = (size_t *)user_data;
+
+  if (*pos + nbytes > size + 16 * BLOSC_MAX_OVERHEAD) {
+    return -1;
+  }
+  memcpy(cdata + *pos, data, nbytes);
+  *pos += nbytes;
+  nchunks++;
+  return 0;
+}
+
+/* Sink gathering the decompressed chunks in `dest` */
+static int decompressed_sink(const void *data, size_t nbytes, void *user_data) {
+  size_t *pos = (size_t *)user_data;
+
+  if (*pos + nbytes > size) {
+    return -1;
+  }
+  memcpy(dest + *pos, data, nbytes);
+  *pos += nbytes;
+  return 0;
+}
+
+/* Sink that always fails */
+static int failing_sink(const void *data, size_t nbytes, void *user_data) {
+  (void)data;
+  (void)nbytes;
+  (void)user_data;
+  return -42;
+}
+
+/* Size of the next piece to write: from 1 byte up to ~100 KB */
+static size_t piece_size(size_t i) {
+  return 1 + (i * 7919) % (100 * 1000);
+}
+
+
+/* Check a stream roundtrip with pieces of varying sizes */
+static const char *test_stream_roundtrip(void) {
+  blosc_cstream *cs;
+  blosc_dstream *ds;
+  size_t pos, n, i;
+  int nthreads;
+
+  for (nthreads = 1; nthreads <= 3; nthreads += 2) {
+    csize = 0;
+    nchunks = 0;
+    cs = blosc_cstream_new(5, BLOSC_SHUFFLE, 4, "blosclz", 256 * 1000,
+                           nthreads, compressed_sink, &csize);
+    mu_assert("ERROR: cannot create the compression stream", cs != NULL);
+    for (pos = 0, i = 0; pos < size; pos += n, i++) {
+      n = piece_size(i);
+      if (n > size - pos) {
+        n = size - pos;
+      }
+      mu_assert("ERROR: cannot write to the compression stream",
+                blosc_cstream_write(cs, src + pos, n) == 0);
+    }
+    mu_assert("ERROR: cannot free the compression stream",
+              blosc_cstream_free(cs) == 0);
+    mu_assert("ERROR: bad number of chunks", nchunks == (int)(size / (256 * 1000)) + 1);
+    mu_assert("ERROR: data not compressed", csize < size);
+
+    /* Pieces of the compressed stream, even in the middle of headers */
+    dsize = 0;
+    memset(dest, 0, size);
+    ds = blosc_dstream_new(nthreads, decompressed_sink, &dsize);
+    mu_assert("ERROR: cannot create the decompression stream", ds != NULL);
+    for (pos = 0, i = 0; pos < csize; pos += n, i++) {
+      n = piece_size(i) % 5000 + 1;
+      if (n > csize - pos) {
+        n = csize - pos;
+      }
+      mu_assert("ERROR: cannot write to the decompression stream",
+                blosc_dstream_write(ds, cdata + pos, n) == 0);
+    }
+    mu_assert("ERROR: cannot free the decompression stream",
+              blosc_dstream_free(ds) == 0);
+    mu_assert("ERROR: bad decompressed size", dsize == size);
+    mu_assert("ERROR: bad roundtrip", memcmp(src, dest, size) == 0);
+
+    /* The whole compressed stream in one go */
+    dsize = 0;
+    ds = blosc_dstream_new(nthreads, decompressed_sink, &dsize);
+    mu_assert("ERROR: cannot write to the decompression stream",
+              blosc_dstream_write(ds, cdata, csize) == 0);
+    mu_assert("ERROR: cannot free the decompression stream",
+              blosc_dstream_free(ds) == 0);
+    mu_assert("ERROR: bad decompressed size (one go)", dsize == size);
+    mu_assert("ERROR: bad roundtrip (one go)", memcmp(src, dest, size) == 0);
+  }
+
+  return 0;
+}
+
+
+/* Check that explicit flushes produce valid chunks */
+static const char *test_stream_flush(void) {
+  blosc_cstream *cs;
+  blosc_dstream *ds;
+
+  csize = 0;
+  nchunks = 0;
+  cs = blosc_cstream_new(5, BLOSC_SHUFFLE, 4, "blosclz", 0, 1,
+                         compressed_sink, &csize);
+  mu_assert("ERROR: cannot create the compression stream", cs != NULL);
+  mu_assert("ERROR: cannot write", blosc_cstream_write(cs, src, 1000) == 0);
+  mu_assert("ERROR: cannot flush", blosc_cstream_flush(cs) == 0);
+  mu_assert("ERROR: flush did not emit a chunk", nchunks == 1);
+  mu_assert("ERROR: empty flush failed", blosc_cstream_flush(cs) == 0);
+  mu_assert("ERROR: empty flush emitted a chunk", nchunks == 1);
+  mu_assert("ERROR: cannot write", blosc_cstream_write(cs, src + 1000, 3) == 0);
+  mu_assert("ERROR: cannot free", blosc_cstream_free(cs) == 0);
+  mu_assert("ERROR: free did not emit a chunk", nchunks == 2);
+
+  dsize = 0;
+  ds = blosc_dstream_new(1, decompressed_sink, &dsize);
+  mu_assert("ERROR: cannot write to the decompression stream",
+            blosc_dstream_write(ds, cdata, csize) == 0);
+  mu_assert("ERROR: cannot free the decompression stream",
+            blosc_dstream_free(ds) == 0);
+  mu_assert("ERROR: bad decompressed size", dsize == 1003);
+  mu_assert("ERROR: bad roundtrip", memcmp(src, dest, 1003) == 0);
+
+  return 0;
+}
+
+
+/* Check errors */
+static const char *test_stream_errors(void) {
+  blosc_cstream *cs;
+  blosc_dstream *ds;
+  uint8_t garbage[64];
+
+  /* Sink errors are reported */
+  cs = blosc_cstream_new(5, BLOSC_SHUFFLE, 4, "blosclz", 1000, 1,
+                         failing_sink, NULL);
+  mu_assert("ERROR: cannot create the compression stream", cs != NULL);
+  blosc_cstream_write(cs, src, 5000);
+  mu_assert("ERROR: sink error not reported", blosc_cstream_free(cs) == -42);
+
+  mu_assert("ERROR: bad compressor accepted",
+            blosc_cstream_new(5, BLOSC_SHUFFLE, 4, "nocomp", 0, 1,
+                              compressed_sink, &csize) == NULL);
+  mu_assert("ERROR: missing sink accepted",
+            blosc_cstream_new(5, BLOSC_SHUFFLE, 4, "blosclz", 0, 1,
+                              NULL, NULL) == NULL);
+
+  /* Garbage and truncated chunks */
+  memset(garbage, 0xff, sizeof(garbage));
+  ds = blosc_dstream_new(1, decompressed_sink, &dsize);
+  mu_assert("ERROR: garbage accepted",
+            blosc_dstream_write(ds, garbage, sizeof(garbage)) < 0);
+  mu_assert("ERROR: error not kept", blosc_dstream_free(ds) < 0);
+
+  csize = 0;
+  cs = blosc_cstream_new(5, BLOSC_SHUFFLE, 4, "blosclz", 0, 1,
+                         compressed_sink, &csize);
+  blosc_cstream_write(cs, src, 10000);
+  blosc_cstream_free(cs);
+  dsize = 0;
+  ds = blosc_dstream_new(1, decompressed_sink, &dsize);
+  mu_assert("ERROR: cannot write a partial chunk",
+            blosc_dstream_write(ds, cdata, csize - 1) == 0);
+  mu_assert("ERROR: partial chunk decompressed", dsize == 0);
+  mu_assert("ERROR: truncated stream accepted", blosc_dstream_free(ds) < 0);
+
+  return 0;
+}
+
+
+static const char *all_tests(void) {
+  mu_run_test(test_stream_roundtrip);
+  mu_run_test(test_stream_flush);
+  mu_run_test(test_stream_errors);
+
+  return 0;
+}
+
+#define BUFFER_ALIGN_SIZE   32
+
+int main(int argc, char **argv) {
+  const char *result;
+  size_t i;
+
+  printf("STARTING TESTS for %s", argv[0]);
+
+  blosc_init();
+
+  /* Initialize buffers */
+  src = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  cdata = blosc_test_malloc(BUFFER_ALIGN_SIZE, size + 16 * BLOSC_MAX_OVERHEAD);
+  dest = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  for (i = 0; i < size; i++) {
+    src[i] = (uint8_t)((i / 4) % 97 + (i % 4 == 0 ? i / 10000 : 0));
+  }
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != 0) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  blosc_test_free(src);
+  blosc_test_free(cdata);
+  blosc_test_free(dest);
+
+  blosc_destroy();
+
+  return result != 0;
+}
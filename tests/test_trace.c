@@ -0,0 +1,239 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for the trace callback.
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+int tests_run = 0;
+
+/* Global vars */
+int32_t *src, *noise, *dest;
+uint8_t *comp;
+size_t size = 1024 * 1024;      /* must be divisible by 4 */
+size_t typesize = 4;
+size_t blocksize = 32 * 1024;
+
+#define NBLOCKS 64              /* enough for any blocksize */
+#define NEVENTS 5
+
+/* Events seen, by thread (the calling one first) and type.  Every
+   thread only updates its own row and its own blocks. */
+int events[BLOSC_MAX_THREADS + 1][NEVENTS];
+int block_starts[NBLOCKS], block_ends[NBLOCKS];
+int block_codecs[NBLOCKS];
+int64_t block_results[NBLOCKS];
+int64_t chunk_nbytes, chunk_result;
+int calls_user_data;
+
+
+static void callback(const blosc_trace_event* event, void* user_data) {
+  if (user_data != &calls_user_data || event->tid < -1 ||
+      event->tid >= BLOSC_MAX_THREADS || event->type < 0 ||
+      event->type >= NEVENTS) {
+    return;
+  }
+  events[event->tid + 1][event->type]++;
+  switch (event->type) {
+    case BLOSC_TRACE_CHUNK_END:
+      chunk_nbytes = event->nbytes;
+      chunk_result = event->result;
+      break;
+    case BLOSC_TRACE_BLOCK_START:
+      if (event->nblock >= 0 && event->nblock < NBLOCKS) {
+        block_starts[event->nblock]++;
+      }
+      break;
+    case BLOSC_TRACE_BLOCK_END:
+      if (event->nblock >= 0 && event->nblock < NBLOCKS) {
+        block_ends[event->nblock]++;
+        block_codecs[event->nblock] = event->codec;
+        block_results[event->nblock] = event->result;
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+static void clear_events(void) {
+  memset(events, 0, sizeof(events));
+  memset(block_starts, 0, sizeof(block_starts));
+  memset(block_ends, 0, sizeof(block_ends));
+  memset(block_codecs, 0, sizeof(block_codecs));
+  memset(block_results, 0, sizeof(block_results));
+  chunk_nbytes = chunk_result = 0;
+}
+
+/* Total of the events of `type` in the pool threads */
+static int pool_events(int type) {
+  int t, n = 0;
+
+  for (t = 1; t <= BLOSC_MAX_THREADS; t++) {
+    n += events[t][type];
+  }
+  return n;
+}
+
+/* Check that there was one chunk producing `result` bytes and that
+   every block of `comp` was traced once, with `codec` */
+static const char *check_events(int64_t result, int codec, int nthreads) {
+  size_t nbytes, cbytes, bsize;
+  int j, nblocks;
+
+  blosc_cbuffer_sizes(comp, &nbytes, &cbytes, &bsize);
+  nblocks = (int)((nbytes + bsize - 1) / bsize);
+  mu_assert("ERROR: too many blocks", nblocks <= NBLOCKS);
+
+  mu_assert("ERROR: not one chunk",
+            events[0][BLOSC_TRACE_CHUNK_START] == 1 &&
+            events[0][BLOSC_TRACE_CHUNK_END] == 1);
+  mu_assert("ERROR: chunk events in the pool",
+            pool_events(BLOSC_TRACE_CHUNK_START) == 0 &&
+            pool_events(BLOSC_TRACE_CHUNK_END) == 0);
+  mu_assert("ERROR: bad chunk sizes",
+            chunk_nbytes == (int64_t)size && chunk_result == result);
+  for (j = 0; j < nblocks; j++) {
+    mu_assert("ERROR: block not traced once",
+              block_starts[j] == 1 && block_ends[j] == 1);
+    mu_assert("ERROR: bad codec", block_codecs[j] == codec);
+    mu_assert("ERROR: bad block result", block_results[j] > 0);
+  }
+  if (nthreads == 1) {
+    mu_assert("ERROR: block events in the pool",
+              events[0][BLOSC_TRACE_BLOCK_END] == nblocks &&
+              pool_events(BLOSC_TRACE_THREAD_WAKEUP) == 0);
+  }
+  else {
+    mu_assert("ERROR: block events out of the pool",
+              pool_events(BLOSC_TRACE_BLOCK_END) == nblocks &&
+              pool_events(BLOSC_TRACE_THREAD_WAKEUP) > 0);
+  }
+
+  return 0;
+}
+
+
+/* Check the events of a roundtrip, serial and with threads */
+static const char *test_roundtrip(void) {
+  const char* result;
+  int cbytes, nbytes, nthreads;
+
+  for (nthreads = 1; nthreads <= 4; nthreads += 3) {
+    clear_events();
+    cbytes = blosc_compress_ctx(5, BLOSC_SHUFFLE, typesize, size, src, comp,
+                                size + BLOSC_MAX_OVERHEAD, "lz4", blocksize,
+                                nthreads);
+    mu_assert("ERROR: compression failed", cbytes > 0 && cbytes < (int)size);
+    result = check_events(cbytes, BLOSC_LZ4_FORMAT, nthreads);
+    if (result != 0) {
+      return result;
+    }
+
+    clear_events();
+    nbytes = blosc_decompress_ctx(comp, dest, size, nthreads);
+    mu_assert("ERROR: decompression failed", nbytes == (int)size);
+    mu_assert("ERROR: roundtrip failed", memcmp(src, dest, size) == 0);
+    result = check_events(nbytes, BLOSC_LZ4_FORMAT, nthreads);
+    if (result != 0) {
+      return result;
+    }
+  }
+
+  return 0;
+}
+
+
+/* Check that blocks stored as is have no codec */
+static const char *test_memcpyed(void) {
+  const char* result;
+  int cbytes, nbytes;
+
+  cbytes = blosc_compress_ctx(5, BLOSC_NOSHUFFLE, typesize, size, noise, comp,
+                              size + BLOSC_MAX_OVERHEAD, "blosclz", blocksize,
+                              1);
+  mu_assert("ERROR: compression failed",
+            cbytes == (int)size + BLOSC_MAX_OVERHEAD);
+  clear_events();
+  nbytes = blosc_decompress_ctx(comp, dest, size, 1);
+  mu_assert("ERROR: decompression failed", nbytes == (int)size);
+  result = check_events(nbytes, -1, 1);
+  if (result != 0) {
+    return result;
+  }
+
+  return 0;
+}
+
+
+/* Check that no events are passed once the callback is removed */
+static const char *test_remove(void) {
+  int cbytes;
+
+  blosc_set_trace_callback(NULL, NULL);
+  clear_events();
+  cbytes = blosc_compress_ctx(5, BLOSC_SHUFFLE, typesize, size, src, comp,
+                              size + BLOSC_MAX_OVERHEAD, "blosclz", 0, 4);
+  mu_assert("ERROR: compression failed", cbytes > 0);
+  mu_assert("ERROR: events after removing the callback",
+            events[0][BLOSC_TRACE_CHUNK_START] == 0 &&
+            pool_events(BLOSC_TRACE_BLOCK_START) == 0);
+  blosc_set_trace_callback(callback, &calls_user_data);
+
+  return 0;
+}
+
+
+static const char *all_tests(void) {
+  mu_run_test(test_roundtrip);
+  mu_run_test(test_memcpyed);
+  mu_run_test(test_remove);
+
+  return 0;
+}
+
+#define BUFFER_ALIGN_SIZE   32
+
+int main(int argc, char **argv) {
+  const char *result;
+  size_t i;
+  uint32_t seed = 1;
+
+  printf("STARTING TESTS for %s", argv[0]);
+
+  blosc_init();
+  blosc_set_trace_callback(callback, &calls_user_data);
+
+  /* Initialize buffers */
+  src = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  noise = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  dest = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  comp = blosc_test_malloc(BUFFER_ALIGN_SIZE, size + BLOSC_MAX_OVERHEAD);
+  for (i = 0; i < size / typesize; i++) {
+    src[i] = (int32_t)(i * 3 + (i % 17));
+    seed = seed * 1103515245 + 12345;
+    noise[i] = (int32_t)seed;
+  }
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != 0) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  blosc_set_trace_callback(NULL, NULL);
+  blosc_test_free(src);
+  blosc_test_free(noise);
+  blosc_test_free(dest);
+  blosc_test_free(comp);
+  blosc_destroy();
+
+  return result != 0;
+}
@@ -0,0 +1,176 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for the views of the data stored as is in compressed
+  buffers.
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+int tests_run = 0;
+
+/* Global vars */
+uint8_t *src, *noise, *comp;
+size_t size = 1024 * 1024;
+size_t blocksize = 64 * 1024;
+
+
+/* Check the view of a memcpyed buffer */
+static const char *test_memcpyed(void) {
+  const void* data;
+  size_t nbytes, csize, bsize;
+  int cbytes, rc;
+
+  cbytes = blosc_compress_ctx(0, BLOSC_SHUFFLE, 4, size, src, comp,
+                              size + BLOSC_MAX_OVERHEAD, "blosclz", 0, 1);
+  mu_assert("ERROR: compression failed", cbytes > 0);
+  rc = blosc_cbuffer_view(comp, (size_t)cbytes, &data, &nbytes);
+  mu_assert("ERROR: no view of a memcpyed buffer", rc == 1);
+  mu_assert("ERROR: view not inside the buffer",
+            (const uint8_t*)data == comp + BLOSC_MAX_OVERHEAD);
+  mu_assert("ERROR: bad view", nbytes == size && memcmp(data, src, size) == 0);
+
+  blosc_cbuffer_sizes(comp, &nbytes, &csize, &bsize);
+  rc = blosc_cbuffer_block_view(comp, (size_t)cbytes, 3, &data, &nbytes);
+  mu_assert("ERROR: no view of a block of a memcpyed buffer", rc == 1);
+  mu_assert("ERROR: bad view of a block", nbytes == bsize &&
+            memcmp(data, src + 3 * bsize, bsize) == 0);
+
+  mu_assert("ERROR: wrong size accepted",
+            blosc_cbuffer_view(comp, (size_t)cbytes - 1, &data, &nbytes) < 0);
+  mu_assert("ERROR: block out of range accepted",
+            blosc_cbuffer_block_view(comp, (size_t)cbytes, 1 << 20, &data,
+                                     &nbytes) < 0);
+
+  return 0;
+}
+
+
+/* Check that the checksums are verified */
+static const char *test_checksums(void) {
+  const void* data;
+  size_t nbytes;
+  int cbytes;
+
+  blosc_set_checksum(1);
+  cbytes = blosc_compress_ctx(5, BLOSC_NOSHUFFLE, 1, size, noise, comp,
+                              size + BLOSC_MAX_OVERHEAD_CHECKSUMS(size),
+                              "lz4", blocksize, 1);
+  blosc_set_checksum(0);
+  mu_assert("ERROR: compression failed", cbytes > 0);
+  mu_assert("ERROR: no view of a checksummed buffer",
+            blosc_cbuffer_view(comp, (size_t)cbytes, &data, &nbytes) == 1);
+  mu_assert("ERROR: bad view", nbytes == size && memcmp(data, noise, size) == 0);
+
+  comp[BLOSC_MAX_OVERHEAD + 100] ^= 1;
+  mu_assert("ERROR: corrupted buffer accepted",
+            blosc_cbuffer_view(comp, (size_t)cbytes, &data, &nbytes) < 0);
+  mu_assert("ERROR: corrupted block accepted",
+            blosc_cbuffer_block_view(comp, (size_t)cbytes, 0, &data,
+                                     &nbytes) < 0);
+  mu_assert("ERROR: intact block rejected",
+            blosc_cbuffer_block_view(comp, (size_t)cbytes, 1, &data,
+                                     &nbytes) == 1);
+
+  return 0;
+}
+
+
+/* Check the views of the blocks of a compressed buffer: only the
+   incompressible ones are stored as is */
+static const char *test_raw_blocks(void) {
+  const void* data;
+  size_t nbytes, j;
+  int cbytes, rc;
+  static const int filters[] = {BLOSC_NOSHUFFLE, BLOSC_AUTOSHUFFLE};
+  size_t f;
+
+  for (f = 0; f < sizeof(filters) / sizeof(filters[0]); f++) {
+    /* Compressible blocks alternate with incompressible ones */
+    for (j = 0; j < size / blocksize; j++) {
+      memcpy(comp, (j % 2) ? noise : src, blocksize);
+      memcpy(src + size + j * blocksize, comp, blocksize);
+    }
+    cbytes = blosc_compress_ctx(5, filters[f], 1, size, src + size, comp,
+                                size + BLOSC_MAX_OVERHEAD, "lz4", blocksize, 1);
+    mu_assert("ERROR: compression failed", cbytes > 0 && cbytes < (int)size);
+    mu_assert("ERROR: view of a compressed buffer",
+              blosc_cbuffer_view(comp, (size_t)cbytes, &data, &nbytes) == 0 &&
+              data == NULL);
+
+    for (j = 0; j < size / blocksize; j++) {
+      rc = blosc_cbuffer_block_view(comp, (size_t)cbytes, (int)j, &data, &nbytes);
+      if (j % 2) {
+        mu_assert("ERROR: no view of a raw block", rc == 1);
+        mu_assert("ERROR: view not inside the buffer",
+                  (const uint8_t*)data > comp &&
+                  (const uint8_t*)data + nbytes <= comp + cbytes);
+        mu_assert("ERROR: bad view of a raw block", nbytes == blocksize &&
+                  memcmp(data, src + size + j * blocksize, blocksize) == 0);
+      }
+      else {
+        mu_assert("ERROR: view of a compressed block", rc == 0);
+      }
+    }
+  }
+
+  /* Shuffled blocks cannot be viewed */
+  cbytes = blosc_compress_ctx(5, BLOSC_SHUFFLE, 4, size, src + size, comp,
+                              size + BLOSC_MAX_OVERHEAD, "lz4", blocksize, 1);
+  mu_assert("ERROR: compression failed", cbytes > 0 && cbytes < (int)size);
+  mu_assert("ERROR: view of a shuffled block",
+            blosc_cbuffer_block_view(comp, (size_t)cbytes, 1, &data,
+                                     &nbytes) == 0);
+
+  return 0;
+}
+
+
+static const char *all_tests(void) {
+  mu_run_test(test_memcpyed);
+  mu_run_test(test_checksums);
+  mu_run_test(test_raw_blocks);
+
+  return 0;
+}
+
+#define BUFFER_ALIGN_SIZE   32
+
+int main(int argc, char **argv) {
+  const char *result;
+  size_t i;
+  uint32_t seed = 1;
+
+  printf("STARTING TESTS for %s", argv[0]);
+
+  blosc_init();
+
+  /* Initialize buffers (the second half of src is for mixed data) */
+  src = blosc_test_malloc(BUFFER_ALIGN_SIZE, 2 * size);
+  noise = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  comp = blosc_test_malloc(BUFFER_ALIGN_SIZE, 2 * size + BLOSC_MAX_OVERHEAD);
+  for (i = 0; i < size; i++) {
+    src[i] = (uint8_t)(i % 7);
+    seed = seed * 1103515245 + 12345;
+    noise[i] = (uint8_t)(seed >> 24);
+  }
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != 0) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  blosc_test_free(src);
+  blosc_test_free(noise);
+  blosc_test_free(comp);
+  blosc_destroy();
+
+  return result != 0;
+}
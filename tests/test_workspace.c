@@ -0,0 +1,234 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for the entry points with caller-provided scratch memory.
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+int tests_run = 0;
+
+/* Global vars */
+int32_t *src, *dest, *dest2;
+uint8_t *comp, *workspace;
+size_t size = 1024 * 1024;      /* must be divisible by 4 */
+size_t typesize = 4;
+size_t blocksize = 64 * 1024;
+int wssize;
+/* Large enough for any blocksize of the buffers in these tests */
+size_t maxwssize;
+
+
+/* Check that the sizes of the workspaces for compression and
+   decompression agree */
+static const char *test_sizes(void) {
+  int cbytes;
+
+  wssize = blosc_compress_workspace_size(5, BLOSC_SHUFFLE, typesize, size,
+                                         "blosclz", blocksize);
+  mu_assert("ERROR: compression workspace size not computed",
+            wssize >= (int)(3 * blocksize));
+  mu_assert("ERROR: invalid parameters should be rejected",
+            blosc_compress_workspace_size(10, BLOSC_SHUFFLE, typesize, size,
+                                          "blosclz", blocksize) < 0);
+
+  cbytes = blosc_compress_ctx(5, BLOSC_SHUFFLE, typesize, size, src, comp,
+                              size + BLOSC_MAX_OVERHEAD, "blosclz", blocksize, 1);
+  mu_assert("ERROR: compression failed", cbytes > 0);
+  mu_assert("ERROR: decompression workspace size does not match",
+            blosc_decompress_workspace_size(comp) == wssize);
+
+  return 0;
+}
+
+
+/* Check roundtrips of every codec, filter and some clevels reusing the
+   same workspace */
+static const char *test_roundtrip(void) {
+  static const char* compressors[] = {"blosclz", "lz4", "lz4hc", "snappy",
+                                      "zlib", "zstd"};
+  static const int filters[] = {BLOSC_NOSHUFFLE, BLOSC_SHUFFLE,
+                                BLOSC_BITSHUFFLE, BLOSC_AUTOSHUFFLE};
+  static const int clevels[] = {5, 9};
+  size_t c, f, l;
+  int cbytes, nbytes, needed;
+
+  for (c = 0; c < sizeof(compressors) / sizeof(compressors[0]); c++) {
+    if (blosc_compname_to_compcode(compressors[c]) < 0) {
+      continue;     /* not available in this build */
+    }
+    for (f = 0; f < sizeof(filters) / sizeof(filters[0]); f++) {
+      for (l = 0; l < sizeof(clevels) / sizeof(clevels[0]); l++) {
+        needed = blosc_compress_workspace_size(clevels[l], filters[f], typesize,
+                                               size, compressors[c], 0);
+        mu_assert("ERROR: workspace size not computed", needed > 0);
+        mu_assert("ERROR: workspace of the test too small",
+                  needed <= (int)maxwssize);
+        cbytes = blosc_compress_ctx_ws(clevels[l], filters[f], typesize, size,
+                                       src, comp, size + BLOSC_MAX_OVERHEAD,
+                                       compressors[c], 0, workspace,
+                                       (size_t)needed);
+        mu_assert("ERROR: compression with workspace failed", cbytes > 0);
+
+        needed = blosc_decompress_workspace_size(comp);
+        nbytes = blosc_decompress_ctx_ws(comp, dest, size, workspace,
+                                         (size_t)needed);
+        mu_assert("ERROR: decompression with workspace failed",
+                  nbytes == (int)size);
+        mu_assert("ERROR: roundtrip failed", memcmp(src, dest, size) == 0);
+      }
+    }
+  }
+
+  return 0;
+}
+
+
+/* Check that the workspace holds the tables of the high compression mode
+   of BloscLZ, and that the result does not depend on what it held */
+static const char *test_blosclz_hc(void) {
+  int cbytes, cbytes2, needed;
+
+  needed = blosc_compress_workspace_size(9, BLOSC_SHUFFLE, typesize, size,
+                                         "blosclz", blocksize);
+  mu_assert("ERROR: no room for the tables of BloscLZ", needed > wssize);
+  mu_assert("ERROR: workspace of the test too small", needed <= (int)maxwssize);
+  cbytes = blosc_compress_ctx_ws(9, BLOSC_SHUFFLE, typesize, size, src, comp,
+                                 size + BLOSC_MAX_OVERHEAD, "blosclz",
+                                 blocksize, workspace, (size_t)needed - 1);
+  mu_assert("ERROR: small workspace accepted for BloscLZ", cbytes < 0);
+
+  /* Stale contents of the workspace must not matter */
+  memset(workspace, 0xff, (size_t)needed);
+  cbytes = blosc_compress_ctx_ws(9, BLOSC_SHUFFLE, typesize, size, src, comp,
+                                 size + BLOSC_MAX_OVERHEAD, "blosclz",
+                                 blocksize, workspace, (size_t)needed);
+  mu_assert("ERROR: compression with workspace failed",
+            cbytes > 0 && cbytes < (int)size);
+  cbytes2 = blosc_compress_ctx(9, BLOSC_SHUFFLE, typesize, size, src, dest2,
+                               size, "blosclz", blocksize, 1);
+  mu_assert("ERROR: results with and without workspace differ",
+            cbytes2 == cbytes && memcmp(comp, dest2, (size_t)cbytes) == 0);
+  mu_assert("ERROR: decompression failed",
+            blosc_decompress_ctx(comp, dest, size, 1) == (int)size);
+  mu_assert("ERROR: roundtrip failed", memcmp(src, dest, size) == 0);
+
+  return 0;
+}
+
+
+/* Check that getitem with a workspace returns the same as without */
+static const char *test_getitem(void) {
+  static const int starts[] = {0, 1, 16383, 16384, 100000, 262143};
+  size_t i;
+  int cbytes, nitems, ret;
+
+  cbytes = blosc_compress_ctx(5, BLOSC_SHUFFLE, typesize, size, src, comp,
+                              size + BLOSC_MAX_OVERHEAD, "lz4", blocksize, 1);
+  mu_assert("ERROR: compression failed", cbytes > 0);
+
+  for (i = 0; i < sizeof(starts) / sizeof(starts[0]); i++) {
+    nitems = (int)(size / typesize) - starts[i];
+    if (nitems > 50000) {
+      nitems = 50000;
+    }
+    ret = blosc_getitem_ws(comp, starts[i], nitems, dest, workspace,
+                           (size_t)wssize);
+    mu_assert("ERROR: getitem with workspace failed",
+              ret == nitems * (int)typesize);
+    ret = blosc_getitem(comp, starts[i], nitems, dest2);
+    mu_assert("ERROR: getitem failed", ret == nitems * (int)typesize);
+    mu_assert("ERROR: getitem results differ",
+              memcmp(dest, dest2, (size_t)ret) == 0);
+    mu_assert("ERROR: bad items", memcmp(dest, src + starts[i], (size_t)ret) == 0);
+  }
+
+  return 0;
+}
+
+
+/* Check that a too small workspace is rejected and NULL falls back to
+   allocating the scratch memory */
+static const char *test_small_workspace(void) {
+  int cbytes, nbytes;
+
+  cbytes = blosc_compress_ctx_ws(5, BLOSC_SHUFFLE, typesize, size, src, comp,
+                                 size + BLOSC_MAX_OVERHEAD, "blosclz",
+                                 blocksize, workspace, (size_t)wssize - 1);
+  mu_assert("ERROR: small workspace accepted for compression", cbytes < 0);
+
+  cbytes = blosc_compress_ctx_ws(5, BLOSC_SHUFFLE, typesize, size, src, comp,
+                                 size + BLOSC_MAX_OVERHEAD, "blosclz",
+                                 blocksize, NULL, 0);
+  mu_assert("ERROR: compression without workspace failed", cbytes > 0);
+
+  nbytes = blosc_decompress_ctx_ws(comp, dest, size, workspace,
+                                   (size_t)wssize - 1);
+  mu_assert("ERROR: small workspace accepted for decompression", nbytes < 0);
+  mu_assert("ERROR: small workspace accepted for getitem",
+            blosc_getitem_ws(comp, 0, 10, dest, workspace,
+                             (size_t)wssize - 1) < 0);
+
+  nbytes = blosc_decompress_ctx_ws(comp, dest, size, NULL, 0);
+  mu_assert("ERROR: decompression without workspace failed", nbytes == (int)size);
+  mu_assert("ERROR: roundtrip failed", memcmp(src, dest, size) == 0);
+
+  return 0;
+}
+
+
+static const char *all_tests(void) {
+  mu_run_test(test_sizes);
+  mu_run_test(test_roundtrip);
+  mu_run_test(test_blosclz_hc);
+  mu_run_test(test_getitem);
+  mu_run_test(test_small_workspace);
+
+  return 0;
+}
+
+#define BUFFER_ALIGN_SIZE   32
+
+int main(int argc, char **argv) {
+  const char *result;
+  size_t i;
+
+  printf("STARTING TESTS for %s", argv[0]);
+
+  blosc_init();
+
+  /* Initialize buffers */
+  src = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  dest = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  dest2 = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  comp = blosc_test_malloc(BUFFER_ALIGN_SIZE, size + BLOSC_MAX_OVERHEAD);
+  /* Blocks up to `size`, plus the padding that keeps the buffers aligned
+     and the tables of BloscLZ from clevel 8 on */
+  maxwssize = 3 * size + typesize * sizeof(int32_t) + 2 * BUFFER_ALIGN_SIZE +
+              256 * 1024;
+  workspace = blosc_test_malloc(BUFFER_ALIGN_SIZE, maxwssize);
+  for (i = 0; i < size / typesize; i++) {
+    src[i] = (int32_t)(i * 3 + (i % 17));
+  }
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != 0) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  blosc_test_free(src);
+  blosc_test_free(dest);
+  blosc_test_free(dest2);
+  blosc_test_free(comp);
+  blosc_test_free(workspace);
+  blosc_destroy();
+
+  return result != 0;
+}